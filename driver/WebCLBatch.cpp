@@ -0,0 +1,375 @@
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include "WebCLBatch.hpp"
+#include "WebCLHeader.hpp"
+
+#include <clv/clv.h>
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/Timer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#if LLVM_ENABLE_THREADS && defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#define WEBCL_THREADS 1
+#endif
+
+namespace {
+    double getWallTime()
+    {
+        return llvm::TimeRecord::getCurrentTime().getWallTime();
+    }
+
+    long getMilliseconds(double seconds)
+    {
+        return static_cast<long>(seconds * 1000.0 + 0.5);
+    }
+}
+
+WebCLSettings::WebCLSettings()
+    : includedSource()
+    , extensions()
+    , userDefines()
+    , options()
+    , trapStatus(false)
+    , checkCounters(false)
+    , reports(false)
+    , sourceMap(false)
+{
+}
+
+bool readAll(std::ifstream &from, std::string &to)
+{
+    from.seekg(0, std::ios::end);
+    to.resize(from.tellg());
+    from.seekg(0, std::ios::beg);
+    return !from.read(&to[0], to.size()).fail();
+}
+
+bool readManifest(const std::string &manifest, std::vector<std::string> &inputs)
+{
+    std::ifstream ifs(manifest.c_str());
+    if (!ifs.good())
+        return false;
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        // tolerate manifests with DOS line endings
+        if (!line.empty() && (line[line.size() - 1] == '\r'))
+            line.erase(line.size() - 1);
+        if (!line.empty() && (line[0] != '#'))
+            inputs.push_back(line);
+    }
+    return !ifs.bad();
+}
+
+bool validateSource(
+    const std::string &source, const WebCLSettings &settings,
+    std::ostream &log, std::ostream &output)
+{
+    // The library doesn't take const lists.
+    std::vector<const char *> extensions(settings.extensions);
+    std::vector<const char *> userDefines(settings.userDefines);
+
+    // Run validator
+    cl_int err = CL_SUCCESS;
+    clv_program prog = clvValidateWithOptions(
+        source.c_str(), &extensions[0], &userDefines[0], settings.options.c_str(), NULL, NULL, &err);
+    if (!prog) {
+        log << "Failed to call validator: " << err << '\n';
+        return false;
+    }
+
+    // Lines of the input file follow the included headers.
+    const cl_long includedLines =
+        std::count(settings.includedSource.begin(), settings.includedSource.end(), '\n');
+
+    // Print validation log
+    for (cl_int i = 0; i < clvGetProgramLogMessageCount(prog); i++) {
+        // Print line number in the input file
+        if (clvProgramLogMessageHasSource(prog, i)) {
+            const cl_long line = clvGetProgramLogMessageInputLine(prog, i);
+            if (line > includedLines)
+                log << "line " << (line - includedLines) << ": ";
+        }
+
+        // Print severity
+        switch (clvGetProgramLogMessageLevel(prog, i)) {
+        case CLV_LOG_MESSAGE_NOTE:
+            log << "note: ";
+            break;
+        case CLV_LOG_MESSAGE_WARNING:
+            log << "warning: ";
+            break;
+        case CLV_LOG_MESSAGE_ERROR:
+            log << "error: ";
+            break;
+        }
+
+        // Determine message text size
+        size_t textSize = 0;
+        err = clvGetProgramLogMessageText(prog, i, 0, NULL, &textSize);
+        assert(err == CL_SUCCESS);
+
+        // Get and print message text
+        std::string text(textSize, '\0');
+        err = clvGetProgramLogMessageText(prog, i, text.size(), &text[0], &textSize);
+        assert(err == CL_SUCCESS);
+        text.erase(text.size() - 1); // erase NUL
+        log << text << '\n';
+
+        // Print relevant source code
+        if (clvProgramLogMessageHasSource(prog, i)) {
+            std::string source(clvGetProgramLogMessageSourceLen(prog, i) + 1, '\0');
+            err = clvGetProgramLogMessageSourceText(
+                prog, i,
+                clvGetProgramLogMessageSourceOffset(prog, i), source.size() - 1,
+                source.size(), &source[0], NULL);
+            assert(err == CL_SUCCESS);
+            source.erase(source.size() - 1); // erase NUL
+            log << source << '\n';
+        }
+    }
+
+    bool accepted = false;
+    if (clvGetProgramStatus(prog) == CLV_PROGRAM_ACCEPTED ||
+        clvGetProgramStatus(prog) == CLV_PROGRAM_ACCEPTED_WITH_WARNINGS) {
+        // Success, print output
+        accepted = true;
+
+        // Print JSON header
+        WebCLHeader header(settings.trapStatus, settings.checkCounters,
+                           settings.reports, settings.sourceMap);
+        header.emitHeader(output, prog);
+
+        // Determine source size
+        size_t sourceSize = 0;
+        err = clvGetProgramValidatedSource(prog, 0, NULL, &sourceSize);
+        assert(err == CL_SUCCESS);
+
+        // Get source
+        std::string validatedSource(sourceSize, '\0');
+        err = clvGetProgramValidatedSource(prog, validatedSource.size(), &validatedSource[0], NULL);
+        assert(err == CL_SUCCESS);
+
+        // Strip terminating NUL, we don't need it
+        assert(validatedSource[validatedSource.size() - 1] == '\0');
+        validatedSource.erase(validatedSource.size() - 1);
+
+        // Print source
+        output << validatedSource;
+    }
+
+    clvReleaseProgram(prog);
+
+    return accepted;
+}
+
+WebCLBatch::Job::Job(const std::string &input, const std::string &output)
+    : input(input), output(output), accepted(false), seconds(0.0), log()
+{
+}
+
+struct WebCLBatch::Queue
+{
+    Queue(WebCLBatch &batch)
+        : batch(batch), next(0), mutex() {}
+
+    /// \return Next job to run, or NULL if all jobs have been taken.
+    Job *pop()
+    {
+        llvm::sys::ScopedLock lock(mutex);
+        return (next < batch.jobs_.size()) ? &batch.jobs_[next++] : NULL;
+    }
+
+    /// Prints the log of a finished job so that logs of different
+    /// jobs aren't mixed.
+    void print(const Job &job)
+    {
+        if (job.log.empty())
+            return;
+        llvm::sys::ScopedLock lock(mutex);
+        std::cerr << job.input << ":\n" << job.log << std::flush;
+    }
+
+    WebCLBatch &batch;
+    Jobs::size_type next;
+    llvm::sys::Mutex mutex;
+};
+
+WebCLBatch::WebCLBatch(const WebCLSettings &settings,
+                       const std::string &outputDirectory, unsigned threads)
+    : settings_(settings)
+    , outputDirectory_(outputDirectory)
+    , threads_(threads)
+    , jobs_()
+    , outputs_()
+{
+}
+
+WebCLBatch::~WebCLBatch()
+{
+}
+
+bool WebCLBatch::addInput(const std::string &input)
+{
+    const std::string::size_type separator = input.find_last_of("/\\");
+    const std::string filename =
+        (separator == std::string::npos) ? input : input.substr(separator + 1);
+    const std::string output = outputDirectory_ + "/" + filename;
+
+    if (!outputs_.insert(output).second)
+        return false;
+    jobs_.push_back(Job(input, output));
+    return true;
+}
+
+bool WebCLBatch::run(std::ostream &summary)
+{
+    const double start = getWallTime();
+    Queue queue(*this);
+
+#ifdef WEBCL_THREADS
+    std::vector<pthread_t> workers;
+    if ((threads_ > 1) && (jobs_.size() > 1))
+        llvm::llvm_start_multithreaded();
+    for (unsigned i = 1; (i < threads_) && (i < jobs_.size()); ++i) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, runJobs, &queue))
+            break;
+        workers.push_back(worker);
+    }
+#endif
+
+    // This thread takes jobs too, and runs all of them if threads
+    // aren't available.
+    runJobs(&queue);
+
+#ifdef WEBCL_THREADS
+    for (std::vector<pthread_t>::iterator i = workers.begin(); i != workers.end(); ++i)
+        pthread_join(*i, NULL);
+#endif
+
+    emitSummary(summary, getWallTime() - start);
+
+    for (Jobs::const_iterator i = jobs_.begin(); i != jobs_.end(); ++i) {
+        if (!i->accepted)
+            return false;
+    }
+    return true;
+}
+
+void WebCLBatch::runJob(Job &job) const
+{
+    const double start = getWallTime();
+    std::ostringstream log;
+
+    std::string source = settings_.includedSource;
+    std::ifstream ifs(job.input.c_str(), std::ios::binary);
+    std::string fileContents;
+    if (!ifs.good()) {
+        log << "Failed to open input file \"" << job.input << "\"\n";
+    } else if (!readAll(ifs, fileContents)) {
+        log << "Failed to read from input file \"" << job.input << "\"\n";
+    } else {
+        source.append(fileContents);
+
+        std::ostringstream output;
+        if (validateSource(source, settings_, log, output)) {
+            std::ofstream ofs(job.output.c_str(), std::ios::binary);
+            const std::string text = output.str();
+            job.accepted = ofs.write(text.data(), text.size()) && ofs.flush();
+            if (!job.accepted)
+                log << "Failed to write output file \"" << job.output << "\"\n";
+        }
+    }
+
+    // Don't leave outputs of earlier runs behind.
+    if (!job.accepted)
+        std::remove(job.output.c_str());
+
+    job.log = log.str();
+    job.seconds = getWallTime() - start;
+}
+
+void *WebCLBatch::runJobs(void *queue)
+{
+    Queue *jobs = static_cast<Queue*>(queue);
+    while (Job *job = jobs->pop()) {
+        jobs->batch.runJob(*job);
+        jobs->print(*job);
+    }
+    return NULL;
+}
+
+void WebCLBatch::emitString(std::ostream &out, const std::string &value) const
+{
+    out << "\"";
+    for (std::string::const_iterator i = value.begin(); i != value.end(); ++i) {
+        const unsigned char c = *i;
+        if ((c == '"') || (c == '\\'))
+            out << '\\' << c;
+        else if (c < ' ')
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+        else
+            out << c;
+    }
+    out << "\"";
+}
+
+void WebCLBatch::emitSummary(std::ostream &out, double seconds) const
+{
+    unsigned accepted = 0;
+    double validationSeconds = 0.0;
+    for (Jobs::const_iterator i = jobs_.begin(); i != jobs_.end(); ++i) {
+        accepted += i->accepted;
+        validationSeconds += i->seconds;
+    }
+
+    out << "{\n";
+    out << "    \"inputs\" : " << jobs_.size() << ",\n";
+    out << "    \"accepted\" : " << accepted << ",\n";
+    out << "    \"threads\" : " << threads_ << ",\n";
+    out << "    \"wall-ms\" : " << getMilliseconds(seconds) << ",\n";
+    out << "    \"validation-ms\" : " << getMilliseconds(validationSeconds) << ",\n";
+    out << "    \"results\" : [";
+    for (Jobs::const_iterator i = jobs_.begin(); i != jobs_.end(); ++i) {
+        out << ((i == jobs_.begin()) ? "\n" : ",\n");
+        out << "        { \"input\" : ";
+        emitString(out, i->input);
+        out << ", \"output\" : ";
+        emitString(out, i->output);
+        out << ", \"accepted\" : " << (i->accepted ? "true" : "false");
+        out << ", \"ms\" : " << getMilliseconds(i->seconds) << " }";
+    }
+    out << "\n    ]\n";
+    out << "}\n";
+}
@@ -0,0 +1,143 @@
+#ifndef WEBCLVALIDATOR_WEBCLBATCH
+#define WEBCLVALIDATOR_WEBCLBATCH
+
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+/// Command line settings that are the same for each validated input.
+struct WebCLSettings
+{
+    WebCLSettings();
+
+    /// Contents of -include files, prepended to each input.
+    std::string includedSource;
+    /// NULL terminated list of enabled extensions.
+    std::vector<const char *> extensions;
+    /// NULL terminated list of user defines without -D.
+    std::vector<const char *> userDefines;
+    /// Code generation options for clvValidateWithOptions.
+    std::string options;
+    /// Whether kernels have a trailing status word parameter.
+    bool trapStatus;
+    /// Whether kernels have a trailing check counter parameter.
+    bool checkCounters;
+    /// Whether to emit instrumentation reports in the JSON header.
+    bool reports;
+    /// Whether to emit the source map in the JSON header.
+    bool sourceMap;
+};
+
+/// Reads the rest of the file.
+///
+/// \return Whether the file could be read.
+bool readAll(std::ifstream &from, std::string &to);
+
+/// Reads the input files listed in a manifest file, one on each
+/// line. Empty lines and lines starting with '#' are skipped.
+///
+/// \return Whether the manifest could be read.
+bool readManifest(const std::string &manifest, std::vector<std::string> &inputs);
+
+/// Validates the source. The validation log is written to the log
+/// stream. If the source is accepted, the JSON header and the
+/// validated source are written to the output stream.
+///
+/// \return Whether the source was accepted.
+bool validateSource(
+    const std::string &source, const WebCLSettings &settings,
+    std::ostream &log, std::ostream &output);
+
+/// \brief Validates many input files with one process.
+///
+/// Inputs are validated in parallel with the given number of
+/// threads. The output of each accepted input, i.e. the JSON header
+/// and the validated source, is written to a file with the same name
+/// in the output directory. Logs are written to standard error as
+/// soon as an input has been validated. A JSON summary with
+/// validation times is written after all inputs have been validated.
+class WebCLBatch
+{
+public:
+
+    WebCLBatch(const WebCLSettings &settings,
+               const std::string &outputDirectory, unsigned threads);
+    ~WebCLBatch();
+
+    /// Adds an input file.
+    ///
+    /// \return Whether the output file name of the input is unique.
+    bool addInput(const std::string &input);
+
+    /// Validates all inputs and writes the summary.
+    ///
+    /// \return Whether all inputs were accepted.
+    bool run(std::ostream &summary);
+
+private:
+
+    /// Validation of one input.
+    struct Job
+    {
+        Job(const std::string &input, const std::string &output);
+
+        std::string input;
+        std::string output;
+        bool accepted;
+        double seconds;
+        /// Diagnostics of the validation.
+        std::string log;
+    };
+    typedef std::vector<Job> Jobs;
+
+    /// Jobs that threads take in turns.
+    struct Queue;
+
+    /// Validates an input and writes its output file.
+    void runJob(Job &job) const;
+    /// Entry point of threads.
+    static void *runJobs(void *queue);
+
+    /// Writes a JSON string with special characters escaped.
+    void emitString(std::ostream &out, const std::string &value) const;
+    /// Writes the outcome and timings of all jobs.
+    void emitSummary(std::ostream &out, double seconds) const;
+
+    /// Settings of each input.
+    const WebCLSettings &settings_;
+    /// Directory of output files.
+    const std::string outputDirectory_;
+    /// Number of threads that validate inputs.
+    unsigned threads_;
+    /// Inputs in the order in which they were added.
+    Jobs jobs_;
+    /// Output files of the inputs.
+    std::set<std::string> outputs_;
+};
+
+#endif // WEBCLVALIDATOR_WEBCLBATCH
@@ -31,10 +31,18 @@ static const char *image2d = "image2d_t";
 static const char *sizeParameterPrefix = "_wcl";
 // must be the same as WebCLConfiguration::sizeParameterType_
 static const char *sizeParameterType = "ulong";
+// must be the same as WebCLConfiguration::trapStatusParameter_
+static const char *trapStatusParameter = "_wcl_trap_status";
+// must be the same as WebCLConfiguration::checkCountersParameter_
+static const char *checkCountersParameter = "_wcl_check_counters";
 
-WebCLHeader::WebCLHeader()
+WebCLHeader::WebCLHeader(bool trapStatus, bool checkCounters, bool reports, bool sourceMap)
     : indentation_("    ")
     , level_(0)
+    , trapStatus_(trapStatus)
+    , checkCounters_(checkCounters)
+    , reports_(reports)
+    , sourceMap_(sourceMap)
 {
     // nothing
 }
@@ -55,6 +63,18 @@ void WebCLHeader::emitHeader(std::ostream &out, clv_program program)
     emitVersion(out);
     out << ",\n";
     emitKernels(out, program);
+    if (reports_) {
+        out << ",\n";
+        emitReports(out, program);
+    }
+    if (checkCounters_) {
+        out << ",\n";
+        emitCheckSites(out, program);
+    }
+    if (sourceMap_) {
+        out << ",\n";
+        emitSourceMap(out, program);
+    }
     out << "\n";
 
     --level_;
@@ -192,7 +212,7 @@ void WebCLHeader::emitArrayParameter(
     --level_;
 }
 
-void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kernel)
+std::string WebCLHeader::getKernelName(clv_program program, cl_int kernel)
 {
     cl_int err = CL_SUCCESS;
     size_t nameSize = 0;
@@ -205,6 +225,15 @@ void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kern
     assert(err == CL_SUCCESS);
     name.erase(name.size() - 1);
 
+    return name;
+}
+
+void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kernel)
+{
+    cl_int err = CL_SUCCESS;
+    size_t nameSize = 0;
+    const std::string name = getKernelName(program, kernel);
+
     emitIndentation(out);
     out << "\"" << name << "\"" << " :\n";
     ++level_;
@@ -222,11 +251,11 @@ void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kern
         // Get argument name
         err = clvGetKernelArgName(program, kernel, arg, 0, NULL, &nameSize);
         assert(err == CL_SUCCESS);
-        name.resize(nameSize, '\0');
 
-        err = clvGetKernelArgName(program, kernel, arg, name.size(), &name[0], NULL);
+        std::string argName(nameSize, '\0');
+        err = clvGetKernelArgName(program, kernel, arg, argName.size(), &argName[0], NULL);
         assert(err == CL_SUCCESS);
-        name.erase(name.size() - 1);
+        argName.erase(argName.size() - 1);
 
         // Get argument type
         size_t typeSize = 0;
@@ -241,19 +270,30 @@ void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kern
 
         if (clvKernelArgIsImage(program, kernel, arg) || type == "sampler_t") {
             // images and samplers
-            emitBuiltinParameter(out, name, index, type, clvGetKernelArgAccessQual(program, kernel, arg));
+            emitBuiltinParameter(out, argName, index, type, clvGetKernelArgAccessQual(program, kernel, arg));
         } else if (clvKernelArgIsPointer(program, kernel, arg)) {
             // memory objects
-            emitArrayParameter(out, name, index, type, clvGetKernelArgAddressQual(program, kernel, arg));
+            emitArrayParameter(out, argName, index, type, clvGetKernelArgAddressQual(program, kernel, arg));
             ++index;
             out << ",\n";
-            emitParameter(out, buildSizeParameterName(name), index, sizeParameterType);
+            emitParameter(out, buildSizeParameterName(argName), index, sizeParameterType);
         } else {
             // primitives
-            emitParameter(out, name, index, type);
+            emitParameter(out, argName, index, type);
         }
         ++index;
     }
+    if (trapStatus_) {
+        if (numArgs != 0)
+            out << ",\n";
+        emitTrapStatusParameter(out, index);
+        ++index;
+    }
+    if (checkCounters_) {
+        if ((numArgs != 0) || trapStatus_)
+            out << ",\n";
+        emitCheckCountersParameter(out, index);
+    }
     out << "\n";
 
     --level_;
@@ -262,6 +302,48 @@ void WebCLHeader::emitKernel(std::ostream &out, clv_program program, cl_int kern
     --level_;
 }
 
+void WebCLHeader::emitTrapStatusParameter(std::ostream &out, int index)
+{
+    Fields fields;
+    fields["address-space"] = "global";
+    emitParameter(out, trapStatusParameter, index, "uint*", fields);
+}
+
+void WebCLHeader::emitCheckCountersParameter(std::ostream &out, int index)
+{
+    Fields fields;
+    fields["address-space"] = "global";
+    emitParameter(out, checkCountersParameter, index, "uint*", fields);
+}
+
+void WebCLHeader::emitCheckSites(std::ostream &out, clv_program program)
+{
+    emitIndentation(out);
+    out << "\"check-sites\" :\n";
+    ++level_;
+    emitIndentation(out);
+    out << "[\n";
+    ++level_;
+
+    cl_int numSites = clvGetProgramCheckSiteCount(program);
+    assert(numSites >= 0);
+    for (cl_int i = 0; i < numSites; ++i) {
+        if (i != 0)
+            out << ",\n";
+
+        emitIndentation(out);
+        out << "{ \"line\" : " << clvGetProgramCheckSiteLine(program, i)
+            << ", \"column\" : " << clvGetProgramCheckSiteColumn(program, i)
+            << " }";
+    }
+    out << "\n";
+
+    --level_;
+    emitIndentation(out);
+    out << "]";
+    --level_;
+}
+
 void WebCLHeader::emitKernels(std::ostream &out, clv_program program)
 {
     emitIndentation(out);
@@ -287,6 +369,88 @@ void WebCLHeader::emitKernels(std::ostream &out, clv_program program)
     --level_;
 }
 
+void WebCLHeader::emitReport(std::ostream &out, clv_program program, cl_int kernel)
+{
+    static const struct {
+        const char *key;
+        clv_kernel_report_item item;
+    } items[] = {
+        { "private-checks", CLV_KERNEL_REPORT_PRIVATE_CHECKS },
+        { "local-checks", CLV_KERNEL_REPORT_LOCAL_CHECKS },
+        { "constant-checks", CLV_KERNEL_REPORT_CONSTANT_CHECKS },
+        { "global-checks", CLV_KERNEL_REPORT_GLOBAL_CHECKS },
+        { "check-limits", CLV_KERNEL_REPORT_CHECK_LIMITS },
+        { "max-check-limits", CLV_KERNEL_REPORT_MAX_CHECK_LIMITS },
+        { "private-bytes", CLV_KERNEL_REPORT_PRIVATE_BYTES },
+        { "local-bytes", CLV_KERNEL_REPORT_LOCAL_BYTES },
+        { "constant-bytes", CLV_KERNEL_REPORT_CONSTANT_BYTES },
+        { "wrappers", CLV_KERNEL_REPORT_WRAPPERS },
+        { "allocations-bytes", CLV_KERNEL_REPORT_ALLOCATIONS_BYTES },
+        { "local-zeroing-bytes", CLV_KERNEL_REPORT_LOCAL_ZEROING_BYTES },
+        { "added-parameters", CLV_KERNEL_REPORT_ADDED_PARAMETERS }
+    };
+
+    emitIndentation(out);
+    out << "\"" << getKernelName(program, kernel) << "\"" << " :\n";
+    ++level_;
+    emitIndentation(out);
+    out << "{\n";
+    ++level_;
+
+    for (unsigned i = 0; i < sizeof(items) / sizeof(items[0]); ++i) {
+        if (i != 0)
+            out << ",\n";
+        emitNumberEntry(out, items[i].key, clvGetKernelReportItem(program, kernel, items[i].item));
+    }
+    out << "\n";
+
+    --level_;
+    emitIndentation(out);
+    out << "}";
+    --level_;
+}
+
+void WebCLHeader::emitReports(std::ostream &out, clv_program program)
+{
+    emitIndentation(out);
+    out << "\"reports\" :\n";
+    ++level_;
+    emitIndentation(out);
+    out << "{\n";
+    ++level_;
+
+    cl_int numKernels = clvGetProgramKernelCount(program);
+    assert(numKernels >= 0);
+    for (cl_int i = 0; i < numKernels; ++i) {
+        if (i != 0)
+            out << ",\n";
+
+        emitReport(out, program, i);
+    }
+    out << "\n";
+
+    --level_;
+    emitIndentation(out);
+    out << "}";
+    --level_;
+}
+
+void WebCLHeader::emitSourceMap(std::ostream &out, clv_program program)
+{
+    cl_int err = CL_SUCCESS;
+    size_t mappingsSize = 0;
+
+    err = clvGetProgramSourceMap(program, 0, NULL, &mappingsSize);
+    assert(err == CL_SUCCESS);
+
+    std::string mappings(mappingsSize, '\0');
+    err = clvGetProgramSourceMap(program, mappings.size(), &mappings[0], NULL);
+    assert(err == CL_SUCCESS);
+    mappings.erase(mappings.size() - 1);
+
+    emitStringEntry(out, "source-map", mappings);
+}
+
 void WebCLHeader::emitIndentation(std::ostream &out) const
 {
     for (unsigned int i = 0; i < level_; ++i)
@@ -35,7 +35,16 @@ class WebCLHeader
 {
 public:
 
-    WebCLHeader();
+    /// \param trapStatus Whether kernels have a trailing status word
+    /// parameter for trapped memory accesses.
+    /// \param checkCounters Whether kernels have a trailing counter
+    /// parameter for counted memory access checks.
+    /// \param reports Whether to emit instrumentation reports of
+    /// kernels.
+    /// \param sourceMap Whether to emit the map from the validated
+    /// source back to the input source.
+    WebCLHeader(bool trapStatus = false, bool checkCounters = false, bool reports = false,
+                bool sourceMap = false);
     ~WebCLHeader();
 
     /// Creates a JSON header for given set of functions and writes it
@@ -109,6 +118,59 @@ private:
     ///             }
     void emitKernels(std::ostream &out, clv_program program);
 
+    /// Emits status word parameter of trapped memory accesses:
+    /// ->
+    /// "_wcl_trap_status" : {
+    ///                        "index" : 3,
+    ///                        "type" : "uint*",
+    ///                        "address-space" : "global"
+    ///                      }
+    void emitTrapStatusParameter(std::ostream &out, int index);
+
+    /// Emits counter parameter of counted memory access checks:
+    /// ->
+    /// "_wcl_check_counters" : {
+    ///                           "index" : 4,
+    ///                           "type" : "uint*",
+    ///                           "address-space" : "global"
+    ///                         }
+    void emitCheckCountersParameter(std::ostream &out, int index);
+
+    /// Emits locations of counted memory access checks in the order
+    /// of their counters:
+    /// ->
+    /// "check-sites" : [
+    ///                   { "line" : 12, "column" : 5 },
+    ///                   { "line" : 14, "column" : 9 }
+    ///                 ]
+    void emitCheckSites(std::ostream &out, clv_program program);
+
+    /// Emits static facts about the instrumentation of a kernel:
+    /// ->
+    /// "foo" : {
+    ///           "private-checks" : 0,
+    ///           ...
+    ///           "added-parameters" : 2
+    ///         }
+    void emitReport(std::ostream &out, clv_program program, cl_int kernel);
+
+    /// Emits instrumentation reports of kernels:
+    /// ->
+    /// "reports" : {
+    ///               "foo" : { ... },
+    ///               "bar" : { ... }
+    ///             }
+    void emitReports(std::ostream &out, clv_program program);
+
+    /// Emits mappings from the validated source, which follows the
+    /// header, back to the input source:
+    /// ->
+    /// "source-map" : "AAAA;AACA,IAAI"
+    void emitSourceMap(std::ostream &out, clv_program program);
+
+    /// \return Name of the nth kernel of the program.
+    std::string getKernelName(clv_program program, cl_int kernel);
+
     /// Emits correct indentation based on current indentation level.
     void emitIndentation(std::ostream &out) const;
 
@@ -116,6 +178,14 @@ private:
     const std::string indentation_;
     /// Current indentation level.
     unsigned int level_;
+    /// Whether to emit status word parameters.
+    bool trapStatus_;
+    /// Whether to emit counter parameters and check sites.
+    bool checkCounters_;
+    /// Whether to emit instrumentation reports.
+    bool reports_;
+    /// Whether to emit the source map.
+    bool sourceMap_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLHEADER
\ No newline at end of file
@@ -25,24 +25,69 @@
 
 #include <stdlib.h>
 
-#include <cassert>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <set>
 #include <string>
 #include <vector>
 
-#include "WebCLHeader.hpp"
+#include "WebCLBatch.hpp"
 
 namespace {
-    bool readAll(std::ifstream &from, std::string &to)
+    /// Validates the inputs of a -batch=<output-directory> run.
+    int runBatch(int argc, char const* argv[], const WebCLSettings &settings)
     {
-        from.seekg(0, std::ios::end);
-        to.resize(from.tellg());
-        from.seekg(0, std::ios::beg);
-        return from.read(&to[0], to.size());
+        const std::string outputDirectory = std::string(argv[1]).substr(7);
+        if (outputDirectory.empty()) {
+            std::cerr << "Option requires an argument: -batch=; exiting\n";
+            return EXIT_FAILURE;
+        }
+
+        std::vector<std::string> inputs;
+        unsigned threads = 1;
+        for (int i = 2; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (option == "-include") {
+                // file name was handled with the other includes
+                ++i;
+            } else if (!option.compare(0, 2, "-j")) {
+                std::string value = option.substr(2);
+                if (value.empty() && (++i < argc))
+                    value = argv[i];
+                char *end = NULL;
+                const unsigned long count = strtoul(value.c_str(), &end, 10);
+                if (value.empty() || *end || !count) {
+                    std::cerr << "Invalid number of threads: -j" << value << "; exiting\n";
+                    return EXIT_FAILURE;
+                }
+                threads = count;
+            } else if (!option.compare(0, 10, "-manifest=")) {
+                const std::string manifest = option.substr(10);
+                if (!readManifest(manifest, inputs)) {
+                    std::cerr << "Failed to read manifest file \"" << manifest << "\", exiting\n";
+                    return EXIT_FAILURE;
+                }
+            } else if (option.empty() || (option[0] != '-')) {
+                inputs.push_back(option);
+            }
+        }
+
+        if (inputs.empty()) {
+            std::cerr << "No input files, exiting\n";
+            return EXIT_FAILURE;
+        }
+
+        WebCLBatch batch(settings, outputDirectory, threads);
+        for (std::vector<std::string>::const_iterator i = inputs.begin(); i != inputs.end(); ++i) {
+            if (!batch.addInput(*i)) {
+                std::cerr << "Input file \"" << *i
+                          << "\" has the same name as an earlier input, exiting\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        return batch.run(std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 }
 
@@ -54,11 +99,17 @@ int main(int argc, char const* argv[])
     help.insert("--help");
 
     if ((argc == 1) || ((argc == 2) && help.count(argv[1]))) {
-        std::cerr << "Usage: " << argv[0] << " input.cl [clang-options]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " input.cl [clang-options]\n"
+                  << "       " << argv[0] << " -batch=<output-directory> [-j N]"
+                  << " [-manifest=<file>] [clang-options] input.cl..." << std::endl;
         return EXIT_FAILURE;
     }
 
-    std::string inputSource;    
+    // Inputs follow the output directory in batch mode.
+    const bool batch = !std::string(argv[1]).compare(0, 7, "-batch=");
+    const int firstOption = batch ? 1 : 2;
+
+    WebCLSettings settings;
 
     // Handle -I and -include (these aren't allowed to be passed in the library API, so
     // we do it here for the CLI use case, which is mostly testing the CLI validator)
@@ -68,13 +119,13 @@ int main(int argc, char const* argv[])
 
     std::vector<std::string> includePaths;
     includePaths.push_back(".");
-    for (int i = 2; i < argc; ++i) {
+    for (int i = firstOption; i < argc; ++i) {
         char const *option = argv[i];
         if (!std::string(option).substr(0, 2).compare("-I"))
             includePaths.push_back(option + 2);
     }
 
-    for (int i = 2; i < argc; ++i) {
+    for (int i = firstOption; i < argc; ++i) {
         char const *option = argv[i];
         if (!std::string(option).compare("-include")) {
             if (++i == argc) {
@@ -92,8 +143,8 @@ int main(int argc, char const* argv[])
                 if (ifs.good()) {
                     std::string fileContents;
                     if (readAll(ifs, fileContents)) {
-                        inputSource.append(fileContents);
-                        inputSource.append("\n"); // make sure there's a newline between each header
+                        settings.includedSource.append(fileContents);
+                        settings.includedSource.append("\n"); // make sure there's a newline between each header
                         success = true;
                         break;
                     }
@@ -107,8 +158,58 @@ int main(int argc, char const* argv[])
         }
     }
 
+    // Enable usual extensions
+    std::vector<const char *> &extensions = settings.extensions;
+    extensions.push_back("cl_khr_fp64");
+    extensions.push_back("cl_khr_fp16");
+    extensions.push_back("cl_khr_gl_sharing");
+    extensions.push_back("cl_khr_int64_base_atomics");
+    extensions.push_back("cl_khr_int64_extended_atomics");
+    extensions.push_back(0);
+
+    // Parse user defines
+    std::vector<const char *> &userDefines = settings.userDefines;
+    for (int i = firstOption; i < argc; ++i) {
+        char const *option = argv[i];
+        if (!std::string(option).substr(0, 2).compare("-D"))
+            userDefines.push_back(option + 2);
+    }
+    userDefines.push_back(0);
+
+    // Collect code generation options
+    std::string &options = settings.options;
+    for (int i = firstOption; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (!option.compare(0, 12, "-check-mode=") ||
+            !option.compare(0, 16, "-violation-mode=") ||
+            !option.compare(0, 12, "-limit-mode=") ||
+            !option.compare(0, 15, "-helper-clones=") ||
+            !option.compare(0, 18, "-analysis-threads=") ||
+            (option == "-count-checks") ||
+            (option == "-compact-output")) {
+            if (!options.empty())
+                options += " ";
+            options += option;
+        }
+        if (!option.compare(0, 16, "-violation-mode="))
+            settings.trapStatus = (option == "-violation-mode=trap");
+        if (option == "-count-checks")
+            settings.checkCounters = true;
+        if (option == "-report")
+            settings.reports = true;
+        if (option == "-source-map")
+            settings.sourceMap = true;
+    }
+
+    // TODO: handle arguments like -ferror-limit as webcl-validator CLI specific options;
+    // that specific one should affect error printing
+
+    if (batch)
+        return runBatch(argc, argv, settings);
+
     // Read the actual input file
     const std::string inputFilename(argv[1]);
+    std::string inputSource = settings.includedSource;
 
     if (inputFilename == "-") {
         // input is stdin
@@ -135,109 +236,7 @@ int main(int argc, char const* argv[])
         inputSource.append(fileContents);
     }
 
-    // Enable usual extensions
-    std::vector<const char *> extensions;
-    extensions.push_back("cl_khr_fp64");
-    extensions.push_back("cl_khr_fp16");
-    extensions.push_back("cl_khr_gl_sharing");
-    extensions.push_back("cl_khr_int64_base_atomics");
-    extensions.push_back("cl_khr_int64_extended_atomics");
-    extensions.push_back(0);
-
-    // Parse user defines
-    std::vector<const char *> userDefines;
-    for (int i = 2; i < argc; ++i) {
-        char const *option = argv[i];
-        if (!std::string(option).substr(0, 2).compare("-D"))
-            userDefines.push_back(option + 2);
-    }
-    userDefines.push_back(0);
-
-    // TODO: handle arguments like -ferror-limit as webcl-validator CLI specific options;
-    // that specific one should affect error printing
-
     // Run validator
-    cl_int err = CL_SUCCESS;
-    clv_program prog = clvValidate(inputSource.c_str(), &extensions[0], &userDefines[0], NULL, NULL, &err);
-    if (!prog) {
-        std::cerr << "Failed to call validator: " << err << '\n';
-        return EXIT_FAILURE;
-    }
-
-    // Print validation log
-    for (cl_int i = 0; i < clvGetProgramLogMessageCount(prog); i++) {
-        // TODO: print line n/o info once we can reasonably map source lines
-
-        // Print severity
-        switch (clvGetProgramLogMessageLevel(prog, i)) {
-        case CLV_LOG_MESSAGE_NOTE:
-            std::cerr << "note: ";
-            break;
-        case CLV_LOG_MESSAGE_WARNING:
-            std::cerr << "warning: ";
-            break;
-        case CLV_LOG_MESSAGE_ERROR:
-            std::cerr << "error: ";
-            break;
-        }
-
-        // Determine message text size
-        size_t textSize = 0;
-        err = clvGetProgramLogMessageText(prog, i, 0, NULL, &textSize);
-        assert(err == CL_SUCCESS);
-
-        // Get and print message text
-        std::string text(textSize, '\0');
-        err = clvGetProgramLogMessageText(prog, i, text.size(), &text[0], &textSize);
-        assert(err == CL_SUCCESS);
-        text.erase(text.size() - 1); // erase NUL
-        std::cerr << text << '\n';
-
-        // Print relevant source code
-        if (clvProgramLogMessageHasSource(prog, i)) {
-            std::string source(clvGetProgramLogMessageSourceLen(prog, i) + 1, '\0');
-            err = clvGetProgramLogMessageSourceText(
-                prog, i,
-                clvGetProgramLogMessageSourceOffset(prog, i), source.size() - 1,
-                source.size(), &source[0], NULL);
-            assert(err == CL_SUCCESS);
-            source.erase(source.size() - 1); // erase NUL
-            std::cerr << source << '\n';
-        }
-    }
-
-    int exitStatus = EXIT_SUCCESS;
-    if (clvGetProgramStatus(prog) == CLV_PROGRAM_ACCEPTED ||
-        clvGetProgramStatus(prog) == CLV_PROGRAM_ACCEPTED_WITH_WARNINGS) {
-        // Success, print output
-
-        // Print JSON header
-        WebCLHeader header;
-        header.emitHeader(std::cout, prog);
-
-        // Determine source size
-        size_t sourceSize = 0;
-        err = clvGetProgramValidatedSource(prog, 0, NULL, &sourceSize);
-        assert(err == CL_SUCCESS);
-
-        // Get source
-        std::string validatedSource(sourceSize, '\0');
-        err = clvGetProgramValidatedSource(prog, validatedSource.size(), &validatedSource[0], NULL);
-        assert(err == CL_SUCCESS);
-
-        // Strip terminating NUL, we don't need it
-        assert(validatedSource[validatedSource.size() - 1] == '\0');
-        validatedSource.erase(validatedSource.size() - 1);
-
-        // Print source
-        std::cout << validatedSource;
-    } else {
-        // Validation failed
-
-        exitStatus = EXIT_FAILURE;
-    }
-
-    clvReleaseProgram(prog);
-
-    return exitStatus;
+    const bool accepted = validateSource(inputSource, settings, std::cerr, std::cout);
+    return accepted ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -55,6 +55,54 @@ CLV_API clv_program CLV_CALL clvValidate(
     void *notify_data,
     cl_int *errcode_ret);
 
+// Run validation with code generation options. The options string
+// contains space separated options, e.g. "-check-mode=offset", and
+// may be NULL. CL_INVALID_BUILD_OPTIONS is returned through
+// errcode_ret if the options aren't recognized.
+//
+// "-violation-mode=clamp|mask|trap" selects what happens to out of
+// bounds memory accesses. With "mask" stores are skipped and loads
+// read zero. The values of skipped stores are still evaluated. With
+// "trap" each kernel also gets a trailing
+// "__global uint *_wcl_trap_status" parameter that is set to 1 when
+// an access is skipped. Functions without a return value then return
+// early, unless they may reach a barrier.
+//
+// "-limit-mode=record|scalar" selects where memory area limits are
+// kept. With "scalar" limits are kernel scope variables and helper
+// functions receive the limits they use as parameters instead of
+// reading them from the allocation structure.
+//
+// "-helper-clones=N" allows up to N copies of each helper function.
+// A copy is made for each distinct combination of kernel memory
+// objects that callers pass as pointer arguments, and accesses
+// through those arguments are checked only against the passed
+// memory objects. Calls that would need more copies use the original
+// function. The default is 0, which disables copying.
+//
+// "-count-checks" makes memory access checks count their executions.
+// Each kernel gets a trailing "__global uint *_wcl_check_counters"
+// parameter, after the trap status parameter if there is one. The
+// buffer holds two counters for each check site: the number of times
+// the check was executed and the number of times the access was out
+// of bounds. See clvGetProgramCheckSiteCount.
+//
+// "-analysis-threads=N" analyses function bodies with N threads. The
+// result doesn't depend on N. The default is 1.
+//
+// "-compact-output" leaves comments, indentation and blank lines out
+// of the validated source. "#line" directives are inserted where
+// lines are left out, so diagnostics of the OpenCL compiler refer to
+// the same lines as without the option.
+CLV_API clv_program CLV_CALL clvValidateWithOptions(
+    const char *input_source,
+    const char **active_extensions,
+    const char **user_defines,
+    const char *options,
+    void (CL_CALLBACK *pfn_notify)(clv_program program, void *user_data),
+    void *notify_data,
+    cl_int *errcode_ret);
+
 typedef enum {
     /// Callback used, validation still running
     CLV_PROGRAM_VALIDATING,
@@ -107,6 +155,13 @@ CLV_API cl_long CLV_CALL clvGetProgramLogMessageSourceOffset(
     clv_program program,
     cl_uint n);
 
+// Get the line of the input source that the log message refers to,
+// counting from 1. Returns 0 if the message refers to code that
+// isn't part of the input source, such as builtin declarations.
+CLV_API cl_long CLV_CALL clvGetProgramLogMessageInputLine(
+    clv_program program,
+    cl_uint n);
+
 // Get the length of relevant part of the source code
 CLV_API size_t CLV_CALL clvGetProgramLogMessageSourceLen(
     clv_program program,
@@ -181,6 +236,57 @@ CLV_API cl_kernel_arg_access_qualifier CLV_CALL clvGetKernelArgAccessQual(
     cl_uint kernel,
     cl_uint arg);
 
+// Static facts about the instrumentation of a kernel. Checks and
+// wrappers are counted in the kernel and in the helper functions that
+// it may call. Sizes are in bytes.
+typedef enum {
+    // Checked memory accesses of each address space
+    CLV_KERNEL_REPORT_PRIVATE_CHECKS,
+    CLV_KERNEL_REPORT_LOCAL_CHECKS,
+    CLV_KERNEL_REPORT_CONSTANT_CHECKS,
+    CLV_KERNEL_REPORT_GLOBAL_CHECKS,
+    // Memory areas compared by all checks together
+    CLV_KERNEL_REPORT_CHECK_LIMITS,
+    // Memory areas compared by the check that compares the most
+    CLV_KERNEL_REPORT_MAX_CHECK_LIMITS,
+    // Relocated variables of each address space
+    CLV_KERNEL_REPORT_PRIVATE_BYTES,
+    CLV_KERNEL_REPORT_LOCAL_BYTES,
+    CLV_KERNEL_REPORT_CONSTANT_BYTES,
+    // Distinct builtin wrapper functions called
+    CLV_KERNEL_REPORT_WRAPPERS,
+    // Estimated size of the "_WclProgramAllocations" structure
+    CLV_KERNEL_REPORT_ALLOCATIONS_BYTES,
+    // Local memory zeroed at kernel start, excluding local memory
+    // kernel arguments
+    CLV_KERNEL_REPORT_LOCAL_ZEROING_BYTES,
+    // Parameters added to the kernel signature
+    CLV_KERNEL_REPORT_ADDED_PARAMETERS
+} clv_kernel_report_item;
+
+// Get a static fact about the instrumentation of the given kernel
+CLV_API cl_long CLV_CALL clvGetKernelReportItem(
+    clv_program program,
+    cl_uint kernel,
+    clv_kernel_report_item item);
+
+// Get number of check sites whose counters are in the
+// "_wcl_check_counters" buffer of a program validated with
+// "-count-checks". Counters 2 * n and 2 * n + 1 belong to site n.
+CLV_API cl_int CLV_CALL clvGetProgramCheckSiteCount(
+    clv_program program);
+
+// Get the line of the memory access that is checked at a site. Lines
+// and columns refer to the preprocessed source.
+CLV_API cl_long CLV_CALL clvGetProgramCheckSiteLine(
+    clv_program program,
+    cl_uint n);
+
+// Get the column of the memory access that is checked at a site
+CLV_API cl_long CLV_CALL clvGetProgramCheckSiteColumn(
+    clv_program program,
+    cl_uint n);
+
 // Get validated source, ready to pass on to compiler
 CLV_API cl_int CLV_CALL clvGetProgramValidatedSource(
     clv_program program,
@@ -188,6 +294,20 @@ CLV_API cl_int CLV_CALL clvGetProgramValidatedSource(
     char *source_buf,
     size_t *source_size_ret);
 
+// Get a map from the validated source back to the input source. The
+// map is the "mappings" field of a Source Map Revision 3 file: ';'
+// separates the lines of the validated source and ',' the segments
+// of a line. Each segment has the output column, the source index
+// (always 0), the input line and the input column, all 0-based,
+// delta encoded and written as base64 VLQs. Columns are counted in
+// bytes. Generated code maps to the input position where it was
+// inserted.
+CLV_API cl_int CLV_CALL clvGetProgramSourceMap(
+    clv_program program,
+    size_t map_buf_size,
+    char *map_buf,
+    size_t *map_size_ret);
+
 // Release resources allocated by clvValidate()
 CLV_API void CLV_CALL clvReleaseProgram(
     clv_program program);
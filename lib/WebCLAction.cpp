@@ -28,6 +28,7 @@
 
 #include "clang/AST/ASTContext.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendOptions.h"
@@ -39,6 +40,66 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <cctype>
+#include <vector>
+
+namespace {
+    /// Writes preprocessed text without its line markers. The markers
+    /// tell which line of the main file each written line comes from.
+    void stripLineMarkers(llvm::StringRef text, llvm::StringRef source,
+                          llvm::raw_ostream &out, WebCLSourceMap &sourceMap)
+    {
+        std::vector<unsigned> sourceLines;
+        sourceLines.push_back(0);
+        for (unsigned i = 0; i < source.size(); ++i) {
+            if (source[i] == '\n')
+                sourceLines.push_back(i + 1);
+        }
+
+        // The first marker names the main file.
+        llvm::StringRef mainFile;
+        bool isMainFile = false;
+        unsigned line = 0;
+        unsigned written = 0;
+
+        while (!text.empty()) {
+            const std::pair<llvm::StringRef, llvm::StringRef> split = text.split('\n');
+            const llvm::StringRef current = split.first;
+            const bool hasNewline = current.size() < text.size();
+            text = split.second;
+
+            // # 12 "/tmp/wclXXXXXX" 2
+            if (current.startswith("# ") && (current.size() > 2) && std::isdigit(static_cast<unsigned char>(current[2]))) {
+                llvm::StringRef number = current.substr(2);
+                number = number.substr(0, number.find(' '));
+                if (number.getAsInteger(10, line))
+                    line = 0;
+                const llvm::StringRef file =
+                    current.slice(current.find('"'), current.rfind('"') + 1);
+                if (mainFile.empty())
+                    mainFile = file;
+                isMainFile = (file == mainFile);
+                continue;
+            }
+
+            if (isMainFile && line && (line <= sourceLines.size())) {
+                const unsigned begin = sourceLines[line - 1];
+                const unsigned end = (line < sourceLines.size()) ?
+                    (sourceLines[line] - 1) : source.size();
+                sourceMap.add(begin, written);
+                sourceMap.add(end, written + current.size());
+            }
+
+            out << current;
+            if (hasNewline)
+                out << '\n';
+            written += current.size() + hasNewline;
+            if (line)
+                ++line;
+        }
+    }
+}
+
 WebCLAction::WebCLAction(const char *output)
     : clang::FrontendAction()
     , reporter_(NULL), preprocessor_(NULL)
@@ -58,6 +119,11 @@ void WebCLAction::setExtensions(const std::set<std::string> &extensions)
     extensions_ = extensions;
 }
 
+void WebCLAction::setOptions(const WebCLOptions &options)
+{
+    options_ = options;
+}
+
 bool WebCLAction::initialize(clang::CompilerInstance &instance)
 {
     reporter_ = new WebCLReporter(instance);
@@ -96,8 +162,9 @@ bool WebCLAction::initialize(clang::CompilerInstance &instance)
     return true;
 }
 
-WebCLPreprocessorAction::WebCLPreprocessorAction(const char *output, std::string &builtinDecls)
-    : WebCLAction(output), builtinDecls_(builtinDecls)
+WebCLPreprocessorAction::WebCLPreprocessorAction(const char *output, std::string &builtinDecls,
+                                                 WebCLSourceMap &sourceMap)
+    : WebCLAction(output), builtinDecls_(builtinDecls), sourceMap_(sourceMap)
 {
 }
 
@@ -118,10 +185,21 @@ void WebCLPreprocessorAction::ExecuteAction()
         return;
 
     clang::PreprocessorOutputOptions& options = instance.getPreprocessorOutputOpts();
-    options.ShowComments = 1;
-    options.ShowLineMarkers = 0;
+    // comments would be left out of compact output anyway
+    options.ShowComments = !options_.compactOutput;
+    // Line markers are removed after they have been recorded. Apart
+    // from the markers the output is the same as without them.
+    options.ShowLineMarkers = 1;
+    std::string preprocessed;
+    llvm::raw_string_ostream preprocessedOut(preprocessed);
     clang::DoPrintPreprocessedInput(
-        instance.getPreprocessor(), out_, options);
+        instance.getPreprocessor(), &preprocessedOut, options);
+    preprocessedOut.flush();
+
+    clang::SourceManager &manager = instance.getSourceManager();
+    sourceMap_.clear();
+    stripLineMarkers(preprocessed, manager.getBufferData(manager.getMainFileID()),
+                     *out_, sourceMap_);
     out_->flush();
 
     // Iterate over all identifier tokens found in the source, to collect
@@ -148,11 +226,12 @@ bool WebCLPreprocessorAction::usesPreprocessorOnly() const
     return true;
 }
 
-WebCLMatcherAction::WebCLMatcherAction(const char *output)
+WebCLMatcherAction::WebCLMatcherAction(const char *output, WebCLSourceMap &sourceMap)
     : WebCLAction(output)
     , finder_()
     , consumer_(0), rewriter_(0)
     , cfg_(), printer_(0)
+    , sourceMap_(sourceMap)
 {
 }
 
@@ -205,8 +284,8 @@ bool WebCLMatcherAction::initialize(clang::CompilerInstance &instance)
     return true;
 }
 
-WebCLMatcher1Action::WebCLMatcher1Action(const char *output)
-    : WebCLMatcherAction(output)
+WebCLMatcher1Action::WebCLMatcher1Action(const char *output, WebCLSourceMap &sourceMap)
+    : WebCLMatcherAction(output, sourceMap)
 {
 }
 
@@ -233,10 +312,11 @@ void WebCLMatcher1Action::ExecuteAction()
         return;
     }
 
-    if (!printer_->print(*out_, "// WebCL Validator: matching stage 1.\n")) {
+    if (!printer_->print(*out_, options_.compactOutput ? "" : "// WebCL Validator: matching stage 1.\n")) {
         reporter_->fatal("Can't print first matcher stage output.");
         return;
     }
+    printer_->recordSourceMap(sourceMap_);
 }
 
 bool WebCLMatcher1Action::checkIdentifiers()
@@ -282,8 +362,8 @@ bool WebCLMatcher1Action::checkIdentifiers()
     return status;
 }
 
-WebCLMatcher2Action::WebCLMatcher2Action(const char *output)
-    : WebCLMatcherAction(output)
+WebCLMatcher2Action::WebCLMatcher2Action(const char *output, WebCLSourceMap &sourceMap)
+    : WebCLMatcherAction(output, sourceMap)
 {
 }
 
@@ -307,13 +387,15 @@ void WebCLMatcher2Action::ExecuteAction()
         return;
     }
 
-    if (!printer_->print(*out_, "// WebCL Validator: matching stage 2.\n")) {
+    if (!printer_->print(*out_, options_.compactOutput ? "" : "// WebCL Validator: matching stage 2.\n")) {
         reporter_->fatal("Can't print second matcher stage output.");
         return;
     }
+    printer_->recordSourceMap(sourceMap_);
 }
 
-WebCLValidatorAction::WebCLValidatorAction(std::string &validatedSource, WebCLAnalyser::KernelList &kernels)
+WebCLValidatorAction::WebCLValidatorAction(std::string &validatedSource, WebCLAnalyser::KernelList &kernels,
+                                           CheckSiteList &checkSites, WebCLSourceMap &sourceMap)
     : WebCLAction()
     , consumer_(0)
     , transformer_(0)
@@ -321,6 +403,8 @@ WebCLValidatorAction::WebCLValidatorAction(std::string &validatedSource, WebCLAn
     , sema_(0)
     , validatedSource_(validatedSource)
     , kernels_(kernels)
+    , checkSites_(checkSites)
+    , sourceMap_(sourceMap)
 {
 }
 
@@ -349,6 +433,8 @@ void WebCLValidatorAction::ExecuteAction()
     ParseAST(*sema.get());
     validatedSource_ = consumer_->getTransformedSource();
     kernels_ = consumer_->getKernels();
+    checkSites_ = transformer_->getCheckSites();
+    sourceMap_ = consumer_->getSourceMap();
 }
 
 bool WebCLValidatorAction::usesPreprocessorOnly() const
@@ -368,7 +454,7 @@ bool WebCLValidatorAction::initialize(clang::CompilerInstance &instance)
         return false;
     }
 
-    transformer_ = new WebCLTransformer(instance, *rewriter_);
+    transformer_ = new WebCLTransformer(instance, *rewriter_, options_);
     if (!transformer_) {
         reporter_->fatal("Internal error. Can't create AST transformer.\n");
         return false;
@@ -26,6 +26,9 @@
 
 #include "WebCLConsumer.hpp"
 #include "WebCLConfiguration.hpp"
+#include "WebCLHelper.hpp"
+#include "WebCLOptions.hpp"
+#include "WebCLSourceMap.hpp"
 #include "WebCLVisitor.hpp"
 
 #include "clang/ASTMatchers/ASTMatchFinder.h"
@@ -53,6 +56,7 @@ public:
     virtual ~WebCLAction();
 
     void setExtensions(const std::set<std::string> &extensions);
+    void setOptions(const WebCLOptions &options);
 
 protected:
 
@@ -69,6 +73,8 @@ protected:
     WebCLPreprocessor *preprocessor_;
     // Additional OpenCL extensions to allow in preprocessing besides cl_khr_initialize_memory
     std::set<std::string> extensions_;
+    /// Code generation options selected for the program.
+    WebCLOptions options_;
     /// Output filename.
     const char *output_;
     /// Stream corresponding to the output filename.
@@ -80,7 +86,8 @@ class WebCLPreprocessorAction : public WebCLAction
 {
 public:
 
-    explicit WebCLPreprocessorAction(const char *output, std::string &builtinDecls);
+    WebCLPreprocessorAction(const char *output, std::string &builtinDecls,
+                            WebCLSourceMap &sourceMap);
     virtual ~WebCLPreprocessorAction();
 
     /// \see clang::FrontendAction
@@ -98,6 +105,9 @@ private:
     /// Where to store additional builtin function forward declarations
     /// needed by later AST parsing passes
     std::string &builtinDecls_;
+    /// Where to store the lines of the user source file that
+    /// preprocessed lines come from.
+    WebCLSourceMap &sourceMap_;
 };
 
 /// A base class for stages that use AST matchers for consuming ASTs.
@@ -105,7 +115,7 @@ class WebCLMatcherAction : public WebCLAction
 {
 public:
 
-    explicit WebCLMatcherAction(const char *output);
+    WebCLMatcherAction(const char *output, WebCLSourceMap &sourceMap);
     virtual ~WebCLMatcherAction();
 
     /// \see clang::FrontendAction
@@ -130,6 +140,8 @@ protected:
     WebCLConfiguration cfg_;
     /// Outputs stored transformations.
     WebCLPrinter *printer_;
+    /// Where to store the origins of the output.
+    WebCLSourceMap &sourceMap_;
 };
 
 /// Performs early normalizations:
@@ -140,7 +152,7 @@ class WebCLMatcher1Action : public WebCLMatcherAction
 {
 public:
 
-    explicit WebCLMatcher1Action(const char *output);
+    WebCLMatcher1Action(const char *output, WebCLSourceMap &sourceMap);
     virtual ~WebCLMatcher1Action();
 
     /// \see clang::FrontendAction
@@ -162,7 +174,7 @@ class WebCLMatcher2Action : public WebCLMatcherAction
 {
 public:
 
-    explicit WebCLMatcher2Action(const char *output);
+    WebCLMatcher2Action(const char *output, WebCLSourceMap &sourceMap);
     virtual ~WebCLMatcher2Action();
 
     /// \see clang::FrontendAction
@@ -175,7 +187,8 @@ class WebCLValidatorAction : public WebCLAction
 {
 public:
 
-    WebCLValidatorAction(std::string &validatedSource, WebCLAnalyser::KernelList &kernels);
+    WebCLValidatorAction(std::string &validatedSource, WebCLAnalyser::KernelList &kernels,
+                         CheckSiteList &checkSites, WebCLSourceMap &sourceMap);
     virtual ~WebCLValidatorAction();
 
     /// \see clang::FrontendAction
@@ -208,6 +221,10 @@ private:
     std::string &validatedSource_;
     /// Ditto for kernel info
     WebCLAnalyser::KernelList &kernels_;
+    /// Ditto for locations of counted memory access checks
+    CheckSiteList &checkSites_;
+    /// Ditto for origins of the transformed source
+    WebCLSourceMap &sourceMap_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLACTION
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
@@ -53,9 +54,17 @@ typedef SSIZE_T ssize_t;
 #endif
 
 int mingwcompatible_mkstemp(char* tmplt) {
-  char *filename = mktemp(tmplt);
-  if (filename == NULL) return -1;
-  return open(filename, O_RDWR | O_CREAT, 0600);
+  // Parallel validations may draw the same name before either of
+  // them has created the file, so the loser tries another name.
+  const std::string pattern(tmplt);
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    std::copy(pattern.begin(), pattern.end(), tmplt);
+    char *filename = mktemp(tmplt);
+    if (filename == NULL || *filename == '\0') return -1;
+    int fd = open(filename, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd != -1 || errno != EEXIST) return fd;
+  }
+  return -1;
 }
 
 WebCLArguments::WebCLArguments(const std::string &inputSource, int argc, char const *argv[])
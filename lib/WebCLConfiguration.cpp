@@ -26,6 +26,9 @@
 #include "clang/AST/Decl.h"
 #include "clang/Basic/AddressSpaces.h"
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include <sstream>
 
 namespace {
@@ -97,7 +100,14 @@ WebCLConfiguration::WebCLConfiguration()
     , constantNullField_("cn")
     , globalNullField_("gn")
 
+    , trapStatusParameter_(variablePrefix_ + "_trap_status")
+    , trapStatusField_("ts")
+
+    , checkCountersParameter_(variablePrefix_ + "_check_counters")
+    , checkCountersField_("cc")
+
     , localRangeZeroingMacro_(macroPrefix_ + "_LOCAL_RANGE_INIT")
+    , localItemRangeZeroingMacro_(macroPrefix_ + "_LOCAL_ITEM_RANGE_INIT")
 
     , dataWidths_(generateWidths(2, 16) + 3)
     , roundingModes_(StringList() + "rte" + "rtz" + "rtp" + "rtn")
@@ -117,12 +127,23 @@ WebCLConfiguration::~WebCLConfiguration()
 {
 }
 
-const std::string WebCLConfiguration::getNameOfAddressSpace(clang::QualType type) const
+std::string &WebCLConfiguration::getInterned(
+    InternedKind kind, unsigned addressSpaceNum, int limitCount,
+    const void *decl, const std::string &type) const
+{
+    llvm::SmallString<128> key;
+    llvm::raw_svector_ostream out(key);
+    out << kind << ":" << addressSpaceNum << ":" << limitCount << ":"
+        << decl << ":" << type;
+    return interned_[out.str()];
+}
+
+const std::string &WebCLConfiguration::getNameOfAddressSpace(clang::QualType type) const
 {
     return getNameOfAddressSpace(type.getAddressSpace());
 }
 
-const std::string WebCLConfiguration::getNameOfAddressSpace(unsigned addressSpaceNumber) const
+const std::string &WebCLConfiguration::getNameOfAddressSpace(unsigned addressSpaceNumber) const
 {
     switch (addressSpaceNumber) {
       case clang::LangAS::opencl_global:
@@ -136,31 +157,41 @@ const std::string WebCLConfiguration::getNameOfAddressSpace(unsigned addressSpac
       }
 }
 
-const std::string WebCLConfiguration::getNameOfAddressSpaceNull (unsigned addressSpaceNum) const
+const std::string &WebCLConfiguration::getNameOfAddressSpaceNull (unsigned addressSpaceNum) const
 {
-      return variablePrefix_ + "_" + getNameOfAddressSpace(addressSpaceNum) + "_null";
+    std::string &name = getInterned(ADDRESS_SPACE_NULL, addressSpaceNum, 0, NULL, "");
+    if (name.empty())
+        name = variablePrefix_ + "_" + getNameOfAddressSpace(addressSpaceNum) + "_null";
+    return name;
 }
 
-const std::string WebCLConfiguration::getNameOfAddressSpaceNullPtrRef(unsigned addressSpaceNum) const
+const std::string &WebCLConfiguration::getNameOfAddressSpaceNullPtrRef(unsigned addressSpaceNum) const
 {
-    const std::string prefix = addressSpaceRecordName_ + "->";
+    std::string &ref = getInterned(ADDRESS_SPACE_NULL_PTR_REF, addressSpaceNum, 0, NULL, "");
+    if (!ref.empty())
+        return ref;
+
+    ref = addressSpaceRecordName_ + "->";
 
     switch (addressSpaceNum)
     {
     case clang::LangAS::opencl_global:
-        return prefix + globalNullField_;
+        return ref += globalNullField_;
     case clang::LangAS::opencl_constant:
-        return prefix + constantNullField_;
+        return ref += constantNullField_;
     case clang::LangAS::opencl_local:
-        return prefix + localNullField_;
+        return ref += localNullField_;
     }
 
-    return prefix + privateNullField_;
+    return ref += privateNullField_;
 }
 
-const std::string WebCLConfiguration::getIdentifierForString(std::string str) const
+const std::string &WebCLConfiguration::getIdentifierForString(const std::string &str) const
 {
-    std::string result;
+    std::string &result = getInterned(IDENTIFIER, 0, 0, NULL, str);
+    if (!result.empty() || str.empty())
+        return result;
+
     for (unsigned c = 0; c < str.size(); ++c) {
         switch (str[c]) {
         case ' ': {
@@ -183,19 +214,100 @@ const std::string WebCLConfiguration::getIdentifierForString(std::string str) co
     return result;
 }
 
-const std::string WebCLConfiguration::getNameOfLimitClampFunction(
-    unsigned addressSpaceNum, int limitCount, std::string type) const
+const std::string &WebCLConfiguration::getNameOfLimitClampFunction(
+    unsigned addressSpaceNum, int limitCount, const std::string &type) const
+{
+    std::string &name = getInterned(LIMIT_CLAMP_FUNCTION, addressSpaceNum, limitCount, NULL, type);
+    if (name.empty()) {
+        llvm::raw_string_ostream result(name);
+        result << functionPrefix_ << "_addr_clamp_" << getNameOfAddressSpace(addressSpaceNum) << "_" << limitCount << "_" << getIdentifierForString(type);
+    }
+    return name;
+}
+
+const std::string &WebCLConfiguration::getNameOfLimitCheckFunction(
+    unsigned addressSpaceNum, int limitCount, const std::string &type) const
+{
+    std::string &name = getInterned(LIMIT_CHECK_FUNCTION, addressSpaceNum, limitCount, NULL, type);
+    if (name.empty()) {
+        llvm::raw_string_ostream result(name);
+        result << functionPrefix_ << "_addr_check_" << getNameOfAddressSpace(addressSpaceNum) << "_" << limitCount << "_" << getIdentifierForString(type);
+    }
+    return name;
+}
+
+const std::string &WebCLConfiguration::getNameOfIndexClampFunction(
+    unsigned addressSpaceNum, const std::string &type) const
+{
+    std::string &name = getInterned(INDEX_CLAMP_FUNCTION, addressSpaceNum, 0, NULL, type);
+    if (name.empty()) {
+        llvm::raw_string_ostream result(name);
+        result << functionPrefix_ << "_idx_clamp_" << getNameOfAddressSpace(addressSpaceNum) << "_" << getIdentifierForString(type);
+    }
+    return name;
+}
+
+const std::string WebCLConfiguration::getNameOfCountedFunction(
+    const std::string &function) const
+{
+    assert(!function.compare(0, functionPrefix_.size(), functionPrefix_) &&
+           "Only generated functions have counted variants.");
+    return functionPrefix_ + "_counted" + function.substr(functionPrefix_.size());
+}
+
+const std::string WebCLConfiguration::getNameOfGroupType(
+    const std::string &type, const std::string &group) const
+{
+    if (group.empty())
+        return type;
+    return type + "_" + group;
+}
+
+const std::string WebCLConfiguration::getNameOfWrapperFunction(
+    const std::string &builtin, unsigned index) const
+{
+    std::stringstream result;
+    result << functionPrefix_ << "_" << builtin << "_" << index;
+    return result.str();
+}
+
+const std::string WebCLConfiguration::getNameOfHelperClone(
+    const std::string &function, unsigned index) const
 {
     std::stringstream result;
-    result << functionPrefix_ << "_addr_clamp_" << getNameOfAddressSpace(addressSpaceNum) << "_" << limitCount << "_" << getIdentifierForString(type);
+    result << functionPrefix_ << "_" << function << "_clone_" << index;
     return result.str();
 }
 
-const std::string WebCLConfiguration::getNameOfLimitCheckFunction(
-    unsigned addressSpaceNum, int limitCount, std::string type) const
+const std::string WebCLConfiguration::getNameOfCheckedPointer(unsigned index) const
 {
     std::stringstream result;
-    result << functionPrefix_ << "_addr_check_" << getNameOfAddressSpace(addressSpaceNum) << "_" << limitCount << "_" << getIdentifierForString(type);
+    result << variablePrefix_ << "_checked_" << index;
+    return result.str();
+}
+
+const std::string WebCLConfiguration::getNameOfGuardedPointer(unsigned index) const
+{
+    std::stringstream result;
+    result << variablePrefix_ << "_guarded_" << index;
+    return result.str();
+}
+
+const std::string WebCLConfiguration::getNameOfGuardedValue() const
+{
+    return variablePrefix_ + "_value";
+}
+
+const std::string WebCLConfiguration::getTrapStatusRef() const
+{
+    return addressSpaceRecordName_ + "->" + trapStatusField_;
+}
+
+const std::string WebCLConfiguration::getCheckCountersRef(unsigned site) const
+{
+    std::stringstream result;
+    result << addressSpaceRecordName_ << "->" << checkCountersField_
+           << " + " << (2 * site);
     return result.str();
 }
 
@@ -206,9 +318,12 @@ const std::string WebCLConfiguration::getNameOfSizeMacro(const std::string &asNa
   return name;
 }
 
-const std::string WebCLConfiguration::getNameOfSizeMacro(unsigned addressSpaceNum) const
+const std::string &WebCLConfiguration::getNameOfSizeMacro(unsigned addressSpaceNum) const
 {
-  return getNameOfSizeMacro(getNameOfAddressSpace(addressSpaceNum));
+  std::string &name = getInterned(SIZE_MACRO, addressSpaceNum, 0, NULL, "");
+  if (name.empty())
+    name = getNameOfSizeMacro(getNameOfAddressSpace(addressSpaceNum));
+  return name;
 }
 
 const std::string WebCLConfiguration::getNameOfAlignMacro(const std::string &asName) const
@@ -218,9 +333,12 @@ const std::string WebCLConfiguration::getNameOfAlignMacro(const std::string &asN
   return name;
 }
 
-const std::string WebCLConfiguration::getNameOfAlignMacro(unsigned addressSpaceNum) const
+const std::string &WebCLConfiguration::getNameOfAlignMacro(unsigned addressSpaceNum) const
 {
-  return getNameOfAlignMacro(getNameOfAddressSpace(addressSpaceNum));
+  std::string &name = getInterned(ALIGN_MACRO, addressSpaceNum, 0, NULL, "");
+  if (name.empty())
+    name = getNameOfAlignMacro(getNameOfAddressSpace(addressSpaceNum));
+  return name;
 }
 
 const std::string WebCLConfiguration::getNameOfLimitMacro() const
@@ -238,24 +356,19 @@ const std::string WebCLConfiguration::getNameOfSizeParameter(const std::string &
     return variablePrefix_ + "_" + arrayParamName + "_size";
 }
 
-const std::string WebCLConfiguration::getNameOfAnonymousStructure(const clang::RecordDecl *decl)
+const std::string &WebCLConfiguration::getNameOfAnonymousStructure(const clang::RecordDecl *decl)
 {
     static const std::string name = "Struct";
 
-    std::ostringstream out;
-    anonymousStructureRenamer_.generate(out, decl, name);
-    return out.str();
+    return anonymousStructureRenamer_.generate(decl, name);
 }
 
 const std::string WebCLConfiguration::getNameOfRelocatedTypeDecl(const clang::NamedDecl *decl)
 {
-    std::ostringstream out;
-
-    typedefRenamer_.rename(out, decl);
+    const std::string &renamed = typedefRenamer_.rename(decl);
 
     // Indicate error if renaming is needed.
     const std::string original = decl->getName();
-    const std::string renamed = out.str();
     if (original.compare(renamed))
         return std::string();
 
@@ -263,42 +376,57 @@ const std::string WebCLConfiguration::getNameOfRelocatedTypeDecl(const clang::Na
     return original;
 }
 
-const std::string WebCLConfiguration::getNameOfRelocatedVariable(const clang::VarDecl *decl)
+const std::string &WebCLConfiguration::getNameOfRelocatedVariable(const clang::VarDecl *decl)
 {
-    std::ostringstream out;
-
     switch (decl->getType().getAddressSpace()) {
     case 0:
-        privateVariableRenamer_.rename(out, decl);
-        break;
+        return privateVariableRenamer_.rename(decl);
     case clang::LangAS::opencl_local:
-        localVariableRenamer_.rename(out, decl);
-        break;
+        return localVariableRenamer_.rename(decl);
     default:
-        out << decl->getName().str();
         break;
     }
 
-    return out.str();
+    std::string &name = getInterned(RELOCATED_VARIABLE, 0, 0, decl, "");
+    if (name.empty())
+        name = decl->getName().str();
+    return name;
 }
 
-const std::string WebCLConfiguration::getNameOfLimitField(
+const std::string &WebCLConfiguration::getNameOfLimitField(
     const clang::VarDecl *decl, bool isMax) const
 {
-    std::ostringstream out;
+    std::string &name = getInterned(LIMIT_FIELD, 0, isMax, decl, "");
+    if (!name.empty())
+        return name;
+
+    llvm::raw_string_ostream out(name);
 
     const clang::FunctionDecl *function =
         llvm::dyn_cast<clang::FunctionDecl>(decl->getParentFunctionOrMethod());
     if (function)
-        out << function->getName().str() << "__";
+        out << function->getName() << "__";
 
-    out << decl->getName().str() << "_" << (isMax ? maxSuffix_ : minSuffix_);
+    out << decl->getName() << "_" << (isMax ? maxSuffix_ : minSuffix_);
 
     return out.str();
 }
 
-const std::string WebCLConfiguration::getReferenceToRelocatedVariable(const clang::VarDecl *decl)
+const std::string &WebCLConfiguration::getNameOfLimitVariable(
+    const clang::VarDecl *decl, bool isMax) const
 {
+    std::string &name = getInterned(LIMIT_VARIABLE, 0, isMax, decl, "");
+    if (name.empty())
+        name = variablePrefix_ + "_" + getNameOfLimitField(decl, isMax);
+    return name;
+}
+
+const std::string &WebCLConfiguration::getReferenceToRelocatedVariable(const clang::VarDecl *decl)
+{
+  std::string &reference = getInterned(RELOCATED_REFERENCE, 0, 0, decl, "");
+  if (!reference.empty())
+    return reference;
+
   std::string prefix;
 
   switch (decl->getType().getAddressSpace()) {
@@ -319,7 +447,7 @@ const std::string WebCLConfiguration::getReferenceToRelocatedVariable(const clan
       break;
   }
 
-  return prefix + getNameOfRelocatedVariable(decl);
+  return reference = prefix + getNameOfRelocatedVariable(decl);
 }
 
 const std::string WebCLConfiguration::getIndentation(unsigned int levels) const
@@ -330,31 +458,39 @@ const std::string WebCLConfiguration::getIndentation(unsigned int levels) const
     return indentation;
 }
 
-const std::string WebCLConfiguration::getStaticLimitRef(unsigned addressSpaceNum, std::string cast) const
+const std::string &WebCLConfiguration::getStaticLimitRef(unsigned addressSpaceNum, const std::string &cast) const
 {
+    std::string &ref = getInterned(STATIC_LIMIT_REF, addressSpaceNum, 0, NULL, cast);
+    if (!ref.empty())
+        return ref;
+
     std::string prefix = addressSpaceRecordName_ + "->";
 
     switch (addressSpaceNum) {
     case clang::LangAS::opencl_constant:
         prefix += constantLimitsField_ + ".";
-        return cast + prefix + constantMinField_ + ", " + cast + prefix + constantMaxField_;
+        return ref = cast + prefix + constantMinField_ + ", " + cast + prefix + constantMaxField_;
 
     case clang::LangAS::opencl_local:
         prefix += localLimitsField_ + ".";
-        return cast + prefix + localMinField_ + ", " + cast + prefix + localMaxField_;
+        return ref = cast + prefix + localMinField_ + ", " + cast + prefix + localMaxField_;
 
     case clang::LangAS::opencl_global:
         assert(false && "There can't be static allocations in global address space.");
-        return "0, 0";
+        return ref = "0, 0";
 
     default:
         prefix += privatesField_;
-        return cast + "&" + prefix + ", " + cast + "(&" + prefix + " + 1)";
+        return ref = cast + "&" + prefix + ", " + cast + "(&" + prefix + " + 1)";
     }
 }
 
-const std::string WebCLConfiguration::getDynamicLimitRef(const clang::VarDecl *decl, std::string cast) const
+const std::string &WebCLConfiguration::getDynamicLimitRef(const clang::VarDecl *decl, const std::string &cast) const
 {
+    std::string &ref = getInterned(DYNAMIC_LIMIT_REF, 0, 0, decl, cast);
+    if (!ref.empty())
+        return ref;
+
     std::string prefix = addressSpaceRecordName_ + "->";
 
     switch (decl->getType().getTypePtr()->getPointeeType().getAddressSpace()) {
@@ -374,17 +510,51 @@ const std::string WebCLConfiguration::getDynamicLimitRef(const clang::VarDecl *d
 
     prefix += ".";
 
-    std::stringstream retVal;
+    llvm::raw_string_ostream retVal(ref);
     retVal << cast << prefix << getNameOfLimitField(decl, false) << ", "
            << cast << prefix << getNameOfLimitField(decl, true);
     return retVal.str();
 }
 
-const std::string WebCLConfiguration::getNullLimitRef(unsigned addressSpaceNum) const
+const std::string &WebCLConfiguration::getStaticLimitVariables(unsigned addressSpaceNum, const std::string &cast) const
+{
+    switch (addressSpaceNum) {
+    case clang::LangAS::opencl_constant:
+    case clang::LangAS::opencl_local:
+        break;
+
+    default:
+        // private limits always come from the address space record
+        return getStaticLimitRef(addressSpaceNum, cast);
+    }
+
+    std::string &variables = getInterned(STATIC_LIMIT_VARIABLES, addressSpaceNum, 0, NULL, cast);
+    if (!variables.empty())
+        return variables;
+
+    if (addressSpaceNum == clang::LangAS::opencl_constant)
+        return variables = cast + constantMinField_ + ", " + cast + constantMaxField_;
+    return variables = cast + localMinField_ + ", " + cast + localMaxField_;
+}
+
+const std::string &WebCLConfiguration::getDynamicLimitVariables(const clang::VarDecl *decl, const std::string &cast) const
+{
+    std::string &variables = getInterned(DYNAMIC_LIMIT_VARIABLES, 0, 0, decl, cast);
+    if (variables.empty()) {
+        variables = cast + getNameOfLimitVariable(decl, false) + ", " +
+            cast + getNameOfLimitVariable(decl, true);
+    }
+    return variables;
+}
+
+const std::string &WebCLConfiguration::getNullLimitRef(unsigned addressSpaceNum) const
 {
     assert((addressSpaceNum == clang::LangAS::opencl_local) &&
            "Expected local address space.");
-    const std::string localNull = getNameOfAddressSpaceNull(addressSpaceNum);
-    return localNull + ", " + localNull + " + " + getNameOfSizeMacro(addressSpaceNum);
+    std::string &ref = getInterned(NULL_LIMIT_REF, addressSpaceNum, 0, NULL, "");
+    if (ref.empty()) {
+        const std::string &localNull = getNameOfAddressSpaceNull(addressSpaceNum);
+        ref = localNull + ", " + localNull + " + " + getNameOfSizeMacro(addressSpaceNum);
+    }
+    return ref;
 }
-
@@ -29,6 +29,8 @@
 
 #include "clang/AST/Type.h"
 
+#include "llvm/ADT/StringMap.h"
+
 #include <string>
 
 namespace clang {
@@ -40,6 +42,10 @@ namespace clang {
 
 /// A helper class for producing strings that occur repeatedly in
 /// generated code.
+///
+/// Generated identifiers and limit references are interned: each of
+/// them is built once per validation and the returned references
+/// stay valid as long as the configuration.
 class WebCLConfiguration
 {
 public:
@@ -48,20 +54,20 @@ public:
     ~WebCLConfiguration();
 
     /// \return Address space name (with the leading "__" omitted).
-    const std::string getNameOfAddressSpace(clang::QualType type) const;
-    const std::string getNameOfAddressSpace(unsigned addressSpaceNum) const;
+    const std::string &getNameOfAddressSpace(clang::QualType type) const;
+    const std::string &getNameOfAddressSpace(unsigned addressSpaceNum) const;
 
     /// \return Name of variable that reserves space for the largest
     /// memory reference in given address space.
     ///
     /// \see getNameOfAddressSpaceNullPtrRef
-    const std::string getNameOfAddressSpaceNull(unsigned addressSpace) const;
+    const std::string &getNameOfAddressSpaceNull(unsigned addressSpace) const;
     /// \return Reference to address space specific null pointer,
     /// i.e. the area that is big enough to contain the largest memory
     /// reference in that address space.
     ///
     /// \see getNameOfAddressSpaceNull
-    const std::string getNameOfAddressSpaceNullPtrRef(unsigned addressSpaceNum) const;
+    const std::string &getNameOfAddressSpaceNullPtrRef(unsigned addressSpaceNum) const;
 
     /// \return Name of macro that can be used to validate pointers. The
     /// generated macro with this name returns a valid pointer by making call to
@@ -71,8 +77,8 @@ public:
     /// \see getDynamicLimitRef
     /// \see getNullLimitRef
     /// \see getNameOfLimitCheckFunction
-    const std::string getNameOfLimitClampFunction(
-        unsigned addressSpaceNum, int limitCount, std::string type) const;
+    const std::string &getNameOfLimitClampFunction(
+        unsigned addressSpaceNum, int limitCount, const std::string &type) const;
     /// \return Name of macro that can be used to validate pointers. The
     /// generated macro with this name returns a boolean indicating whether the
     /// access is permitted or not.
@@ -81,16 +87,66 @@ public:
     /// \see getDynamicLimitRef
     /// \see getNullLimitRef
     /// \see getNameOfLimitClampFunction
-    const std::string getNameOfLimitCheckFunction(
-        unsigned addressSpaceNum, int limitCount, std::string type) const;
+    const std::string &getNameOfLimitCheckFunction(
+        unsigned addressSpaceNum, int limitCount, const std::string &type) const;
+    /// \return Name of function that validates an indexed access to
+    /// a kernel memory object parameter. The generated function with
+    /// this name compares the index against the element count of the
+    /// memory object and returns either the indexed address or the
+    /// null area of the address space.
+    const std::string &getNameOfIndexClampFunction(
+        unsigned addressSpaceNum, const std::string &type) const;
+    /// \return Name of a variant of the given check or clamp function
+    /// that also updates the execution counters of an access site.
+    ///
+    /// \see getNameOfLimitClampFunction
+    /// \see getNameOfLimitCheckFunction
+    /// \see getNameOfIndexClampFunction
+    const std::string getNameOfCountedFunction(const std::string &function) const;
+    /// \return Name of a type that is generated separately for each
+    /// group of kernels that share an allocation structure. Groups
+    /// are named after their first kernel. If the whole program
+    /// forms a single group, the group name is empty and the plain
+    /// type name is used.
+    const std::string getNameOfGroupType(
+        const std::string &type, const std::string &group) const;
+    /// \return Name of a generated function that checks the
+    /// arguments of a builtin function before calling it. Index must
+    /// be unique among the generated functions.
+    const std::string getNameOfWrapperFunction(
+        const std::string &builtin, unsigned index) const;
+    /// \return Name of a copy of a helper function that checks
+    /// accesses against a narrower set of limits. Index must be
+    /// unique among the copies of the function.
+    const std::string getNameOfHelperClone(
+        const std::string &function, unsigned index) const;
+    /// \return Name of a function local variable that holds a
+    /// checked address so that it can be reused by later identical
+    /// accesses.
+    const std::string getNameOfCheckedPointer(unsigned index) const;
+    /// \return Name of a function local variable that holds the
+    /// address of an access whose out of bounds evaluation is masked.
+    const std::string getNameOfGuardedPointer(unsigned index) const;
+    /// \return Name of a block scope variable that holds the value
+    /// of a guarded store, so that the value is evaluated even if the
+    /// store is skipped.
+    const std::string getNameOfGuardedValue() const;
+    /// \return Reference to the status word that is set when an out
+    /// of bounds access is trapped.
+    const std::string getTrapStatusRef() const;
+    /// \return Reference to the execution counters of the given
+    /// access site. Each site has two counters: the number of
+    /// executed checks and the number of accesses that were out of
+    /// bounds.
+    const std::string getCheckCountersRef(unsigned site) const;
     /// \return Name of macro that describes size of largest memory
     /// reference in given address space.
     const std::string getNameOfSizeMacro(const std::string &asName) const;
-    const std::string getNameOfSizeMacro(unsigned addressSpaceNum) const;
+    const std::string &getNameOfSizeMacro(unsigned addressSpaceNum) const;
     /// \return Name of macro that describes alignment for address
     /// space record.
     const std::string getNameOfAlignMacro(const std::string &asName) const;
-    const std::string getNameOfAlignMacro(unsigned addressSpaceNum) const;
+    const std::string &getNameOfAlignMacro(unsigned addressSpaceNum) const;
     /// \return Name of macro that calculates the last addressable
     /// location for some type.
     const std::string getNameOfLimitMacro() const;
@@ -102,38 +158,48 @@ public:
     const std::string getNameOfSizeParameter(const std::string &arrayParamName) const;
     /// \return Name that should be generated for given anonymous or
     /// nameless structure.
-    const std::string getNameOfAnonymousStructure(const clang::RecordDecl *decl);
+    const std::string &getNameOfAnonymousStructure(const clang::RecordDecl *decl);
     /// \return New name for type declaration that needs to be
     /// relocated.
     const std::string getNameOfRelocatedTypeDecl(const clang::NamedDecl *decl);
     /// \return New name for variable declaration that needs to be
     /// relocated.
-    const std::string getNameOfRelocatedVariable(const clang::VarDecl *decl);
+    const std::string &getNameOfRelocatedVariable(const clang::VarDecl *decl);
     /// \return Name of field in a limit structure describing a
     /// minimum or maximum value of some static or dynamic memory
     /// area.
-    const std::string getNameOfLimitField(const clang::VarDecl *decl, bool isMax) const;
+    const std::string &getNameOfLimitField(const clang::VarDecl *decl, bool isMax) const;
+    /// \return Name of kernel scope variable or helper function
+    /// parameter holding a minimum or maximum value of a memory
+    /// object passed to a kernel.
+    const std::string &getNameOfLimitVariable(const clang::VarDecl *decl, bool isMax) const;
     /// \return Reference to a variable that was relocated to an
     /// address space record.
-    const std::string getReferenceToRelocatedVariable(const clang::VarDecl *decl);
+    const std::string &getReferenceToRelocatedVariable(const clang::VarDecl *decl);
     /// \return The default whitespace sequence repeated the given
     /// number of times.
     const std::string getIndentation(unsigned int levels) const;
 
     /// \return Minimum and maximum limits of an address space
     /// structure.
-    const std::string getStaticLimitRef(unsigned addressSpaceNum, std::string cast = "") const;
+    const std::string &getStaticLimitRef(unsigned addressSpaceNum, const std::string &cast = "") const;
     /// \return Minimum and maximum limits of a memory object passed
     /// to a kernel.
-    const std::string getDynamicLimitRef(const clang::VarDecl *decl, std::string cast = "") const;
+    const std::string &getDynamicLimitRef(const clang::VarDecl *decl, const std::string &cast = "") const;
+    /// \return Minimum and maximum limits of an address space
+    /// structure when limits are kept in variables.
+    const std::string &getStaticLimitVariables(unsigned addressSpaceNum, const std::string &cast = "") const;
+    /// \return Minimum and maximum limits of a memory object passed
+    /// to a kernel when limits are kept in variables.
+    const std::string &getDynamicLimitVariables(const clang::VarDecl *decl, const std::string &cast = "") const;
     /// \return Minimum and maximum limits of a null memory area.
-    const std::string getNullLimitRef(unsigned addressSpaceNum) const;
+    const std::string &getNullLimitRef(unsigned addressSpaceNum) const;
 
     /// \return Stripped version of str in purpose of using it as an identifier
     /// Currently only handles spaces and asterisks. The generated sequences
     /// should be so that the user is not able to generate colliisions
     /// by choosing identifiers in a certain way.
-    const std::string getIdentifierForString(std::string str) const;
+    const std::string &getIdentifierForString(const std::string &str) const;
 
     /// Prefixes for generated types, variables and macros.
     const std::string typePrefix_;
@@ -204,8 +270,21 @@ public:
     const std::string constantNullField_;
     const std::string globalNullField_;
 
+    /// Kernel parameter pointing to the status word of trapped
+    /// accesses and its copy in the main allocation structure.
+    const std::string trapStatusParameter_;
+    const std::string trapStatusField_;
+
+    /// Kernel parameter pointing to the execution counters of memory
+    /// access checks and its copy in the main allocation structure.
+    const std::string checkCountersParameter_;
+    const std::string checkCountersField_;
+
     /// Name of macro for zeroing local memory areas.
     const std::string localRangeZeroingMacro_;
+    /// Name of macro for zeroing local memory areas that may be
+    /// initialized by work items.
+    const std::string localItemRangeZeroingMacro_;
 
     // List of data widths: 2, 4, 8, 16
     const UintList dataWidths_;
@@ -224,6 +303,38 @@ public:
 
 private:
 
+    /// Kinds of interned strings.
+    enum InternedKind {
+        ADDRESS_SPACE_NULL,
+        ADDRESS_SPACE_NULL_PTR_REF,
+        IDENTIFIER,
+        LIMIT_CLAMP_FUNCTION,
+        LIMIT_CHECK_FUNCTION,
+        INDEX_CLAMP_FUNCTION,
+        SIZE_MACRO,
+        ALIGN_MACRO,
+        LIMIT_FIELD,
+        LIMIT_VARIABLE,
+        RELOCATED_VARIABLE,
+        RELOCATED_REFERENCE,
+        STATIC_LIMIT_REF,
+        DYNAMIC_LIMIT_REF,
+        STATIC_LIMIT_VARIABLES,
+        DYNAMIC_LIMIT_VARIABLES,
+        NULL_LIMIT_REF
+    };
+
+    /// \return Interned string identified by its kind, address
+    /// space, limit count, declaration and type or cast. The string
+    /// is empty if it hasn't been generated yet, in which case the
+    /// caller assigns it.
+    std::string &getInterned(
+        InternedKind kind, unsigned addressSpaceNum, int limitCount,
+        const void *decl, const std::string &type) const;
+
+    /// Strings generated during the validation.
+    mutable llvm::StringMap<std::string> interned_;
+
     /// Renamer of variables relocated to local address space
     /// structure.
     WebCLRenamer localVariableRenamer_;
@@ -24,6 +24,7 @@
 #include "WebCLConsumer.hpp"
 #include "WebCLHelper.hpp"
 #include "WebCLPass.hpp"
+#include "WebCLTransformer.hpp"
 
 #include "clang/AST/ASTContext.h"
 
@@ -35,7 +36,7 @@ WebCLConsumer::WebCLConsumer(
     : clang::ASTConsumer()
     , restrictor_(instance)
     , analyser_(instance)
-    , visitors_()
+    , traversal_(instance, transformer.getOptions().analysisThreads)
     , inputNormaliser_(instance, analyser_, transformer)
     , addressSpaceHandler_(instance, analyser_, transformer)
     , kernelHandler_(instance, analyser_, transformer, addressSpaceHandler_)
@@ -43,12 +44,14 @@ WebCLConsumer::WebCLConsumer(
     , printer_(instance, rewriter, analyser_, transformer)
     , imageSampleSafetyHandler_(instance, analyser_, transformer, kernelHandler_)
     , functionCallHandler_(instance, analyser_, transformer, kernelHandler_)
+    , helperCloneHandler_(instance, analyser_, transformer, kernelHandler_, memoryAccessHandler_)
+    , reportHandler_(instance, analyser_, transformer, addressSpaceHandler_, kernelHandler_)
     , passes_()
 {
-    visitors_.push_back(&restrictor_);
+    traversal_.addVisitor(&restrictor_);
 
     // Collects information about nodes.
-    visitors_.push_back(&analyser_);
+    traversal_.addVisitor(&analyser_);
 
     // Checks that when image types are being used, they always originate from
     // function parameters
@@ -79,6 +82,16 @@ WebCLConsumer::WebCLConsumer(
     // Replace calls to builtin functions with versions that check the arguments
     // before calling them. The functions that perform the check are generated.
     passes_.push_back(&functionCallHandler_);
+
+    // Copies helper functions for the memory objects passed to them
+    // and checks the accesses of the copies against those objects
+    // only. Must be run after all other replacements of the copied
+    // functions have been made.
+    passes_.push_back(&helperCloneHandler_);
+
+    // Collects static facts about the instrumentation of each kernel
+    // for reports.
+    passes_.push_back(&reportHandler_);
   
     // Prints out the final result.
     passes_.push_back(&printer_);
@@ -97,10 +110,7 @@ void WebCLConsumer::HandleTranslationUnit(clang::ASTContext &context)
     
     // FUTURE: Add memory limit dependence analysis here (or maybe it
     //         could be even separate visitor). Also value range
-    //         analysis could help in many cases. Based on dependence
-    //         analysis, one could create separate implementations for
-    //         different calls if we know which arguments are passed
-    //         to function.
+    //         analysis could help in many cases.
 
     transform(context);
 
@@ -114,6 +124,11 @@ const std::string &WebCLConsumer::getTransformedSource() const
     return printer_.getOutput();
 }
 
+const WebCLSourceMap &WebCLConsumer::getSourceMap() const
+{
+    return printer_.getSourceMap();
+}
+
 const WebCLAnalyser::KernelList &WebCLConsumer::getKernels() const
 {
     return analyser_.getKernelFunctions();
@@ -121,14 +136,10 @@ const WebCLAnalyser::KernelList &WebCLConsumer::getKernels() const
 
 void WebCLConsumer::checkAndAnalyze(clang::ASTContext &context)
 {
-    clang::TranslationUnitDecl *decl = context.getTranslationUnitDecl();
-    for (Visitors::iterator i = visitors_.begin(); i != visitors_.end(); ++i) {
-        // There is no point to continue if an error has been reported.
-        if (!hasErrors(context)) {
-            WebCLVisitor *visitor = (*i);
-            visitor->TraverseDecl(decl);
-        }
-    }
+    // There is no point to continue if the parser has reported
+    // errors. Otherwise checks and analysis share a single walk.
+    if (!hasErrors(context))
+        traversal_.traverse(context.getTranslationUnitDecl());
 }
 
 void WebCLConsumer::transform(clang::ASTContext &context)
@@ -51,6 +51,9 @@ public:
     /// Get transformed source
     const std::string &getTransformedSource() const;
 
+    /// Get origins of transformed source
+    const WebCLSourceMap &getSourceMap() const;
+
     /// Get kernel info
     const WebCLAnalyser::KernelList &getKernels() const;
 
@@ -68,10 +71,9 @@ private:
     WebCLRestrictor restrictor_;
     /// Analyzes AST for transformation passes.
     WebCLAnalyser analyser_;
-    /// Visitors that check the AST for errors or perform analysis for
-    /// transformation passes.
-    typedef std::vector<WebCLVisitor*> Visitors;
-    Visitors visitors_;
+    /// Walks the AST once for all visitors that check the AST for
+    /// errors or perform analysis for transformation passes.
+    WebCLTraversal traversal_;
 
     /// Transformation passes.
     WebCLInputNormaliser inputNormaliser_;
@@ -81,6 +83,8 @@ private:
     WebCLValidatorPrinter printer_;
     WebCLImageSamplerSafetyHandler imageSampleSafetyHandler_;
     WebCLFunctionCallHandler functionCallHandler_;
+    WebCLHelperCloneHandler helperCloneHandler_;
+    WebCLReportHandler reportHandler_;
     /// Passes that generate transformations based on analysis.
     typedef std::vector<WebCLPass*> Passes;
     Passes passes_;
@@ -22,7 +22,9 @@
 */
 
 #include "WebCLDiag.hpp"
+#include "WebCLSourceMap.hpp"
 
+#include <algorithm>
 #include <utility>
 
 #include "llvm/ADT/SmallString.h"
@@ -30,6 +32,7 @@
 #include "clang/Basic/SourceManager.h"
 
 WebCLDiag::WebCLDiag()
+    : input_(NULL), sourceMap_(NULL)
 {
 }
 
@@ -47,6 +50,12 @@ void WebCLDiag::EndSourceFile()
 {
 }
 
+void WebCLDiag::setSourceMap(const std::string &input, const WebCLSourceMap &map)
+{
+    input_ = &input;
+    sourceMap_ = &map;
+}
+
 namespace
 {
     bool collectSourceLocation(
@@ -84,6 +93,22 @@ namespace
 
         return true;
     }
+
+    unsigned getInputLine(
+        const clang::Diagnostic &info,
+        const std::string &input, const WebCLSourceMap &map)
+    {
+        clang::SourceManager &sm = info.getSourceManager();
+
+        std::pair<clang::FileID, unsigned> filePosPair =
+            sm.getDecomposedExpansionLoc(info.getLocation());
+        if (filePosPair.first != sm.getMainFileID())
+            return 0;
+
+        const unsigned offset =
+            std::min(map.getInput(filePosPair.second), static_cast<unsigned>(input.size()));
+        return std::count(input.begin(), input.begin() + offset, '\n') + 1;
+    }
 }
 
 void WebCLDiag::HandleDiagnostic(clang::DiagnosticsEngine::Level level, const clang::Diagnostic &info)
@@ -97,7 +122,8 @@ void WebCLDiag::HandleDiagnostic(clang::DiagnosticsEngine::Level level, const cl
     info.FormatDiagnostic(formatted);
     message.text = formatted.str();
 
-    collectSourceLocation(info, this->sources, message);
+    if (collectSourceLocation(info, this->sources, message) && sourceMap_)
+        message.inputLine = getInputLine(info, *input_, *sourceMap_);
 
     messages.push_back(message);
 }
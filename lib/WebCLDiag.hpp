@@ -34,6 +34,8 @@ namespace clang {
     class Preprocessor;
 }
 
+class WebCLSourceMap;
+
 /// Captures Clang warning/error output
 class WebCLDiag : public clang::DiagnosticConsumer
 {
@@ -46,6 +48,11 @@ public:
     void EndSourceFile();
     void HandleDiagnostic(clang::DiagnosticsEngine::Level Level, const clang::Diagnostic &Info);
 
+    /// Diagnostics of the main file are mapped back to lines of the
+    /// input source with the given map. The map is kept up to date
+    /// for the stage that is running.
+    void setSourceMap(const std::string &input, const WebCLSourceMap &map);
+
     struct Message {
         clang::DiagnosticsEngine::Level level;
         std::string text;
@@ -53,10 +60,14 @@ public:
         std::shared_ptr<std::string> source;
         std::string::size_type sourceOffset;
         std::string::size_type sourceLen;
+        /// Line of the input source counting from 1, or 0 if the
+        /// message doesn't refer to the input source.
+        unsigned inputLine;
 
         Message(clang::DiagnosticsEngine::Level level)
             : level(level)
             , source(), sourceOffset(std::string::npos), sourceLen(std::string::npos)
+            , inputLine(0)
         {
         }
     };
@@ -66,4 +77,7 @@ public:
 private:
 
     std::map<clang::FileID, std::shared_ptr<std::string> > sources;
+
+    const std::string *input_;
+    const WebCLSourceMap *sourceMap_;
 };
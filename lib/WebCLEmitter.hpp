@@ -0,0 +1,80 @@
+#ifndef WEBCLVALIDATOR_WEBCLEMITTER
+#define WEBCLVALIDATOR_WEBCLEMITTER
+
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// \brief Appends generated code to a string.
+///
+/// The stream is unbuffered, so it can be created on the stack
+/// whenever code is added to a long lived string and the string is
+/// always up to date.
+class WebCLCodeStream : public llvm::raw_ostream
+{
+public:
+
+    explicit WebCLCodeStream(std::string &code);
+    virtual ~WebCLCodeStream();
+
+    /// \return Code written so far.
+    const std::string &code() const;
+
+private:
+
+    /// \see llvm::raw_ostream::write_impl
+    virtual void write_impl(const char *ptr, size_t size);
+    /// \see llvm::raw_ostream::current_pos
+    virtual uint64_t current_pos() const;
+
+    /// String to which code is appended.
+    std::string &code_;
+};
+
+/// Storage of a fragment, constructed before the fragment stream.
+struct WebCLFragmentBuffer
+{
+    /// Fits the replacement of a typical memory access.
+    llvm::SmallString<256> buffer_;
+};
+
+/// \brief Composes a short piece of generated code on the stack.
+///
+/// Pieces like names, casts and limit references are written
+/// directly into an inline buffer instead of being concatenated from
+/// temporary strings. The heap is used only if the fragment doesn't
+/// fit into the buffer.
+class WebCLFragment : private WebCLFragmentBuffer
+                    , public llvm::raw_svector_ostream
+{
+public:
+
+    WebCLFragment();
+    virtual ~WebCLFragment();
+};
+
+#endif // WEBCLVALIDATOR_WEBCLEMITTER
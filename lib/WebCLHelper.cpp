@@ -23,6 +23,8 @@
 
 #include "WebCLHelper.hpp"
 
+#include "clang/Basic/AddressSpaces.h"
+
 AddressSpaceLimits::AddressSpaceLimits(unsigned addressSpace)
     : hasStaticLimits_(false)
     , addressSpace_(addressSpace)
@@ -67,3 +69,78 @@ AddressSpaceLimits::LimitList &AddressSpaceLimits::getDynamicLimits()
 {
     return dynamicLimits_;
 }
+
+KernelAllocations::KernelAllocations(const std::string &name)
+    : name_(name)
+    , kernels_()
+    , globalLimits_(clang::LangAS::opencl_global)
+    , constantLimits_(clang::LangAS::opencl_constant)
+    , localLimits_(clang::LangAS::opencl_local)
+    , privateLimits_(0)
+    , privates_()
+{
+}
+
+KernelAllocations::~KernelAllocations()
+{
+}
+
+const std::string &KernelAllocations::getName()
+{
+    return name_;
+}
+
+void KernelAllocations::insertKernel(clang::FunctionDecl *kernel)
+{
+    kernels_.push_back(kernel);
+}
+
+std::vector<clang::FunctionDecl*> &KernelAllocations::getKernels()
+{
+    return kernels_;
+}
+
+AddressSpaceLimits &KernelAllocations::getLimits(unsigned addressSpace)
+{
+    switch (addressSpace) {
+    case clang::LangAS::opencl_global:
+        return globalLimits_;
+    case clang::LangAS::opencl_constant:
+        return constantLimits_;
+    case clang::LangAS::opencl_local:
+        return localLimits_;
+    default:
+        return privateLimits_;
+    }
+}
+
+AddressSpaceLimits &KernelAllocations::getGlobalLimits()
+{
+    return globalLimits_;
+}
+
+AddressSpaceLimits &KernelAllocations::getConstantLimits()
+{
+    return constantLimits_;
+}
+
+AddressSpaceLimits &KernelAllocations::getLocalLimits()
+{
+    return localLimits_;
+}
+
+AddressSpaceLimits &KernelAllocations::getPrivateLimits()
+{
+    return privateLimits_;
+}
+
+AddressSpaceInfo &KernelAllocations::getPrivates()
+{
+    return privates_;
+}
+
+bool KernelAllocations::hasAllocations()
+{
+    return !privates_.empty() || !globalLimits_.empty() ||
+        !constantLimits_.empty() || !localLimits_.empty();
+}
@@ -24,9 +24,11 @@
 ** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
 */
 
+#include <string>
 #include <vector>
 
 namespace clang {
+    class FunctionDecl;
     class ParmVarDecl;
     class VarDecl;
 }
@@ -84,4 +86,113 @@ private:
     LimitList dynamicLimits_;
 };
 
+/// Represents the allocation structure of a group of kernels. A
+/// group consists of kernels that share helper functions and of all
+/// helper functions that are reachable from those kernels. The
+/// allocation structure of a group contains only the memory areas
+/// that the kernels of the group can access.
+class KernelAllocations
+{
+public:
+
+    KernelAllocations(const std::string &name);
+    ~KernelAllocations();
+
+    /// \return Name that distinguishes types generated for this
+    /// group. Empty if the group covers the whole program.
+    const std::string &getName();
+
+    /// Inform about a kernel that belongs to the group.
+    void insertKernel(clang::FunctionDecl *kernel);
+    /// \return Kernels of the group in source order.
+    std::vector<clang::FunctionDecl*> &getKernels();
+
+    /// \return Limits of the given address space.
+    AddressSpaceLimits &getLimits(unsigned addressSpace);
+    AddressSpaceLimits &getGlobalLimits();
+    AddressSpaceLimits &getConstantLimits();
+    AddressSpaceLimits &getLocalLimits();
+    AddressSpaceLimits &getPrivateLimits();
+
+    /// \return Relocated private variables of the functions in the
+    /// group.
+    AddressSpaceInfo &getPrivates();
+
+    /// \return Whether any memory areas need to be checked.
+    bool hasAllocations();
+
+private:
+
+    /// Distinguishes generated types of the group.
+    std::string name_;
+    /// Kernels of the group.
+    std::vector<clang::FunctionDecl*> kernels_;
+    /// Dynamic limits for global address space.
+    AddressSpaceLimits globalLimits_;
+    /// Static and dynamic limits for constant address space.
+    AddressSpaceLimits constantLimits_;
+    /// Static and dynamic limits for local address space.
+    AddressSpaceLimits localLimits_;
+    /// Static limits for private address space.
+    AddressSpaceLimits privateLimits_;
+    /// Relocated private variables.
+    AddressSpaceInfo privates_;
+};
+
+/// Source location of a memory access check that counts its
+/// executions. Lines and columns refer to the preprocessed source
+/// that is validated.
+struct CheckSite
+{
+    CheckSite(unsigned line, unsigned column)
+        : line(line), column(column) {}
+
+    unsigned line;
+    unsigned column;
+};
+
+/// Access sites in the order of their counter indices.
+typedef std::vector<CheckSite> CheckSiteList;
+
+/// Static facts about the instrumentation of a kernel. Checks and
+/// wrappers are counted in the kernel and in the helper functions
+/// that it may call. Copies of helper functions aren't counted
+/// separately. Sizes are in bytes and don't include padding.
+struct KernelReport
+{
+    KernelReport()
+        : privateChecks(0), localChecks(0), constantChecks(0), globalChecks(0)
+        , checkLimits(0), maxCheckLimits(0)
+        , privateBytes(0), localBytes(0), constantBytes(0)
+        , wrappers(0), allocationsBytes(0), localZeroingBytes(0)
+        , addedParameters(0) {}
+
+    /// Checked memory accesses of each address space.
+    unsigned privateChecks;
+    unsigned localChecks;
+    unsigned constantChecks;
+    unsigned globalChecks;
+
+    /// Limits compared by all checks together and by the check that
+    /// compares the most limits.
+    unsigned checkLimits;
+    unsigned maxCheckLimits;
+
+    /// Relocated variables of each address space.
+    unsigned privateBytes;
+    unsigned localBytes;
+    unsigned constantBytes;
+
+    /// Distinct builtin wrapper functions called.
+    unsigned wrappers;
+    /// Estimated size of the allocation structure.
+    unsigned allocationsBytes;
+    /// Local memory zeroed at kernel start, excluding local memory
+    /// parameters whose sizes are known only when the kernel is
+    /// enqueued.
+    unsigned localZeroingBytes;
+    /// Parameters added to the kernel signature.
+    unsigned addedParameters;
+};
+
 #endif // WEBCLVALIDATOR_WEBCLHELPER
@@ -0,0 +1,115 @@
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include "WebCLOptions.hpp"
+
+#include <sstream>
+
+WebCLOptions::WebCLOptions()
+    : checkMode(CHECK_MODE_CLAMP)
+    , violationMode(VIOLATION_MODE_CLAMP)
+    , limitMode(LIMIT_MODE_RECORD)
+    , helperClones(0)
+    , countChecks(false)
+    , analysisThreads(1)
+    , compactOutput(false)
+{
+}
+
+WebCLOptions::~WebCLOptions()
+{
+}
+
+bool WebCLOptions::parse(const std::string &options, std::string &error)
+{
+    static const std::string checkModeOption = "-check-mode=";
+    static const std::string violationModeOption = "-violation-mode=";
+    static const std::string limitModeOption = "-limit-mode=";
+    static const std::string helperClonesOption = "-helper-clones=";
+    static const std::string countChecksOption = "-count-checks";
+    static const std::string analysisThreadsOption = "-analysis-threads=";
+    static const std::string compactOutputOption = "-compact-output";
+
+    std::istringstream in(options);
+    std::string option;
+    while (in >> option) {
+        if (!option.compare(0, checkModeOption.size(), checkModeOption)) {
+            const std::string mode = option.substr(checkModeOption.size());
+            if (mode == "clamp") {
+                checkMode = CHECK_MODE_CLAMP;
+            } else if (mode == "offset") {
+                checkMode = CHECK_MODE_OFFSET;
+            } else {
+                error = "Unknown check mode '" + mode + "'.";
+                return false;
+            }
+        } else if (!option.compare(0, violationModeOption.size(), violationModeOption)) {
+            const std::string mode = option.substr(violationModeOption.size());
+            if (mode == "clamp") {
+                violationMode = VIOLATION_MODE_CLAMP;
+            } else if (mode == "mask") {
+                violationMode = VIOLATION_MODE_MASK;
+            } else if (mode == "trap") {
+                violationMode = VIOLATION_MODE_TRAP;
+            } else {
+                error = "Unknown violation mode '" + mode + "'.";
+                return false;
+            }
+        } else if (!option.compare(0, limitModeOption.size(), limitModeOption)) {
+            const std::string mode = option.substr(limitModeOption.size());
+            if (mode == "record") {
+                limitMode = LIMIT_MODE_RECORD;
+            } else if (mode == "scalar") {
+                limitMode = LIMIT_MODE_SCALAR;
+            } else {
+                error = "Unknown limit mode '" + mode + "'.";
+                return false;
+            }
+        } else if (!option.compare(0, helperClonesOption.size(), helperClonesOption)) {
+            const std::string count = option.substr(helperClonesOption.size());
+            std::istringstream value(count);
+            if (count.empty() || (count[0] == '-') ||
+                !(value >> helperClones) || !value.eof()) {
+                error = "Invalid helper clone count '" + count + "'.";
+                return false;
+            }
+        } else if (option == countChecksOption) {
+            countChecks = true;
+        } else if (!option.compare(0, analysisThreadsOption.size(), analysisThreadsOption)) {
+            const std::string count = option.substr(analysisThreadsOption.size());
+            std::istringstream value(count);
+            if (count.empty() || (count[0] == '-') ||
+                !(value >> analysisThreads) || !value.eof() || !analysisThreads) {
+                error = "Invalid analysis thread count '" + count + "'.";
+                return false;
+            }
+        } else if (option == compactOutputOption) {
+            compactOutput = true;
+        } else {
+            error = "Unknown option '" + option + "'.";
+            return false;
+        }
+    }
+
+    return true;
+}
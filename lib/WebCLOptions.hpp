@@ -0,0 +1,107 @@
+#ifndef WEBCLVALIDATOR_WEBCLOPTIONS
+#define WEBCLVALIDATOR_WEBCLOPTIONS
+
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include <string>
+
+/// Code generation options that are selected per validated
+/// program. The options are given as a single string of space
+/// separated words, e.g. "-check-mode=offset -violation-mode=trap".
+class WebCLOptions
+{
+public:
+
+    /// How indexed memory accesses are checked.
+    enum CheckMode {
+        /// Computed addresses are clamped against the minimum and
+        /// maximum pointers of every memory area in the address space.
+        CHECK_MODE_CLAMP,
+        /// Subscripts of kernel memory object parameters are compared
+        /// against the element count of the memory object. Other
+        /// accesses fall back to clamping.
+        CHECK_MODE_OFFSET
+    };
+
+    /// What happens when a memory access would be out of bounds.
+    enum ViolationMode {
+        /// The access is redirected to the null area of the address
+        /// space.
+        VIOLATION_MODE_CLAMP,
+        /// Stores that form whole statements are skipped and value
+        /// loads read zero. Other accesses are still clamped.
+        VIOLATION_MODE_MASK,
+        /// Like masking, but the work item also sets the status word
+        /// passed in the last kernel parameter. Masked stores return
+        /// from functions that don't return a value.
+        VIOLATION_MODE_TRAP
+    };
+
+    /// Where memory area limits are kept.
+    enum LimitMode {
+        /// Limits are fields of the allocation structure that is
+        /// passed to helper functions by pointer.
+        LIMIT_MODE_RECORD,
+        /// Limits are kernel scope variables. Helper functions get
+        /// the limits of the address spaces they access as
+        /// parameters.
+        LIMIT_MODE_SCALAR
+    };
+
+    WebCLOptions();
+    ~WebCLOptions();
+
+    /// Parses an option string. Options that aren't mentioned keep
+    /// their previous values.
+    ///
+    /// \return Whether all options were recognized. If not, a
+    /// description of the problem is stored in error.
+    bool parse(const std::string &options, std::string &error);
+
+    /// Selected memory access check mode.
+    CheckMode checkMode;
+    /// Selected handling of out of bounds memory accesses.
+    ViolationMode violationMode;
+    /// Selected storage of memory area limits.
+    LimitMode limitMode;
+    /// Maximum number of copies made of a helper function. Each copy
+    /// checks accesses through its pointer parameters only against
+    /// the memory objects that its callers pass to it. Zero disables
+    /// copying.
+    unsigned helperClones;
+    /// Whether memory access checks count how many times they are
+    /// executed and how many times they find an access out of
+    /// bounds. The counts are stored to a buffer that is passed in
+    /// the last kernel parameter.
+    bool countChecks;
+    /// Number of threads that analyse function bodies. Diagnostics
+    /// and generated code don't depend on the number of threads.
+    unsigned analysisThreads;
+    /// Whether comments, indentation and blank lines are left out of
+    /// the validated source. Line directives keep the line numbers
+    /// of the remaining lines.
+    bool compactOutput;
+};
+
+#endif // WEBCLVALIDATOR_WEBCLOPTIONS
@@ -30,8 +30,12 @@
 
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Attr.h"
+#include "clang/AST/ParentMap.h"
 #include "clang/Basic/OpenCL.h"
 
+#include <algorithm>
+#include <sstream>
+
 WebCLPass::WebCLPass(
     clang::CompilerInstance &instance,
     WebCLAnalyser &analyser, WebCLTransformer &transformer)
@@ -66,8 +70,10 @@ void WebCLInputNormaliser::run(clang::ASTContext &context)
 
 WebCLHelperFunctionHandler::WebCLHelperFunctionHandler(
     clang::CompilerInstance &instance,
-    WebCLAnalyser &analyser, WebCLTransformer &transformer)
+    WebCLAnalyser &analyser, WebCLTransformer &transformer,
+    WebCLKernelHandler &kernelHandler)
     : WebCLPass(instance, analyser, transformer)
+    , kernelHandler_(kernelHandler)
 {
 }
 
@@ -82,10 +88,14 @@ void WebCLHelperFunctionHandler::run(clang::ASTContext &context)
     WebCLAnalyser::FunctionDeclSet &helperFunctions = analyser_.getHelperFunctions();
     for (WebCLAnalyser::FunctionDeclSet::iterator i = helperFunctions.begin();
         i != helperFunctions.end(); ++i) {
+        KernelAllocations &allocs = kernelHandler_.getAllocations(*i);
+        if (!allocs.hasAllocations())
+            continue;
         if (!(*i)->hasBody()) {
             error((*i)->getLocStart(), "All declared functions must be defined");
         }
-        transformer_.addRecordParameter(*i);
+        transformer_.addRecordParameter(
+            *i, allocs, kernelHandler_.getLimitAddressSpaces(*i));
     }
 
     // Go through all helper function calls and add allocation
@@ -93,7 +103,11 @@ void WebCLHelperFunctionHandler::run(clang::ASTContext &context)
     WebCLAnalyser::CallExprSet &internalCalls = analyser_.getInternalCalls();
     for (WebCLAnalyser::CallExprSet::iterator i = internalCalls.begin();
         i != internalCalls.end(); ++i) {
-        transformer_.addRecordArgument(*i);
+        KernelAllocations &allocs = kernelHandler_.getAllocations(*i);
+        if (allocs.hasAllocations()) {
+            transformer_.addRecordArgument(
+                *i, allocs, kernelHandler_.getLimitAddressSpaces((*i)->getDirectCallee()));
+        }
     }
 }
 
@@ -122,7 +136,7 @@ void WebCLAddressSpaceHandler::run(clang::ASTContext &context)
             if (decl->getType()->isPointerType() ||
                 decl->getType()->isStructureType() ||
                 decl->getType()->isArrayType() ||
-                analyser_.hasAddressReferences(decl)) {
+                analyser_.hasEscapingAddress(decl)) {
                     DEBUG(
                         std::cerr << "Adding to AS: "
                         << decl->getDeclName().getAsString() << "\n"; );
@@ -146,8 +160,8 @@ void WebCLAddressSpaceHandler::run(clang::ASTContext &context)
             locals_.insert(*i);
     }
 
-    // create address space types
-    transformer_.createPrivateAddressSpaceTypedef(getPrivateAddressSpace());
+    // create address space types, private address space types are
+    // created separately for each kernel group
     transformer_.createLocalAddressSpaceTypedef(getLocalAddressSpace());
     transformer_.createConstantAddressSpaceTypedef(getConstantAddressSpace());
 }
@@ -230,7 +244,8 @@ void WebCLAddressSpaceHandler::doRelocations()
                     "anywhere with & operator.";
                 error(privDecl->getLocStart(), message);
             } else {
-                transformer_.addRelocationInitializer(privDecl);
+                transformer_.addRelocationInitializer(
+                    privDecl, analyser_.getSingleDeclStmt(privDecl));
             }
         }
     }
@@ -292,11 +307,8 @@ WebCLKernelHandler::WebCLKernelHandler(
     WebCLAddressSpaceHandler &addressSpaceHandler)
     : WebCLPass(instance, analyser, transformer)
     , addressSpaceHandler_(addressSpaceHandler)
-    , helperFunctionHandler_(instance, analyser, transformer)
-    , globalLimits_(clang::LangAS::opencl_global)
-    , constantLimits_(clang::LangAS::opencl_constant)
-    , localLimits_(clang::LangAS::opencl_local)
-    , privateLimits_(0)
+    , allocations_()
+    , functionGroups_()
 {
 }
 
@@ -307,15 +319,32 @@ WebCLKernelHandler::~WebCLKernelHandler()
 
 void WebCLKernelHandler::run(clang::ASTContext &context)
 {
-    globalLimits_.setStaticLimits(false);
-    constantLimits_.setStaticLimits(addressSpaceHandler_.hasConstantAddressSpace());
-    localLimits_.setStaticLimits(addressSpaceHandler_.hasLocalAddressSpace());
-    privateLimits_.setStaticLimits(true);
+    createAllocationGroups();
+    findClampedAddressSpaces();
+    findLimitAddressSpaces();
+
+    for (std::vector<KernelAllocations>::iterator i = allocations_.begin();
+         i != allocations_.end(); ++i) {
+        i->getGlobalLimits().setStaticLimits(false);
+        i->getConstantLimits().setStaticLimits(addressSpaceHandler_.hasConstantAddressSpace());
+        i->getLocalLimits().setStaticLimits(addressSpaceHandler_.hasLocalAddressSpace());
+        i->getPrivateLimits().setStaticLimits(true);
+    }
+
+    // distribute relocated private variables to the groups of their
+    // functions
+    AddressSpaceInfo &privates = addressSpaceHandler_.getPrivateAddressSpace();
+    for (AddressSpaceInfo::iterator i = privates.begin(); i != privates.end(); ++i) {
+        const clang::FunctionDecl *function =
+            llvm::dyn_cast_or_null<clang::FunctionDecl>((*i)->getParentFunctionOrMethod());
+        getAllocations(function).getPrivates().push_back(*i);
+    }
 
     // go through dynamic limits in the program and create variables for them
     WebCLAnalyser::KernelList &kernels = analyser_.getKernelFunctions();
     for (WebCLAnalyser::KernelList::iterator i = kernels.begin();
         i != kernels.end(); ++i) {
+            KernelAllocations &allocs = getAllocations(i->decl);
             for (std::vector<WebCLAnalyser::KernelArgInfo>::const_iterator j = i->args.begin();
                 j != i->args.end(); ++j) {
                     const WebCLAnalyser::KernelArgInfo &parm = *j;
@@ -331,15 +360,15 @@ void WebCLKernelHandler::run(clang::ASTContext &context)
                         switch (parm.pointerKind) {
                         case WebCLTypes::GLOBAL_POINTER:
                             DEBUG( std::cerr << "Global address space!\n"; );
-                            globalLimits_.insert(parm.decl);
+                            allocs.getGlobalLimits().insert(parm.decl);
                             break;
                         case WebCLTypes::CONSTANT_POINTER:
                             DEBUG( std::cerr << "Constant address space!\n"; );
-                            constantLimits_.insert(parm.decl);
+                            allocs.getConstantLimits().insert(parm.decl);
                             break;
                         case WebCLTypes::LOCAL_POINTER:
                             DEBUG( std::cerr << "Local address space!\n"; );
-                            localLimits_.insert(parm.decl);
+                            allocs.getLocalLimits().insert(parm.decl);
                             break;
                         case WebCLTypes::IMAGE_HANDLE:
                             DEBUG( std::cerr << "Image or sampler argument!\n"; );
@@ -351,20 +380,24 @@ void WebCLKernelHandler::run(clang::ASTContext &context)
                         }
                     }
             }
+
+            transformer_.addTrailingParameters(i->decl);
     }
 
-    // Add typedefs for each limit structure. These are required if
-    // static or dynamic allocations are present.
-    if (!globalLimits_.empty())
-        transformer_.createGlobalAddressSpaceLimitsTypedef(globalLimits_);
-    if (!constantLimits_.empty())
-        transformer_.createConstantAddressSpaceLimitsTypedef(constantLimits_);
-    if (!localLimits_.empty())
-        transformer_.createLocalAddressSpaceLimitsTypedef(localLimits_);
-    if (hasProgramAllocations()) {
-        transformer_.createProgramAllocationsTypedef(
-            globalLimits_, constantLimits_, localLimits_,
-            addressSpaceHandler_.getPrivateAddressSpace());
+    // Add typedefs for each limit structure of each kernel group.
+    // These are required if static or dynamic allocations are
+    // present.
+    for (std::vector<KernelAllocations>::iterator i = allocations_.begin();
+         i != allocations_.end(); ++i) {
+        transformer_.createPrivateAddressSpaceTypedef(*i);
+        if (!i->getGlobalLimits().empty())
+            transformer_.createGlobalAddressSpaceLimitsTypedef(*i);
+        if (!i->getConstantLimits().empty())
+            transformer_.createConstantAddressSpaceLimitsTypedef(*i);
+        if (!i->getLocalLimits().empty())
+            transformer_.createLocalAddressSpaceLimitsTypedef(*i);
+        if (i->hasAllocations())
+            transformer_.createProgramAllocationsTypedef(*i);
     }
 
     // now that we have all the data about the limit structures, we can actually
@@ -373,6 +406,7 @@ void WebCLKernelHandler::run(clang::ASTContext &context)
         i != kernels.end(); ++i) {
 
             clang::FunctionDecl *func = i->decl;
+            KernelAllocations &allocs = getAllocations(func);
 
             // Create allocation for local address space according to
             // earlier typedef. This is required if there are static
@@ -387,26 +421,28 @@ void WebCLKernelHandler::run(clang::ASTContext &context)
             // pointer to it, give all the data it needs to be able to create
             // also static initializator and prevent need for separate private
             // area zeroing...
-            if (hasProgramAllocations()) {
-                transformer_.createProgramAllocationsAllocation(
-                    func, globalLimits_, constantLimits_, localLimits_,
-                    addressSpaceHandler_.getPrivateAddressSpace());
-            }
+            if (allocs.hasAllocations())
+                transformer_.createProgramAllocationsAllocation(func, allocs);
 
             // Initialize null pointers for global and private addres spaces
-            transformer_.initializeAddressSpaceNull(func, globalLimits_);
-            if (!addressSpaceHandler_.getPrivateAddressSpace().empty()) {
-                transformer_.initializeAddressSpaceNull(func, privateLimits_);
+            transformer_.initializeAddressSpaceNull(func, allocs.getGlobalLimits());
+            if (!allocs.getPrivates().empty()) {
+                transformer_.initializeAddressSpaceNull(func, allocs.getPrivateLimits());
             }
 
             // inject code that does zero initializing for all local memory ranges
-            transformer_.createLocalAreaZeroing(func, localLimits_);
+            transformer_.createLocalAreaZeroing(
+                func, allocs.getLocalLimits(),
+                getItemInitializedParameters(context, func));
     }
 
     // Fixes all the function signatures and calls of internal helper functions
     // with additional wcl_allocs arg
-    if (hasProgramAllocations())
-        helperFunctionHandler_.run(context);
+    if (hasProgramAllocations()) {
+        WebCLHelperFunctionHandler helperFunctionHandler(
+            instance_, analyser_, transformer_, *this);
+        helperFunctionHandler.run(context);
+    }
 
     // Now that limits and all new address spaces are created do the replacements
     // so that struct fields are used instead of original variable declarations.
@@ -415,22 +451,124 @@ void WebCLKernelHandler::run(clang::ASTContext &context)
     addressSpaceHandler_.emitConstantAddressSpaceAllocation();
 }
 
+bool WebCLKernelHandler::isGuardedAccess(clang::Expr *access)
+{
+    if (transformer_.getOptions().violationMode == WebCLOptions::VIOLATION_MODE_CLAMP)
+        return false;
+
+    switch (analyser_.getAccessUse(access)) {
+    case WebCLAnalyser::ACCESS_USE_STORE_STATEMENT:
+        return true;
+    case WebCLAnalyser::ACCESS_USE_LOAD: {
+        // loads read zero instead of the value
+        return !WebCLTypes::classifyType(instance_, access->getType()).zeroValue.empty();
+    }
+    default:
+        return false;
+    }
+}
+
+void WebCLKernelHandler::findClampedAddressSpaces()
+{
+    if (transformer_.getOptions().violationMode == WebCLOptions::VIOLATION_MODE_CLAMP) {
+        transformer_.addClampedAddressSpace(0);
+        transformer_.addClampedAddressSpace(clang::LangAS::opencl_global);
+        transformer_.addClampedAddressSpace(clang::LangAS::opencl_constant);
+        transformer_.addClampedAddressSpace(clang::LangAS::opencl_local);
+        return;
+    }
+
+    // Null areas are needed only for address spaces with accesses
+    // that aren't guarded.
+    WebCLAnalyser::MemoryAccessMap &pointerAccesses = analyser_.getPointerAceesses();
+    for (WebCLAnalyser::MemoryAccessMap::iterator i = pointerAccesses.begin();
+         i != pointerAccesses.end(); ++i) {
+        clang::Expr *access = i->first;
+        if (analyser_.isStaticallySafe(access) || isGuardedAccess(access))
+            continue;
+        transformer_.addClampedAddressSpace(WebCLTypes::getAddressSpace(access));
+    }
+
+    // Builtin wrappers may clamp any pointer arguments.
+    WebCLAnalyser::CallExprSet &builtinCalls = analyser_.getBuiltinCalls();
+    for (WebCLAnalyser::CallExprSet::iterator i = builtinCalls.begin();
+         i != builtinCalls.end(); ++i) {
+        const std::set<unsigned> addressSpaces = getArgumentAddressSpaces(*i);
+        for (std::set<unsigned>::const_iterator j = addressSpaces.begin();
+             j != addressSpaces.end(); ++j) {
+            transformer_.addClampedAddressSpace(*j);
+        }
+    }
+}
+
+std::set<unsigned> WebCLKernelHandler::getArgumentAddressSpaces(clang::CallExpr *call)
+{
+    std::set<unsigned> addressSpaces;
+    for (unsigned arg = 0; arg < call->getNumArgs(); ++arg) {
+        const clang::QualType type = call->getArg(arg)->getType();
+        if (type->isPointerType())
+            addressSpaces.insert(type->getPointeeType().getAddressSpace());
+    }
+    return addressSpaces;
+}
+
+void WebCLKernelHandler::findLimitAddressSpaces()
+{
+    // limits used directly by checked accesses and builtin wrappers
+    WebCLAnalyser::MemoryAccessMap &pointerAccesses = analyser_.getPointerAceesses();
+    for (WebCLAnalyser::MemoryAccessMap::iterator i = pointerAccesses.begin();
+         i != pointerAccesses.end(); ++i) {
+        clang::Expr *access = i->first;
+        const clang::FunctionDecl *function = analyser_.getEnclosingFunction(access);
+        if (!function || analyser_.isStaticallySafe(access))
+            continue;
+        limitSpaces_[function->getCanonicalDecl()].insert(WebCLTypes::getAddressSpace(access));
+    }
+
+    WebCLAnalyser::CallExprSet &builtinCalls = analyser_.getBuiltinCalls();
+    for (WebCLAnalyser::CallExprSet::iterator i = builtinCalls.begin();
+         i != builtinCalls.end(); ++i) {
+        const clang::FunctionDecl *function = analyser_.getEnclosingFunction(*i);
+        if (!function)
+            continue;
+        const std::set<unsigned> addressSpaces = getArgumentAddressSpaces(*i);
+        limitSpaces_[function->getCanonicalDecl()].insert(
+            addressSpaces.begin(), addressSpaces.end());
+    }
+
+    // callers need the limits of their callees
+    WebCLAnalyser::CallExprSet &calls = analyser_.getInternalCalls();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (WebCLAnalyser::CallExprSet::iterator i = calls.begin();
+             i != calls.end(); ++i) {
+            const clang::FunctionDecl *caller = analyser_.getEnclosingFunction(*i);
+            const clang::FunctionDecl *callee = (*i)->getDirectCallee();
+            if (!caller || !callee)
+                continue;
+            std::set<unsigned> &callerSpaces = limitSpaces_[caller->getCanonicalDecl()];
+            const std::set<unsigned> &calleeSpaces = limitSpaces_[callee->getCanonicalDecl()];
+            const size_t count = callerSpaces.size();
+            callerSpaces.insert(calleeSpaces.begin(), calleeSpaces.end());
+            changed = changed || (callerSpaces.size() != count);
+        }
+    }
+}
+
+const std::set<unsigned> &WebCLKernelHandler::getLimitAddressSpaces(
+    const clang::FunctionDecl *function)
+{
+    return limitSpaces_[function->getCanonicalDecl()];
+}
+
 AddressSpaceLimits& WebCLKernelHandler::getLimits(
     clang::Expr *access, clang::VarDecl *decl)
 {
     // IMPROVEMENT: remove if true after better static analysis for limit 
     //              resolving is added
     if (true || decl == NULL) {
-        switch(WebCLTypes::getAddressSpace(access)) {
-        case clang::LangAS::opencl_global:
-            return globalLimits_;
-        case clang::LangAS::opencl_constant:
-            return constantLimits_;
-        case clang::LangAS::opencl_local:
-            return localLimits_;
-        default:
-            return privateLimits_;
-        }
+        return getAllocations(access).getLimits(WebCLTypes::getAddressSpace(access));
     }
 
     // FUTURE: implement getting specific limits..
@@ -441,45 +579,323 @@ AddressSpaceLimits& WebCLKernelHandler::getLimits(
 }
 
 AddressSpaceLimits& WebCLKernelHandler::getDerefLimits(
-    clang::Expr *access)
+    clang::Expr *access, clang::Stmt *context)
 {
-    switch(access->getType().getTypePtr()->getPointeeType().getAddressSpace()) {
-    case clang::LangAS::opencl_global:
-        return globalLimits_;
-    case clang::LangAS::opencl_constant:
-        return constantLimits_;
-    case clang::LangAS::opencl_local:
-        return localLimits_;
-    default:
-        return privateLimits_;
+    return getAllocations(context).getLimits(
+        access->getType().getTypePtr()->getPointeeType().getAddressSpace());
+}
+
+KernelAllocations &WebCLKernelHandler::getAllocations(clang::Stmt *stmt)
+{
+    return getAllocations(analyser_.getEnclosingFunction(stmt));
+}
+
+KernelAllocations &WebCLKernelHandler::getAllocations(
+    const clang::FunctionDecl *function)
+{
+    assert(!allocations_.empty() && "Kernel groups haven't been created.");
+    if (function) {
+        std::map<const clang::FunctionDecl*, unsigned>::iterator i =
+            functionGroups_.find(function->getCanonicalDecl());
+        if (i != functionGroups_.end())
+            return allocations_[i->second];
     }
-    assert(false);
+    return allocations_.front();
 }
 
 bool WebCLKernelHandler::hasProgramAllocations()
 {
-    return !addressSpaceHandler_.getPrivateAddressSpace().empty() ||
-        hasGlobalLimits() || hasConstantLimits() || hasLocalLimits();
+    for (std::vector<KernelAllocations>::iterator i = allocations_.begin();
+         i != allocations_.end(); ++i) {
+        if (i->hasAllocations())
+            return true;
+    }
+    return false;
+}
+
+namespace {
+    typedef std::map<const clang::FunctionDecl*, const clang::FunctionDecl*> FunctionPartition;
+
+    /// \return Representative of the set that the function belongs
+    /// to. Adds the function as a new set if necessary.
+    const clang::FunctionDecl *findPartition(
+        FunctionPartition &partition, const clang::FunctionDecl *function)
+    {
+        if (partition.count(function) == 0)
+            partition[function] = function;
+        while (partition[function] != function) {
+            partition[function] = partition[partition[function]];
+            function = partition[function];
+        }
+        return function;
+    }
+}
+
+namespace {
+    /// \return Call of the named function, or NULL if the expression
+    /// isn't such a call.
+    clang::CallExpr *getCallOf(clang::Expr *expr, const std::string &name)
+    {
+        clang::CallExpr *call =
+            llvm::dyn_cast<clang::CallExpr>(expr->IgnoreParenImpCasts());
+        if (!call)
+            return NULL;
+        clang::FunctionDecl *callee = call->getDirectCallee();
+        if (!callee || (callee->getNameAsString() != name))
+            return NULL;
+        return call;
+    }
+
+    /// \return Whether values of the type can hold any size_t value.
+    bool holdsSize(clang::ASTContext &context, clang::QualType type)
+    {
+        return type->isIntegerType() &&
+            (context.getTypeSize(type) >= context.getTypeSize(context.getSizeType()));
+    }
+
+    /// \return Expression without parentheses and implicit casts, or
+    /// NULL if some of the casts may narrow a size_t value.
+    clang::Expr *ignoreSizeCasts(clang::ASTContext &context, clang::Expr *expr)
+    {
+        expr = expr->IgnoreParens();
+        while (clang::ImplicitCastExpr *cast = llvm::dyn_cast<clang::ImplicitCastExpr>(expr)) {
+            if (!holdsSize(context, cast->getType()))
+                return NULL;
+            expr = cast->getSubExpr()->IgnoreParens();
+        }
+        return expr;
+    }
+
+    /// \return Whether the only argument of the call has the given
+    /// constant value.
+    bool hasConstantArgument(
+        clang::ASTContext &context, clang::CallExpr *call, int64_t expected)
+    {
+        llvm::APSInt value;
+        return (call->getNumArgs() == 1) &&
+            call->getArg(0)->EvaluateAsInt(value, context) &&
+            (value.getSExtValue() == expected);
+    }
+
+    /// \return Whether the statement is a barrier that makes local
+    /// memory writes visible to the work group.
+    bool isLocalBarrier(clang::ASTContext &context, clang::Stmt *stmt)
+    {
+        // value of CLK_LOCAL_MEM_FENCE in kernel.cl
+        static const uint64_t localMemFence = 0x1;
+
+        clang::Expr *expr = llvm::dyn_cast<clang::Expr>(stmt);
+        clang::CallExpr *call = expr ? getCallOf(expr, "barrier") : NULL;
+        llvm::APSInt flags;
+        return call && (call->getNumArgs() == 1) &&
+            call->getArg(0)->EvaluateAsInt(flags, context) &&
+            (flags.getZExtValue() & localMemFence);
+    }
+
+    /// \return Whether the statement refers to a local variable or
+    /// to a pointer to local memory.
+    bool refersToLocalMemory(clang::ASTContext &context, clang::Stmt *stmt)
+    {
+        if (!stmt)
+            return false;
+
+        if (clang::DeclRefExpr *declRef = llvm::dyn_cast<clang::DeclRefExpr>(stmt)) {
+            clang::QualType type = context.getBaseElementType(declRef->getDecl()->getType());
+            while (true) {
+                if (type.getAddressSpace() == clang::LangAS::opencl_local)
+                    return true;
+                if (!type->isPointerType())
+                    break;
+                type = type->getPointeeType();
+            }
+        }
+
+        for (clang::Stmt::child_iterator i = stmt->child_begin();
+             i != stmt->child_end(); ++i) {
+            if (refersToLocalMemory(context, *i))
+                return true;
+        }
+        return false;
+    }
 }
 
-bool WebCLKernelHandler::hasConstantLimits()
+std::set<const clang::ParmVarDecl*> WebCLKernelHandler::getItemInitializedParameters(
+    clang::ASTContext &context, clang::FunctionDecl *kernel)
 {
-    return !constantLimits_.empty();
+    std::set<const clang::ParmVarDecl*> written;
+
+    clang::CompoundStmt *body =
+        llvm::dyn_cast_or_null<clang::CompoundStmt>(kernel->getBody());
+    if (!body)
+        return written;
+
+    // Only statements that don't read local memory may precede the
+    // barrier. Writes are visible to other work items only after
+    // the barrier.
+    for (clang::CompoundStmt::body_iterator i = body->body_begin();
+         i != body->body_end(); ++i) {
+        clang::Stmt *stmt = *i;
+
+        if (isLocalBarrier(context, stmt))
+            return written;
+
+        if (clang::ParmVarDecl *parm = getItemWrittenParameter(context, stmt)) {
+            written.insert(parm);
+            continue;
+        }
+
+        const bool sequential =
+            llvm::isa<clang::Expr>(stmt) ||
+            llvm::isa<clang::DeclStmt>(stmt) ||
+            llvm::isa<clang::NullStmt>(stmt);
+        if (!sequential || refersToLocalMemory(context, stmt))
+            break;
+    }
+
+    return std::set<const clang::ParmVarDecl*>();
 }
 
-bool WebCLKernelHandler::hasGlobalLimits()
+clang::ParmVarDecl *WebCLKernelHandler::getItemWrittenParameter(
+    clang::ASTContext &context, clang::Stmt *stmt)
 {
-    return !globalLimits_.empty();
+    clang::BinaryOperator *assignment = llvm::dyn_cast<clang::BinaryOperator>(stmt);
+    if (!assignment || (assignment->getOpcode() != clang::BO_Assign))
+        return NULL;
+
+    clang::ArraySubscriptExpr *subscript =
+        llvm::dyn_cast<clang::ArraySubscriptExpr>(assignment->getLHS()->IgnoreParens());
+    if (!subscript)
+        return NULL;
+
+    clang::DeclRefExpr *base =
+        llvm::dyn_cast<clang::DeclRefExpr>(subscript->getBase()->IgnoreParenImpCasts());
+    clang::ParmVarDecl *parm =
+        llvm::dyn_cast_or_null<clang::ParmVarDecl>(base ? base->getDecl() : NULL);
+    if (!parm || !parm->getType()->isPointerType())
+        return NULL;
+
+    // The parameter must still point to the start of the range.
+    if (analyser_.isModified(parm) || analyser_.hasAddressReferences(parm))
+        return NULL;
+
+    // Whole elements must be written. Padding of records and of
+    // three component vectors might be left untouched.
+    clang::QualType element = parm->getType()->getPointeeType();
+    if (element.getAddressSpace() != clang::LangAS::opencl_local)
+        return NULL;
+    const clang::VectorType *vector = element->getAs<clang::VectorType>();
+    if (!element->isScalarType() && !(vector && (vector->getNumElements() != 3)))
+        return NULL;
+
+    if (!isLocalIdIndex(context, subscript->getIdx()) ||
+        refersToLocalMemory(context, assignment->getRHS()))
+        return NULL;
+
+    return parm;
 }
 
-bool WebCLKernelHandler::hasLocalLimits()
+bool WebCLKernelHandler::isLocalIdIndex(clang::ASTContext &context, clang::Expr *expr)
 {
-    return !localLimits_.empty();
+    // A narrowed local id, e.g. in a uchar variable, wraps around and
+    // leaves elements of large work groups unwritten.
+    expr = ignoreSizeCasts(context, expr);
+    if (!expr)
+        return false;
+
+    if (clang::CallExpr *call = getCallOf(expr, "get_local_id"))
+        return hasConstantArgument(context, call, 0);
+
+    clang::DeclRefExpr *declRef = llvm::dyn_cast<clang::DeclRefExpr>(expr);
+    clang::VarDecl *var =
+        llvm::dyn_cast_or_null<clang::VarDecl>(declRef ? declRef->getDecl() : NULL);
+    if (!var || !var->isLocalVarDecl() || !var->getInit() ||
+        !holdsSize(context, var->getType()) ||
+        analyser_.isModified(var) || analyser_.hasAddressReferences(var))
+        return false;
+
+    clang::Expr *init = ignoreSizeCasts(context, var->getInit());
+    clang::CallExpr *call = init ? getCallOf(init, "get_local_id") : NULL;
+    return call && hasConstantArgument(context, call, 0);
 }
 
-bool WebCLKernelHandler::hasPrivateLimits()
+void WebCLKernelHandler::createAllocationGroups()
 {
-    return !privateLimits_.empty();
+    // Functions calling each other must use the same allocation
+    // structure type, so kernels that share helper functions are put
+    // into the same group.
+    //
+    // FUTURE: Helper functions shared by several kernels could be
+    //         cloned so that each kernel gets its own group.
+    FunctionPartition partition;
+
+    WebCLAnalyser::KernelList &kernels = analyser_.getKernelFunctions();
+    for (WebCLAnalyser::KernelList::iterator i = kernels.begin();
+         i != kernels.end(); ++i) {
+        findPartition(partition, i->decl->getCanonicalDecl());
+    }
+
+    WebCLAnalyser::FunctionDeclSet &helpers = analyser_.getHelperFunctions();
+    for (WebCLAnalyser::FunctionDeclSet::iterator i = helpers.begin();
+         i != helpers.end(); ++i) {
+        findPartition(partition, (*i)->getCanonicalDecl());
+    }
+
+    WebCLAnalyser::CallExprSet &calls = analyser_.getInternalCalls();
+    for (WebCLAnalyser::CallExprSet::iterator i = calls.begin();
+         i != calls.end(); ++i) {
+        const clang::FunctionDecl *caller = analyser_.getEnclosingFunction(*i);
+        const clang::FunctionDecl *callee = (*i)->getDirectCallee();
+        if (!caller || !callee)
+            continue;
+        const clang::FunctionDecl *callerSet =
+            findPartition(partition, caller->getCanonicalDecl());
+        const clang::FunctionDecl *calleeSet =
+            findPartition(partition, callee->getCanonicalDecl());
+        partition[callerSet] = calleeSet;
+    }
+
+    // Number groups in kernel order.
+    std::map<const clang::FunctionDecl*, unsigned> groups;
+    std::vector<clang::FunctionDecl*> firstKernels;
+    for (WebCLAnalyser::KernelList::iterator i = kernels.begin();
+         i != kernels.end(); ++i) {
+        const clang::FunctionDecl *set =
+            findPartition(partition, i->decl->getCanonicalDecl());
+        if (groups.count(set) == 0) {
+            groups[set] = firstKernels.size();
+            firstKernels.push_back(i->decl);
+        }
+    }
+
+    // Types of a program consisting of a single group are named as
+    // before, otherwise each group is named after its first kernel.
+    allocations_.clear();
+    if (firstKernels.size() <= 1) {
+        allocations_.push_back(KernelAllocations(""));
+    } else {
+        for (std::vector<clang::FunctionDecl*>::iterator i = firstKernels.begin();
+             i != firstKernels.end(); ++i) {
+            allocations_.push_back(KernelAllocations((*i)->getName()));
+        }
+    }
+
+    for (WebCLAnalyser::KernelList::iterator i = kernels.begin();
+         i != kernels.end(); ++i) {
+        const unsigned group =
+            groups[findPartition(partition, i->decl->getCanonicalDecl())];
+        allocations_[group].insertKernel(i->decl);
+    }
+
+    functionGroups_.clear();
+    for (FunctionPartition::iterator i = partition.begin();
+         i != partition.end(); ++i) {
+        std::map<const clang::FunctionDecl*, unsigned>::iterator group =
+            groups.find(findPartition(partition, i->first));
+        // Functions that aren't connected to any kernel use the
+        // first group.
+        functionGroups_[i->first] =
+            (group != groups.end()) ? group->second : 0;
+    }
 }
 
 void WebCLKernelHandler::createDeclarationLimits(clang::VarDecl *decl)
@@ -500,6 +916,91 @@ WebCLMemoryAccessHandler::~WebCLMemoryAccessHandler()
 {
 }
 
+namespace {
+    /// Orders expressions and declarations by their location in the
+    /// source.
+    struct SourceOrder {
+        SourceOrder(clang::SourceManager &sourceManager)
+            : sourceManager_(sourceManager)
+        {
+        }
+
+        bool operator()(const clang::Expr *lhs, const clang::Expr *rhs) const
+        {
+            return sourceManager_.isBeforeInTranslationUnit(
+                lhs->getLocStart(), rhs->getLocStart());
+        }
+
+        bool operator()(const clang::Decl *lhs, const clang::Decl *rhs) const
+        {
+            return sourceManager_.isBeforeInTranslationUnit(
+                lhs->getLocation(), rhs->getLocation());
+        }
+
+        clang::SourceManager &sourceManager_;
+    };
+
+    /// \return Whether the statement calls barrier directly or
+    /// through the functions that it calls.
+    bool callsBarrier(clang::Stmt *stmt, std::set<const clang::FunctionDecl*> &visited)
+    {
+        if (!stmt)
+            return false;
+
+        if (clang::CallExpr *call = llvm::dyn_cast<clang::CallExpr>(stmt)) {
+            if (const clang::FunctionDecl *callee = call->getDirectCallee()) {
+                if (callee->getNameAsString() == "barrier")
+                    return true;
+                const clang::FunctionDecl *definition = NULL;
+                if (callee->hasBody(definition) && visited.insert(definition).second &&
+                    callsBarrier(definition->getBody(), visited))
+                    return true;
+            }
+        }
+
+        for (clang::Stmt::child_iterator i = stmt->child_begin();
+             i != stmt->child_end(); ++i) {
+            if (callsBarrier(*i, visited))
+                return true;
+        }
+        return false;
+    }
+
+    typedef std::vector< std::pair<clang::Expr*, clang::VarDecl*> > AccessList;
+
+    /// Orders accesses so that accesses nested in other accesses come
+    /// first. The rewriter needs the innermost replacement before the
+    /// replacements containing it, e.g. array[0] before
+    /// array2[array[0]].
+    struct NestingOrder {
+        NestingOrder(clang::SourceManager &sourceManager)
+            : sourceManager_(sourceManager)
+        {
+        }
+
+        bool operator()(const AccessList::value_type &lhs, const AccessList::value_type &rhs) const
+        {
+            const clang::SourceRange left = lhs.first->getSourceRange();
+            const clang::SourceRange right = rhs.first->getSourceRange();
+            if (left.getEnd() != right.getEnd())
+                return sourceManager_.isBeforeInTranslationUnit(left.getEnd(), right.getEnd());
+            // *pointer[i] ends where pointer[i] ends
+            return sourceManager_.isBeforeInTranslationUnit(right.getBegin(), left.getBegin());
+        }
+
+        clang::SourceManager &sourceManager_;
+    };
+
+    /// \return Accesses in the order in which they can be replaced.
+    AccessList getReplacementOrder(
+        clang::SourceManager &sourceManager, WebCLAnalyser::MemoryAccessMap &accesses)
+    {
+        AccessList ordered(accesses.begin(), accesses.end());
+        std::stable_sort(ordered.begin(), ordered.end(), NestingOrder(sourceManager));
+        return ordered;
+    }
+}
+
 void WebCLMemoryAccessHandler::run(clang::ASTContext &context)
 {
     // go through memory accesses from analyser
@@ -513,6 +1014,9 @@ void WebCLMemoryAccessHandler::run(clang::ASTContext &context)
     maxAccess[clang::LangAS::opencl_local] = 8;
     maxAccess[0] = 8;
 
+    std::map<const clang::FunctionDecl*, IdenticalAccessMap> identicalAccesses;
+    std::map< const clang::FunctionDecl*, std::vector<clang::Expr*> > guardedAccesses;
+
     for (WebCLAnalyser::MemoryAccessMap::iterator i = pointerAccesses.begin();
         i != pointerAccesses.end(); ++i) {
 
@@ -528,11 +1032,57 @@ void WebCLMemoryAccessHandler::run(clang::ASTContext &context)
             unsigned oldVal = maxAccess[addressSpace];
             maxAccess[addressSpace] = oldVal > accessWidth ? oldVal : accessWidth;
 
-            // add memory check generation to transformer
-            transformer_.addMemoryAccessCheck(
-                access,
-                1, // a single value
-                kernelHandler_.getLimits(access, decl));
+            if (analyser_.isStaticallySafe(access))
+                continue;
+
+            const clang::FunctionDecl *function = analyser_.getEnclosingFunction(access);
+            if (kernelHandler_.isGuardedAccess(access)) {
+                if (function)
+                    guardedAccesses[function].push_back(access);
+                continue;
+            }
+
+            if (getIndexedKernelParameter(access, decl))
+                continue;
+
+            // identical accesses are grouped function by function
+            const std::string key = getAccessKey(access);
+            if (function && !key.empty())
+                identicalAccesses[function][key].push_back(access);
+    }
+
+    // Decide which accesses store or reuse checked addresses before
+    // replacing any accesses, because the replacements are made
+    // innermost first rather than in source order.
+    for (std::map<const clang::FunctionDecl*, IdenticalAccessMap>::iterator i = identicalAccesses.begin();
+         i != identicalAccesses.end(); ++i) {
+        findDominatedAccesses(context, i->first, i->second, storedPointers_, reusedPointers_);
+    }
+
+    // Guarded accesses keep the checked address in a variable of
+    // their own. Number them in source order too.
+    for (std::map< const clang::FunctionDecl*, std::vector<clang::Expr*> >::iterator i = guardedAccesses.begin();
+         i != guardedAccesses.end(); ++i) {
+        std::vector<clang::Expr*> &accesses = i->second;
+        std::sort(accesses.begin(), accesses.end(), SourceOrder(context.getSourceManager()));
+        for (unsigned index = 0; index < accesses.size(); ++index) {
+            guardedPointers_[accesses[index]] = transformer_.addGuardedPointer(
+                i->first, accesses[index], index);
+        }
+    }
+
+    AccessList ordered = getReplacementOrder(context.getSourceManager(), pointerAccesses);
+    for (AccessList::iterator i = ordered.begin(); i != ordered.end(); ++i) {
+
+            clang::Expr *access = i->first;
+            clang::VarDecl *decl = i->second;
+
+            // accesses to variables that stay in registers can't
+            // be checked against private limits and don't need to be
+            if (analyser_.isStaticallySafe(access))
+                continue;
+
+            addAccessCheck(access, decl, kernelHandler_.getLimits(access, decl));
     }
 
     // add defines for address space specific minimum memory requirements.
@@ -544,6 +1094,737 @@ void WebCLMemoryAccessHandler::run(clang::ASTContext &context)
     }
 }
 
+void WebCLMemoryAccessHandler::addAccessCheck(
+    clang::Expr *access, clang::VarDecl *decl, AddressSpaceLimits &limits)
+{
+    CheckedPointerMap::iterator guarded = guardedPointers_.find(access);
+    if (guarded != guardedPointers_.end()) {
+        clang::Expr *store = NULL;
+        if (analyser_.getAccessUse(access, &store) == WebCLAnalyser::ACCESS_USE_STORE_STATEMENT) {
+            // Work items that return early would never reach a later
+            // barrier that the other work items wait at.
+            const clang::FunctionDecl *function = analyser_.getEnclosingFunction(access);
+            std::set<const clang::FunctionDecl*> visited;
+            const bool canReturn = function->getResultType()->isVoidType() &&
+                !callsBarrier(function->getBody(), visited);
+            transformer_.addGuardedStoreCheck(
+                access, store, 1, limits, guarded->second, canReturn);
+        } else {
+            transformer_.addGuardedLoadCheck(access, 1, limits, guarded->second);
+        }
+        return;
+    }
+
+    // add memory check generation to transformer
+    if (clang::ParmVarDecl *parm = getIndexedKernelParameter(access, decl)) {
+        transformer_.addIndexedAccessCheck(
+            llvm::cast<clang::ArraySubscriptExpr>(access), parm);
+        return;
+    }
+
+    CheckedPointerMap::iterator reused = reusedPointers_.find(access);
+    if (reused != reusedPointers_.end()) {
+        transformer_.addReusedMemoryAccessCheck(access, reused->second);
+        return;
+    }
+
+    CheckedPointerMap::iterator stored = storedPointers_.find(access);
+    if (stored != storedPointers_.end()) {
+        transformer_.addStoredMemoryAccessCheck(access, 1, limits, stored->second);
+        return;
+    }
+
+    transformer_.addMemoryAccessCheck(
+        access,
+        1, // a single value
+        limits);
+}
+
+std::string WebCLMemoryAccessHandler::getAccessKey(clang::Expr *access)
+{
+    if (access->getLocStart().isMacroID())
+        return "";
+
+    clang::Expr *base = NULL;
+    clang::Expr *index = NULL;
+    if (clang::ArraySubscriptExpr *subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(access)) {
+        base = subscript->getBase();
+        index = subscript->getIdx();
+    } else if (clang::MemberExpr *member = llvm::dyn_cast<clang::MemberExpr>(access)) {
+        base = member->getBase();
+    } else if (clang::UnaryOperator *unary = llvm::dyn_cast<clang::UnaryOperator>(access)) {
+        base = unary->getSubExpr();
+    }
+    if (!base)
+        return "";
+
+    // *p, p->field and p[0] all check the same address
+    std::stringstream key;
+    key << base->getType().getCanonicalType().getAsString() << ":";
+    if (!getExpressionKey(key, base))
+        return "";
+    key << "[";
+    if (!index)
+        key << "0";
+    else if (!getExpressionKey(key, index))
+        return "";
+    key << "]";
+    return key.str();
+}
+
+bool WebCLMemoryAccessHandler::getExpressionKey(std::ostream &key, clang::Expr *expr)
+{
+    if (clang::ParenExpr *paren = llvm::dyn_cast<clang::ParenExpr>(expr))
+        return getExpressionKey(key, paren->getSubExpr());
+
+    if (clang::CastExpr *cast = llvm::dyn_cast<clang::CastExpr>(expr)) {
+        key << "(" << cast->getType().getCanonicalType().getAsString() << ")";
+        return getExpressionKey(key, cast->getSubExpr());
+    }
+
+    if (clang::IntegerLiteral *literal = llvm::dyn_cast<clang::IntegerLiteral>(expr)) {
+        key << literal->getValue().toString(10, false);
+        return true;
+    }
+
+    if (clang::DeclRefExpr *declRef = llvm::dyn_cast<clang::DeclRefExpr>(expr)) {
+        if (clang::EnumConstantDecl *constant =
+            llvm::dyn_cast<clang::EnumConstantDecl>(declRef->getDecl())) {
+            key << constant->getInitVal().toString(10);
+            return true;
+        }
+
+        clang::VarDecl *var = llvm::dyn_cast<clang::VarDecl>(declRef->getDecl());
+        if (!var || !(var->isLocalVarDecl() || llvm::isa<clang::ParmVarDecl>(var)))
+            return false;
+        if (var->getType().isVolatileQualified() ||
+            analyser_.isModified(var) || analyser_.hasAddressReferences(var))
+            return false;
+        key << "$" << var;
+        return true;
+    }
+
+    if (clang::BinaryOperator *binary = llvm::dyn_cast<clang::BinaryOperator>(expr)) {
+        if (binary->isAssignmentOp() || binary->isCommaOp())
+            return false;
+        key << "(";
+        if (!getExpressionKey(key, binary->getLHS()))
+            return false;
+        key << binary->getOpcodeStr().str();
+        if (!getExpressionKey(key, binary->getRHS()))
+            return false;
+        key << ")";
+        return true;
+    }
+
+    if (clang::UnaryOperator *unary = llvm::dyn_cast<clang::UnaryOperator>(expr)) {
+        switch (unary->getOpcode()) {
+        case clang::UO_Plus:
+        case clang::UO_Minus:
+        case clang::UO_Not:
+        case clang::UO_LNot:
+            break;
+        default:
+            return false;
+        }
+        key << clang::UnaryOperator::getOpcodeStr(unary->getOpcode()).str() << "(";
+        if (!getExpressionKey(key, unary->getSubExpr()))
+            return false;
+        key << ")";
+        return true;
+    }
+
+    return false;
+}
+
+namespace {
+    /// \return Whether the statement contains labels or jumps to
+    /// labels.
+    bool hasLabels(clang::Stmt *stmt)
+    {
+        if (!stmt)
+            return false;
+        if (llvm::isa<clang::LabelStmt>(stmt) ||
+            llvm::isa<clang::GotoStmt>(stmt) ||
+            llvm::isa<clang::IndirectGotoStmt>(stmt))
+            return true;
+        for (clang::Stmt::child_iterator i = stmt->child_begin();
+             i != stmt->child_end(); ++i) {
+            if (hasLabels(*i))
+                return true;
+        }
+        return false;
+    }
+
+    /// \return Whether the statement is the ancestor of the other
+    /// statement or the statement itself.
+    bool containsStatement(
+        clang::ParentMap &parents, clang::Stmt *ancestor, clang::Stmt *stmt)
+    {
+        if (!ancestor)
+            return false;
+        while (stmt && (stmt != ancestor))
+            stmt = parents.getParent(stmt);
+        return stmt != NULL;
+    }
+
+    /// \return Statement of a block that evaluates the access
+    /// unconditionally, or NULL if there is no such statement. The
+    /// block is returned through the second parameter.
+    ///
+    /// Blocks within switch statements are ignored, because case
+    /// labels may skip the access.
+    clang::Stmt *getEvaluatingStatement(
+        clang::ParentMap &parents, clang::Expr *access, clang::CompoundStmt *&block)
+    {
+        clang::Stmt *child = access;
+        clang::Stmt *parent = parents.getParent(child);
+        for (; parent; child = parent, parent = parents.getParent(child)) {
+            if (clang::CompoundStmt *compound = llvm::dyn_cast<clang::CompoundStmt>(parent)) {
+                block = compound;
+                break;
+            }
+
+            if (clang::ConditionalOperator *conditional =
+                llvm::dyn_cast<clang::ConditionalOperator>(parent)) {
+                if (child != conditional->getCond())
+                    return NULL;
+            } else if (llvm::isa<clang::AbstractConditionalOperator>(parent)) {
+                return NULL;
+            } else if (clang::BinaryOperator *binary =
+                       llvm::dyn_cast<clang::BinaryOperator>(parent)) {
+                if (binary->isLogicalOp() && (child != binary->getLHS()))
+                    return NULL;
+            } else if (llvm::isa<clang::UnaryExprOrTypeTraitExpr>(parent) ||
+                       llvm::isa<clang::StmtExpr>(parent)) {
+                return NULL;
+            } else if (clang::IfStmt *ifStmt = llvm::dyn_cast<clang::IfStmt>(parent)) {
+                if (child != ifStmt->getCond())
+                    return NULL;
+            } else if (clang::WhileStmt *whileStmt = llvm::dyn_cast<clang::WhileStmt>(parent)) {
+                if (child != whileStmt->getCond())
+                    return NULL;
+            } else if (!llvm::isa<clang::Expr>(parent) &&
+                       !llvm::isa<clang::DeclStmt>(parent) &&
+                       !llvm::isa<clang::ReturnStmt>(parent)) {
+                return NULL;
+            }
+        }
+        if (!parent)
+            return NULL;
+
+        for (clang::Stmt *ancestor = parents.getParent(block); ancestor;
+             ancestor = parents.getParent(ancestor)) {
+            if (llvm::isa<clang::SwitchStmt>(ancestor))
+                return NULL;
+        }
+        return child;
+    }
+
+    /// \return Whether the first access is always evaluated before
+    /// the second access.
+    bool dominates(clang::ParentMap &parents, clang::Expr *first, clang::Expr *second)
+    {
+        clang::CompoundStmt *block = NULL;
+        clang::Stmt *stmt = getEvaluatingStatement(parents, first, block);
+        if (!stmt)
+            return false;
+
+        // statements controlled by a condition containing the access
+        if (clang::IfStmt *ifStmt = llvm::dyn_cast<clang::IfStmt>(stmt)) {
+            if (containsStatement(parents, ifStmt->getThen(), second) ||
+                containsStatement(parents, ifStmt->getElse(), second))
+                return true;
+        } else if (clang::WhileStmt *whileStmt = llvm::dyn_cast<clang::WhileStmt>(stmt)) {
+            if (containsStatement(parents, whileStmt->getBody(), second))
+                return true;
+        }
+
+        // statements following the access in the same block or in
+        // enclosing blocks that are entered only sequentially
+        while (block) {
+            bool following = false;
+            for (clang::CompoundStmt::body_iterator i = block->body_begin();
+                 i != block->body_end(); ++i) {
+                if (following && containsStatement(parents, *i, second))
+                    return true;
+                if (*i == stmt)
+                    following = true;
+            }
+            stmt = block;
+            block = llvm::dyn_cast_or_null<clang::CompoundStmt>(parents.getParent(block));
+        }
+        return false;
+    }
+}
+
+void WebCLMemoryAccessHandler::findDominatedAccesses(
+    clang::ASTContext &context, const clang::FunctionDecl *function,
+    IdenticalAccessMap &accesses,
+    CheckedPointerMap &storedPointers, CheckedPointerMap &reusedPointers)
+{
+    clang::Stmt *body = function->getBody();
+    if (hasLabels(body))
+        return;
+    clang::ParentMap parents(body);
+
+    // Group accesses under the earliest identical access that
+    // dominates them.
+    std::vector<clang::Expr*> roots;
+    std::map< clang::Expr*, std::vector<clang::Expr*> > dominated;
+    for (IdenticalAccessMap::iterator i = accesses.begin(); i != accesses.end(); ++i) {
+        std::vector<clang::Expr*> &identical = i->second;
+        std::sort(identical.begin(), identical.end(),
+                  SourceOrder(context.getSourceManager()));
+
+        std::vector<clang::Expr*> groupRoots;
+        for (std::vector<clang::Expr*>::iterator access = identical.begin();
+             access != identical.end(); ++access) {
+            clang::Expr *root = NULL;
+            for (std::vector<clang::Expr*>::iterator candidate = groupRoots.begin();
+                 candidate != groupRoots.end(); ++candidate) {
+                if (dominates(parents, *candidate, *access)) {
+                    root = *candidate;
+                    break;
+                }
+            }
+            if (root) {
+                dominated[root].push_back(*access);
+            } else {
+                groupRoots.push_back(*access);
+            }
+        }
+        roots.insert(roots.end(), groupRoots.begin(), groupRoots.end());
+    }
+
+    // Number stored addresses in source order to keep output stable.
+    std::sort(roots.begin(), roots.end(), SourceOrder(context.getSourceManager()));
+    unsigned checkedPointers = 0;
+    for (std::vector<clang::Expr*>::iterator i = roots.begin(); i != roots.end(); ++i) {
+        clang::Expr *root = *i;
+        if (dominated.count(root) == 0)
+            continue;
+
+        const std::string pointer =
+            transformer_.addCheckedPointer(function, root, checkedPointers++);
+        storedPointers[root] = pointer;
+
+        std::vector<clang::Expr*> &users = dominated[root];
+        for (std::vector<clang::Expr*>::iterator user = users.begin();
+             user != users.end(); ++user) {
+            reusedPointers[*user] = pointer;
+        }
+    }
+}
+
+clang::ParmVarDecl *WebCLMemoryAccessHandler::getIndexedKernelParameter(
+    clang::Expr *access, clang::VarDecl *decl)
+{
+    if (transformer_.getOptions().checkMode != WebCLOptions::CHECK_MODE_OFFSET)
+        return NULL;
+
+    if (!llvm::isa<clang::ArraySubscriptExpr>(access))
+        return NULL;
+
+    clang::ParmVarDecl *parm = llvm::dyn_cast_or_null<clang::ParmVarDecl>(decl);
+    if (!parm || !parm->getType()->isPointerType())
+        return NULL;
+
+    const clang::FunctionDecl *function =
+        llvm::dyn_cast<clang::FunctionDecl>(parm->getParentFunctionOrMethod());
+    if (!function || !function->hasAttr<clang::OpenCLKernelAttr>())
+        return NULL;
+
+    switch (parm->getType()->getPointeeType().getAddressSpace()) {
+    case clang::LangAS::opencl_global:
+    case clang::LangAS::opencl_constant:
+    case clang::LangAS::opencl_local:
+        break;
+    default:
+        return NULL;
+    }
+
+    if (analyser_.isModified(parm) || analyser_.hasAddressReferences(parm))
+        return NULL;
+
+    return parm;
+}
+
+WebCLHelperCloneHandler::WebCLHelperCloneHandler(
+    clang::CompilerInstance &instance,
+    WebCLAnalyser &analyser, WebCLTransformer &transformer,
+    WebCLKernelHandler &kernelHandler,
+    WebCLMemoryAccessHandler &memoryAccessHandler)
+    : WebCLPass(instance, analyser, transformer)
+    , kernelHandler_(kernelHandler)
+    , memoryAccessHandler_(memoryAccessHandler)
+{
+}
+
+WebCLHelperCloneHandler::~WebCLHelperCloneHandler()
+{
+}
+
+void WebCLHelperCloneHandler::run(clang::ASTContext &context)
+{
+    if (!transformer_.getOptions().helperClones)
+        return;
+
+    // Kernel memory object parameters point to their own memory
+    // objects. Calls of kernels are redirected directly.
+    WebCLAnalyser::KernelList &kernels = analyser_.getKernelFunctions();
+    for (WebCLAnalyser::KernelList::iterator i = kernels.begin();
+         i != kernels.end(); ++i) {
+        clang::FunctionDecl *kernel = i->decl;
+
+        ParameterProvenances parameters(kernel->getNumParams());
+        for (unsigned index = 0; index < kernel->getNumParams(); ++index) {
+            clang::ParmVarDecl *parm = kernel->getParamDecl(index);
+            if (!parm->getType()->isPointerType())
+                continue;
+            switch (parm->getType()->getPointeeType().getAddressSpace()) {
+            case clang::LangAS::opencl_global:
+            case clang::LangAS::opencl_constant:
+            case clang::LangAS::opencl_local:
+                parameters[index].insert(parm);
+                break;
+            default:
+                break;
+            }
+        }
+
+        CloneCallMap calls;
+        findClones(context, kernel, parameters, calls);
+        for (CloneCallMap::iterator call = calls.begin(); call != calls.end(); ++call) {
+            const clang::FunctionDecl *callee = NULL;
+            call->first->getDirectCallee()->hasBody(callee);
+            transformer_.changeFunctionCallee(
+                call->first, transformer_.getFunctionCloneName(callee, call->second));
+        }
+    }
+
+    // create copies in source order so that checks of the copies
+    // are numbered the same way on every run
+    std::vector<const clang::FunctionDecl*> functions;
+    for (std::map<const clang::FunctionDecl*, CloneList>::iterator i = clones_.begin();
+         i != clones_.end(); ++i) {
+        functions.push_back(i->first);
+    }
+    std::sort(functions.begin(), functions.end(), SourceOrder(context.getSourceManager()));
+    for (std::vector<const clang::FunctionDecl*>::iterator i = functions.begin();
+         i != functions.end(); ++i) {
+        CloneList &clones = clones_[*i];
+        for (unsigned index = 0; index < clones.size(); ++index)
+            createClone(*i, index, clones[index]);
+    }
+}
+
+void WebCLHelperCloneHandler::findClones(
+    clang::ASTContext &context, const clang::FunctionDecl *caller,
+    const ParameterProvenances &parameters, CloneCallMap &calls)
+{
+    // number copies in source order
+    std::vector<clang::CallExpr*> callerCalls;
+    WebCLAnalyser::CallExprSet &internalCalls = analyser_.getInternalCalls();
+    for (WebCLAnalyser::CallExprSet::iterator i = internalCalls.begin();
+         i != internalCalls.end(); ++i) {
+        if (analyser_.getEnclosingFunction(*i) == caller)
+            callerCalls.push_back(*i);
+    }
+    std::sort(callerCalls.begin(), callerCalls.end(), SourceOrder(context.getSourceManager()));
+
+    const unsigned maxClones = transformer_.getOptions().helperClones;
+    for (std::vector<clang::CallExpr*>::iterator i = callerCalls.begin();
+         i != callerCalls.end(); ++i) {
+        clang::CallExpr *call = *i;
+
+        const clang::FunctionDecl *callee = call->getDirectCallee();
+        if (!callee || !callee->hasBody(callee) || !canClone(callee))
+            continue;
+
+        ParameterProvenances arguments(callee->getNumParams());
+        bool isKnown = false;
+        for (unsigned index = 0; (index < call->getNumArgs()) && (index < callee->getNumParams()); ++index) {
+            if (!callee->getParamDecl(index)->getType()->isPointerType())
+                continue;
+            arguments[index] = getProvenance(call->getArg(index), caller, parameters);
+            isKnown = isKnown || !arguments[index].empty();
+        }
+        // the original function is as good
+        if (!isKnown)
+            continue;
+
+        CloneList &clones = clones_[callee];
+        unsigned index = 0;
+        while ((index < clones.size()) && (clones[index].parameters != arguments))
+            ++index;
+        if (index == clones.size()) {
+            if (clones.size() >= maxClones)
+                continue;
+            clones.push_back(Clone());
+            clones.back().parameters = arguments;
+            // Recursion isn't allowed, so calls of the callee don't
+            // add copies of the callee.
+            findClones(context, callee, arguments, clones_[callee][index].calls);
+        }
+        calls[call] = index;
+    }
+}
+
+void WebCLHelperCloneHandler::createClone(
+    const clang::FunctionDecl *function, unsigned index, Clone &clone)
+{
+    transformer_.beginFunctionClone(function, index);
+
+    for (CloneCallMap::iterator i = clone.calls.begin(); i != clone.calls.end(); ++i) {
+        const clang::FunctionDecl *callee = NULL;
+        i->first->getDirectCallee()->hasBody(callee);
+        transformer_.changeFunctionCallee(
+            i->first, transformer_.getFunctionCloneName(callee, i->second));
+    }
+
+    // All accesses are replaced again so that accesses containing
+    // narrowed accesses contain the narrowed checks.
+    AccessList ordered = getReplacementOrder(
+        instance_.getSourceManager(), analyser_.getPointerAceesses());
+    for (AccessList::iterator i = ordered.begin(); i != ordered.end(); ++i) {
+        clang::Expr *access = i->first;
+        clang::VarDecl *decl = i->second;
+        if ((analyser_.getEnclosingFunction(access) != function) ||
+            analyser_.isStaticallySafe(access))
+            continue;
+
+        clang::Expr *pointer = NULL;
+        if (clang::ArraySubscriptExpr *subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(access)) {
+            pointer = subscript->getBase();
+        } else if (clang::MemberExpr *member = llvm::dyn_cast<clang::MemberExpr>(access)) {
+            pointer = member->getBase();
+        } else if (clang::ExtVectorElementExpr *element = llvm::dyn_cast<clang::ExtVectorElementExpr>(access)) {
+            pointer = element->getBase();
+        } else if (clang::UnaryOperator *deref = llvm::dyn_cast<clang::UnaryOperator>(access)) {
+            pointer = deref->getSubExpr();
+        }
+
+        Provenance provenance;
+        if (pointer)
+            provenance = getProvenance(pointer, function, clone.parameters);
+        memoryAccessHandler_.addAccessCheck(
+            access, decl, getNarrowedLimits(access, decl, provenance));
+    }
+
+    transformer_.endFunctionClone();
+}
+
+bool WebCLHelperCloneHandler::canClone(const clang::FunctionDecl *function)
+{
+    // Callers may not see a copy that is inserted after a separate
+    // prototype.
+    return !function->hasAttr<clang::OpenCLKernelAttr>() &&
+        !function->getPreviousDecl() &&
+        !function->getLocation().isMacroID() &&
+        !function->getBody()->getLocEnd().isMacroID();
+}
+
+WebCLHelperCloneHandler::Provenance WebCLHelperCloneHandler::getProvenance(
+    clang::Expr *expr, const clang::FunctionDecl *function,
+    const ParameterProvenances &parameters)
+{
+    expr = expr->IgnoreParens();
+
+    if (clang::CastExpr *cast = llvm::dyn_cast<clang::CastExpr>(expr))
+        return getProvenance(cast->getSubExpr(), function, parameters);
+
+    if (clang::BinaryOperator *binary = llvm::dyn_cast<clang::BinaryOperator>(expr)) {
+        if (binary->getOpcode() == clang::BO_Comma)
+            return getProvenance(binary->getRHS(), function, parameters);
+        if (!binary->getType()->isPointerType())
+            return Provenance();
+        if ((binary->getOpcode() != clang::BO_Add) && (binary->getOpcode() != clang::BO_Sub))
+            return Provenance();
+        if (binary->getLHS()->getType()->isPointerType())
+            return getProvenance(binary->getLHS(), function, parameters);
+        return getProvenance(binary->getRHS(), function, parameters);
+    }
+
+    if (clang::ConditionalOperator *conditional = llvm::dyn_cast<clang::ConditionalOperator>(expr)) {
+        Provenance provenance = getProvenance(conditional->getTrueExpr(), function, parameters);
+        const Provenance other = getProvenance(conditional->getFalseExpr(), function, parameters);
+        if (provenance.empty() || other.empty())
+            return Provenance();
+        provenance.insert(other.begin(), other.end());
+        return provenance;
+    }
+
+    // &pointer[index], &*pointer and &pointer->field stay within the
+    // pointed memory object
+    if (clang::UnaryOperator *unary = llvm::dyn_cast<clang::UnaryOperator>(expr)) {
+        if (unary->getOpcode() != clang::UO_AddrOf)
+            return Provenance();
+        clang::Expr *object = unary->getSubExpr()->IgnoreParens();
+        if (clang::ArraySubscriptExpr *subscript = llvm::dyn_cast<clang::ArraySubscriptExpr>(object))
+            return getProvenance(subscript->getBase(), function, parameters);
+        if (clang::MemberExpr *member = llvm::dyn_cast<clang::MemberExpr>(object)) {
+            if (member->isArrow())
+                return getProvenance(member->getBase(), function, parameters);
+            return Provenance();
+        }
+        if (clang::UnaryOperator *deref = llvm::dyn_cast<clang::UnaryOperator>(object)) {
+            if (deref->getOpcode() == clang::UO_Deref)
+                return getProvenance(deref->getSubExpr(), function, parameters);
+        }
+        return Provenance();
+    }
+
+    // Parameters must not be modified or have their address taken,
+    // so that they still hold the passed pointers.
+    if (clang::DeclRefExpr *ref = llvm::dyn_cast<clang::DeclRefExpr>(expr)) {
+        clang::ParmVarDecl *parm = llvm::dyn_cast<clang::ParmVarDecl>(ref->getDecl());
+        if (!parm || (parm->getParentFunctionOrMethod() != function) ||
+            (parm->getFunctionScopeIndex() >= parameters.size()))
+            return Provenance();
+        if (analyser_.isModified(parm) || analyser_.hasAddressReferences(parm))
+            return Provenance();
+        return parameters[parm->getFunctionScopeIndex()];
+    }
+
+    return Provenance();
+}
+
+AddressSpaceLimits &WebCLHelperCloneHandler::getNarrowedLimits(
+    clang::Expr *access, clang::VarDecl *decl, const Provenance &provenance)
+{
+    AddressSpaceLimits &limits = kernelHandler_.getLimits(access, decl);
+    if (provenance.empty())
+        return limits;
+
+    // keep the order of the default limits
+    AddressSpaceLimits narrowed(limits.getAddressSpace());
+    AddressSpaceLimits::LimitList &dynamicLimits = limits.getDynamicLimits();
+    for (AddressSpaceLimits::LimitList::iterator i = dynamicLimits.begin();
+         i != dynamicLimits.end(); ++i) {
+        if (provenance.count(*i))
+            narrowed.insert(*i);
+    }
+    if (narrowed.empty() || (narrowed.count() == limits.count()))
+        return limits;
+
+    limits_.push_back(narrowed);
+    return limits_.back();
+}
+
+WebCLReportHandler::WebCLReportHandler(
+    clang::CompilerInstance &instance,
+    WebCLAnalyser &analyser, WebCLTransformer &transformer,
+    WebCLAddressSpaceHandler &addressSpaceHandler,
+    WebCLKernelHandler &kernelHandler)
+    : WebCLPass(instance, analyser, transformer)
+    , addressSpaceHandler_(addressSpaceHandler)
+    , kernelHandler_(kernelHandler)
+{
+}
+
+WebCLReportHandler::~WebCLReportHandler()
+{
+}
+
+void WebCLReportHandler::run(clang::ASTContext &context)
+{
+    const WebCLTransformer::AccessCheckMap &checks = transformer_.getAccessChecks();
+    const WebCLTransformer::WrappedCallMap &wrappedCalls = transformer_.getWrappedCalls();
+    WebCLAnalyser::MemoryAccessMap &accesses = analyser_.getPointerAceesses();
+    WebCLAnalyser::CallExprSet &builtinCalls = analyser_.getBuiltinCalls();
+
+    // local and constant variables are relocated to program wide
+    // structures
+    const unsigned localBytes =
+        transformer_.getVariablesSize(addressSpaceHandler_.getLocalAddressSpace());
+    const unsigned constantBytes =
+        transformer_.getVariablesSize(addressSpaceHandler_.getConstantAddressSpace());
+
+    WebCLAnalyser::KernelList &kernels = analyser_.getKernelFunctions();
+    for (WebCLAnalyser::KernelList::iterator i = kernels.begin(); i != kernels.end(); ++i) {
+        clang::FunctionDecl *kernel = i->decl;
+        KernelReport &report = i->report;
+        const FunctionSet functions = getReachableFunctions(kernel);
+
+        for (WebCLAnalyser::MemoryAccessMap::iterator j = accesses.begin();
+             j != accesses.end(); ++j) {
+            const clang::FunctionDecl *function = analyser_.getEnclosingFunction(j->first);
+            if (!function || !functions.count(function->getCanonicalDecl()))
+                continue;
+            WebCLTransformer::AccessCheckMap::const_iterator check = checks.find(j->first);
+            if (check == checks.end())
+                continue;
+
+            switch (check->second.addressSpace) {
+            case clang::LangAS::opencl_global:
+                ++report.globalChecks;
+                break;
+            case clang::LangAS::opencl_constant:
+                ++report.constantChecks;
+                break;
+            case clang::LangAS::opencl_local:
+                ++report.localChecks;
+                break;
+            default:
+                ++report.privateChecks;
+                break;
+            }
+            report.checkLimits += check->second.limitCount;
+            report.maxCheckLimits = std::max(report.maxCheckLimits, check->second.limitCount);
+        }
+
+        std::set<std::string> wrappers;
+        for (WebCLAnalyser::CallExprSet::iterator j = builtinCalls.begin();
+             j != builtinCalls.end(); ++j) {
+            const clang::FunctionDecl *function = analyser_.getEnclosingFunction(*j);
+            if (!function || !functions.count(function->getCanonicalDecl()))
+                continue;
+            WebCLTransformer::WrappedCallMap::const_iterator wrapped = wrappedCalls.find(*j);
+            if (wrapped != wrappedCalls.end())
+                wrappers.insert(wrapped->second);
+        }
+        report.wrappers = wrappers.size();
+
+        KernelAllocations &allocs = kernelHandler_.getAllocations(kernel);
+        AddressSpaceLimits &localLimits = allocs.getLocalLimits();
+        report.privateBytes = transformer_.getVariablesSize(allocs.getPrivates());
+        if (localLimits.hasStaticallyAllocatedLimits())
+            report.localBytes = localBytes;
+        if (allocs.getConstantLimits().hasStaticallyAllocatedLimits())
+            report.constantBytes = constantBytes;
+        report.allocationsBytes = transformer_.getProgramAllocationsSize(allocs);
+        if (!localLimits.empty()) {
+            report.localZeroingBytes = report.localBytes +
+                transformer_.getNullAreaSize(clang::LangAS::opencl_local);
+        }
+        report.addedParameters = transformer_.getAddedParameterCount(kernel);
+    }
+}
+
+WebCLReportHandler::FunctionSet WebCLReportHandler::getReachableFunctions(
+    const clang::FunctionDecl *kernel)
+{
+    FunctionSet functions;
+    functions.insert(kernel->getCanonicalDecl());
+
+    WebCLAnalyser::CallExprSet &calls = analyser_.getInternalCalls();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (WebCLAnalyser::CallExprSet::iterator i = calls.begin();
+             i != calls.end(); ++i) {
+            const clang::FunctionDecl *caller = analyser_.getEnclosingFunction(*i);
+            const clang::FunctionDecl *callee = (*i)->getDirectCallee();
+            if (!caller || !callee || !functions.count(caller->getCanonicalDecl()))
+                continue;
+            changed = functions.insert(callee->getCanonicalDecl()).second || changed;
+        }
+    }
+
+    return functions;
+}
+
 WebCLFunctionCallHandler::WebCLFunctionCallHandler(
     clang::CompilerInstance &instance,
     WebCLAnalyser &analyser,
@@ -556,16 +1837,12 @@ WebCLFunctionCallHandler::WebCLFunctionCallHandler(
 }
 
 void WebCLFunctionCallHandler::handle(clang::CallExpr *callExpr,
-    bool builtin,
-    unsigned& fnCounter)
+    bool builtin)
 {
-    std::string origName = callExpr->getDirectCallee()->getNameInfo().getAsString();
-    std::string wrapperName = "_wcl_" + origName + "_" + stringify(fnCounter);
-
-    bool success = transformer_.wrapFunctionCall(wrapperName, callExpr, kernelHandler_);
+    bool success = transformer_.wrapFunctionCall(callExpr, kernelHandler_);
 
     if (success) {
-        ++fnCounter;
+        // calls of identical wrappers share a wrapper function
     } else if (builtin && analyser_.hasUnsafeParameters(callExpr)) {
         // error on unknown builtin functions involving pointer arguments
         error((callExpr)->getLocStart(), "Builtin argument check is required.");
@@ -579,18 +1856,16 @@ void WebCLFunctionCallHandler::run(clang::ASTContext &context)
     WebCLAnalyser::CallExprSet builtinCalls = analyser_.getBuiltinCalls();
     WebCLAnalyser::CallExprSet internalCalls = analyser_.getInternalCalls();
 
-    unsigned fnCounter = 0;
-
     for (WebCLAnalyser::CallExprSet::const_iterator builtinCallIt = builtinCalls.begin();
         builtinCallIt != builtinCalls.end();
         ++builtinCallIt) {
-        handle(*builtinCallIt, true, fnCounter);
+        handle(*builtinCallIt, true);
     }
 
     for (WebCLAnalyser::CallExprSet::const_iterator internalCallIt = internalCalls.begin();
         internalCallIt != internalCalls.end();
         ++internalCallIt) {
-        handle(*internalCallIt, false, fnCounter);
+        handle(*internalCallIt, false);
     }
 }
 
@@ -714,8 +1989,8 @@ WebCLImageSamplerSafetyHandler::WebCLImageSamplerSafetyHandler(
     : WebCLPass(instance, analyser, transformer),
       kernelHandler_(kernelHandler)
 {
-    checkedTypes_["image2d_t"] = new TypeAccessCheckerImage2d;
-    checkedTypes_["sampler_t"] = new TypeAccessCheckerSampler;
+    checkedTypes_[WebCLTypes::IMAGE2D_TYPE] = new TypeAccessCheckerImage2d;
+    checkedTypes_[WebCLTypes::SAMPLER_TYPE] = new TypeAccessCheckerSampler;
 }
 
 namespace {
@@ -744,10 +2019,12 @@ void WebCLImageSamplerSafetyHandler::run(clang::ASTContext &context)
         clang::CallExpr *callExpr = *callExprIt;
         for (unsigned argIdx = 0; argIdx < callExpr->getNumArgs(); ++argIdx) {
             clang::Expr *expr = callExpr->getArg(argIdx);
-            clang::QualType type = WebCLTypes::reduceType(instance_, expr->getType());
-            TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(type.getAsString());
+            const WebCLTypes::TypeClass &typeClass =
+                WebCLTypes::classifyType(instance_, expr->getType());
+            const clang::QualType type = typeClass.reduced;
+            TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(typeClass.opaque);
             if (checkedTypeIt != checkedTypes_.end()) {
-                const std::string& checkedTypeName = checkedTypeIt->first;
+                const std::string& checkedTypeName = typeClass.name;
                 const TypeAccessChecker* checkedTypeChecker = checkedTypeIt->second;
 
                 enum {
@@ -830,8 +2107,8 @@ void WebCLImageSamplerSafetyHandler::run(clang::ASTContext &context)
          useIt != uses.end();
          ++useIt) {
         clang::DeclRefExpr *expr = *useIt;
-        clang::QualType type = WebCLTypes::reduceType(instance_, expr->getType());
-        TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(type.getAsString());
+        TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(
+            WebCLTypes::classifyType(instance_, expr->getType()).opaque);
         if (checkedTypeIt != checkedTypes_.end()) {
             std::string errorMessage;
             if (!checkedTypeIt->second->validateDeclRefExpr(*expr, usedAsArgument.count(expr), usedAsInitializer.count(expr),
@@ -846,12 +2123,13 @@ void WebCLImageSamplerSafetyHandler::run(clang::ASTContext &context)
          ++varDeclIt) {
         clang::VarDecl *varDecl = *varDeclIt;
         if (!clang::isa<clang::ParmVarDecl>(varDecl)) {
-            clang::QualType type = WebCLTypes::reduceType(instance_, varDecl->getType());
-            TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(type.getAsString());
+            const WebCLTypes::TypeClass &typeClass =
+                WebCLTypes::classifyType(instance_, varDecl->getType());
+            TypeAccessCheckerMap::const_iterator checkedTypeIt = checkedTypes_.find(typeClass.opaque);
             if (checkedTypeIt != checkedTypes_.end() &&
                 !checkedTypeIt->second->isValidDeclaration(*varDecl)) {
                 if (!checkedTypeIt->second->rewriteDeclaration(transformer_, kernelHandler_, *varDecl)) {
-                    error(varDecl->getLocStart(), "%0 is not initialized properly") << checkedTypeIt->first;
+                    error(varDecl->getLocStart(), "%0 is not initialized properly") << typeClass.name;
                 }
             }
         }
@@ -26,18 +26,28 @@
 
 #include "WebCLHelper.hpp"
 #include "WebCLReporter.hpp"
+#include "WebCLTypes.hpp"
 
+#include <iosfwd>
+#include <list>
 #include <map>
 #include <set>
+#include <vector>
+
+#include "llvm/ADT/SetVector.h"
 
 namespace clang {
     class ASTContext;
     class Expr;
+    class FunctionDecl;
+    class Stmt;
     class VarDecl;
+    class ParmVarDecl;
     class CallExpr;
 }
 
 class WebCLAnalyser;
+class WebCLKernelHandler;
 class WebCLTransformer;
 
 /// Abstract base class for different passes of validation
@@ -100,14 +110,23 @@ public:
 
     WebCLHelperFunctionHandler(
         clang::CompilerInstance &instance,
-        WebCLAnalyser &analyser, WebCLTransformer &transformer);
+        WebCLAnalyser &analyser, WebCLTransformer &transformer,
+        WebCLKernelHandler &kernelHandler);
     virtual ~WebCLHelperFunctionHandler();
     
     /// - Adds allocation structure parameter to function signatures.
     /// - Adds allocation structure argument to corresponding calls.
     ///
+    /// Functions of kernel groups that don't need any allocations
+    /// are left untouched.
+    ///
     /// \see WebCLPass
     virtual void run(clang::ASTContext &context);
+
+private:
+
+    /// Provides allocation structures of kernel groups.
+    WebCLKernelHandler &kernelHandler_;
 };
 
 /// Creates address space structures.
@@ -127,7 +146,8 @@ public:
     /// - Handles all the local address space variables.
     /// - Collects private address space variables if they are
     ///   accessed through a pointer or if their address is taken with
-    ///   the &-operator.
+    ///   the &-operator and may flow into accesses that need to be
+    ///   checked.
     /// - Injects address space types and constant address space initialization
     ///   to prologue.
     ///
@@ -166,7 +186,9 @@ public:
   
 private:
 
-    typedef std::set<clang::VarDecl*> AddressSpaceSet;
+    /// Variables in the order they were collected, so that the
+    /// layout of address space structures is stable.
+    typedef llvm::SetVector<clang::VarDecl*> AddressSpaceSet;
     std::map< AddressSpaceSet*, AddressSpaceInfo > organizedAddressSpaces_;
 
     /// Sorts address space variables.
@@ -199,6 +221,8 @@ public:
         WebCLAddressSpaceHandler &addressSpaceHandler);
     virtual ~WebCLKernelHandler();
 
+    /// - Groups kernels that share helper functions. Each group
+    ///   gets an allocation structure of its own.
     /// - Analyzes kernel parameters to see what kind of memory area
     ///   limits are needed. Creates limit types. Adds size parameter
     ///   for each memory object parameter.
@@ -214,36 +238,81 @@ public:
     AddressSpaceLimits& getLimits(clang::Expr *access, clang::VarDecl *decl);
 
     /// \return Memory area limits for the address space of given
-    /// expression when it is being dereference
-    AddressSpaceLimits& getDerefLimits(clang::Expr *access);
+    /// expression when it is being dereference. The limits are
+    /// chosen according to the function that contains the context
+    /// statement.
+    AddressSpaceLimits& getDerefLimits(clang::Expr *access, clang::Stmt *context);
+
+    /// \return Allocation structure of the kernel group that the
+    /// function containing the given memory access or call belongs
+    /// to.
+    KernelAllocations &getAllocations(clang::Stmt *stmt);
+    /// \return Allocation structure of the kernel group that the
+    /// given function belongs to.
+    KernelAllocations &getAllocations(const clang::FunctionDecl *function);
 
     /// \return Whether any memory areas need to be checked.
     bool hasProgramAllocations();
 
-    /// \return Whether constant memory areas need to be checked.
-    bool hasConstantLimits();
-    /// \return Whether global memory areas need to be checked.
-    bool hasGlobalLimits();
-    /// \return Whether local memory areas need to be checked.
-    bool hasLocalLimits();
-    /// \return Whether private memory areas need to be checked.
-    bool hasPrivateLimits();
+    /// \return Whether an out of bounds access is skipped instead
+    /// of being redirected to the null area. Only plain loads and
+    /// store statements can be guarded and only if the violation
+    /// mode isn't clamp.
+    bool isGuardedAccess(clang::Expr *access);
+
+    /// \return Address spaces whose limits the function or any
+    /// function called by it uses for checking memory accesses.
+    const std::set<unsigned> &getLimitAddressSpaces(const clang::FunctionDecl *function);
+
+    /// \return Address spaces pointed to by the arguments of the
+    /// call.
+    std::set<unsigned> getArgumentAddressSpaces(clang::CallExpr *call);
 
 private:
 
+    /// Finds out which limits are needed by each function.
+    void findLimitAddressSpaces();
+
+    /// Tells transformer which address spaces need a null area
+    /// because some accesses are clamped to it.
+    void findClampedAddressSpaces();
+
+    /// Partitions kernels and helper functions into groups so that
+    /// functions calling each other end up in the same group. Helper
+    /// functions that aren't connected to any kernel are put into
+    /// the first group.
+    void createAllocationGroups();
+
     /// Provides information about relocated variables.
     WebCLAddressSpaceHandler &addressSpaceHandler_;
-    /// Modifier helper function signatures and calls.
-    WebCLHelperFunctionHandler helperFunctionHandler_;
-
-    /// Contains dynamic limits for global address space.
-    AddressSpaceLimits globalLimits_;
-    /// Contains static and dynamic limits for constant address space.
-    AddressSpaceLimits constantLimits_;
-    /// Constains static and dynamic limits for local address space.
-    AddressSpaceLimits localLimits_;
-    /// Constains statuc limits for private address space.
-    AddressSpaceLimits privateLimits_;
+
+    /// Allocation structures of kernel groups in kernel order.
+    std::vector<KernelAllocations> allocations_;
+    /// Maps canonical function declarations to kernel groups.
+    std::map<const clang::FunctionDecl*, unsigned> functionGroups_;
+    /// Maps canonical function declarations to address spaces of
+    /// limits they use.
+    std::map< const clang::FunctionDecl*, std::set<unsigned> > limitSpaces_;
+
+    /// \return Local memory parameters of the kernel that each work
+    /// item writes at its own local id before any local memory is
+    /// read. Recognizes kernels that start with statements like:
+    ///
+    /// tile[get_local_id(0)] = input[get_global_id(0)];
+    /// barrier(CLK_LOCAL_MEM_FENCE);
+    ///
+    /// The ranges of these parameters are completely initialized if
+    /// they hold one element per work item.
+    std::set<const clang::ParmVarDecl*> getItemInitializedParameters(
+        clang::ASTContext &context, clang::FunctionDecl *kernel);
+    /// \return Local memory parameter that is written at the local
+    /// id of each work item by the statement, or NULL.
+    clang::ParmVarDecl *getItemWrittenParameter(
+        clang::ASTContext &context, clang::Stmt *stmt);
+    /// \return Whether the expression is get_local_id(0) or an
+    /// unmodified variable initialized with it. Neither the index nor
+    /// the variable may be narrower than size_t.
+    bool isLocalIdIndex(clang::ASTContext &context, clang::Expr *expr);
 
     /// Maps variable to a possibly more restricted set of limits.
     std::map< clang::VarDecl*, AddressSpaceLimits* > declarationLimits_;
@@ -265,15 +334,191 @@ public:
     virtual ~WebCLMemoryAccessHandler();
 
     /// - Generates checks for pointer accesses.
+    /// - Reuses checked addresses for identical accesses that are
+    ///   always preceded by an earlier access.
     /// - Generates information about largest memory accesses.
     ///
     /// \see WebCLPass
     virtual void run(clang::ASTContext &context);
 
+    /// Replaces the access with a checked access. Accesses that
+    /// reuse an earlier checked address or index a kernel memory
+    /// object parameter don't need the limits.
+    void addAccessCheck(
+        clang::Expr *access, clang::VarDecl *decl, AddressSpaceLimits &limits);
+
 private:
 
+    /// Identical accesses of a function, mapped by access key.
+    typedef std::map< std::string, std::vector<clang::Expr*> > IdenticalAccessMap;
+
+    /// \return Key that is equal for accesses that always point to
+    /// the same address within a function. Empty key is returned if
+    /// the address might change between accesses.
+    ///
+    /// The base and index of the access may only refer to local
+    /// variables that are never modified and whose address is never
+    /// taken.
+    std::string getAccessKey(clang::Expr *access);
+    /// Appends key of a side effect free expression to the stream.
+    ///
+    /// \return Whether the expression can be part of an access key.
+    bool getExpressionKey(std::ostream &key, clang::Expr *expr);
+
+    /// Maps accesses to variables holding their checked addresses.
+    typedef std::map<clang::Expr*, std::string> CheckedPointerMap;
+
+    /// Finds identical accesses of a function that are dominated by
+    /// an earlier identical access. The earlier access stores its
+    /// checked address and the dominated accesses reuse the stored
+    /// address.
+    ///
+    /// Dominance is structural: an access dominates the statements
+    /// following it in the same block and the bodies of if and while
+    /// statements whose condition contains it. Functions with labels
+    /// aren't optimized.
+    void findDominatedAccesses(
+        clang::ASTContext &context, const clang::FunctionDecl *function,
+        IdenticalAccessMap &accesses,
+        CheckedPointerMap &storedPointers, CheckedPointerMap &reusedPointers);
+
+    /// \return Kernel memory object parameter that is indexed
+    /// directly by the given access, if offset checks have been
+    /// selected and the access can be checked against the size
+    /// parameter of the memory object. NULL otherwise.
+    ///
+    /// The parameter must not be modified or have its address taken,
+    /// so that it still points to the start of the memory object.
+    clang::ParmVarDecl *getIndexedKernelParameter(
+        clang::Expr *access, clang::VarDecl *decl);
+
     /// Contains information about address space limits.
     WebCLKernelHandler &kernelHandler_;
+
+    /// Accesses that store their checked addresses for later
+    /// accesses.
+    CheckedPointerMap storedPointers_;
+    /// Accesses that reuse checked addresses of earlier accesses.
+    CheckedPointerMap reusedPointers_;
+    /// Guarded accesses and the variables holding their checked
+    /// addresses.
+    CheckedPointerMap guardedPointers_;
+};
+
+/// Copies helper functions for the memory objects that their callers
+/// pass to them.
+class WebCLHelperCloneHandler : public WebCLPass
+{
+public:
+
+    WebCLHelperCloneHandler(
+        clang::CompilerInstance &instance,
+        WebCLAnalyser &analyser, WebCLTransformer &transformer,
+        WebCLKernelHandler &kernelHandler,
+        WebCLMemoryAccessHandler &memoryAccessHandler);
+    virtual ~WebCLHelperCloneHandler();
+
+    /// - Finds out, starting from kernels, which kernel memory object
+    ///   parameters the pointer arguments of each call may point to.
+    /// - Creates a copy of the called helper function for each
+    ///   distinct combination of pointed memory objects, up to the
+    ///   number of copies selected with the options. Calls that
+    ///   would need more copies keep calling the original function.
+    /// - Checks accesses of each copy only against the memory
+    ///   objects that its pointer parameters may point to.
+    ///
+    /// \see WebCLPass
+    virtual void run(clang::ASTContext &context);
+
+private:
+
+    /// Kernel memory object parameters that a pointer may point
+    /// to. Empty if the pointer may point anywhere.
+    typedef std::set<clang::ParmVarDecl*> Provenance;
+    /// Provenances of function parameters by parameter index.
+    typedef std::vector<Provenance> ParameterProvenances;
+    /// Maps calls to the copies of the called functions.
+    typedef std::map<clang::CallExpr*, unsigned> CloneCallMap;
+
+    /// Copy of a helper function.
+    struct Clone {
+        /// Provenances of the parameters of the copy.
+        ParameterProvenances parameters;
+        /// Calls of the copy that are redirected to other copies.
+        CloneCallMap calls;
+    };
+    typedef std::vector<Clone> CloneList;
+
+    /// Finds copies needed by the calls of the given function and
+    /// the copies needed by the calls of those copies.
+    void findClones(
+        clang::ASTContext &context, const clang::FunctionDecl *caller,
+        const ParameterProvenances &parameters, CloneCallMap &calls);
+
+    /// Replaces the accesses of a copy and redirects its calls.
+    void createClone(
+        const clang::FunctionDecl *function, unsigned index, Clone &clone);
+
+    /// \return Whether a copy of the function can be inserted right
+    /// after the function.
+    bool canClone(const clang::FunctionDecl *function);
+
+    /// \return Memory objects that the pointer expression of the
+    /// function may point to.
+    Provenance getProvenance(
+        clang::Expr *expr, const clang::FunctionDecl *function,
+        const ParameterProvenances &parameters);
+
+    /// \return Limits of the memory objects in the provenance, or
+    /// default limits of the access if the provenance is unknown.
+    AddressSpaceLimits &getNarrowedLimits(
+        clang::Expr *access, clang::VarDecl *decl,
+        const Provenance &provenance);
+
+    /// Contains information about address space limits.
+    WebCLKernelHandler &kernelHandler_;
+    /// Generates the checks of the copies.
+    WebCLMemoryAccessHandler &memoryAccessHandler_;
+
+    /// Copies of each helper function.
+    std::map<const clang::FunctionDecl*, CloneList> clones_;
+    /// Narrowed limits referred by the checks of the copies.
+    std::list<AddressSpaceLimits> limits_;
+};
+
+/// Collects static facts about the instrumentation of each kernel.
+class WebCLReportHandler : public WebCLPass
+{
+public:
+
+    WebCLReportHandler(
+        clang::CompilerInstance &instance,
+        WebCLAnalyser &analyser, WebCLTransformer &transformer,
+        WebCLAddressSpaceHandler &addressSpaceHandler,
+        WebCLKernelHandler &kernelHandler);
+    virtual ~WebCLReportHandler();
+
+    /// - Counts memory access checks and builtin wrappers of the
+    ///   functions that each kernel may call.
+    /// - Computes sizes of relocated variables, the allocation
+    ///   structure and zeroed local memory of each kernel.
+    /// - Stores the facts to the kernel information of the analyser.
+    ///
+    /// \see WebCLPass
+    virtual void run(clang::ASTContext &context);
+
+private:
+
+    typedef std::set<const clang::FunctionDecl*> FunctionSet;
+
+    /// \return Canonical declarations of the kernel and of the
+    /// helper functions that it may call.
+    FunctionSet getReachableFunctions(const clang::FunctionDecl *kernel);
+
+    /// Provides relocated local and constant variables.
+    WebCLAddressSpaceHandler &addressSpaceHandler_;
+    /// Provides allocation structures of kernel groups.
+    WebCLKernelHandler &kernelHandler_;
 };
 
 /// Generates memory access checks.
@@ -297,7 +542,7 @@ private:
     /// Contains information about address space limits.
     WebCLKernelHandler &kernelHandler_;
 
-    void handle(clang::CallExpr *callExpr, bool builtin, unsigned& fnCounter);
+    void handle(clang::CallExpr *callExpr, bool builtin);
 };
 
 /// Checks that image2d_t and sampler_t can only originate from function arguments
@@ -322,7 +567,7 @@ private:
     class TypeAccessCheckerImage2d;
     class TypeAccessCheckerSampler;
 
-    typedef std::map<std::string, TypeAccessChecker*> TypeAccessCheckerMap;
+    typedef std::map<WebCLTypes::OpaqueKind, TypeAccessChecker*> TypeAccessCheckerMap;
 
     WebCLKernelHandler &kernelHandler_;
     TypeAccessCheckerMap checkedTypes_;
@@ -29,6 +29,198 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <cctype>
+#include <utility>
+#include <vector>
+
+namespace {
+    /// Gaps of at most this many left out lines are filled with
+    /// empty lines instead of a line directive.
+    const unsigned maxEmptyLines = 8;
+
+    /// \return Whether whitespace between the characters can be left
+    /// out without joining two tokens.
+    bool isSpaceRedundant(char previous, char next)
+    {
+        static const char separators[] = "(){}[];,";
+        for (const char *c = separators; *c; ++c) {
+            if ((previous == *c) || (next == *c))
+                return true;
+        }
+        return false;
+    }
+
+    /// \return Whether characters of different kinds are next to
+    /// each other.
+    bool isTokenBoundary(char previous, char current)
+    {
+        const bool isWord = std::isalnum(static_cast<unsigned char>(current)) || (current == '_');
+        const bool wasWord = std::isalnum(static_cast<unsigned char>(previous)) || (previous == '_');
+        const bool isSpace = std::isspace(static_cast<unsigned char>(current));
+        const bool wasSpace = std::isspace(static_cast<unsigned char>(previous));
+        return (previous == '\n') || (!isWord && !isSpace) ||
+            (isWord != wasWord) || (isSpace != wasSpace);
+    }
+
+    /// Builds compact lines and keeps them on their original line
+    /// numbers.
+    class Compactor
+    {
+    public:
+
+        Compactor(std::string &output, WebCLSourceMap &sourceMap)
+            : output_(output), sourceMap_(sourceMap), outputLine_(1)
+            , text_(), textLine_(0), space_(false), origins_(), next_(0)
+        {
+        }
+
+        /// Adds a character of a token that starts or continues on
+        /// the given line. The character is at the given offset of
+        /// the source.
+        void add(char c, unsigned line, unsigned offset)
+        {
+            const bool isJoined = space_ || (offset != next_);
+            if (text_.empty()) {
+                textLine_ = line;
+            } else if (space_ &&
+                       ((text_[0] == '#') || !isSpaceRedundant(text_[text_.size() - 1], c))) {
+                text_ += ' ';
+            }
+            if (text_.empty() || isJoined)
+                origins_.push_back(Origin(text_.size(), offset));
+            space_ = false;
+            text_ += c;
+            next_ = offset + 1;
+        }
+
+        /// Marks whitespace, including comments, before the next
+        /// character.
+        void space()
+        {
+            space_ = true;
+        }
+
+        /// Ends the current line at the given offset of the
+        /// source. Empty lines are left out.
+        void end(unsigned offset)
+        {
+            space_ = false;
+            if (text_.empty())
+                return;
+
+            const unsigned gap = textLine_ - outputLine_;
+            if (gap > maxEmptyLines) {
+                llvm::raw_string_ostream out(output_);
+                out << "#line " << textLine_ << "\n";
+            } else {
+                output_.append(gap, '\n');
+            }
+            for (Origins::const_iterator i = origins_.begin(); i != origins_.end(); ++i)
+                sourceMap_.add(i->second, output_.size() + i->first);
+            sourceMap_.add(offset, output_.size() + text_.size());
+            origins_.clear();
+
+            output_ += text_;
+            output_ += '\n';
+            outputLine_ = textLine_ + 1;
+            text_.clear();
+        }
+
+    private:
+
+        /// Compact source written so far.
+        std::string &output_;
+        /// Where the compact source comes from.
+        WebCLSourceMap &sourceMap_;
+        /// Line number that the compiler gives to the next line of
+        /// output.
+        unsigned outputLine_;
+        /// Current line without comments and redundant whitespace.
+        std::string text_;
+        /// Original line number of the current line.
+        unsigned textLine_;
+        /// Whether whitespace precedes the next character.
+        bool space_;
+        /// Offsets of the current line and of the source where
+        /// characters that weren't next to each other in the source
+        /// were joined.
+        typedef std::pair<unsigned, unsigned> Origin;
+        typedef std::vector<Origin> Origins;
+        Origins origins_;
+        /// Source offset that follows the previous character.
+        unsigned next_;
+    };
+
+    /// Writes the source without comments, indentation, blank lines
+    /// and whitespace between tokens that stay separate anyway. Lines
+    /// continued with backslashes are joined. Line directives are
+    /// written where many lines are left out.
+    void compactSource(const std::string &source, std::string &output,
+                       WebCLSourceMap &sourceMap)
+    {
+        Compactor compactor(output, sourceMap);
+        unsigned line = 1;
+        const size_t size = source.size();
+
+        size_t i = 0;
+        while (i < size) {
+            const char c = source[i];
+            const char next = ((i + 1) < size) ? source[i + 1] : '\0';
+
+            if ((c == '\\') && (next == '\n')) {
+                i += 2;
+                ++line;
+            } else if (c == '\n') {
+                compactor.end(i);
+                ++i;
+                ++line;
+            } else if ((c == '/') && (next == '/')) {
+                // the newline ends the line as usual
+                while ((i < size) && (source[i] != '\n')) {
+                    if ((source[i] == '\\') && ((i + 1) < size) && (source[i + 1] == '\n')) {
+                        ++i;
+                        ++line;
+                    }
+                    ++i;
+                }
+                compactor.space();
+            } else if ((c == '/') && (next == '*')) {
+                i += 2;
+                while ((i < size) && !((source[i] == '*') && ((i + 1) < size) && (source[i + 1] == '/'))) {
+                    if (source[i] == '\n')
+                        ++line;
+                    ++i;
+                }
+                i += 2;
+                compactor.space();
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                compactor.space();
+                ++i;
+            } else if ((c == '"') || (c == '\'')) {
+                // literals are copied as such
+                compactor.add(c, line, i);
+                ++i;
+                while ((i < size) && (source[i] != c) && (source[i] != '\n')) {
+                    if ((source[i] == '\\') && ((i + 1) < size)) {
+                        compactor.add(source[i], line, i);
+                        ++i;
+                    }
+                    compactor.add(source[i], line, i);
+                    ++i;
+                }
+                if (i < size && (source[i] == c)) {
+                    compactor.add(c, line, i);
+                    ++i;
+                }
+            } else {
+                compactor.add(c, line, i);
+                ++i;
+            }
+        }
+        compactor.end(size);
+    }
+}
+
 WebCLPrinter::WebCLPrinter(clang::Rewriter &rewriter)
     : rewriter_(rewriter)
 {
@@ -59,6 +251,29 @@ bool WebCLPrinter::print(llvm::raw_ostream &out, const std::string &comment)
     return true;
 }
 
+void WebCLPrinter::recordSourceMap(WebCLSourceMap &sourceMap) const
+{
+    clang::SourceManager &manager = rewriter_.getSourceMgr();
+    clang::FileID file = manager.getMainFileID();
+    clang::SourceLocation start = manager.getLocForStartOfFile(file);
+    const llvm::StringRef source = manager.getBufferData(file);
+
+    sourceMap.clear();
+    char previous = '\n';
+    for (unsigned i = 0; i <= source.size(); ++i) {
+        const char current = (i < source.size()) ? source[i] : '\n';
+        if ((i == source.size()) || isTokenBoundary(previous, current)) {
+            // Rewritten size of the text before the offset, including
+            // text inserted at the offset.
+            const int size = rewriter_.getRangeSize(
+                clang::CharSourceRange::getCharRange(start, start.getLocWithOffset(i)));
+            if (size >= 0)
+                sourceMap.add(i, size);
+        }
+        previous = current;
+    }
+}
+
 WebCLValidatorPrinter::WebCLValidatorPrinter(
     clang::CompilerInstance &instance, clang::Rewriter &rewriter,
     WebCLAnalyser &analyser, WebCLTransformer &transformer)
@@ -77,10 +292,24 @@ void WebCLValidatorPrinter::run(clang::ASTContext &context)
     if (!transformer_.rewrite())
         return;
 
-    output_.clear();
-    llvm::raw_string_ostream os(output_);
-    if (!print(os, "// WebCL Validator: validation stage.\n")) {
+    const bool compact = transformer_.getOptions().compactOutput;
+
+    std::string output;
+    llvm::raw_string_ostream os(output);
+    if (!print(os, compact ? "" : "// WebCL Validator: validation stage.\n")) {
         fatal("Can't print validator output.");
         return;
     }
+
+    os.flush();
+    recordSourceMap(sourceMap_);
+
+    output_.clear();
+    if (compact) {
+        WebCLSourceMap compactMap;
+        compactSource(output, output_, compactMap);
+        sourceMap_.append(compactMap);
+    } else {
+        output_.swap(output);
+    }
 }
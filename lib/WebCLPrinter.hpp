@@ -26,6 +26,7 @@
 
 #include "WebCLReporter.hpp"
 #include "WebCLPass.hpp"
+#include "WebCLSourceMap.hpp"
 
 #include <string>
 
@@ -49,6 +50,11 @@ public:
     /// beginning of output to describe validation stage for example.
     bool print(llvm::raw_ostream &out, const std::string &comment);
 
+    /// \brief Records where the printed text comes from in the
+    /// original source file. The map is sampled at each token
+    /// boundary, because transformations start and end at tokens.
+    void recordSourceMap(WebCLSourceMap &sourceMap) const;
+
 protected:
 
     /// Stores transformations.
@@ -76,10 +82,15 @@ public:
     /// Get transformed source
     const std::string &getOutput() const { return output_; }
 
+    /// Get origins of the transformed source
+    const WebCLSourceMap &getSourceMap() const { return sourceMap_; }
+
 private:
 
     /// Stores transformed source after a succesful run
     std::string output_;
+    /// Ditto for origins of the transformed source
+    WebCLSourceMap sourceMap_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLPRINTER
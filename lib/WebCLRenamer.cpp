@@ -25,8 +25,10 @@
 
 #include "clang/AST/Decl.h"
 
+#include "llvm/Support/raw_ostream.h"
+
 WebCLRenamer::WebCLRenamer(const std::string &prefix, const std::string &separator)
-    : serials_(), counts_(), prefix_(prefix), separator_(separator)
+    : names_(), counts_(), prefix_(prefix), separator_(separator)
 {
 }
 
@@ -34,17 +36,25 @@ WebCLRenamer::~WebCLRenamer()
 {
 }
 
-void WebCLRenamer::rename(
-    std::ostream &out, const clang::NamedDecl *decl)
+const std::string &WebCLRenamer::rename(const clang::NamedDecl *decl)
 {
-    generate(out, decl, decl->getName().str());
+    Names::iterator i = names_.find(decl);
+    if (i != names_.end())
+        return i->second;
+    return generate(decl, decl->getName().str());
 }
 
-void WebCLRenamer::generate(
-    std::ostream &out, const clang::NamedDecl *decl, const std::string &name)
+const std::string &WebCLRenamer::generate(
+    const clang::NamedDecl *decl, const std::string &name)
 {
-    Serials::iterator i = serials_.find(decl);
-    unsigned int serial = (i == serials_.end()) ? assign(decl) : i->second;
+    Names::iterator i = names_.find(decl);
+    if (i != names_.end())
+        return i->second;
+
+    unsigned int serial = assign(decl);
+
+    std::string &renamed = names_[decl];
+    llvm::raw_string_ostream out(renamed);
 
     // Ensure that the user can't interfere with our renaming
     // scheme. The prefix can be freely chosen.
@@ -56,18 +66,12 @@ void WebCLRenamer::generate(
     }
 
     out << name;
+    out.flush();
+    return renamed;
 }
 
 unsigned int WebCLRenamer::assign(const clang::NamedDecl *decl)
 {
-    const std::string name = decl->getName();
-    Counts::iterator i = counts_.find(name);
-
-    unsigned int serial = 1;
-    if (i != counts_.end())
-        serial = i->second + 1;
-
-    counts_[name] = serial;
-    serials_[decl] = serial;
-    return serial;
+    unsigned int &count = counts_[decl->getName()];
+    return ++count;
 }
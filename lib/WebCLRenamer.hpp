@@ -24,7 +24,8 @@
 ** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
 */
 
-#include <iostream>
+#include "llvm/ADT/StringMap.h"
+
 #include <map>
 #include <string>
 
@@ -42,26 +43,28 @@ public:
     explicit WebCLRenamer(const std::string &prefix, const std::string &separator);
     ~WebCLRenamer();
 
-    /// Write unique version of given name to the output stream.
-    void rename(std::ostream &out, const clang::NamedDecl *decl);
+    /// \return Unique version of the name of the object.
+    const std::string &rename(const clang::NamedDecl *decl);
 
-    /// Generate unique version of given name to the output stream.
-    void generate(std::ostream &out, const clang::NamedDecl *decl, const std::string &name);
+    /// \return Unique version of given name. The name is generated
+    /// when the object is first seen and reused after that.
+    const std::string &generate(const clang::NamedDecl *decl, const std::string &name);
 
 private:
 
     /// Indicate that a named object needs to be uniquely renamed.
     unsigned int assign(const clang::NamedDecl *decl);
 
-    /// Maps object to serial number '#'. The object could be renamed
+    /// Maps object to its unique name. The object could be renamed
     /// as '_wcl#_name' or '_Wcl#Name' depending on the used prefix
-    /// and separator. Needed so that object can be renamed quickly.
-    typedef std::map<const clang::NamedDecl*, unsigned int> Serials;
-    Serials serials_;
+    /// and separator, where '#' is a serial number. Needed so that
+    /// object can be renamed quickly.
+    typedef std::map<const clang::NamedDecl*, std::string> Names;
+    Names names_;
     /// Maps object name to number of identically named objects. The
     /// count of a name becomes the serial number of next object with
     /// that name.
-    typedef std::map<const std::string, unsigned int> Counts;
+    typedef llvm::StringMap<unsigned int> Counts;
     Counts counts_;
 
     // Freely chosen prefix for renamed variables. Usually '_wcl' or
@@ -23,10 +23,12 @@
 
 #include "WebCLReporter.hpp"
 
+#include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/CompilerInstance.h"
 
 WebCLReporter::WebCLReporter(clang::CompilerInstance &instance)
     : instance_(instance)
+    , diagnostics_(NULL)
 {
 }
 
@@ -77,7 +79,21 @@ clang::DiagnosticBuilder WebCLReporter::fatal(const char *format)
 
 bool WebCLReporter::isFromMainFile(clang::SourceLocation location) const
 {
-    return location.isValid() && instance_.getSourceManager().isWrittenInMainFile(location);
+    if (location.isInvalid() || !location.isFileID())
+        return false;
+
+    // Compare offsets instead of looking up the file of the location,
+    // because the lookup updates caches of the source manager and
+    // function bodies may be analysed concurrently.
+    const clang::SourceManager &sources = instance_.getSourceManager();
+    const clang::FileID main = sources.getMainFileID();
+    return !(location < sources.getLocForStartOfFile(main)) &&
+        !(sources.getLocForEndOfFile(main) < location);
+}
+
+void WebCLReporter::setDiagnostics(clang::DiagnosticsEngine *diagnostics)
+{
+    diagnostics_ = diagnostics;
 }
 
 clang::DiagnosticBuilder WebCLReporter::message(
@@ -89,6 +105,7 @@ clang::DiagnosticBuilder WebCLReporter::message(
         sourceLocation = *location;
     }
 
-    clang::DiagnosticsEngine &diags = instance_.getDiagnostics();
+    clang::DiagnosticsEngine &diags =
+        diagnostics_ ? *diagnostics_ : instance_.getDiagnostics();
     return diags.Report(sourceLocation, diags.getCustomDiagID(level, format));
 }
@@ -69,6 +69,11 @@ public:
     /// \see WebCLArguments
     bool isFromMainFile(clang::SourceLocation location) const;
 
+    /// Reports further messages to the given diagnostics engine
+    /// instead of the one of the compiler instance. NULL restores
+    /// the default.
+    void setDiagnostics(clang::DiagnosticsEngine *diagnostics);
+
 protected:
 
     /// Provides access to diagnostics engine and source file manager.
@@ -76,6 +81,9 @@ protected:
 
 private:
 
+    /// Overrides the diagnostics engine of the compiler instance.
+    clang::DiagnosticsEngine *diagnostics_;
+
     /// Helper for printing informational messages, warning, errors
     /// and fatal errors.
     clang::DiagnosticBuilder message(
@@ -38,6 +38,7 @@ WebCLRewriter::WebCLRewriter(clang::CompilerInstance &instance,
     : instance_(instance)
     , rewriter_(rewriter)
     , isFilteredRangesDirty_(false)
+    , isRecordingChanges_(false)
 {
 }
 
@@ -325,6 +326,39 @@ void WebCLRewriter::replaceText(clang::SourceRange range, const std::string &tex
   DEBUG( std::cerr << "Replace SourceLoc " << rawStart << ":" << rawEnd << " " << getOriginalText(range) << " with: " << text << "\n"; );
 }
 
+void WebCLRewriter::beginChanges()
+{
+  assert(!isRecordingChanges_);
+  isRecordingChanges_ = true;
+  savedRanges_ = modifiedRanges_;
+}
+
+WebCLRewriter::Changes WebCLRewriter::endChanges()
+{
+  assert(isRecordingChanges_);
+  isRecordingChanges_ = false;
+
+  Changes changes;
+  for (RangeModifications::iterator i = modifiedRanges_.begin();
+       i != modifiedRanges_.end(); ++i) {
+    RangeModifications::iterator saved = savedRanges_.find(i->first);
+    if (saved == savedRanges_.end() || saved->second != i->second)
+      changes[i->first] = i->second;
+  }
+
+  modifiedRanges_.swap(savedRanges_);
+  savedRanges_.clear();
+  isFilteredRangesDirty_ = true;
+  return changes;
+}
+
+void WebCLRewriter::applyChanges(const Changes &changes)
+{
+  isFilteredRangesDirty_ = true;
+  for (Changes::const_iterator i = changes.begin(); i != changes.end(); ++i)
+    modifiedRanges_[i->first] = i->second;
+}
+
 std::string WebCLRewriter::getOriginalText(clang::SourceRange range)
 {
     return rewriter_.getRewrittenText(range);
@@ -89,6 +89,21 @@ public:
   /// Applies transformations.
   void applyTransformations();
 
+  /// Replacements that differ from the ones collected earlier.
+  typedef std::map< std::pair< int, int >, std::string > Changes;
+
+  /// \brief Starts recording replacements that can be taken back.
+  void beginChanges();
+
+  /// \brief Takes back replacements done after beginChanges.
+  ///
+  /// Returns the replacements that were taken back, so that they can be
+  /// applied again temporarily with applyChanges.
+  Changes endChanges();
+
+  /// \brief Applies replacements returned by endChanges.
+  void applyChanges(const Changes &changes);
+
 private:
 
   clang::CompilerInstance &instance_;
@@ -119,6 +134,12 @@ private:
   /// \brief Map of all replacements.
   RangeModifications modifiedRanges_;
 
+  /// \brief Replacements that were done before beginChanges.
+  RangeModifications savedRanges_;
+
+  /// \brief Whether beginChanges has been called without endChanges.
+  bool isRecordingChanges_;
+
   /// \brief Set of toplevel replacements which are not nested inside any other replacement.
   RangeModificationsFilter filteredModifiedRanges_;
 
@@ -0,0 +1,246 @@
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include "WebCLSourceMap.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+    typedef std::pair<unsigned, unsigned> Sample;
+
+    /// \return Whether text between the samples is copied as such.
+    bool isCopied(const Sample &from, const Sample &to)
+    {
+        return (to.first - from.first) == (to.second - from.second);
+    }
+
+    /// Orders samples by their input offsets.
+    struct InputLess
+    {
+        bool operator()(unsigned input, const Sample &sample) const
+        {
+            return input < sample.second;
+        }
+    };
+
+    /// Collects offsets where lines start.
+    void getLineStarts(const std::string &text, std::vector<unsigned> &starts)
+    {
+        starts.push_back(0);
+        for (unsigned i = 0; i < text.size(); ++i) {
+            if (text[i] == '\n')
+                starts.push_back(i + 1);
+        }
+    }
+
+    /// Appends a base64 VLQ of the value.
+    void encodeVlq(std::string &out, int value)
+    {
+        static const char digits[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        static const unsigned continuation = 32;
+
+        // the sign is stored in the least significant bit
+        unsigned vlq = (value < 0) ? ((-value << 1) | 1) : (value << 1);
+        do {
+            unsigned digit = vlq % continuation;
+            vlq /= continuation;
+            if (vlq)
+                digit += continuation;
+            out += digits[digit];
+        } while (vlq);
+    }
+}
+
+WebCLSourceMap::WebCLSourceMap()
+    : samples_()
+{
+}
+
+WebCLSourceMap::~WebCLSourceMap()
+{
+}
+
+void WebCLSourceMap::add(unsigned input, unsigned output)
+{
+    if (!samples_.empty()) {
+        const Sample &last = samples_.back();
+        const Sample sample(std::max(output, last.first), std::max(input, last.second));
+        if (sample == last)
+            return;
+
+        // leave out samples in the middle of copied text
+        if ((samples_.size() > 1) &&
+            isCopied(samples_[samples_.size() - 2], last) && isCopied(last, sample)) {
+            samples_.back() = sample;
+            return;
+        }
+
+        samples_.push_back(sample);
+        return;
+    }
+
+    samples_.push_back(Sample(output, input));
+}
+
+unsigned WebCLSourceMap::getInput(unsigned output) const
+{
+    if (samples_.empty())
+        return output;
+
+    Samples::const_iterator next =
+        std::upper_bound(samples_.begin(), samples_.end(), Sample(output, UINT_MAX));
+    if (next == samples_.begin())
+        return next->second;
+
+    const Sample &sample = *(next - 1);
+    const unsigned input = sample.second + (output - sample.first);
+    if (next == samples_.end())
+        return input;
+    return std::min(input, next->second);
+}
+
+unsigned WebCLSourceMap::getOutput(unsigned input) const
+{
+    if (samples_.empty())
+        return input;
+
+    Samples::const_iterator next =
+        std::upper_bound(samples_.begin(), samples_.end(), input, InputLess());
+    if (next == samples_.begin())
+        return next->first;
+
+    const Sample &sample = *(next - 1);
+    const unsigned output = sample.first + (input - sample.second);
+    if (next == samples_.end())
+        return output;
+    return std::min(output, next->first);
+}
+
+void WebCLSourceMap::append(const WebCLSourceMap &next)
+{
+    // Sample where either of the maps changes.
+    std::vector<unsigned> outputs;
+    outputs.reserve(samples_.size() + next.samples_.size());
+    for (Samples::const_iterator i = next.samples_.begin(); i != next.samples_.end(); ++i)
+        outputs.push_back(i->first);
+    for (Samples::const_iterator i = samples_.begin(); i != samples_.end(); ++i)
+        outputs.push_back(next.getOutput(i->first));
+    std::sort(outputs.begin(), outputs.end());
+    outputs.erase(std::unique(outputs.begin(), outputs.end()), outputs.end());
+
+    WebCLSourceMap chained;
+    for (std::vector<unsigned>::const_iterator i = outputs.begin(); i != outputs.end(); ++i)
+        chained.add(getInput(next.getInput(*i)), *i);
+    samples_.swap(chained.samples_);
+}
+
+void WebCLSourceMap::encode(const std::string &output, const std::string &input,
+                            std::string &mappings) const
+{
+    mappings.clear();
+
+    std::vector<unsigned> outputLines;
+    getLineStarts(output, outputLines);
+    std::vector<unsigned> inputLines;
+    getLineStarts(input, inputLines);
+
+    // Each output line and each sample may start a segment.
+    std::vector<unsigned> offsets(outputLines);
+    for (Samples::const_iterator i = samples_.begin(); i != samples_.end(); ++i)
+        offsets.push_back(i->first);
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    // Fields of the previous segment. Only the output column starts
+    // from zero on each line.
+    unsigned line = 0;
+    int column = 0;
+    int inputLine = 0;
+    int inputColumn = 0;
+    bool firstOnLine = true;
+
+    // Offsets of the previous segment and whether its text is copied
+    // as such. Otherwise all of its text maps to its input offset.
+    unsigned segmentOutput = 0;
+    unsigned segmentInput = 0;
+    bool copied = false;
+
+    const unsigned inputSize = input.size();
+    for (std::vector<unsigned>::const_iterator i = offsets.begin(); i != offsets.end(); ++i) {
+        const unsigned offset = *i;
+        if ((offset >= output.size()) || (output[offset] == '\n'))
+            continue;
+
+        while (((line + 1) < outputLines.size()) && (outputLines[line + 1] <= offset)) {
+            mappings += ';';
+            ++line;
+            column = 0;
+            firstOnLine = true;
+        }
+
+        const unsigned source = std::min(getInput(offset), inputSize);
+        const unsigned next = ((i + 1) != offsets.end()) ?
+            std::min(*(i + 1), static_cast<unsigned>(output.size())) : output.size();
+        const bool copiedNext =
+            (std::min(getInput(next), inputSize) - source) == (next - offset);
+
+        // the previous segment covers the following text too
+        if (!firstOnLine && (copied == copiedNext) &&
+            (source == (copied ? (segmentInput + (offset - segmentOutput)) : segmentInput))) {
+            continue;
+        }
+
+        const int sourceLine =
+            std::upper_bound(inputLines.begin(), inputLines.end(), source) - inputLines.begin() - 1;
+        const int sourceColumn = source - inputLines[sourceLine];
+        const int outputColumn = offset - outputLines[line];
+
+        if (!firstOnLine)
+            mappings += ',';
+        encodeVlq(mappings, outputColumn - column);
+        encodeVlq(mappings, 0);
+        encodeVlq(mappings, sourceLine - inputLine);
+        encodeVlq(mappings, sourceColumn - inputColumn);
+
+        column = outputColumn;
+        inputLine = sourceLine;
+        inputColumn = sourceColumn;
+        firstOnLine = false;
+
+        segmentOutput = offset;
+        segmentInput = source;
+        copied = copiedNext;
+    }
+}
+
+bool WebCLSourceMap::empty() const
+{
+    return samples_.empty();
+}
+
+void WebCLSourceMap::clear()
+{
+    samples_.clear();
+}
@@ -0,0 +1,90 @@
+#ifndef WEBCLVALIDATOR_WEBCLSOURCEMAP
+#define WEBCLVALIDATOR_WEBCLSOURCEMAP
+
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/// \brief Maps offsets of the text written by a validation stage
+/// back to offsets of the text that the stage read.
+///
+/// The mapping is sampled where the stage may have changed the
+/// text. Between two samples the text is assumed to be copied as
+/// such, up to the input offset of the latter sample. Text that the
+/// stage inserted therefore maps to the input offset where it was
+/// inserted.
+class WebCLSourceMap
+{
+public:
+
+    WebCLSourceMap();
+    ~WebCLSourceMap();
+
+    /// Records that input text at the given offset was written to
+    /// the given output offset. Samples are added in input
+    /// order. Output offsets never go backwards: text that was
+    /// removed maps to where the removal took place.
+    void add(unsigned input, unsigned output);
+
+    /// \return Input offset of the text at the given output offset.
+    unsigned getInput(unsigned output) const;
+
+    /// \return Output offset of the text at the given input offset.
+    unsigned getOutput(unsigned input) const;
+
+    /// Chains the map of the following stage after this map, so that
+    /// this map maps the output of the following stage to the input
+    /// of this stage.
+    void append(const WebCLSourceMap &next);
+
+    /// Writes the map as the "mappings" field of a Source Map
+    /// Revision 3 file. There is a group of segments for each line of
+    /// the output separated by ';'. Each segment has the 0-based
+    /// output column, source index, input line and input column,
+    /// delta encoded as base64 VLQs. The source index is always 0 and
+    /// columns are counted in bytes. A segment either starts text
+    /// that is copied as such, or text that maps as a whole to the
+    /// input offset of the segment, such as inserted text.
+    void encode(const std::string &output, const std::string &input,
+                std::string &mappings) const;
+
+    /// \return Whether nothing has been recorded. An empty map maps
+    /// each offset to itself.
+    bool empty() const;
+
+    /// Forgets all samples.
+    void clear();
+
+private:
+
+    /// Output offset and input offset of a sample.
+    typedef std::pair<unsigned, unsigned> Sample;
+    /// Samples in increasing order of both offsets.
+    typedef std::vector<Sample> Samples;
+    Samples samples_;
+};
+
+#endif // WEBCLVALIDATOR_WEBCLSOURCEMAP
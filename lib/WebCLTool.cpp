@@ -50,7 +50,7 @@ namespace {
 
 WebCLTool::WebCLTool(int argc, char const **argv,
                      char const *input, char const *output)
-    : compilations_(NULL), paths_(), tool_(NULL), output_(output)
+    : compilations_(NULL), paths_(), tool_(NULL), output_(output), sourceMap_()
 {
     compilations_ = loadFromCommandLine(argc, argv);
 
@@ -80,6 +80,11 @@ void WebCLTool::setExtensions(const std::set<std::string> &extensions)
     extensions_ = extensions;
 }
 
+void WebCLTool::setOptions(const WebCLOptions &options)
+{
+    options_ = options;
+}
+
 int WebCLTool::run()
 {
     if (!compilations_ || !tool_)
@@ -99,8 +104,9 @@ WebCLPreprocessorTool::~WebCLPreprocessorTool()
 
 clang::FrontendAction *WebCLPreprocessorTool::create()
 {
-    WebCLAction *action = new WebCLPreprocessorAction(output_, builtinDecls_);
+    WebCLAction *action = new WebCLPreprocessorAction(output_, builtinDecls_, sourceMap_);
     action->setExtensions(extensions_);
+    action->setOptions(options_);
     return action;
 }
 
@@ -116,8 +122,9 @@ WebCLMatcher1Tool::~WebCLMatcher1Tool()
 
 clang::FrontendAction *WebCLMatcher1Tool::create()
 {
-    WebCLAction *action = new WebCLMatcher1Action(output_);
+    WebCLAction *action = new WebCLMatcher1Action(output_, sourceMap_);
     action->setExtensions(extensions_);
+    action->setOptions(options_);
     return action;
 }
 
@@ -133,8 +140,9 @@ WebCLMatcher2Tool::~WebCLMatcher2Tool()
 
 clang::FrontendAction *WebCLMatcher2Tool::create()
 {
-    WebCLAction *action = new WebCLMatcher2Action(output_);
+    WebCLAction *action = new WebCLMatcher2Action(output_, sourceMap_);
     action->setExtensions(extensions_);
+    action->setOptions(options_);
     return action;
 }
 
@@ -150,7 +158,8 @@ WebCLValidatorTool::~WebCLValidatorTool()
 
 clang::FrontendAction *WebCLValidatorTool::create()
 {
-    WebCLAction *action = new WebCLValidatorAction(validatedSource_, kernels_);
+    WebCLAction *action = new WebCLValidatorAction(validatedSource_, kernels_, checkSites_, sourceMap_);
     action->setExtensions(extensions_);
+    action->setOptions(options_);
     return action;
 }
@@ -26,6 +26,9 @@
 
 #include "clang/Tooling/Tooling.h"
 
+#include "WebCLHelper.hpp"
+#include "WebCLOptions.hpp"
+#include "WebCLSourceMap.hpp"
 #include "WebCLVisitor.hpp"
 
 #include <string>
@@ -63,6 +66,7 @@ public:
 
     void setDiagnosticConsumer(clang::DiagnosticConsumer *diag);
     void setExtensions(const std::set<std::string> &extensions);
+    void setOptions(const WebCLOptions &options);
 
     /// \see clang::tooling::FrontendActionFactory
     virtual clang::FrontendAction *create() = 0;
@@ -70,6 +74,10 @@ public:
     /// Process input to produce transformed output.
     int run();
 
+    /// Returns where the output comes from in the input after a
+    /// successful run.
+    const WebCLSourceMap &getSourceMap() const { return sourceMap_; }
+
 protected:
 
     /// Jobs to perform based on command line options.
@@ -78,10 +86,14 @@ protected:
     std::vector<std::string> paths_;
     // Additional OpenCL extensions to allow in preprocessing besides cl_khr_initialize_memory
     std::set<std::string> extensions_;
+    /// Code generation options selected for the program.
+    WebCLOptions options_;
     /// Tool representing a validation stage.
     clang::tooling::ClangTool* tool_;
     /// Target file for transformations.
     const char *output_;
+    /// Origins of the output in the input.
+    WebCLSourceMap sourceMap_;
 };
 
 /// Runs preprocessing stage. Takes the user source file as input.
@@ -154,6 +166,8 @@ public:
     const std::string &getValidatedSource() const { return validatedSource_; }
     /// Ditto for kernel info
     const WebCLAnalyser::KernelList &getKernels() const { return kernels_; }
+    /// Ditto for locations of counted memory access checks
+    const CheckSiteList &getCheckSites() const { return checkSites_; }
 
 private:
 
@@ -161,6 +175,8 @@ private:
     std::string validatedSource_;
     // ditto for kernels
     WebCLAnalyser::KernelList kernels_;
+    // ditto for check sites
+    CheckSiteList checkSites_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLTOOL
@@ -34,6 +34,10 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Rewrite/Core/Rewriter.h"
 
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
 namespace {
     typedef std::vector<clang::Expr*> ExprVector;
     typedef std::list<std::pair<std::string, std::string> > FunctionArgumentList;
@@ -95,10 +99,11 @@ public:
     virtual unsigned getNumArgs() const = 0;
 
     /// Does this wrapper match the signature of the call?
-    virtual bool matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr);
+    /// Only consulted for wrappers that aren't looked up by name.
+    virtual bool matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr) const;
 
     /// Does this wrapper match the signature of this variable declaration?
-    virtual bool matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl);
+    virtual bool matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl) const;
 	
     /// Returns the return type and body of the builtin function with given arguments.
     /// Declaration for the function is generated by the function functionDeclaration
@@ -126,14 +131,14 @@ WebCLTransformer::FunctionCallWrapper::~FunctionCallWrapper()
 // nothing    
 }
 
-bool WebCLTransformer::FunctionCallWrapper::matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr)
+bool WebCLTransformer::FunctionCallWrapper::matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr) const
 {
     const clang::FunctionDecl *callee = callExpr->getDirectCallee();
     std::string callName = callee->getNameInfo().getAsString();
     return getName() == callName && getNumArgs() == callExpr->getNumArgs();
 }
 
-bool WebCLTransformer::FunctionCallWrapper::matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl)
+bool WebCLTransformer::FunctionCallWrapper::matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl) const
 {
     return false;
 }
@@ -149,16 +154,16 @@ void WebCLTransformer::FunctionCallWrapper::wrapDeclaration(WebCLTransformer &tr
 }
 
 namespace {
-    // Does the type name of the nth argument of a call OR the function that is
-    // being called match the given type name?
-    bool argTypeMatchesCallerOrCalleeArg(clang::CompilerInstance &instance, clang::CallExpr *callExpr, size_t argIdx, std::string typeName) {
+    // Is the type of the nth argument of a call OR the function that is
+    // being called the given OpenCL C builtin type?
+    bool argTypeMatchesCallerOrCalleeArg(clang::CompilerInstance &instance, clang::CallExpr *callExpr, size_t argIdx, WebCLTypes::OpaqueKind opaque) {
         const clang::FunctionDecl *callee = callExpr->getDirectCallee();
-        if (argIdx < callExpr->getNumArgs() && WebCLTypes::reduceType(instance, callExpr->getArg(argIdx)->getType()).getAsString() == typeName) {
+        if (argIdx < callExpr->getNumArgs() && WebCLTypes::classifyType(instance, callExpr->getArg(argIdx)->getType()).opaque == opaque) {
             return true;
         } else if (argIdx < callee->getNumParams()) {
             const clang::ParmVarDecl *paramVarDecl = callee->getParamDecl(argIdx);
             const clang::QualType paramQualType = paramVarDecl->getOriginalType();
-            return WebCLTypes::reduceType(instance, paramQualType).getAsString() == typeName;
+            return WebCLTypes::classifyType(instance, paramQualType).opaque == opaque;
         } else {
             return false;
         }
@@ -229,7 +234,7 @@ namespace {
 
             const clang::ValueDecl *valueDecl = declRefExpr ? declRefExpr->getDecl() : 0;
             
-            if (valueDecl && WebCLTypes::reduceType(instance, valueDecl->getType()).getAsString() != typeName) {
+            if (valueDecl && WebCLTypes::classifyType(instance, valueDecl->getType()).opaque != WebCLTypes::SAMPLER_TYPE) {
                 transformer.error(location, "initializer is not of type %0") << typeName;
             } else if (valueDecl && clang::isa<clang::ParmVarDecl>(valueDecl)) {
                 // ok, this value is directly (or implicitly casted) parameter reference
@@ -279,8 +284,8 @@ namespace {
         std::string getName() const;
         unsigned getNumArgs() const;
 
-        bool matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr);
-        bool matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *callExpr);
+        bool matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr) const;
+        bool matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *callExpr) const;
 
         WrappedFunction wrapFunction(WebCLTransformer &transformer, clang::CompilerInstance &instance, clang::CallExpr *callExpr, const ExprVector &arguments, WebCLKernelHandler &kernelHandler, WebCLRewriter &rewriter) const;
         void wrapDeclaration(WebCLTransformer &transformer, clang::CompilerInstance &instance, clang::VarDecl *varDecl, WebCLKernelHandler &kernelHandler, WebCLRewriter &rewriter) const;
@@ -377,12 +382,10 @@ namespace {
 	clang::CompilerInstance &instance, 
 	std::string returnTypeStr,
 	const clang::CallExpr *callExpr, 
-	std::string name)
+	std::string name,
+	const FunctionArgumentList &recordArguments)
     {
-	WebCLConfiguration cfg;
-
-	FunctionArgumentList newArguments;
-	newArguments.push_back(std::make_pair(cfg.addressSpaceRecordType_ + "*", cfg.addressSpaceRecordName_));
+	FunctionArgumentList newArguments = recordArguments;
 	for (size_t argIdx = 0; argIdx < callExpr->getNumArgs(); ++argIdx) {
 	    newArguments.push_back(std::make_pair(
 		    callExpr->getArg(argIdx)->getType().getAsString(),
@@ -405,24 +408,29 @@ namespace {
 
 	std::string ptrTypeStr = pointerArg->getType().getAsString();
 	std::string returnTypeStr;
+	std::string zeroValue;
 	unsigned origDataWidth = (aligned_ && width_ == 3) ? 4 : width_;
 
 	if (half_) {
 	    returnTypeStr = "float" + stringify(width_);
+	    WebCLTypes::InitialZeroValues::const_iterator zero =
+	        WebCLTypes::initialZeroValues().find(returnTypeStr);
+	    if (zero != WebCLTypes::initialZeroValues().end())
+	        zeroValue = zero->second;
 	} else {
-	    returnTypeStr = WebCLTypes::reduceType(instance, pointerArg->getType().getTypePtr()->getPointeeType()).getAsString();
+	    const WebCLTypes::TypeClass &returnType =
+	        WebCLTypes::classifyType(instance, pointerArg->getType().getTypePtr()->getPointeeType());
+	    returnTypeStr = returnType.name;
+	    zeroValue = returnType.zeroValue;
 	}
 	
-	AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg);
+	AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg, callExpr);
 
 	std::string indent = cfg.getIndentation(1);
 	std::string indent__ = cfg.getIndentation(2);
 	std::stringstream body;
-	std::string zeroValue;
-	if (!WebCLTypes::initialZeroValues().count(returnTypeStr)) {
+	if (zeroValue.empty()) {
 	    transformer.error(arguments[1]->getLocStart(), ("Cannot find default zero initializer for type " + returnTypeStr).c_str());
-	} else {
-	    zeroValue = WebCLTypes::initialZeroValues().find(returnTypeStr)->second;
 	}
 	body
 	    << indent << ptrTypeStr << " ptr = arg1 + " << origDataWidth << " * (size_t) arg0;\n"
@@ -478,7 +486,7 @@ namespace {
 	std::string ptrTypeStr = pointerArg->getType().getAsString();
 	unsigned origDataWidth = (aligned_ && width_ == 3) ? 4 : width_;
 	
-	AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg);
+	AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg, callExpr);
 
 	std::string indent = cfg.getIndentation(1);
 	std::string indent__ = cfg.getIndentation(2);
@@ -512,7 +520,7 @@ namespace {
 	llvm::APSInt apsValue;
 	clang::Expr *imageArg = arguments[0];
 	clang::Expr *samplerArg = arguments[1];
-	if (WebCLTypes::reduceType(instance, imageArg->getType()).getAsString() != "image2d_t") {
+	if (WebCLTypes::classifyType(instance, imageArg->getType()).opaque != WebCLTypes::IMAGE2D_TYPE) {
 	    transformer.error(arguments[1]->getLocStart(), "%0 argument number 1 must be image2d_t") << getName().c_str();
 	    return WrappedFunction();
 	}
@@ -541,12 +549,12 @@ namespace {
         return 0;
     }
 
-    bool SamplerType::matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr)
+    bool SamplerType::matchesCallExpr(clang::CompilerInstance &instance, clang::CallExpr *callExpr) const
     {
         for (size_t argIdx = 0; argIdx < callExpr->getNumArgs(); ++argIdx) {
             // either the argument or the function parameter type matchesCallExpr. this covers the case of implicit conversions
             // of, say, an integer to sampler_t
-            if (argTypeMatchesCallerOrCalleeArg(instance, callExpr, argIdx, "sampler_t")) {
+            if (argTypeMatchesCallerOrCalleeArg(instance, callExpr, argIdx, WebCLTypes::SAMPLER_TYPE)) {
                 return true;
 	    }
         }
@@ -560,7 +568,7 @@ namespace {
             transformer.error(callExpr->getLocStart(), "Unsupported expression to function call involving sampler_t");
 	} else {
             for (unsigned argIdx = 0; argIdx < arguments.size(); ++argIdx) {
-                if (argTypeMatchesCallerOrCalleeArg(instance, callExpr, argIdx, "sampler_t")) {
+                if (argTypeMatchesCallerOrCalleeArg(instance, callExpr, argIdx, WebCLTypes::SAMPLER_TYPE)) {
                     rewriteOrForwardSamplerArgument(transformer, instance, rewriter, ranges[argIdx], arguments[argIdx], ranges[argIdx].getBegin());
                 }
             }
@@ -568,9 +576,9 @@ namespace {
 	return WrappedFunction();
     }
 
-    bool SamplerType::matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl)
+    bool SamplerType::matchesVarDecl(clang::CompilerInstance &instance, clang::VarDecl *varDecl) const
     {
-        return WebCLTypes::reduceType(instance, varDecl->getType()).getAsString() == "sampler_t";
+        return WebCLTypes::classifyType(instance, varDecl->getType()).opaque == WebCLTypes::SAMPLER_TYPE;
     }
 
     void SamplerType::wrapDeclaration(WebCLTransformer &transformer, clang::CompilerInstance &instance, clang::VarDecl *varDecl, WebCLKernelHandler &kernelHandler, WebCLRewriter &rewriter) const
@@ -617,10 +625,10 @@ namespace {
         std::string ptrTypeStr = pointerArg->getType().getAsString();
         std::string returnTypeStr =
             ((returnTypeArgIndex_ == ptrArgIndex_) 
-                ? WebCLTypes::reduceType(instance, pointerArg->getType().getTypePtr()->getPointeeType())
-                : WebCLTypes::reduceType(instance, arguments[returnTypeArgIndex_]->getType())).getAsString();
+                ? WebCLTypes::classifyType(instance, pointerArg->getType().getTypePtr()->getPointeeType())
+                : WebCLTypes::classifyType(instance, arguments[returnTypeArgIndex_]->getType())).name;
 
-        AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg);
+        AddressSpaceLimits &limits = kernelHandler.getDerefLimits(pointerArg, callExpr);
 
         std::string indent = cfg.getIndentation(1);
         std::stringstream body;
@@ -640,98 +648,197 @@ namespace {
         return WrappedFunction(returnTypeStr, body.str());
     }
 
-}
+    /// Builtin wrappers indexed by the name of the wrapped builtin.
+    /// Wrappers don't depend on the program being transformed, so
+    /// the table is built once and shared by all transformers.
+    class BuiltinWrapperTable {
+    public:
+        BuiltinWrapperTable();
+        ~BuiltinWrapperTable();
 
+        /// \return The first wrapper matching the call or NULL.
+        const WebCLTransformer::FunctionCallWrapper *findCall(
+            clang::CompilerInstance &instance, clang::CallExpr *callExpr) const;
+        /// \return The first wrapper matching the declaration or NULL.
+        const WebCLTransformer::FunctionCallWrapper *findDeclaration(
+            clang::CompilerInstance &instance, clang::VarDecl *varDecl) const;
 
+    private:
+        typedef std::vector<WebCLTransformer::FunctionCallWrapper*> WrapperList;
+
+        /// Adds a wrapper that matches calls by builtin name and
+        /// number of arguments.
+        void addNamed(WebCLTransformer::FunctionCallWrapper *wrapper);
+        /// Adds generic wrappers from a sequence; reduces code duplication
+        void addGeneric(const StringList &list, unsigned numArgs, unsigned ptrArgIndex);
+        /// Adds a wrapper that inspects each call and declaration
+        /// itself. These are tried only if no named wrapper matches.
+        void addFallback(WebCLTransformer::FunctionCallWrapper *wrapper);
+
+        /// Named wrappers in insertion order for each builtin name.
+        llvm::StringMap<WrapperList> named_;
+        /// Wrappers that don't match by name.
+        WrapperList fallbacks_;
+    };
 
-WebCLTransformer::WebCLTransformer(
-    clang::CompilerInstance &instance, clang::Rewriter &rewriter)
-    : WebCLReporter(instance)
-    , wclRewriter_(instance, rewriter)
-    , cfg_()
-{
-    // Make a list of builtin wrappers
-    for (UintList::const_iterator widthIt = cfg_.dataWidths_.begin();
-	 widthIt != cfg_.dataWidths_.end();
-	 ++widthIt) {
-        functionWrappers_.push_back(new VLoad(*widthIt, false, false));
-        functionWrappers_.push_back(new VStore(*widthIt, false, false, ""));
-        functionWrappers_.push_back(new VLoad(*widthIt, true, false));
-        functionWrappers_.push_back(new VStore(*widthIt, true, false, ""));
-        functionWrappers_.push_back(new VLoad(*widthIt, true, true));
-        functionWrappers_.push_back(new VStore(*widthIt, true, true, ""));
-	for (StringList::const_iterator roundingModeIt = cfg_.roundingModes_.begin();
-	     roundingModeIt != cfg_.roundingModes_.end();
-	     ++roundingModeIt) {
-            functionWrappers_.push_back(new VStore(*widthIt, true, false, *roundingModeIt));
-            functionWrappers_.push_back(new VStore(*widthIt, true, true, *roundingModeIt));
-	}
+    BuiltinWrapperTable::BuiltinWrapperTable()
+    {
+        WebCLConfiguration cfg;
+
+        for (UintList::const_iterator widthIt = cfg.dataWidths_.begin();
+             widthIt != cfg.dataWidths_.end();
+             ++widthIt) {
+            addNamed(new VLoad(*widthIt, false, false));
+            addNamed(new VStore(*widthIt, false, false, ""));
+            addNamed(new VLoad(*widthIt, true, false));
+            addNamed(new VStore(*widthIt, true, false, ""));
+            addNamed(new VLoad(*widthIt, true, true));
+            addNamed(new VStore(*widthIt, true, true, ""));
+            for (StringList::const_iterator roundingModeIt = cfg.roundingModes_.begin();
+                 roundingModeIt != cfg.roundingModes_.end();
+                 ++roundingModeIt) {
+                addNamed(new VStore(*widthIt, true, false, *roundingModeIt));
+                addNamed(new VStore(*widthIt, true, true, *roundingModeIt));
+            }
+        }
+        addNamed(new VLoad(1, true, false));
+        addNamed(new VStore(1, true, false, ""));
+        addNamed(new VLoad(1, true, true));
+        addNamed(new VStore(1, true, true, ""));
+        for (StringList::const_iterator roundingModeIt = cfg.roundingModes_.begin();
+             roundingModeIt != cfg.roundingModes_.end();
+             ++roundingModeIt) {
+            addNamed(new VStore(1, true, false, *roundingModeIt));
+            addNamed(new VStore(1, true, true, *roundingModeIt));
+        }
+        addNamed(new ReadImage("f"));
+        addNamed(new ReadImage("i"));
+
+        addGeneric(cfg.atomicOperations1_, 1, 0);
+        addGeneric(cfg.atomicOperations2_, 2, 0);
+        addGeneric(cfg.atomicOperations3_, 3, 0);
+
+        addNamed(new GenericWrapper("fract", 2, 1, 0));
+        addNamed(new GenericWrapper("frexp", 2, 1, 0));
+        addNamed(new GenericWrapper("modf", 2, 1, 0));
+        addNamed(new GenericWrapper("lgamma_r", 2, 1, 0));
+        addNamed(new GenericWrapper("remquo", 3, 2, 0));
+        addNamed(new GenericWrapper("sincos", 2, 1, 0));
+
+        // note: only the first matching handler is executed, so named
+        // wrappers such as ReadImage take precedence over this one.
+        addFallback(new SamplerType());
+    }
+
+    BuiltinWrapperTable::~BuiltinWrapperTable()
+    {
+        for (llvm::StringMap<WrapperList>::iterator i = named_.begin();
+             i != named_.end(); ++i) {
+            WrapperList &wrappers = i->getValue();
+            for (WrapperList::iterator j = wrappers.begin(); j != wrappers.end(); ++j)
+                delete *j;
+        }
+
+        for (WrapperList::iterator i = fallbacks_.begin(); i != fallbacks_.end(); ++i)
+            delete *i;
+    }
+
+    void BuiltinWrapperTable::addNamed(WebCLTransformer::FunctionCallWrapper *wrapper)
+    {
+        named_[wrapper->getName()].push_back(wrapper);
+    }
+
+    void BuiltinWrapperTable::addGeneric(
+        const StringList &list, unsigned numArgs, unsigned ptrArgIndex)
+    {
+        for (StringList::const_iterator operationIt = list.begin();
+             operationIt != list.end();
+             ++operationIt) {
+            addNamed(new GenericWrapper(*operationIt, numArgs, ptrArgIndex, ptrArgIndex));
+        }
     }
-    functionWrappers_.push_back(new VLoad(1, true, false));
-    functionWrappers_.push_back(new VStore(1, true, false, ""));
-    functionWrappers_.push_back(new VLoad(1, true, true));
-    functionWrappers_.push_back(new VStore(1, true, true, ""));
-    for (StringList::const_iterator roundingModeIt = cfg_.roundingModes_.begin();
-	 roundingModeIt != cfg_.roundingModes_.end();
-	 ++roundingModeIt) {
-        functionWrappers_.push_back(new VStore(1, true, false, *roundingModeIt));
-        functionWrappers_.push_back(new VStore(1, true, true, *roundingModeIt));
+
+    void BuiltinWrapperTable::addFallback(WebCLTransformer::FunctionCallWrapper *wrapper)
+    {
+        fallbacks_.push_back(wrapper);
     }
-    functionWrappers_.push_back(new ReadImage("f"));
-    functionWrappers_.push_back(new ReadImage("i"));
 
-    addGenericWrappers(cfg_.atomicOperations1_, 1, 0);
-    addGenericWrappers(cfg_.atomicOperations2_, 2, 0);
-    addGenericWrappers(cfg_.atomicOperations3_, 3, 0);
+    const WebCLTransformer::FunctionCallWrapper *BuiltinWrapperTable::findCall(
+        clang::CompilerInstance &instance, clang::CallExpr *callExpr) const
+    {
+        const clang::FunctionDecl *callee = callExpr->getDirectCallee();
+        const clang::IdentifierInfo *identifier =
+            callee ? callee->getIdentifier() : NULL;
+
+        if (identifier) {
+            llvm::StringMap<WrapperList>::const_iterator i =
+                named_.find(identifier->getName());
+            if (i != named_.end()) {
+                const WrapperList &wrappers = i->getValue();
+                for (WrapperList::const_iterator j = wrappers.begin(); j != wrappers.end(); ++j) {
+                    if ((*j)->getNumArgs() == callExpr->getNumArgs())
+                        return *j;
+                }
+            }
+        }
 
-    functionWrappers_.push_back(new GenericWrapper("fract", 2, 1, 0));
-    functionWrappers_.push_back(new GenericWrapper("frexp", 2, 1, 0));
-    functionWrappers_.push_back(new GenericWrapper("modf", 2, 1, 0));
-    functionWrappers_.push_back(new GenericWrapper("lgamma_r", 2, 1, 0));
-    functionWrappers_.push_back(new GenericWrapper("remquo", 3, 2, 0));
-    functionWrappers_.push_back(new GenericWrapper("sincos", 2, 1, 0));
+        for (WrapperList::const_iterator i = fallbacks_.begin(); i != fallbacks_.end(); ++i) {
+            if ((*i)->matchesCallExpr(instance, callExpr))
+                return *i;
+        }
+        return NULL;
+    }
 
-    // note: needs to be inserted after other, more specific, wrappers, as only the first matching handler is
-    // executed. In this case this needs to be before ReadImage.
-    functionWrappers_.push_back(new SamplerType());
+    const WebCLTransformer::FunctionCallWrapper *BuiltinWrapperTable::findDeclaration(
+        clang::CompilerInstance &instance, clang::VarDecl *varDecl) const
+    {
+        // named wrappers never match declarations
+        for (WrapperList::const_iterator i = fallbacks_.begin(); i != fallbacks_.end(); ++i) {
+            if ((*i)->matchesVarDecl(instance, varDecl))
+                return *i;
+        }
+        return NULL;
+    }
+
+    const BuiltinWrapperTable &getBuiltinWrappers()
+    {
+        static const BuiltinWrapperTable table;
+        return table;
+    }
 }
 
-void WebCLTransformer::addGenericWrappers(const StringList& list, 
-    unsigned numArgs,
-    unsigned ptrArgIndex)
+
+
+WebCLTransformer::WebCLTransformer(
+    clang::CompilerInstance &instance, clang::Rewriter &rewriter,
+    const WebCLOptions &options)
+    : WebCLReporter(instance)
+    , wclRewriter_(instance, rewriter)
+    , preModulePrologue_(preModulePrologueCode_)
+    , modulePrologue_(modulePrologueCode_)
+    , afterLimitFunctions_(afterLimitFunctionsCode_)
+    , cfg_()
+    , options_(options)
 {
-    for (StringList::const_iterator operationIt = list.begin();
-         operationIt != list.end();
-         ++operationIt) {
-        functionWrappers_.push_back(new GenericWrapper(*operationIt, numArgs, ptrArgIndex, ptrArgIndex));
-    }
 }
 
 WebCLTransformer::~WebCLTransformer()
 {
-    for (FunctionPrologueMap::iterator i = kernelPrologues_.begin();
-         i != kernelPrologues_.end(); ++i) {
-        std::stringstream *out = i->second;
-        delete out;
-    }
-
-    for (FunctionPrologueMap::iterator i = functionPrologues_.begin();
-         i != functionPrologues_.end(); ++i) {
-        std::stringstream *out = i->second;
-        delete out;
-    }
+}
 
-    for (FunctionCallWrapperList::iterator it = functionWrappers_.begin();
-         it != functionWrappers_.end();
-	 ++it) {
-        delete *it;
-    }
+const WebCLOptions &WebCLTransformer::getOptions() const
+{
+    return options_;
 }
 
 bool WebCLTransformer::rewrite()
 {
     bool status = true;
 
+    // copies of helper functions are composed from the replacements
+    // of the original functions, so they must be emitted first
+    emitFunctionClones();
+
     // do all replacements stored in refactoring first ()
     flushQueuedTransformations();
 
@@ -752,24 +859,12 @@ bool WebCLTransformer::rewrite()
          iter != kernelOrFunction.end(); iter++) {
 
       const clang::FunctionDecl *func = *iter;
-      clang::Stmt *body = func->getBody();
-      if (!body) {
+      if (!func->getBody()) {
         error(func->getLocStart(), "Function has no body.");
         return false;
       }
 
-      std::stringstream prologue;
-      if (kernelPrologues_.count(func) > 0) {
-          prologue << functionPrologue(kernelPrologues_, func).str();
-      }
-      if (functionPrologues_.count(func) > 0) {
-          prologue << functionPrologue(functionPrologues_, func).str();
-      }
-
-      clang::SourceLocation loc = body->getLocStart();
-      clang::SourceRange range(loc, loc);
-      std::string orig = wclRewriter_.getTransformedText(range) + "\n";
-      wclRewriter_.replaceText(range, orig + prologue.str());
+      insertFunctionPrologue(func);
     }
 
     flushQueuedTransformations();
@@ -777,23 +872,81 @@ bool WebCLTransformer::rewrite()
     return status;
 }
 
-std::stringstream& WebCLTransformer::functionPrologue(
-    FunctionPrologueMap &prologues, const clang::FunctionDecl *kernel)
+void WebCLTransformer::insertFunctionPrologue(const clang::FunctionDecl *func)
 {
-    if (!prologues.count(kernel)) {
-        std::stringstream *out = new std::stringstream();
-        if (!out) {
-            fatal("Internal error. Can't create stream for function prologue.");
-            return modulePrologue_;
-        }
-        prologues[kernel] = out;
+    clang::SourceLocation loc = func->getBody()->getLocStart();
+    clang::SourceRange range(loc, loc);
+    std::string code = wclRewriter_.getTransformedText(range) + "\n";
+    if (kernelPrologues_.count(func) > 0) {
+        code += functionPrologue(kernelPrologues_, func);
+    }
+    if (functionPrologues_.count(func) > 0) {
+        code += functionPrologue(functionPrologues_, func);
     }
-    return *prologues[kernel];
+
+    wclRewriter_.replaceText(range, code);
+}
+
+std::string WebCLTransformer::getFunctionCloneName(
+    const clang::FunctionDecl *function, unsigned index)
+{
+    return cfg_.getNameOfHelperClone(function->getNameAsString(), index);
+}
+
+void WebCLTransformer::beginFunctionClone(
+    const clang::FunctionDecl *function, unsigned index)
+{
+    FunctionClone clone;
+    clone.function = function;
+    functionClones_.push_back(clone);
+
+    wclRewriter_.beginChanges();
+    clang::SourceLocation loc = function->getLocation();
+    wclRewriter_.replaceText(
+        clang::SourceRange(loc, loc), getFunctionCloneName(function, index));
+}
+
+void WebCLTransformer::endFunctionClone()
+{
+    functionClones_.back().changes = wclRewriter_.endChanges();
+}
+
+void WebCLTransformer::emitFunctionClones()
+{
+    std::map<const clang::FunctionDecl*, std::string> clones;
+
+    for (FunctionCloneList::iterator i = functionClones_.begin();
+         i != functionClones_.end(); ++i) {
+        const clang::FunctionDecl *function = i->function;
+
+        // The prologues of the original function are inserted only
+        // later, so the copy needs them now. Both use the same
+        // variable names.
+        wclRewriter_.beginChanges();
+        wclRewriter_.applyChanges(i->changes);
+        if (kernelPrologues_.count(function) || functionPrologues_.count(function))
+            insertFunctionPrologue(function);
+        clones[function] += "\n\n" + wclRewriter_.getTransformedText(function->getSourceRange());
+        wclRewriter_.endChanges();
+    }
+
+    for (std::map<const clang::FunctionDecl*, std::string>::iterator i = clones.begin();
+         i != clones.end(); ++i) {
+        clang::SourceLocation loc = i->first->getBody()->getLocEnd();
+        clang::SourceRange range(loc, loc);
+        wclRewriter_.replaceText(range, wclRewriter_.getTransformedText(range) + i->second);
+    }
+}
+
+std::string &WebCLTransformer::functionPrologue(
+    FunctionPrologueMap &prologues, const clang::FunctionDecl *kernel)
+{
+    return prologues[kernel];
 }
 
 std::string WebCLTransformer::addressSpaceInfoAsStruct(AddressSpaceInfo &as)
 {
-  std::stringstream retVal;
+  WebCLFragment retVal;
   retVal << "{\n";
   for (AddressSpaceInfo::iterator declIter = as.begin();
        declIter != as.end(); ++declIter) {
@@ -806,9 +959,9 @@ std::string WebCLTransformer::addressSpaceInfoAsStruct(AddressSpaceInfo &as)
 }
 
 std::string WebCLTransformer::addressSpaceInitializer(AddressSpaceInfo &as) {
-  std::stringstream retVal;
+  WebCLFragment retVal;
   retVal << "{ ";
-  std::string comma = "";
+  const char *comma = "";
   for (AddressSpaceInfo::iterator declIter = as.begin();
        declIter != as.end(); ++declIter) {
     retVal << comma;
@@ -817,18 +970,18 @@ std::string WebCLTransformer::addressSpaceInitializer(AddressSpaceInfo &as) {
   }
   retVal << " }";
 
-  DEBUG( std::cerr << "Created address space initializer: " << retVal.str() << "\n"; );
+  DEBUG( std::cerr << "Created address space initializer: " << retVal.str().str() << "\n"; );
   return retVal.str();
 }
 
 std::string WebCLTransformer::addressSpaceLimitsAsStruct(AddressSpaceLimits &asLimits)
 {
-    std::stringstream retVal;
+    WebCLFragment retVal;
     retVal << "{\n";
   
     // if address space has static allocations
     if (asLimits.hasStaticallyAllocatedLimits()) {
-        std::stringstream prefix;
+        WebCLFragment prefix;
         prefix << cfg_.indentation_ << "__";
 
         switch (asLimits.getAddressSpace()) {
@@ -874,7 +1027,7 @@ std::string WebCLTransformer::addressSpaceLimitsAsStruct(AddressSpaceLimits &asL
 std::string WebCLTransformer::addressSpaceLimitsInitializer(
     clang::FunctionDecl *kernelFunc, AddressSpaceLimits &asLimits)
 {
-    std::stringstream retVal;
+    WebCLFragment retVal;
     retVal << "{ ";
     std::string comma = "";
 
@@ -931,7 +1084,7 @@ std::string WebCLTransformer::addressSpaceLimitsInitializer(
 }
 
 void WebCLTransformer::createAddressSpaceLimitsNullInitializer(
-    std::ostream &out, unsigned addressSpace)
+    llvm::raw_ostream &out, unsigned addressSpace)
 {
   switch (addressSpace) {
     case clang::LangAS::opencl_constant:
@@ -953,9 +1106,12 @@ void WebCLTransformer::createAddressSpaceTypedef(
     }
 }
 
-void WebCLTransformer::createPrivateAddressSpaceTypedef(AddressSpaceInfo &as)
+void WebCLTransformer::createPrivateAddressSpaceTypedef(KernelAllocations &allocs)
 {
-    createAddressSpaceTypedef(as, cfg_.privateRecordType_, cfg_.getNameOfAlignMacro("private"));
+    createAddressSpaceTypedef(
+        allocs.getPrivates(),
+        cfg_.getNameOfGroupType(cfg_.privateRecordType_, allocs.getName()),
+        cfg_.getNameOfAlignMacro("private"));
 }
 
 void WebCLTransformer::createLocalAddressSpaceTypedef(AddressSpaceInfo &as)
@@ -971,24 +1127,32 @@ void WebCLTransformer::createConstantAddressSpaceTypedef(AddressSpaceInfo &as)
 void WebCLTransformer::createAddressSpaceLimitsTypedef(
     AddressSpaceLimits &limits, const std::string &name)
 {
+    if (hasScalarLimits())
+        return;
     modulePrologue_ << "typedef struct "
                     << addressSpaceLimitsAsStruct(limits)
                     << " " << name << ";\n\n";
 }
 
-void WebCLTransformer::createGlobalAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits)
+void WebCLTransformer::createGlobalAddressSpaceLimitsTypedef(KernelAllocations &allocs)
 {
-    createAddressSpaceLimitsTypedef(asLimits, cfg_.globalLimitsType_);
+    createAddressSpaceLimitsTypedef(
+        allocs.getGlobalLimits(),
+        cfg_.getNameOfGroupType(cfg_.globalLimitsType_, allocs.getName()));
 }
 
-void WebCLTransformer::createConstantAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits)
+void WebCLTransformer::createConstantAddressSpaceLimitsTypedef(KernelAllocations &allocs)
 {
-    createAddressSpaceLimitsTypedef(asLimits, cfg_.constantLimitsType_);
+    createAddressSpaceLimitsTypedef(
+        allocs.getConstantLimits(),
+        cfg_.getNameOfGroupType(cfg_.constantLimitsType_, allocs.getName()));
 }
 
-void WebCLTransformer::createLocalAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits)
+void WebCLTransformer::createLocalAddressSpaceLimitsTypedef(KernelAllocations &allocs)
 {
-    createAddressSpaceLimitsTypedef(asLimits, cfg_.localLimitsType_);
+    createAddressSpaceLimitsTypedef(
+        allocs.getLocalLimits(),
+        cfg_.getNameOfGroupType(cfg_.localLimitsType_, allocs.getName()));
 }
 
 void WebCLTransformer::createAddressSpaceLimitsField(
@@ -1005,28 +1169,57 @@ void WebCLTransformer::createAddressSpaceNullField(
                     << " " << cfg_.nullType_ << " *" << name << ";\n";
 }
 
-void WebCLTransformer::createProgramAllocationsTypedef(
-    AddressSpaceLimits &globalLimits, AddressSpaceLimits &constantLimits,
-    AddressSpaceLimits &localLimits, AddressSpaceInfo &privateAs)
+void WebCLTransformer::createProgramAllocationsTypedef(KernelAllocations &allocs)
 {
+    const std::string &group = allocs.getName();
+    AddressSpaceLimits &globalLimits = allocs.getGlobalLimits();
+    AddressSpaceLimits &constantLimits = allocs.getConstantLimits();
+    AddressSpaceLimits &localLimits = allocs.getLocalLimits();
+    const bool limitFields = !hasScalarLimits();
+
+    if (!hasRecordFields(allocs))
+        return;
+
     modulePrologue_ << "typedef struct {\n";
     if (!globalLimits.empty()) {
-        createAddressSpaceLimitsField(cfg_.globalLimitsType_, cfg_.globalLimitsField_);
-        createAddressSpaceNullField(cfg_.globalNullField_, globalLimits.getAddressSpace());
+        if (limitFields)
+            createAddressSpaceLimitsField(
+                cfg_.getNameOfGroupType(cfg_.globalLimitsType_, group), cfg_.globalLimitsField_);
+        if (isClampedAddressSpace(globalLimits.getAddressSpace()))
+            createAddressSpaceNullField(cfg_.globalNullField_, globalLimits.getAddressSpace());
     }
     if (!constantLimits.empty()) {
-        createAddressSpaceLimitsField(cfg_.constantLimitsType_, cfg_.constantLimitsField_);
-        createAddressSpaceNullField(cfg_.constantNullField_, constantLimits.getAddressSpace());
+        if (limitFields)
+            createAddressSpaceLimitsField(
+                cfg_.getNameOfGroupType(cfg_.constantLimitsType_, group), cfg_.constantLimitsField_);
+        if (isClampedAddressSpace(constantLimits.getAddressSpace()))
+            createAddressSpaceNullField(cfg_.constantNullField_, constantLimits.getAddressSpace());
     }
     if (!localLimits.empty()) {
-        createAddressSpaceLimitsField(cfg_.localLimitsType_, cfg_.localLimitsField_);
-        createAddressSpaceNullField(cfg_.localNullField_, localLimits.getAddressSpace());
+        if (limitFields)
+            createAddressSpaceLimitsField(
+                cfg_.getNameOfGroupType(cfg_.localLimitsType_, group), cfg_.localLimitsField_);
+        if (isClampedAddressSpace(localLimits.getAddressSpace()))
+            createAddressSpaceNullField(cfg_.localNullField_, localLimits.getAddressSpace());
+    }
+    if (!allocs.getPrivates().empty()) {
+        modulePrologue_ << cfg_.indentation_
+                        << cfg_.getNameOfGroupType(cfg_.privateRecordType_, group)
+                        << " " << cfg_.privatesField_ << ";\n";
+        if (isClampedAddressSpace(0))
+            createAddressSpaceNullField(cfg_.privateNullField_, 0);
     }
-    if (!privateAs.empty()) {
-        modulePrologue_ << cfg_.indentation_ << cfg_.privateRecordType_<< " " << cfg_.privatesField_ << ";\n";
-        createAddressSpaceNullField(cfg_.privateNullField_, 0);
+    if (isTrapping()) {
+        modulePrologue_ << cfg_.indentation_
+                        << "__" << cfg_.globalAddressSpace_ << " uint *"
+                        << cfg_.trapStatusField_ << ";\n";
     }
-    modulePrologue_ << "} " << cfg_.addressSpaceRecordType_ << ";\n\n";
+    if (isCountingChecks()) {
+        modulePrologue_ << cfg_.indentation_
+                        << "__" << cfg_.globalAddressSpace_ << " uint *"
+                        << cfg_.checkCountersField_ << ";\n";
+    }
+    modulePrologue_ << "} " << cfg_.getNameOfGroupType(cfg_.addressSpaceRecordType_, group) << ";\n\n";
 }
 
 void WebCLTransformer::createConstantAddressSpaceAllocation(AddressSpaceInfo &as)
@@ -1041,71 +1234,120 @@ void WebCLTransformer::createConstantAddressSpaceAllocation(AddressSpaceInfo &as
 
 void WebCLTransformer::createLocalAddressSpaceAllocation(clang::FunctionDecl *kernelFunc)
 {
-    std::ostream &out = functionPrologue(kernelPrologues_, kernelFunc);
+    WebCLCodeStream out(functionPrologue(kernelPrologues_, kernelFunc));
 
     out << "\n" << cfg_.indentation_ << "__" << cfg_.localAddressSpace_ << " "
         << cfg_.localRecordType_ << " " << cfg_.localRecordName_ << ";\n";
 }
 
 void WebCLTransformer::createAddressSpaceLimitsInitializer(
-    std::ostream &out, clang::FunctionDecl *kernel, AddressSpaceLimits &limits)
+    std::vector<std::string> &initializers,
+    clang::FunctionDecl *kernel, AddressSpaceLimits &limits)
 {
-    out << cfg_.getIndentation(2) << addressSpaceLimitsInitializer(kernel, limits);
-    out << ",\n" << cfg_.getIndentation(2);
-    createAddressSpaceLimitsNullInitializer(out, limits.getAddressSpace());
+    if (!hasScalarLimits())
+        initializers.push_back(addressSpaceLimitsInitializer(kernel, limits));
+    if (isClampedAddressSpace(limits.getAddressSpace())) {
+        WebCLFragment null;
+        createAddressSpaceLimitsNullInitializer(null, limits.getAddressSpace());
+        initializers.push_back(null.str());
+    }
 }
 
-void WebCLTransformer::createProgramAllocationsAllocation(
-    clang::FunctionDecl *kernelFunc, AddressSpaceLimits &globalLimits,
-    AddressSpaceLimits &constantLimits, AddressSpaceLimits &localLimits,
-    AddressSpaceInfo &privateAs)
+void WebCLTransformer::createLimitVariables(
+    llvm::raw_ostream &out, clang::FunctionDecl *kernel, AddressSpaceLimits &limits)
 {
-    std::ostream &out = functionPrologue(kernelPrologues_, kernelFunc);
-
-    out << "\n" << cfg_.indentation_
-        << cfg_.addressSpaceRecordType_ << " " << cfg_.programRecordName_ << " = {\n";
-
-    bool hasPrev = false;
+    ParameterList variables;
+    addLimitParameters(variables, limits);
 
-    if (!globalLimits.empty()) {
-        createAddressSpaceLimitsInitializer(out, kernelFunc, globalLimits);
-        hasPrev = true;
+    std::vector<std::string> initializers;
+    if (limits.hasStaticallyAllocatedLimits()) {
+        const std::string record = "&(&" +
+            ((limits.getAddressSpace() == clang::LangAS::opencl_constant) ?
+             cfg_.constantRecordName_ : cfg_.localRecordName_) + ")";
+        initializers.push_back(record + "[0]");
+        initializers.push_back(record + "[1]");
     }
-
-    if (!constantLimits.empty()) {
-        if (hasPrev) {
-            out << ",\n";
+    for (AddressSpaceLimits::LimitList::iterator i = limits.getDynamicLimits().begin();
+         i != limits.getDynamicLimits().end(); ++i) {
+        clang::ParmVarDecl *decl = *i;
+        if (llvm::dyn_cast<clang::FunctionDecl>(decl->getParentFunctionOrMethod()) == kernel) {
+            const std::string name = decl->getName();
+            initializers.push_back("&" + name + "[0]");
+            initializers.push_back("&" + name + "[" + cfg_.getNameOfSizeParameter(name) + "]");
+        } else {
+            initializers.push_back("0");
+            initializers.push_back("0");
         }
-        createAddressSpaceLimitsInitializer(out, kernelFunc, constantLimits);
-        hasPrev = true;
     }
 
-    if (!localLimits.empty()) {
-        if (hasPrev) {
-            out << ",\n";
-        }
-        createAddressSpaceLimitsInitializer(out, kernelFunc, localLimits);
-        hasPrev = true;
+    std::vector<std::string>::iterator initializer = initializers.begin();
+    for (ParameterList::iterator i = variables.begin(); i != variables.end(); ++i, ++initializer) {
+        out << cfg_.indentation_ << i->first << i->second
+            << " = " << *initializer << ";\n";
     }
+}
 
-    if (!privateAs.empty()) {
-      if (hasPrev) {
-            out << ",\n";
-      }
+void WebCLTransformer::createProgramAllocationsAllocation(
+    clang::FunctionDecl *kernelFunc, KernelAllocations &allocs)
+{
+    const std::string recordType =
+        cfg_.getNameOfGroupType(cfg_.addressSpaceRecordType_, allocs.getName());
+    AddressSpaceLimits &globalLimits = allocs.getGlobalLimits();
+    AddressSpaceLimits &constantLimits = allocs.getConstantLimits();
+    AddressSpaceLimits &localLimits = allocs.getLocalLimits();
+
+    WebCLCodeStream out(functionPrologue(kernelPrologues_, kernelFunc));
+
+    if (hasScalarLimits()) {
+        out << "\n";
+        createLimitVariables(out, kernelFunc, globalLimits);
+        createLimitVariables(out, kernelFunc, constantLimits);
+        createLimitVariables(out, kernelFunc, localLimits);
+    }
+
+    if (!hasRecordFields(allocs))
+        return;
+
+    std::vector<std::string> initializers;
+
+    if (!globalLimits.empty())
+        createAddressSpaceLimitsInitializer(initializers, kernelFunc, globalLimits);
+
+    if (!constantLimits.empty())
+        createAddressSpaceLimitsInitializer(initializers, kernelFunc, constantLimits);
+
+    if (!localLimits.empty())
+        createAddressSpaceLimitsInitializer(initializers, kernelFunc, localLimits);
+
+    if (!allocs.getPrivates().empty()) {
       // we pretty much cannot initialize this in the start since if e.g. variables
       // are used to initialize private variables, we cannot move initialization to start of function
       // since value might be different in that phase.
-      out << cfg_.getIndentation(2) << "{ },\n";
-      out << cfg_.getIndentation(2) << "0\n";
+      initializers.push_back("{ }");
+      if (isClampedAddressSpace(0))
+          initializers.push_back("0");
     }
 
+    if (isTrapping())
+        initializers.push_back(cfg_.trapStatusParameter_);
+    if (isCountingChecks())
+        initializers.push_back(cfg_.checkCountersParameter_);
+
+    out << "\n" << cfg_.indentation_
+        << recordType << " " << cfg_.programRecordName_ << " = {\n";
+    for (std::vector<std::string>::iterator i = initializers.begin();
+         i != initializers.end(); ++i) {
+        if (i != initializers.begin())
+            out << ",\n";
+        out << cfg_.getIndentation(2) << *i;
+    }
     out << "\n" << cfg_.indentation_ << "};\n";
-    out << cfg_.indentation_ << cfg_.addressSpaceRecordType_ << " *"
+    out << cfg_.indentation_ << recordType << " *"
         << cfg_.addressSpaceRecordName_ << " = &" << cfg_.programRecordName_ << ";\n";
 }
 
 void WebCLTransformer::createAddressSpaceNullAllocation(
-    std::ostream &out, unsigned addressSpace)
+    llvm::raw_ostream &out, unsigned addressSpace)
 {
     const bool isLocal = (addressSpace == clang::LangAS::opencl_local);
 
@@ -1124,12 +1366,16 @@ void WebCLTransformer::createAddressSpaceNullAllocation(
 
 void WebCLTransformer::createConstantAddressSpaceNullAllocation()
 {
+    if (!isClampedAddressSpace(clang::LangAS::opencl_constant))
+        return;
     createAddressSpaceNullAllocation(modulePrologue_, clang::LangAS::opencl_constant);
 }
 
 void WebCLTransformer::createLocalAddressSpaceNullAllocation(clang::FunctionDecl *kernel)
 {
-    std::ostream &out = functionPrologue(kernelPrologues_, kernel);
+    if (!isClampedAddressSpace(clang::LangAS::opencl_local))
+        return;
+    WebCLCodeStream out(functionPrologue(kernelPrologues_, kernel));
     createAddressSpaceNullAllocation(out, clang::LangAS::opencl_local);
 }
 
@@ -1138,8 +1384,10 @@ void WebCLTransformer::initializeAddressSpaceNull(clang::FunctionDecl *kernel,
 {
   // init null only if there is limits.
   if (limits.empty()) return;
+  if (!isClampedAddressSpace(limits.getAddressSpace())) return;
   
-  std::ostream &out = functionPrologue(kernelPrologues_, kernel);
+  WebCLCodeStream out(functionPrologue(kernelPrologues_, kernel));
+  useGeneralCode("set-null");
   
   std::string nullType =  "__" + cfg_.getNameOfAddressSpace(limits.getAddressSpace()) + " " + cfg_.nullType_ + "*";
 
@@ -1149,13 +1397,13 @@ void WebCLTransformer::initializeAddressSpaceNull(clang::FunctionDecl *kernel,
   int endParenthesis = 0;
   
   if (limits.hasStaticallyAllocatedLimits()) {
-      out << "_WCL_SET_NULL(" << nullType << ", " << cfg_.getNameOfSizeMacro(limits.getAddressSpace()) << ", " << cfg_.getStaticLimitRef(limits.getAddressSpace()) << ", ";
+      out << "_WCL_SET_NULL(" << nullType << ", " << cfg_.getNameOfSizeMacro(limits.getAddressSpace()) << ", " << getStaticLimitRef(limits.getAddressSpace()) << ", ";
       endParenthesis++;
   }
   
   for(AddressSpaceLimits::LimitList::iterator i = limits.getDynamicLimits().begin();
       i != limits.getDynamicLimits().end(); i++) {
-      out << "_WCL_SET_NULL(" << nullType << ", " << cfg_.getNameOfSizeMacro(limits.getAddressSpace()) << "," << cfg_.getDynamicLimitRef(*i) << ", ";
+      out << "_WCL_SET_NULL(" << nullType << ", " << cfg_.getNameOfSizeMacro(limits.getAddressSpace()) << "," << getDynamicLimitRef(*i) << ", ";
     endParenthesis++;
   }
   
@@ -1171,34 +1419,49 @@ void WebCLTransformer::initializeAddressSpaceNull(clang::FunctionDecl *kernel,
 }
 
 void WebCLTransformer::createLocalRangeZeroing(
-    std::ostream &out, const std::string &arguments)
+    llvm::raw_ostream &out, const std::string &arguments)
 {
+    useGeneralCode("local-range-init");
     out << cfg_.indentation_
         << cfg_.localRangeZeroingMacro_ << "(" << arguments << ");\n";
 }
 
+void WebCLTransformer::createLocalItemRangeZeroing(
+    llvm::raw_ostream &out, const clang::ParmVarDecl *decl)
+{
+    useGeneralCode("local-item-range-init");
+    out << cfg_.indentation_
+        << cfg_.localItemRangeZeroingMacro_ << "(" << getDynamicLimitRef(decl) << ", "
+        << cfg_.getNameOfType(decl->getType()->getPointeeType()) << ");\n";
+}
+
 void WebCLTransformer::createLocalAreaZeroing(
-    clang::FunctionDecl *kernelFunc, AddressSpaceLimits &localLimits)
+    clang::FunctionDecl *kernelFunc, AddressSpaceLimits &localLimits,
+    const std::set<const clang::ParmVarDecl*> &itemInitialized)
 {
     if (localLimits.empty())
         return;
 
-    std::ostream &out = functionPrologue(kernelPrologues_, kernelFunc);
+    WebCLCodeStream out(functionPrologue(kernelPrologues_, kernelFunc));
 
     out << "\n" << cfg_.indentation_ << "// => Local memory zeroing.\n";
 
     if (localLimits.hasStaticallyAllocatedLimits()) {
-        createLocalRangeZeroing(out, cfg_.getStaticLimitRef(clang::LangAS::opencl_local));
+        createLocalRangeZeroing(out, getStaticLimitRef(clang::LangAS::opencl_local));
     }
 
     AddressSpaceLimits::LimitList &dynamicLimits = localLimits.getDynamicLimits();
     for (AddressSpaceLimits::LimitList::iterator i = dynamicLimits.begin();
          i != dynamicLimits.end(); ++i) {
         const clang::ParmVarDecl *decl = *i;
-        createLocalRangeZeroing(out, cfg_.getDynamicLimitRef(decl));
+        if (itemInitialized.count(decl))
+            createLocalItemRangeZeroing(out, decl);
+        else
+            createLocalRangeZeroing(out, getDynamicLimitRef(decl));
     }
 
-    createLocalRangeZeroing(out, cfg_.getNullLimitRef(clang::LangAS::opencl_local));
+    if (isClampedAddressSpace(clang::LangAS::opencl_local))
+        createLocalRangeZeroing(out, cfg_.getNullLimitRef(clang::LangAS::opencl_local));
 
     out << cfg_.indentation_ << "barrier(CLK_LOCAL_MEM_FENCE);\n";
     out << cfg_.indentation_ << "// <= Local memory zeroing.\n";
@@ -1217,45 +1480,61 @@ void WebCLTransformer::removeRelocated(clang::VarDecl *decl)
   wclRewriter_.removeText(decl->getSourceRange());
 }
 
-std::string WebCLTransformer::getCheckFunctionCall(CheckKind kind, std::string addr, std::string type, unsigned size, AddressSpaceLimits &limits)
+std::string WebCLTransformer::getCheckFunctionCall(
+    CheckKind kind, const std::string &addr, const std::string &type, unsigned size,
+    AddressSpaceLimits &limits, const clang::Expr *access)
 {
-  std::stringstream retVal;
+  WebCLFragment retVal;
+  emitCheckFunctionCall(retVal, kind, addr, type, size, limits, access);
+  return retVal.str();
+}
 
+void WebCLTransformer::emitCheckFunctionCall(
+    llvm::raw_ostream &retVal,
+    CheckKind kind, llvm::StringRef addr, const std::string &type, unsigned size,
+    AddressSpaceLimits &limits, const clang::Expr *access)
+{
   const unsigned limitCount = limits.count();
   const unsigned addressSpace = limits.getAddressSpace();
 
-  std::string name;
-  switch (kind) {
-  case CHECK_CLAMP:
-      name = cfg_.getNameOfLimitClampFunction(addressSpace, limitCount, type);
-      break;
-  case CHECK_CHECK:
-      name = cfg_.getNameOfLimitCheckFunction(addressSpace, limitCount, type);
-      break;
-  default:
-      assert(0);
+  assert(((kind == CHECK_CLAMP) || (kind == CHECK_CHECK)) && "Unknown check kind.");
+  const std::string &name = (kind == CHECK_CLAMP) ?
+      cfg_.getNameOfLimitClampFunction(addressSpace, limitCount, type) :
+      cfg_.getNameOfLimitCheckFunction(addressSpace, limitCount, type);
+
+  // copies of helper functions check the same accesses again
+  if (access)
+      accessChecks_.insert(std::make_pair(access, AccessCheck(addressSpace, limitCount)));
+
+  if (access && isCountingChecks()) {
+      retVal << cfg_.getNameOfCountedFunction(name) << "("
+             << addCheckSite(access) << ", ";
+  } else {
+      retVal << name << "(";
   }
+  retVal << addr << ", " << size;
 
-  retVal << name << "(" << addr << ", " << size;
+  // every limit is cast to the same type
+  const std::string cast = "(" + type + ")";
 
   if (limits.hasStaticallyAllocatedLimits()) {
-      retVal << ", " << cfg_.getStaticLimitRef(addressSpace, "(" + type + ")");
+      retVal << ", " << getStaticLimitRef(addressSpace, cast);
   }
 
   for (AddressSpaceLimits::LimitList::iterator i = limits.getDynamicLimits().begin();
        i != limits.getDynamicLimits().end(); i++) {
-      retVal << ", " << cfg_.getDynamicLimitRef(*i, "(" + type + ")");
+      retVal << ", " << getDynamicLimitRef(*i, cast);
   }
 
   if (kind == CHECK_CLAMP) {
-      retVal << ", (" << type << ")" << cfg_.getNameOfAddressSpaceNullPtrRef(addressSpace);
+      assert(isClampedAddressSpace(addressSpace) && "Address space doesn't have a null area.");
+      retVal << ", " << cast << cfg_.getNameOfAddressSpaceNullPtrRef(addressSpace);
   }
   retVal << ")";
 
   // add function implementations afterwards
   usedClampFunctions_.insert(ClampFunctionKey(limits.getAddressSpace(), limitCount, type));
-  
-  return retVal.str();
+  useGeneralCode("last");
 }
 
 namespace {
@@ -1289,64 +1568,429 @@ namespace {
     };
 }
 
-std::string WebCLTransformer::getClampFunctionExpression(clang::Expr *access, unsigned size, AddressSpaceLimits &limits)
+void WebCLTransformer::emitAccessAddress(llvm::raw_ostream &out, clang::Expr *access)
 {
     BaseIndexField     bif(access);
     clang::SourceRange baseRange = clang::SourceRange(bif.base->getLocStart(), bif.base->getLocEnd());
-    const std::string  original  = wclRewriter_.getOriginalText(access->getSourceRange());
-    const std::string  baseStr   = wclRewriter_.getTransformedText(baseRange);
-    std::stringstream  memAddress;
 
-    memAddress << "(" << baseStr << ")";
-    std::string indexStr;
+    out << "(" << wclRewriter_.getTransformedText(baseRange) << ")";
     if (bif.index) {
-	indexStr = wclRewriter_.getTransformedText(bif.index->getSourceRange());
-	memAddress << "+(" << indexStr << ")";
+	out << "+(" << wclRewriter_.getTransformedText(bif.index->getSourceRange()) << ")";
     }
-  
-    // trust limits given in parameter or check against all limits
-    std::string macro = getCheckFunctionCall(CHECK_CLAMP, memAddress.str(), bif.base->getType().getAsString(), size, limits);
+}
 
-    std::stringstream retVal;
-    retVal << "(*(" << macro  << "))";
+void WebCLTransformer::emitClampFunctionExpression(
+    llvm::raw_ostream &out,
+    clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+    const std::string &pointer)
+{
+    BaseIndexField bif(access);
+
+    WebCLFragment address;
+    emitAccessAddress(address, access);
+
+    out << "(*(";
+    if (!pointer.empty())
+        out << pointer << " = ";
+    // trust limits given in parameter or check against all limits
+    emitCheckFunctionCall(out, CHECK_CLAMP, address.str(), bif.base->getType().getAsString(), size, limits, access);
+    out << "))";
     if (!bif.field.empty()) {
-	retVal << "." << bif.field;
+	out << "." << bif.field;
     }
-	
-    return retVal.str();
 }
 
 void WebCLTransformer::addMemoryAccessCheck(clang::Expr *access, unsigned size, AddressSpaceLimits &limits)
 {
-  std::string retVal = getClampFunctionExpression(access, size, limits);
+  WebCLFragment retVal;
+  emitClampFunctionExpression(retVal, access, size, limits, "");
   
   DEBUG(
     std::cerr << "Creating memcheck for: " << original
               << "\n                 base: " << baseStr
               << "\n                index: " << indexStr
-              << "\n          replacement: " << retVal
+              << "\n          replacement: " << retVal.str().str()
               << "\n----------------------------\n";
     access->dump();
     std::cerr << "============================\n\n"; );
   
-  wclRewriter_.replaceText(access->getSourceRange(), retVal);
+  wclRewriter_.replaceText(access->getSourceRange(), retVal.str());
   DEBUG( std::cerr << "============================\n\n"; );
 }
 
+void WebCLTransformer::addPointerDeclaration(
+    const clang::FunctionDecl *func, clang::Expr *access, const std::string &name)
+{
+    BaseIndexField bif(access);
+
+    WebCLCodeStream out(functionPrologue(functionPrologues_, func));
+    out << "\n" << bif.base->getType().getAsString() << " " << name << ";\n";
+}
+
+std::string WebCLTransformer::addCheckedPointer(
+    const clang::FunctionDecl *func, clang::Expr *access, unsigned index)
+{
+    const std::string name = cfg_.getNameOfCheckedPointer(index);
+    addPointerDeclaration(func, access, name);
+    return name;
+}
+
+std::string WebCLTransformer::addGuardedPointer(
+    const clang::FunctionDecl *func, clang::Expr *access, unsigned index)
+{
+    const std::string name = cfg_.getNameOfGuardedPointer(index);
+    addPointerDeclaration(func, access, name);
+    return name;
+}
+
+void WebCLTransformer::addStoredMemoryAccessCheck(
+    clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+    const std::string &pointer)
+{
+    WebCLFragment retVal;
+    emitClampFunctionExpression(retVal, access, size, limits, pointer);
+    wclRewriter_.replaceText(access->getSourceRange(), retVal.str());
+}
+
+void WebCLTransformer::addReusedMemoryAccessCheck(
+    clang::Expr *access, const std::string &pointer)
+{
+    BaseIndexField bif(access);
+
+    WebCLFragment retVal;
+    retVal << "(*" << pointer << ")";
+    if (!bif.field.empty())
+        retVal << "." << bif.field;
+
+    wclRewriter_.replaceText(access->getSourceRange(), retVal.str());
+}
+
+void WebCLTransformer::addGuardedLoadCheck(
+    clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+    const std::string &pointer)
+{
+    BaseIndexField bif(access);
+    const std::string type = bif.base->getType().getAsString();
+    const std::string &zeroValue =
+        WebCLTypes::classifyType(instance_, access->getType()).zeroValue;
+    assert(!zeroValue.empty() &&
+           "Guarded load of a value without zero initializer.");
+
+    WebCLFragment address;
+    address << "(" << pointer << " = ";
+    emitAccessAddress(address, access);
+    address << ")";
+
+    WebCLFragment retVal;
+    retVal << "(";
+    emitCheckFunctionCall(retVal, CHECK_CHECK, address.str(), type, size, limits, access);
+    retVal << " ? (*" << pointer << ")";
+    if (!bif.field.empty())
+        retVal << "." << bif.field;
+    retVal << " : ";
+    if (isTrapping())
+        retVal << "(*" << cfg_.getTrapStatusRef() << " = 1, " << zeroValue << ")";
+    else
+        retVal << zeroValue;
+    retVal << ")";
+
+    wclRewriter_.replaceText(access->getSourceRange(), retVal.str());
+}
+
+void WebCLTransformer::addGuardedStoreCheck(
+    clang::Expr *access, clang::Expr *store, unsigned size,
+    AddressSpaceLimits &limits, const std::string &pointer,
+    bool canReturn)
+{
+    BaseIndexField bif(access);
+    const std::string type = bif.base->getType().getAsString();
+
+    WebCLFragment address;
+    address << "(" << pointer << " = ";
+    emitAccessAddress(address, access);
+    address << ")";
+
+    WebCLFragment guarded;
+    guarded << "if (";
+    emitCheckFunctionCall(guarded, CHECK_CHECK, address.str(), type, size, limits, access);
+    guarded << ") (*" << pointer << ")";
+    if (!bif.field.empty())
+        guarded << "." << bif.field;
+
+    WebCLFragment otherwise;
+    if (isTrapping()) {
+        otherwise << "else ";
+        if (canReturn)
+            otherwise << "{ *" << cfg_.getTrapStatusRef() << " = 1; return; } ";
+        else
+            otherwise << "*" << cfg_.getTrapStatusRef() << " = 1; ";
+    }
+    otherwise << "}";
+
+    const clang::SourceLocation semi = wclRewriter_.findLocForNext(store->getLocEnd(), ';');
+
+    // a[i]++ has no value to evaluate
+    clang::BinaryOperator *assignment = llvm::dyn_cast<clang::BinaryOperator>(store);
+    if (!assignment) {
+        WebCLFragment begin;
+        begin << "{ " << guarded.str();
+        wclRewriter_.replaceText(access->getSourceRange(), begin.str());
+
+        WebCLFragment end;
+        end << "; " << otherwise.str();
+        wclRewriter_.replaceText(clang::SourceRange(semi, semi), end.str());
+        return;
+    }
+
+    // The value is left in place between the replaced access and
+    // semicolon. Compound assignments become plain initializations.
+    const std::string value = cfg_.getNameOfGuardedValue();
+    WebCLFragment begin;
+    begin << "{ " << assignment->getRHS()->getType().getUnqualifiedType().getAsString()
+          << " " << value;
+    wclRewriter_.replaceText(access->getSourceRange(), begin.str());
+    if (assignment->getOpcode() != clang::BO_Assign) {
+        const clang::SourceLocation op = assignment->getOperatorLoc();
+        wclRewriter_.replaceText(clang::SourceRange(op, op), "=");
+    }
+
+    WebCLFragment end;
+    end << "; " << guarded.str()
+        << " " << clang::BinaryOperator::getOpcodeStr(assignment->getOpcode()).str()
+        << " " << value << "; " << otherwise.str();
+    wclRewriter_.replaceText(clang::SourceRange(semi, semi), end.str());
+}
+
+void WebCLTransformer::addClampedAddressSpace(unsigned addressSpace)
+{
+    clampedAddressSpaces_.insert(addressSpace);
+}
+
+bool WebCLTransformer::isClampedAddressSpace(unsigned addressSpace) const
+{
+    return clampedAddressSpaces_.count(addressSpace);
+}
+
+bool WebCLTransformer::isTrapping() const
+{
+    return options_.violationMode == WebCLOptions::VIOLATION_MODE_TRAP;
+}
+
+bool WebCLTransformer::isCountingChecks() const
+{
+    return options_.countChecks;
+}
+
+std::string WebCLTransformer::addCheckSite(const clang::Expr *access)
+{
+    clang::SourceManager &sm = instance_.getSourceManager();
+    const clang::PresumedLoc loc =
+        sm.getPresumedLoc(sm.getExpansionLoc(access->getLocStart()));
+    checkSites_.push_back(CheckSite(loc.getLine(), loc.getColumn()));
+    return cfg_.getCheckCountersRef(checkSites_.size() - 1);
+}
+
+const CheckSiteList &WebCLTransformer::getCheckSites() const
+{
+    return checkSites_;
+}
+
+const WebCLTransformer::AccessCheckMap &WebCLTransformer::getAccessChecks() const
+{
+    return accessChecks_;
+}
+
+const WebCLTransformer::WrappedCallMap &WebCLTransformer::getWrappedCalls() const
+{
+    return wrappedCalls_;
+}
+
+unsigned WebCLTransformer::getNullAreaSize(unsigned addressSpace) const
+{
+    if (!isClampedAddressSpace(addressSpace))
+        return 0;
+    std::map<unsigned, unsigned>::const_iterator i = nullAreaSizes_.find(addressSpace);
+    return (i != nullAreaSizes_.end()) ? i->second : 0;
+}
+
+unsigned WebCLTransformer::getVariablesSize(AddressSpaceInfo &variables)
+{
+    clang::ASTContext &context = instance_.getASTContext();
+    unsigned size = 0;
+    for (AddressSpaceInfo::iterator i = variables.begin(); i != variables.end(); ++i)
+        size += context.getTypeSizeInChars((*i)->getType()).getQuantity();
+    return size;
+}
+
+unsigned WebCLTransformer::getProgramAllocationsSize(KernelAllocations &allocs)
+{
+    if (!hasRecordFields(allocs))
+        return 0;
+
+    // each limit field has a minimum and a maximum pointer
+    unsigned pointers = 0;
+    AddressSpaceLimits *limits[] = {
+        &allocs.getGlobalLimits(), &allocs.getConstantLimits(), &allocs.getLocalLimits()
+    };
+    for (unsigned i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+        if (limits[i]->empty())
+            continue;
+        if (!hasScalarLimits())
+            pointers += 2 * limits[i]->count();
+        if (isClampedAddressSpace(limits[i]->getAddressSpace()))
+            ++pointers;
+    }
+    if (!allocs.getPrivates().empty() && isClampedAddressSpace(0))
+        ++pointers;
+    if (isTrapping())
+        ++pointers;
+    if (isCountingChecks())
+        ++pointers;
+
+    clang::ASTContext &context = instance_.getASTContext();
+    const unsigned pointerSize = context.getTypeSizeInChars(context.VoidPtrTy).getQuantity();
+    return pointers * pointerSize + getVariablesSize(allocs.getPrivates());
+}
+
+unsigned WebCLTransformer::getAddedParameterCount(const clang::FunctionDecl *kernel) const
+{
+    std::map<const clang::FunctionDecl*, unsigned>::const_iterator i =
+        addedParameters_.find(kernel->getCanonicalDecl());
+    return (i != addedParameters_.end()) ? i->second : 0;
+}
+
+bool WebCLTransformer::hasScalarLimits() const
+{
+    return options_.limitMode == WebCLOptions::LIMIT_MODE_SCALAR;
+}
+
+const std::string &WebCLTransformer::getStaticLimitRef(unsigned addressSpace, const std::string &cast)
+{
+    if (hasScalarLimits())
+        return cfg_.getStaticLimitVariables(addressSpace, cast);
+    return cfg_.getStaticLimitRef(addressSpace, cast);
+}
+
+const std::string &WebCLTransformer::getDynamicLimitRef(const clang::VarDecl *decl, const std::string &cast)
+{
+    if (hasScalarLimits())
+        return cfg_.getDynamicLimitVariables(decl, cast);
+    return cfg_.getDynamicLimitRef(decl, cast);
+}
+
+bool WebCLTransformer::hasRecordFields(KernelAllocations &allocs)
+{
+    if (!hasScalarLimits())
+        return allocs.hasAllocations();
+
+    // only null pointers of limited address spaces remain
+    return !allocs.getPrivates().empty() || isTrapping() || isCountingChecks() ||
+        (!allocs.getGlobalLimits().empty() && isClampedAddressSpace(clang::LangAS::opencl_global)) ||
+        (!allocs.getConstantLimits().empty() && isClampedAddressSpace(clang::LangAS::opencl_constant)) ||
+        (!allocs.getLocalLimits().empty() && isClampedAddressSpace(clang::LangAS::opencl_local));
+}
+
+void WebCLTransformer::addLimitParameters(ParameterList &parameters, AddressSpaceLimits &limits)
+{
+    if (limits.hasStaticallyAllocatedLimits()) {
+        switch (limits.getAddressSpace()) {
+        case clang::LangAS::opencl_constant: {
+            const std::string type =
+                "__" + cfg_.constantAddressSpace_ + " " + cfg_.constantRecordType_ + " *";
+            parameters.push_back(std::make_pair(type, cfg_.constantMinField_));
+            parameters.push_back(std::make_pair(type, cfg_.constantMaxField_));
+            break;
+        }
+        case clang::LangAS::opencl_local: {
+            const std::string type =
+                "__" + cfg_.localAddressSpace_ + " " + cfg_.localRecordType_ + " *";
+            parameters.push_back(std::make_pair(type, cfg_.localMinField_));
+            parameters.push_back(std::make_pair(type, cfg_.localMaxField_));
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    for (AddressSpaceLimits::LimitList::iterator i = limits.getDynamicLimits().begin();
+         i != limits.getDynamicLimits().end(); ++i) {
+        const std::string type = (*i)->getType().getUnqualifiedType().getAsString();
+        parameters.push_back(std::make_pair(type, cfg_.getNameOfLimitVariable(*i, false)));
+        parameters.push_back(std::make_pair(type, cfg_.getNameOfLimitVariable(*i, true)));
+    }
+}
+
+WebCLTransformer::ParameterList WebCLTransformer::getRecordParameters(
+    KernelAllocations &allocs, const std::set<unsigned> &limitSpaces)
+{
+    ParameterList parameters;
+    if (hasRecordFields(allocs)) {
+        parameters.push_back(std::make_pair(
+            cfg_.getNameOfGroupType(cfg_.addressSpaceRecordType_, allocs.getName()) + " *",
+            cfg_.addressSpaceRecordName_));
+    }
+
+    if (hasScalarLimits()) {
+        for (std::set<unsigned>::const_iterator i = limitSpaces.begin();
+             i != limitSpaces.end(); ++i) {
+            // private limits are taken from the allocation structure
+            if (*i != 0)
+                addLimitParameters(parameters, allocs.getLimits(*i));
+        }
+    }
+    return parameters;
+}
+
+void WebCLTransformer::addIndexedAccessCheck(
+    clang::ArraySubscriptExpr *access, clang::ParmVarDecl *parm)
+{
+    clang::Expr *base = access->getBase();
+    clang::Expr *index = access->getIdx();
+    const unsigned addressSpace = WebCLTypes::getAddressSpace(access);
+    const std::string type = base->getType().getAsString();
+
+    const std::string baseStr = wclRewriter_.getTransformedText(base->getSourceRange());
+    const std::string indexStr = wclRewriter_.getTransformedText(index->getSourceRange());
+    assert(isClampedAddressSpace(addressSpace) && "Address space doesn't have a null area.");
+
+    const std::string &name = cfg_.getNameOfIndexClampFunction(addressSpace, type);
+    accessChecks_.insert(std::make_pair(access, AccessCheck(addressSpace, 1)));
+
+    WebCLFragment retVal;
+    retVal << "(*(";
+    if (isCountingChecks())
+        retVal << cfg_.getNameOfCountedFunction(name) << "(" << addCheckSite(access) << ", ";
+    else
+        retVal << name << "(";
+    retVal << "(" << baseStr << "), (" << indexStr << "), "
+           << cfg_.getNameOfSizeParameter(parm->getName())
+           << ", (" << type << ")" << cfg_.getNameOfAddressSpaceNullPtrRef(addressSpace)
+           << ")))";
+
+    // add function implementations afterwards
+    usedIndexClampFunctions_.insert(std::make_pair(addressSpace, type));
+
+    wclRewriter_.replaceText(access->getSourceRange(), retVal.str());
+}
+
 void WebCLTransformer::addRelocationInitializerFromFunctionArg(clang::ParmVarDecl *parmDecl)
 {
   const clang::FunctionDecl *parent = llvm::dyn_cast<const clang::FunctionDecl>(parmDecl->getParentFunctionOrMethod());
   // add only once
   if (parameterRelocationInitializations_.count(parmDecl) == 0) {
-      std::ostream &out = functionPrologue(functionPrologues_, parent);
+      WebCLCodeStream out(functionPrologue(functionPrologues_, parent));
       out << "\n" << cfg_.getReferenceToRelocatedVariable(parmDecl) << " = "
           << parmDecl->getNameAsString() << ";\n";
     parameterRelocationInitializations_.insert(parmDecl);
   }
 }
 
-void WebCLTransformer::addRelocationInitializer(clang::VarDecl *decl)
+void WebCLTransformer::addRelocationInitializer(clang::VarDecl *decl, clang::DeclStmt *stmt)
 {
+  if (stmt && replaceWithRelocatedArrayInitializer(decl, stmt))
+    return;
+
   clang::SourceLocation addLoc = wclRewriter_.findLocForNext(decl->getLocEnd(), ';');
   clang::SourceRange replaceRange(addLoc, addLoc);
   std::stringstream inits;
@@ -1354,6 +1998,7 @@ void WebCLTransformer::addRelocationInitializer(clang::VarDecl *decl)
 
   // we have to assign arrays with memcpy
   if (decl->getType().getTypePtr()->isArrayType()) {
+    useGeneralCode("memcpy");
     inits << "_WCL_MEMCPY(" << cfg_.getReferenceToRelocatedVariable(decl) << "," << decl->getNameAsString() << ");";
   } else {
     inits << cfg_.getReferenceToRelocatedVariable(decl) << " = " << decl->getNameAsString() << ";";
@@ -1362,6 +2007,87 @@ void WebCLTransformer::addRelocationInitializer(clang::VarDecl *decl)
 
 }
 
+bool WebCLTransformer::replaceWithRelocatedArrayInitializer(
+    clang::VarDecl *decl, clang::DeclStmt *stmt)
+{
+    clang::ASTContext &context = instance_.getASTContext();
+
+    const clang::ConstantArrayType *arrayType =
+        context.getAsConstantArrayType(decl->getType());
+    if (!arrayType)
+        return false;
+    const clang::Type *elementType =
+        arrayType->getElementType().getCanonicalType().getTypePtr();
+    if (!elementType->isScalarType() && !elementType->isVectorType())
+        return false;
+
+    clang::InitListExpr *init =
+        llvm::dyn_cast_or_null<clang::InitListExpr>(decl->getInit());
+    if (!init)
+        return false;
+    if (clang::InitListExpr *syntactic = init->getSyntacticForm())
+        init = syntactic;
+
+    const unsigned numInits = init->getNumInits();
+    const uint64_t numElements = arrayType->getSize().getZExtValue();
+    if ((numInits == 0) || (numInits > numElements))
+        return false;
+
+    // Only flat lists that give elements one by one are supported,
+    // e.g. brace elision or designators would require mapping the
+    // expressions to elements.
+    if (stmt->getLocStart().isMacroID() ||
+        init->getLBraceLoc().isMacroID() || init->getRBraceLoc().isMacroID())
+        return false;
+    for (unsigned i = 0; i < numInits; ++i) {
+        const clang::Expr *element = init->getInit(i);
+        if (llvm::isa<clang::InitListExpr>(element) ||
+            llvm::isa<clang::DesignatedInitExpr>(element) ||
+            element->getLocStart().isMacroID() || element->getLocEnd().isMacroID())
+            return false;
+        if (!context.hasSameUnqualifiedType(element->getType(), arrayType->getElementType()))
+            return false;
+    }
+
+    const std::string relocated = cfg_.getReferenceToRelocatedVariable(decl);
+
+    // "int foo[3] = {" -> "ref[0] ="
+    std::stringstream first;
+    first << relocated << "[0] =";
+    wclRewriter_.replaceText(
+        clang::SourceRange(stmt->getLocStart(), init->getLBraceLoc()), first.str());
+
+    // "," -> "; ref[i] ="
+    for (unsigned i = 1; i < numInits; ++i) {
+        clang::SourceLocation comma =
+            wclRewriter_.findLocForNext(init->getInit(i - 1)->getLocEnd(), ',');
+        std::stringstream next;
+        next << "; " << relocated << "[" << i << "] =";
+        wclRewriter_.replaceText(clang::SourceRange(comma, comma), next.str());
+    }
+
+    // "};" -> "; _WCL_FILL_ZERO(ref, n);", possible trailing comma
+    // is dropped too
+    clang::SourceManager &manager = instance_.getSourceManager();
+    clang::SourceLocation last = init->getRBraceLoc();
+    clang::SourceLocation comma =
+        wclRewriter_.findLocForNext(init->getInit(numInits - 1)->getLocEnd(), ',');
+    if (manager.isBeforeInTranslationUnit(comma, last))
+        last = comma;
+    clang::SourceLocation semicolon = wclRewriter_.findLocForNext(init->getRBraceLoc(), ';');
+    std::stringstream rest;
+    rest << ";";
+    // Elements without initializer must be zeroed every time the
+    // declaration is executed.
+    if (numInits < numElements) {
+        useGeneralCode("fill-zero");
+        rest << " _WCL_FILL_ZERO(" << relocated << ", " << numInits << ");";
+    }
+    wclRewriter_.replaceText(clang::SourceRange(last, semicolon), rest.str());
+
+    return true;
+}
+
 void WebCLTransformer::moveToModulePrologue(clang::NamedDecl *decl)
 {
     // set typeName if we should make sure that this declaration name is not used multiple times
@@ -1404,6 +2130,11 @@ void WebCLTransformer::flushQueuedTransformations()
 void WebCLTransformer::addMinimumRequiredContinuousAreaLimit(unsigned addressSpace,
                                                              unsigned minWidthInBits)
 {
+    // the null area has a 4 byte uint element for each byte of the
+    // largest access
+    const unsigned bytes = (minWidthInBits + 7) / 8;
+    nullAreaSizes_[addressSpace] = bytes * 4;
+
     preModulePrologue_ << "#define " << cfg_.getNameOfSizeMacro(addressSpace) << " ("
                        << "((" << minWidthInBits << " + (CHAR_BIT - 1)) / CHAR_BIT)"
                        << ")\n";
@@ -1420,9 +2151,20 @@ void WebCLTransformer::addMinimumRequiredContinuousAreaLimit(unsigned addressSpa
                        << "(" << minAlignment << "/CHAR_BIT)\n";
 }
 
-void WebCLTransformer::addRecordParameter(clang::FunctionDecl *decl)
+void WebCLTransformer::addRecordParameter(
+    clang::FunctionDecl *decl, KernelAllocations &allocs,
+    const std::set<unsigned> &limitSpaces)
 {
-    std::string parameter = cfg_.addressSpaceRecordType_ + " *" + cfg_.addressSpaceRecordName_;
+    const ParameterList parameters = getRecordParameters(allocs, limitSpaces);
+    if (parameters.empty())
+        return;
+
+    std::string parameter;
+    for (ParameterList::const_iterator i = parameters.begin(); i != parameters.end(); ++i) {
+        if (i != parameters.begin())
+            parameter += ", ";
+        parameter += i->first + i->second;
+    }
 
     if (decl->getNumParams() > 0) {
       clang::SourceLocation addLoc = wclRewriter_.findLocForNext(decl->getLocStart(), '(');
@@ -1437,10 +2179,50 @@ void WebCLTransformer::addRecordParameter(clang::FunctionDecl *decl)
     }
 }
 
-void WebCLTransformer::addRecordArgument(clang::CallExpr *call)
+void WebCLTransformer::addTrailingParameters(clang::FunctionDecl *kernel)
+{
+    const std::string type = "__" + cfg_.globalAddressSpace_ + " uint *";
+    std::string parameter;
+    unsigned &added = addedParameters_[kernel->getCanonicalDecl()];
+    if (isTrapping()) {
+        parameter = type + cfg_.trapStatusParameter_;
+        ++added;
+    }
+    if (isCountingChecks()) {
+        if (!parameter.empty())
+            parameter += ", ";
+        parameter += type + cfg_.checkCountersParameter_;
+        ++added;
+    }
+    if (parameter.empty())
+        return;
+
+    clang::TypeLoc typeLoc = kernel->getTypeSourceInfo()->getTypeLoc();
+    clang::FunctionTypeLoc funTypeLoc = typeLoc.castAs<clang::FunctionTypeLoc>();
+    if (kernel->getNumParams() > 0) {
+        clang::SourceRange addRange(funTypeLoc.getRParenLoc(), funTypeLoc.getRParenLoc());
+        wclRewriter_.replaceText(addRange, ", " + parameter + ")");
+    } else {
+        clang::SourceRange addRange(funTypeLoc.getLParenLoc(), funTypeLoc.getRParenLoc());
+        wclRewriter_.replaceText(addRange, "(" + parameter + ")");
+    }
+}
+
+void WebCLTransformer::addRecordArgument(
+    clang::CallExpr *call, KernelAllocations &allocs,
+    const std::set<unsigned> &limitSpaces)
 {
+  const ParameterList parameters = getRecordParameters(allocs, limitSpaces);
+  if (parameters.empty())
+    return;
+
   clang::SourceLocation addLoc = wclRewriter_.findLocForNext(call->getLocStart(), '(');
-  std::string allocsArg = cfg_.addressSpaceRecordName_;
+  std::string allocsArg;
+  for (ParameterList::const_iterator i = parameters.begin(); i != parameters.end(); ++i) {
+    if (i != parameters.begin())
+      allocsArg += ", ";
+    allocsArg += i->second;
+  }
   if (call->getNumArgs() > 0) {
     allocsArg += ", ";
   }
@@ -1458,6 +2240,11 @@ void WebCLTransformer::addSizeParameter(clang::ParmVarDecl *decl)
     wclRewriter_.replaceText(
         decl->getSourceRange(),
         replacement);
+
+    const clang::FunctionDecl *kernel =
+        llvm::dyn_cast<const clang::FunctionDecl>(decl->getParentFunctionOrMethod());
+    if (kernel)
+        ++addedParameters_[kernel->getCanonicalDecl()];
 }
 
 bool WebCLTransformer::rewritePrologue()
@@ -1483,16 +2270,16 @@ bool WebCLTransformer::rewriteKernelPrologue(const clang::FunctionDecl *kernel)
     }
     clang::SourceRange range(body->getLocStart(), body->getLocStart());
     std::string origStr = wclRewriter_.getTransformedText(range) + "\n";
-    wclRewriter_.replaceText(range, origStr + functionPrologue(kernelPrologues_, kernel).str());
+    wclRewriter_.replaceText(range, origStr + functionPrologue(kernelPrologues_, kernel));
     return true;
 }
 
-void WebCLTransformer::emitVarDeclToStruct(std::ostream &out, const clang::VarDecl *decl)
+void WebCLTransformer::emitVarDeclToStruct(llvm::raw_ostream &out, const clang::VarDecl *decl)
 {
     emitVarDeclToStruct(out, decl, cfg_.getNameOfRelocatedVariable(decl));
 }
 
-void WebCLTransformer::emitVarDeclToStruct(std::ostream &out, const clang::VarDecl *decl,
+void WebCLTransformer::emitVarDeclToStruct(llvm::raw_ostream &out, const clang::VarDecl *decl,
                                     const std::string &name)
 {
     clang::QualType type = decl->getType();
@@ -1501,8 +2288,6 @@ void WebCLTransformer::emitVarDeclToStruct(std::ostream &out, const clang::VarDe
   
     const clang::Type *typePtr = type.getTypePtrOrNull();
  
-    std::string variable;
-    llvm::raw_string_ostream stream(variable);
     clang::PrintingPolicy policy(instance_.getLangOpts());
   
     // dropping qualifiers from array type is pretty hard... there must be better way to do this
@@ -1514,17 +2299,92 @@ void WebCLTransformer::emitVarDeclToStruct(std::ostream &out, const clang::VarDe
       out << constArr->getElementType().getAsString() << " " << name << "[" << constArr->getSize().getZExtValue() << "]";
 
     } else {
-      clang::QualType::print(typePtr, qualifiers, stream, policy, name);
-      out << stream.str();
+      clang::QualType::print(typePtr, qualifiers, out, policy, name);
+    }
+}
+
+void WebCLTransformer::useGeneralCode(const std::string &fragment)
+{
+    usedGeneralCode_.insert(fragment);
+}
+
+namespace {
+    /// Part of general.cl that is emitted only when needed.
+    struct GeneralFragment {
+        std::string name;
+        std::vector<std::string> requires;
+        std::string code;
+    };
+
+    /// Splits general.cl into the text around fragments and the
+    /// fragments themselves.
+    void parseGeneralCode(
+        std::string &header, std::vector<GeneralFragment> &fragments,
+        std::string &footer)
+    {
+        const char *buffer = reinterpret_cast<const char*>(general_endlfix_cl);
+        const llvm::StringRef contents(buffer, general_endlfix_cl_len);
+        const llvm::StringRef marker = "//@";
+
+        std::string *code = &header;
+        llvm::StringRef rest = contents;
+        while (!rest.empty()) {
+            std::pair<llvm::StringRef, llvm::StringRef> split = rest.split('\n');
+            const llvm::StringRef line = split.first;
+            rest = split.second;
+
+            if (!line.startswith(marker)) {
+                code->append(line.begin(), line.end());
+                code->append("\n");
+                continue;
+            }
+
+            llvm::SmallVector<llvm::StringRef, 4> words;
+            line.drop_front(marker.size()).split(words, " ", -1, false);
+            if (words.empty())
+                continue;
+
+            if (words[0] == "end") {
+                code = &footer;
+            } else if ((words[0] == "fragment") && (words.size() >= 2)) {
+                fragments.push_back(GeneralFragment());
+                GeneralFragment &fragment = fragments.back();
+                fragment.name = words[1].str();
+                // words[2] is "requires"
+                for (unsigned i = 3; i < words.size(); ++i)
+                    fragment.requires.push_back(words[i].str());
+                code = &fragment.code;
+            }
+        }
     }
 }
 
 void WebCLTransformer::emitGeneralCode(std::ostream &out)
 {
-    const char *buffer = reinterpret_cast<const char*>(general_endlfix_cl);
-    size_t length = general_endlfix_cl_len;
-    const std::string generalClContents(buffer, length);
-    out << "\n" << generalClContents << "\n";
+    std::string header;
+    std::vector<GeneralFragment> fragments;
+    std::string footer;
+    parseGeneralCode(header, fragments, footer);
+
+    // fragments only require fragments that come before them
+    std::set<std::string> used = usedGeneralCode_;
+    for (std::vector<GeneralFragment>::reverse_iterator i = fragments.rbegin();
+         i != fragments.rend(); ++i) {
+        if (used.count(i->name))
+            used.insert(i->requires.begin(), i->requires.end());
+    }
+
+    std::string code;
+    for (std::vector<GeneralFragment>::iterator i = fragments.begin();
+         i != fragments.end(); ++i) {
+        if (used.erase(i->name))
+            code += i->code;
+    }
+    assert(used.empty() && "Unknown fragment of general code.");
+
+    if (code.empty())
+        return;
+    out << "\n" << header << code << footer << "\n";
 }
 
 void WebCLTransformer::emitLimitFunctions(std::ostream &out)
@@ -1534,6 +2394,11 @@ void WebCLTransformer::emitLimitFunctions(std::ostream &out)
       out << getWclAddrCheckFunctionDefinition(*i) << "\n";
     }
 
+    for (RequiredIndexFunctionSet::iterator i = usedIndexClampFunctions_.begin();
+         i != usedIndexClampFunctions_.end(); ++i) {
+        out << getWclIndexClampFunctionDefinition(i->first, i->second) << "\n";
+    }
+
     out << "\n";
 }
 
@@ -1576,21 +2441,85 @@ std::string WebCLTransformer::getWclAddrCheckFunctionDefinition(ClampFunctionKey
            << cfg_.getNameOfLimitCheckFunction(clamp.aSpaceNum, clamp.limitCount, clamp.type) 
            << "(" << limitCheckCallArgs.str() << ") ? addr : asnull;\n"
            << "}\n";
-  
+
+    if (!isCountingChecks())
+        return retVal.str();
+
+    // counted variants take the counters of the access site as the
+    // first argument
+    const std::string checkName =
+        cfg_.getNameOfLimitCheckFunction(clamp.aSpaceNum, clamp.limitCount, clamp.type);
+    const std::string countersDeclArg =
+        "__" + cfg_.globalAddressSpace_ + " uint *counters, ";
+
+    retVal << "bool " << cfg_.getNameOfCountedFunction(checkName)
+           << "(" << countersDeclArg << limitCheckDeclArgs.str() << ")\n"
+           << "{\n"
+           << cfg_.indentation_ << "atomic_inc(&counters[0]);\n"
+           << cfg_.indentation_ << "if (" << checkName << "(" << limitCheckCallArgs.str() << "))\n"
+           << cfg_.getIndentation(2) << "return 1;\n"
+           << cfg_.indentation_ << "atomic_inc(&counters[1]);\n"
+           << cfg_.indentation_ << "return 0;\n"
+           << "}\n";
+
+    retVal << clamp.type
+           << cfg_.getNameOfCountedFunction(
+               cfg_.getNameOfLimitClampFunction(clamp.aSpaceNum, clamp.limitCount, clamp.type))
+           << "(" << countersDeclArg << limitCheckDeclArgs.str() << ", " << clamp.type << " asnull)\n"
+           << "{\n"
+           << cfg_.indentation_ << "return " << cfg_.getNameOfCountedFunction(checkName)
+           << "(counters, " << limitCheckCallArgs.str() << ") ? addr : asnull;\n"
+           << "}\n";
+
+    return retVal.str();
+}
+
+std::string WebCLTransformer::getWclIndexClampFunctionDefinition(
+    unsigned addressSpace, const std::string &type)
+{
+    std::stringstream retVal;
+
+    // A negative index converts to a large unsigned value, so a
+    // single comparison covers both ends of the memory object.
+    retVal << type
+           << cfg_.getNameOfIndexClampFunction(addressSpace, type)
+           << "(" << type << "base, " << cfg_.sizeParameterType_ << " index, "
+           << cfg_.sizeParameterType_ << " size, " << type << "asnull)\n"
+           << "{\n"
+           << cfg_.getIndentation(1)
+           << "return (index < size) ? (base + index) : asnull;\n"
+           << "}\n";
+
+    if (!isCountingChecks())
+        return retVal.str();
+
+    retVal << type
+           << cfg_.getNameOfCountedFunction(cfg_.getNameOfIndexClampFunction(addressSpace, type))
+           << "(__" << cfg_.globalAddressSpace_ << " uint *counters, "
+           << type << "base, " << cfg_.sizeParameterType_ << " index, "
+           << cfg_.sizeParameterType_ << " size, " << type << "asnull)\n"
+           << "{\n"
+           << cfg_.indentation_ << "atomic_inc(&counters[0]);\n"
+           << cfg_.indentation_ << "if (index < size)\n"
+           << cfg_.getIndentation(2) << "return base + index;\n"
+           << cfg_.indentation_ << "atomic_inc(&counters[1]);\n"
+           << cfg_.indentation_ << "return asnull;\n"
+           << "}\n";
+
     return retVal.str();
 }
 
 void WebCLTransformer::emitPrologue(std::ostream &out)
 {
-    out << preModulePrologue_.str();
-    out << modulePrologue_.str();
+    out << preModulePrologueCode_;
+    out << modulePrologueCode_;
     emitGeneralCode(out);
     emitLimitFunctions(out);
-    out << afterLimitFunctions_.str();
+    out << afterLimitFunctionsCode_;
 }
 
 void WebCLTransformer::emitTypeNullInitialization(
-    std::ostream &out, clang::QualType qualType)
+    llvm::raw_ostream &out, clang::QualType qualType)
 {
     const clang::Type *type = qualType.getTypePtrOrNull();
     if (type && type->isArrayType()) {
@@ -1605,7 +2534,7 @@ void WebCLTransformer::emitTypeNullInitialization(
 }
 
 void WebCLTransformer::emitVariableInitialization(
-    std::ostream &out, const clang::VarDecl *decl)
+    llvm::raw_ostream &out, const clang::VarDecl *decl)
 {
     const clang::Expr *init =  decl->getInit();
   
@@ -1625,54 +2554,79 @@ void WebCLTransformer::changeFunctionCallee(clang::CallExpr *expr,
     wclRewriter_.replaceText(callee->getSourceRange(), newName);
 }
 
-bool WebCLTransformer::wrapFunctionCall(std::string wrapperName, clang::CallExpr *expr, WebCLKernelHandler &kernelHandler)
+bool WebCLTransformer::wrapFunctionCall(clang::CallExpr *expr, WebCLKernelHandler &kernelHandler)
 {
-    bool handled = false;
-    
-    for (FunctionCallWrapperList::iterator wrapperIt = functionWrappers_.begin();
-         !handled && wrapperIt != functionWrappers_.end();
-         ++wrapperIt) {
-        if ((*wrapperIt)->matchesCallExpr(instance_, expr)) {
-            WrappedFunction result =
-                (*wrapperIt)->wrapFunction(
-                    *this, instance_,
-                    expr,
-                    ExprVector(expr->getArgs(), expr->getArgs() + expr->getNumArgs()),
-                    kernelHandler,
-                    wclRewriter_);
-
-            if (result.doWrap_) {
-                afterLimitFunctions_ << wrappedDeclaration(instance_, result.returnTypeStr_, expr, wrapperName) << "\n";
-
-                afterLimitFunctions_ << "{\n" << result.body_ << "}\n";
-
-                changeFunctionCallee(expr, wrapperName);
-                addRecordArgument(expr);
+    const FunctionCallWrapper *wrapper =
+        getBuiltinWrappers().findCall(instance_, expr);
+    if (!wrapper)
+        return false;
+
+    WrappedFunction result =
+        wrapper->wrapFunction(
+            *this, instance_,
+            expr,
+            ExprVector(expr->getArgs(), expr->getArgs() + expr->getNumArgs()),
+            kernelHandler,
+            wclRewriter_);
+
+    if (result.doWrap_) {
+        KernelAllocations &allocs = kernelHandler.getAllocations(expr);
+        const std::set<unsigned> limitSpaces =
+            kernelHandler.getArgumentAddressSpaces(expr);
+        FunctionArgumentList recordArguments;
+        if (hasRecordFields(allocs)) {
+            const std::string recordType = cfg_.getNameOfGroupType(
+                cfg_.addressSpaceRecordType_, allocs.getName());
+            recordArguments.push_back(std::make_pair(recordType + "*", cfg_.addressSpaceRecordName_));
+        }
+        if (hasScalarLimits()) {
+            for (std::set<unsigned>::const_iterator i = limitSpaces.begin();
+                 i != limitSpaces.end(); ++i) {
+                if (*i != 0)
+                    addLimitParameters(recordArguments, allocs.getLimits(*i));
             }
-	
-            handled = true;
         }
+        const std::string origName =
+            expr->getDirectCallee()->getNameInfo().getAsString();
+
+        // reuse an earlier wrapper if it would be identical
+        const std::string wrapperKey = origName + "\n" +
+            wrappedDeclaration(instance_, result.returnTypeStr_, expr, "", recordArguments) +
+            "\n" + result.body_;
+        std::map<std::string, std::string>::iterator existing =
+            wrapperFunctions_.find(wrapperKey);
+
+        std::string wrapperName;
+        if (existing != wrapperFunctions_.end()) {
+            wrapperName = existing->second;
+        } else {
+            wrapperName = cfg_.getNameOfWrapperFunction(
+                origName, wrapperFunctions_.size());
+            wrapperFunctions_[wrapperKey] = wrapperName;
+
+            afterLimitFunctions_ << wrappedDeclaration(instance_, result.returnTypeStr_, expr, wrapperName, recordArguments) << "\n";
+            afterLimitFunctions_ << "{\n" << result.body_ << "}\n";
+        }
+
+        changeFunctionCallee(expr, wrapperName);
+        addRecordArgument(expr, allocs, limitSpaces);
+        wrappedCalls_[expr] = wrapperName;
     }
 
-    return handled;
+    return true;
 }
 
 bool WebCLTransformer::wrapVariableDeclaration(clang::VarDecl *varDecl, WebCLKernelHandler &kernelHandler)
 {
-    bool handled = false;
-
-    for (FunctionCallWrapperList::iterator wrapperIt = functionWrappers_.begin();
-         !handled && wrapperIt != functionWrappers_.end();
-         ++wrapperIt) {
-        if ((*wrapperIt)->matchesVarDecl(instance_, varDecl)) {
-            (*wrapperIt)->wrapDeclaration(
-                *this, instance_,
-                varDecl,
-                kernelHandler,
-                wclRewriter_);
-            handled = true;
-        }
-    }
+    const FunctionCallWrapper *wrapper =
+        getBuiltinWrappers().findDeclaration(instance_, varDecl);
+    if (!wrapper)
+        return false;
 
-    return handled;
+    wrapper->wrapDeclaration(
+        *this, instance_,
+        varDecl,
+        kernelHandler,
+        wclRewriter_);
+    return true;
 }
@@ -25,14 +25,18 @@
 */
 
 #include "WebCLConfiguration.hpp"
+#include "WebCLEmitter.hpp"
 #include "WebCLHelper.hpp"
+#include "WebCLOptions.hpp"
 #include "WebCLReporter.hpp"
 #include "WebCLRewriter.hpp"
 
+#include <list>
 #include <map>
 #include <set>
 #include <utility>
 #include <sstream>
+#include <vector>
 
 namespace clang {
     class ArraySubscriptExpr;
@@ -61,8 +65,12 @@ class WebCLTransformer : public WebCLReporter
 public:
 
     WebCLTransformer(
-        clang::CompilerInstance &instance, clang::Rewriter &rewriter);
+        clang::CompilerInstance &instance, clang::Rewriter &rewriter,
+        const WebCLOptions &options);
     ~WebCLTransformer();
+
+    /// \return Code generation options selected for the program.
+    const WebCLOptions &getOptions() const;
   
     /// Applies all AST transformations. All cached modifications are
     /// flushed to the rewriter.
@@ -75,9 +83,9 @@ public:
     /// relocated variables of the given address space as fields.
     void createAddressSpaceTypedef(
         AddressSpaceInfo &as, const std::string &name, const std::string &alignment);
-    /// Create private address space structure.
+    /// Create private address space structure of a kernel group.
     /// \see createAddressSpaceTypedef
-    void createPrivateAddressSpaceTypedef(AddressSpaceInfo &as);
+    void createPrivateAddressSpaceTypedef(KernelAllocations &allocs);
     /// Create local address space structure.
     /// \see createAddressSpaceTypedef
     void createLocalAddressSpaceTypedef(AddressSpaceInfo &as);
@@ -100,15 +108,15 @@ public:
     /// address space structure.
     void createAddressSpaceLimitsTypedef(
         AddressSpaceLimits &limits, const std::string &name);
-    /// Create limits structure for globals. It contains only dynamic
-    /// limits.
-    void createGlobalAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits);
-    /// Create limits structure for constants. It may contain both
-    /// dynamic and static limits.
-    void createConstantAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits);
-    /// Create limits structure for locals. It may contain both
-    /// dynamic and static limits.
-    void createLocalAddressSpaceLimitsTypedef(AddressSpaceLimits &asLimits);
+    /// Create limits structure for globals of a kernel group. It
+    /// contains only dynamic limits.
+    void createGlobalAddressSpaceLimitsTypedef(KernelAllocations &allocs);
+    /// Create limits structure for constants of a kernel group. It
+    /// may contain both dynamic and static limits.
+    void createConstantAddressSpaceLimitsTypedef(KernelAllocations &allocs);
+    /// Create limits structure for locals of a kernel group. It may
+    /// contain both dynamic and static limits.
+    void createLocalAddressSpaceLimitsTypedef(KernelAllocations &allocs);
 
     // Amends the main allocation structure with a field that contains
     // limits of all disjoint memory areas. This is done for address
@@ -120,34 +128,33 @@ public:
     /// given address space.
     void createAddressSpaceNullField(
         const std::string &name, unsigned addressSpace);
-    /// Creates the main allocation structure type that holds
-    /// information about all disjoint memory areas as well as
-    /// fallback areas (address space specific null pointers).
-    void createProgramAllocationsTypedef(
-        AddressSpaceLimits &globalLimits, AddressSpaceLimits &constantLimits,
-        AddressSpaceLimits &localLimits, AddressSpaceInfo &privateAs);
+    /// Creates the main allocation structure type of a kernel group.
+    /// The type holds information about all disjoint memory areas
+    /// that the group can access as well as fallback areas (address
+    /// space specific null pointers).
+    void createProgramAllocationsTypedef(KernelAllocations &allocs);
 
     /// Creates the instance that holds all relocated constant
     /// variables.
     void createConstantAddressSpaceAllocation(AddressSpaceInfo &as);
     /// Creates an instance that holds all relocated local variables.
     ///
-    /// FUTURE: Each kernel could have a different kind of allocation
+    /// FUTURE: Each kernel group could have its own local address
+    ///         space structure, like it has its own allocation
     ///         structure.
     void createLocalAddressSpaceAllocation(clang::FunctionDecl *kernelFunc);
   
-    /// Creates an initializer for the address space specific limits
-    /// of the main allocation structure. Called for address spaces
-    /// that may contain dynamic limits, i.e. the private address
-    /// space is excluded.
+    /// Creates initializers for the address space specific limits
+    /// and null pointer of the main allocation structure. Called for
+    /// address spaces that may contain dynamic limits, i.e. the
+    /// private address space is excluded.
     void createAddressSpaceLimitsInitializer(
-        std::ostream &out, clang::FunctionDecl *kernel, AddressSpaceLimits &limits);
+        std::vector<std::string> &initializers,
+        clang::FunctionDecl *kernel, AddressSpaceLimits &limits);
     /// Creates an allocation with initialization for the instance of
-    /// the main allocation structure.
+    /// the main allocation structure of the kernel's group.
     void createProgramAllocationsAllocation(
-        clang::FunctionDecl *kernelFunc, AddressSpaceLimits &globalLimits,
-        AddressSpaceLimits &constantLimits, AddressSpaceLimits &localLimits,
-        AddressSpaceInfo &privateAs);
+        clang::FunctionDecl *kernelFunc, KernelAllocations &allocs);
 
     /// Creates and initializes a variable declaration that holds
     /// enough space for the largest memory access in the given
@@ -155,7 +162,7 @@ public:
     ///
     /// Used for constants and locals, because those address spaces may
     /// contain both static and dynamic limits.
-    void createAddressSpaceNullAllocation(std::ostream &out, unsigned addressSpace);
+    void createAddressSpaceNullAllocation(llvm::raw_ostream &out, unsigned addressSpace);
     /// Creates and initializes a fallback area variable for constant
     /// memory accesses.
     void createConstantAddressSpaceNullAllocation();
@@ -174,16 +181,103 @@ public:
     void initializeAddressSpaceNull(clang::FunctionDecl *kernel, AddressSpaceLimits &limits);
 
     /// \brief Zero a single local memory range.
-    void createLocalRangeZeroing(std::ostream &out, const std::string &arguments);
+    void createLocalRangeZeroing(llvm::raw_ostream &out, const std::string &arguments);
+    /// \brief Zero a local memory range of a kernel parameter that
+    /// each work item writes at its local id before the range is
+    /// read. The range is zeroed only if it doesn't consist of
+    /// exactly one element per work item.
+    void createLocalItemRangeZeroing(
+        llvm::raw_ostream &out, const clang::ParmVarDecl *decl);
     /// \brief Zero all local memory ranges.
     void createLocalAreaZeroing(clang::FunctionDecl *kernelFunc,
-                                AddressSpaceLimits &localLimits);
+                                AddressSpaceLimits &localLimits,
+                                const std::set<const clang::ParmVarDecl*> &itemInitialized);
 
     /// Replaces memory access with a checked access. If the access
     /// doesn't fall within limits of any given disjoint memory areas,
     /// the fallback area (null pointer) is accessed instead.
     void addMemoryAccessCheck(clang::Expr *access, unsigned size, AddressSpaceLimits &limits);
 
+    /// Declares a variable for holding the checked address of the
+    /// given access at the beginning of the function. Index must be
+    /// unique within the function.
+    ///
+    /// \return Name of the declared variable.
+    std::string addCheckedPointer(
+        const clang::FunctionDecl *func, clang::Expr *access, unsigned index);
+
+    /// Declares a variable for holding the checked address of a
+    /// guarded access like addCheckedPointer.
+    ///
+    /// \return Name of the declared variable.
+    std::string addGuardedPointer(
+        const clang::FunctionDecl *func, clang::Expr *access, unsigned index);
+
+    /// Replaces memory access with a checked access like
+    /// addMemoryAccessCheck, but also stores the checked address to
+    /// the given variable.
+    ///
+    /// array[i]
+    /// ->
+    /// (*(_wcl_checked_0 = _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(i), 1, ...)))
+    void addStoredMemoryAccessCheck(
+        clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+        const std::string &pointer);
+
+    /// Replaces memory access with an access through an address that
+    /// has already been checked and stored by an earlier identical
+    /// access.
+    ///
+    /// array[i]
+    /// ->
+    /// (*_wcl_checked_0)
+    void addReusedMemoryAccessCheck(clang::Expr *access, const std::string &pointer);
+
+    /// Replaces a value load with a conditional expression that
+    /// reads zero instead of accessing memory if the address isn't
+    /// within limits. In trap mode the violation is also recorded to
+    /// the status word.
+    ///
+    /// array[i]
+    /// ->
+    /// (_wcl_addr_check_global_1__u_uglobal__int__Ptr((_wcl_guarded_0 = (array)+(i)), 1, ...) ? (*_wcl_guarded_0) : (int) 0)
+    void addGuardedLoadCheck(
+        clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+        const std::string &pointer);
+
+    /// Makes a store statement conditional so that memory isn't
+    /// accessed if the address isn't within limits. The stored value
+    /// is evaluated first, so its side effects take place even if
+    /// the store is skipped. In trap mode the violation is also
+    /// recorded to the status word, after which the function returns
+    /// immediately if canReturn is set. The caller must not set it
+    /// for functions that may reach a barrier, because the work items
+    /// that return would never reach the barrier.
+    ///
+    /// array[i] = value;
+    /// ->
+    /// { int _wcl_value = value; if (_wcl_addr_check_global_1__u_uglobal__int__Ptr((_wcl_guarded_0 = (array)+(i)), 1, ...)) (*_wcl_guarded_0) = _wcl_value; }
+    void addGuardedStoreCheck(
+        clang::Expr *access, clang::Expr *store, unsigned size,
+        AddressSpaceLimits &limits, const std::string &pointer,
+        bool canReturn);
+
+    /// Remembers that some memory accesses of the given address space
+    /// are redirected to the null area of the address space. Null
+    /// areas are created only for such address spaces.
+    void addClampedAddressSpace(unsigned addressSpace);
+
+    /// Replaces an indexed access to a kernel memory object parameter
+    /// with a checked access. The original subscript is compared
+    /// against the element count given in the size parameter of the
+    /// memory object. If the index is out of range, the fallback
+    /// area (null pointer) is accessed instead.
+    ///
+    /// array[i]
+    /// ->
+    /// (*(_wcl_idx_clamp_global__u_uglobal__int__Ptr((array), (i), _wcl_array_size, (__global int *)_wcl_allocs->gn)))
+    void addIndexedAccessCheck(clang::ArraySubscriptExpr *access, clang::ParmVarDecl *parm);
+
     /// Adds an initialization row to start of function if relocated
     /// variable was a function argument.
     ///
@@ -210,7 +304,16 @@ public:
     ///
     /// The driver compiler should optimize unused variables (original
     /// foo) away afterwards.
-    void addRelocationInitializer(clang::VarDecl *decl);
+    ///
+    /// Arrays that are the only variable declared by the statement
+    /// and that are initialized with a flat initializer list are
+    /// initialized directly in the relocated storage instead of
+    /// being copied from the original variable:
+    ///
+    /// int foo[3] = { a, b };
+    /// ->
+    /// _wcl_allocs->pa._wcl_foo[0] = a; _wcl_allocs->pa._wcl_foo[1] = b; _WCL_FILL_ZERO(_wcl_allocs->pa._wcl_foo, 2);
+    void addRelocationInitializer(clang::VarDecl *decl, clang::DeclStmt *stmt);
 
     /// Defines a macro that tells what is the largest memory access
     /// in the given address space. The macro defines this size as
@@ -241,21 +344,59 @@ public:
 
     /// Modify function parameter declarations:
     /// function(a, b) -> function(_wcl_allocs, a, b)
-    void addRecordParameter(clang::FunctionDecl *decl);
+    ///
+    /// The parameter type is the allocation structure of the group
+    /// that the function belongs to. If limits are kept in
+    /// variables, the limits of the given address spaces are added
+    /// as parameters too:
+    /// function(a, b) -> function(_wcl_allocs, _wcl_kernel__array_min, _wcl_kernel__array_max, a, b)
+    void addRecordParameter(
+        clang::FunctionDecl *decl, KernelAllocations &allocs,
+        const std::set<unsigned> &limitSpaces);
 
     /// Modify arguments passed to a function:
     /// call(a, b) -> call(_wcl_allocs, a, b)
-    void addRecordArgument(clang::CallExpr *expr);
+    ///
+    /// Arguments match the parameters added by addRecordParameter.
+    void addRecordArgument(
+        clang::CallExpr *expr, KernelAllocations &allocs,
+        const std::set<unsigned> &limitSpaces);
+
+    /// \return Whether the allocation structure of the group has
+    /// any fields. The structure isn't created or passed to helper
+    /// functions otherwise.
+    bool hasRecordFields(KernelAllocations &allocs);
 
     /// Modify kernel parameter declarations:
     /// kernel(a, array, b) -> kernel(a, array, array_size, b)
     void addSizeParameter(clang::ParmVarDecl *decl);
 
+    /// Adds status word parameter of trapped accesses and counter
+    /// parameter of counted checks to a kernel if they are enabled:
+    /// kernel(a, b) -> kernel(a, b, __global uint *_wcl_trap_status, __global uint *_wcl_check_counters)
+    void addTrailingParameters(clang::FunctionDecl *kernel);
+
     /// Modify a function call to call a function of another name
     void changeFunctionCallee(clang::CallExpr *expr, std::string newName);
 
+    /// \return Name of a copy of a helper function. Index must be
+    /// unique among the copies of the function.
+    std::string getFunctionCloneName(
+        const clang::FunctionDecl *function, unsigned index);
+
+    /// Starts a copy of a helper function. Replacements done until
+    /// endFunctionClone apply only to the copy, which is inserted
+    /// after the function with the other replacements of the
+    /// function.
+    void beginFunctionClone(const clang::FunctionDecl *function, unsigned index);
+    /// Finishes the copy started with beginFunctionClone.
+    void endFunctionClone();
+
     /// Modify a function call to a generated replacement if applicaple. The
-    /// replacement function is generated if required. if wrapping was
+    /// replacement function is generated if required. Calls that
+    /// need identical replacement functions, i.e. calls of the same
+    /// function with the same argument types and limits, share a
+    /// single replacement function. if wrapping was
     /// performed the function returns true. otherwise (ie. an unknown builtin or 
     /// functions without dangerous arguments like image2d_t or sampler_t)
     /// false is returned. 
@@ -269,7 +410,7 @@ public:
     /// of its integer constant expression and then reconstructed by generating
     /// an expression that builds the desired value by using the related macro
     /// definitions and the bitwise or operator.
-    bool wrapFunctionCall(std::string wrapperName, clang::CallExpr *expr, WebCLKernelHandler &kernelHandler);
+    bool wrapFunctionCall(clang::CallExpr *expr, WebCLKernelHandler &kernelHandler);
 
     /// Same, but for variable declarations. For variable declarations no helper functions
     /// are currently generated, so it doesn't use a name argument for that.
@@ -286,7 +427,54 @@ public:
     /// a safe memory area.
     ///
     /// e.g. _WCL_ADDR_global_1(__global int *, addr, _wcl_allocs->gl.array_min, _wcl_allocs->gl.array_max, _wcl_allocs->gn)
-    std::string getCheckFunctionCall(CheckKind kind, std::string addr, std::string type, unsigned size, AddressSpaceLimits &limits);
+    ///
+    /// If checks are counted and the access is given, the call also
+    /// updates the counters of a new access site:
+    /// _wcl_counted_addr_clamp_global_1__u_uglobal__int__Ptr(_wcl_allocs->cc + 0, addr, ...)
+    std::string getCheckFunctionCall(
+        CheckKind kind, const std::string &addr, const std::string &type, unsigned size,
+        AddressSpaceLimits &limits, const clang::Expr *access = NULL);
+    /// Writes the call returned by getCheckFunctionCall to a stream.
+    void emitCheckFunctionCall(
+        llvm::raw_ostream &out,
+        CheckKind kind, llvm::StringRef addr, const std::string &type, unsigned size,
+        AddressSpaceLimits &limits, const clang::Expr *access = NULL);
+
+    /// \return Locations of counted memory access checks. The index
+    /// of a site in the list selects its counters.
+    const CheckSiteList &getCheckSites() const;
+
+    /// Memory access check generated for the original source.
+    struct AccessCheck {
+        AccessCheck(unsigned addressSpace = 0, unsigned limitCount = 0)
+            : addressSpace(addressSpace), limitCount(limitCount) {}
+
+        unsigned addressSpace;
+        /// Number of memory areas that the address is compared to.
+        unsigned limitCount;
+    };
+    typedef std::map<const clang::Expr*, AccessCheck> AccessCheckMap;
+    /// \return Checks of memory accesses. Checks of the copies of
+    /// helper functions aren't included.
+    const AccessCheckMap &getAccessChecks() const;
+
+    typedef std::map<const clang::CallExpr*, std::string> WrappedCallMap;
+    /// \return Builtin calls and the wrapper functions they call.
+    const WrappedCallMap &getWrappedCalls() const;
+
+    /// \return Size of the null area of the address space in bytes,
+    /// or zero if the address space doesn't have a null area.
+    unsigned getNullAreaSize(unsigned addressSpace) const;
+
+    /// \return Size of the given variables in bytes without padding.
+    unsigned getVariablesSize(AddressSpaceInfo &variables);
+
+    /// \return Estimated size of the allocation structure of the
+    /// group in bytes, or zero if the structure isn't created.
+    unsigned getProgramAllocationsSize(KernelAllocations &allocs);
+
+    /// \return Number of parameters added to the kernel.
+    unsigned getAddedParameterCount(const clang::FunctionDecl *kernel) const;
 
 private:
 
@@ -307,34 +495,126 @@ private:
     typedef std::set<ClampFunctionKey> RequiredFunctionSet;
     RequiredFunctionSet usedClampFunctions_;
 
-    /// Stream for inserting code at the beginning of each kernel or
-    /// helper function.
-    typedef std::map< const clang::FunctionDecl*, std::stringstream* > FunctionPrologueMap;
+    /// Set of all different index clamp function types (address
+    /// space and pointer type) in the program.
+    typedef std::set< std::pair<unsigned, std::string> > RequiredIndexFunctionSet;
+    RequiredIndexFunctionSet usedIndexClampFunctions_;
+
+    /// Fragments of general.cl that the generated code uses.
+    std::set<std::string> usedGeneralCode_;
+
+    /// Code inserted at the beginning of each kernel or helper
+    /// function.
+    typedef std::map< const clang::FunctionDecl*, std::string > FunctionPrologueMap;
     /// Contains only kernels.
     FunctionPrologueMap kernelPrologues_;
     /// Contains kernels and helper functions.
     FunctionPrologueMap functionPrologues_;
-    /// \return Chosen prologue stream for the given function.
+    /// \return Chosen prologue of the given function. Code is added
+    /// to it with a WebCLCodeStream.
     ///
-    /// A kernel might have both function and kernel prologue
-    /// streams. Kernel prologue comes before function prologue.
-    std::stringstream& functionPrologue(FunctionPrologueMap &prologues, const clang::FunctionDecl *func);
-
-    /// Stream for code that needs to be located at the beginning of
-    /// the transformed program even before typedefs.
-    std::stringstream preModulePrologue_;
-    /// Stream for code at the start of the module like typedefs and
-    /// address space structures.
-    std::stringstream modulePrologue_;
-    /// Stream for code after limit functions, eg. for builtin functions/macros
-    std::stringstream afterLimitFunctions_;
+    /// A kernel might have both function and kernel prologues.
+    /// Kernel prologue comes before function prologue.
+    std::string &functionPrologue(FunctionPrologueMap &prologues, const clang::FunctionDecl *func);
+    /// Inserts kernel and function prologues to start of function
+    /// body.
+    void insertFunctionPrologue(const clang::FunctionDecl *func);
+
+    /// Copy of a helper function and the replacements that apply
+    /// only to the copy.
+    struct FunctionClone {
+        const clang::FunctionDecl *function;
+        WebCLRewriter::Changes changes;
+    };
+    typedef std::vector<FunctionClone> FunctionCloneList;
+    /// Copies of helper functions in creation order.
+    FunctionCloneList functionClones_;
+    /// Inserts copies of helper functions after the functions.
+    void emitFunctionClones();
+
+    /// Code that needs to be located at the beginning of the
+    /// transformed program even before typedefs.
+    std::string preModulePrologueCode_;
+    WebCLCodeStream preModulePrologue_;
+    /// Code at the start of the module like typedefs and address
+    /// space structures.
+    std::string modulePrologueCode_;
+    WebCLCodeStream modulePrologue_;
+    /// Code after limit functions, eg. for builtin functions/macros
+    std::string afterLimitFunctionsCode_;
+    WebCLCodeStream afterLimitFunctions_;
   
     /// Set to ensure that we aren't initializing relocated parameters
     /// multiple times.
     std::set< clang::ParmVarDecl* > parameterRelocationInitializations_;
+    /// Maps declarations and bodies of generated wrapper functions
+    /// to wrapper function names so that identical wrappers are
+    /// generated only once.
+    std::map<std::string, std::string> wrapperFunctions_;
     /// Set to ensure that we don't have multiple type declarations
     /// with the same name.
     std::set<std::string> usedTypeNames_;
+    /// Address spaces that need a null area.
+    std::set<unsigned> clampedAddressSpaces_;
+    /// Locations of counted memory access checks.
+    CheckSiteList checkSites_;
+    /// Checks of memory accesses.
+    AccessCheckMap accessChecks_;
+    /// Wrapper functions called by builtin calls.
+    WrappedCallMap wrappedCalls_;
+    /// Sizes of null areas by address space.
+    std::map<unsigned, unsigned> nullAreaSizes_;
+    /// Numbers of parameters added to kernels.
+    std::map<const clang::FunctionDecl*, unsigned> addedParameters_;
+
+    /// \return Whether the given address space needs a null area.
+    bool isClampedAddressSpace(unsigned addressSpace) const;
+    /// \return Whether out of bounds accesses set the status word.
+    bool isTrapping() const;
+    /// \return Whether memory access checks update execution
+    /// counters.
+    bool isCountingChecks() const;
+    /// Records the location of a counted memory access check.
+    ///
+    /// \return Reference to the counters of the new site.
+    std::string addCheckSite(const clang::Expr *access);
+    /// \return Whether limits are kept in kernel scope variables
+    /// instead of the allocation structure.
+    bool hasScalarLimits() const;
+    /// \return Minimum and maximum limits of an address space
+    /// structure in the selected limit mode.
+    const std::string &getStaticLimitRef(unsigned addressSpace, const std::string &cast = "");
+    /// \return Minimum and maximum limits of a memory object in the
+    /// selected limit mode.
+    const std::string &getDynamicLimitRef(const clang::VarDecl *decl, const std::string &cast = "");
+
+    /// Types and names of function parameters.
+    typedef std::list< std::pair<std::string, std::string> > ParameterList;
+    /// Appends minimum and maximum parameters of each limit of the
+    /// address space to the list.
+    void addLimitParameters(ParameterList &parameters, AddressSpaceLimits &limits);
+    /// \return Allocation structure and limit parameters that are
+    /// passed to functions of the group.
+    ParameterList getRecordParameters(
+        KernelAllocations &allocs, const std::set<unsigned> &limitSpaces);
+    /// Declares and initializes limit variables of the address space
+    /// in kernel prologue.
+    void createLimitVariables(
+        llvm::raw_ostream &out, clang::FunctionDecl *kernel, AddressSpaceLimits &limits);
+    /// Writes address that the given access refers to, e.g.
+    /// (array)+(i).
+    void emitAccessAddress(llvm::raw_ostream &out, clang::Expr *access);
+    /// Declares a variable for the address of the given access at
+    /// the beginning of the function.
+    void addPointerDeclaration(
+        const clang::FunctionDecl *func, clang::Expr *access, const std::string &name);
+
+    /// Replaces declaration of relocated array with element
+    /// assignments to the relocated array. Initializer expressions
+    /// are left in place so that they can still be transformed.
+    ///
+    /// \return Whether the declaration could be replaced.
+    bool replaceWithRelocatedArrayInitializer(clang::VarDecl *decl, clang::DeclStmt *stmt);
 
     /// \return Address space structure, e.g. { float *a; uint b; }.
     ///
@@ -354,18 +634,13 @@ private:
     /// \return Initializer for address space fallback area (null
     /// pointer).
     void createAddressSpaceLimitsNullInitializer(
-        std::ostream &out, unsigned addressSpace);
+        llvm::raw_ostream &out, unsigned addressSpace);
 
     /// \brief Inserts module prologue to start of module.
     bool rewritePrologue();
     /// \brief Inserts kernel prologue to start of kernel body.
     bool rewriteKernelPrologue(const clang::FunctionDecl *kernel);
 
-    /// Adds generic wrappers from a sequence; reduces code duplication
-    void addGenericWrappers(const StringList& list,
-        unsigned numArgs,
-        unsigned ptrArgIndex);
-
     /// Writes a variable declaration to a stream in the form it
     /// should be declared inside an address space structure.
     ///
@@ -374,21 +649,30 @@ private:
     /// __constant int foo[2] = { 1 }
     /// ->
     /// int _wcl_foo[2]
-    void emitVarDeclToStruct(std::ostream &out, const clang::VarDecl *decl);
+    void emitVarDeclToStruct(llvm::raw_ostream &out, const clang::VarDecl *decl);
 
     /// Writes a variable declaration to a stream in the form it
     /// should be declared inside an address space structure. A unique
     /// name, which doesn't conflict with other address space
     /// structure field names, should be given for the variable.
-    void emitVarDeclToStruct(std::ostream &out, const clang::VarDecl *decl,
+    void emitVarDeclToStruct(llvm::raw_ostream &out, const clang::VarDecl *decl,
                              const std::string &name);
 
-    /// \return A full expression (incorporating a macro call from
+    /// Writes a full expression (incorporating a macro call from
     /// getClampFunctionCall) call that forces the given address to point to a safe
-    /// memory area.
-    std::string getClampFunctionExpression(clang::Expr *access, unsigned size, AddressSpaceLimits &limits);
-
-    /// \brief Writes bytestream generated from general.cl to stream.
+    /// memory area. If a pointer variable is given, the checked
+    /// address is also assigned to it.
+    void emitClampFunctionExpression(
+        llvm::raw_ostream &out,
+        clang::Expr *access, unsigned size, AddressSpaceLimits &limits,
+        const std::string &pointer);
+
+    /// Requests that the named fragment of general.cl and the
+    /// fragments it requires are emitted.
+    void useGeneralCode(const std::string &fragment);
+
+    /// \brief Writes the used fragments of the bytestream generated
+    /// from general.cl to stream.
     void emitGeneralCode(std::ostream &out);
   
     /// \brief Goes through the set of all generated _wcl_addr_* calls
@@ -404,6 +688,14 @@ private:
     /// the clamping macro is defined in terms of the checking macro
     std::string getWclAddrCheckFunctionDefinition(ClampFunctionKey clamp);
 
+    /// \return Definition of a function that clamps an indexed
+    /// access to a kernel memory object with a single unsigned
+    /// comparison.
+    ///
+    /// e.g.
+    /// __global int *_wcl_idx_clamp_global__u_uglobal__int__Ptr(__global int *base, ulong index, ulong size, __global int *asnull)
+    std::string getWclIndexClampFunctionDefinition(unsigned addressSpace, const std::string &type);
+
     /// Write generated code at the beginning of module.
     void emitPrologue(std::ostream &out);
 
@@ -411,19 +703,17 @@ private:
     /// written if there is no original initializer, or if the
     /// original initializer isn't a compile time constant.
     void emitVariableInitialization(
-        std::ostream &out, const clang::VarDecl *decl);
+        llvm::raw_ostream &out, const clang::VarDecl *decl);
 
     /// \brief Emits empty (zero) initializer for a type.
     void emitTypeNullInitialization(
-        std::ostream &out, clang::QualType qualType);
+        llvm::raw_ostream &out, clang::QualType qualType);
 
     /// Generates recurring names.
     WebCLConfiguration cfg_;
 
-    typedef std::list<FunctionCallWrapper*> FunctionCallWrapperList;
-
-    /// Map from a function name to a wrapping handler
-    FunctionCallWrapperList functionWrappers_;
+    /// Code generation options selected for the program.
+    WebCLOptions options_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLTRANSFORMER
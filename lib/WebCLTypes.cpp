@@ -30,6 +30,7 @@
 #include "clang/AST/Expr.h"
 #include "clang/AST/Attr.h"
 #include "clang/Basic/OpenCL.h"
+#include "llvm/Support/Mutex.h"
 
 #include "WebCLConfiguration.hpp"
 #include "WebCLCommon.hpp"
@@ -186,15 +187,22 @@ namespace WebCLTypes {
         return unsupportedBuiltinTypes_;
     }
 
-    const BuiltinTypes& allOclTypes()
-    {
-        static BuiltinTypes types;
-        if (types.empty()) {
+    namespace {
+        BuiltinTypes collectOclTypes()
+        {
+            BuiltinTypes types;
             for (HostTypes::const_iterator i = hostTypes_.begin(); i != hostTypes_.end(); ++i)
                 types.insert(i->first);
             types.insert(supportedBuiltinTypes_.begin(), supportedBuiltinTypes_.end());
             types.insert(unsupportedBuiltinTypes_.begin(), unsupportedBuiltinTypes_.end());
+            return types;
         }
+    }
+
+    const BuiltinTypes& allOclTypes()
+    {
+        // Initialized once even if programs are validated in parallel.
+        static const BuiltinTypes types = collectOclTypes();
         return types;
     }
 
@@ -203,46 +211,153 @@ namespace WebCLTypes {
         return initialZeroValues_;
     }
 
-    clang::QualType reduceType(const clang::CompilerInstance &instance, clang::QualType type)
+    TypeClass::TypeClass()
+        : reduced(), name(), opaque(NOT_OPAQUE)
+        , hostType(), zeroValue(), pointerKind(NOT_POINTER)
     {
-        static std::string indent;
+    }
 
-        clang::QualType reducedType = type;
+    namespace {
+        /// Classified types of an AST context keyed by unqualified
+        /// type. Types are uniqued by the context, so typedef sugar
+        /// such as event_t is distinguished from its underlying type.
+        struct TypeClassCache {
+            TypeClassCache(const clang::ASTContext &context)
+                : context(context), classes() {
+            }
 
-        DEBUG( std::cerr << indent << "Reducing " << reducedType.getAsString() << '\n'; )
+            const clang::ASTContext &context;
+            std::map<const clang::Type*, TypeClass> classes;
+        };
 
-        // First, clean up qualifiers (at the current indirection level in case of pointers)
-        if (reducedType.hasQualifiers()) {
-            reducedType = reducedType.getUnqualifiedType();
-            DEBUG( std::cerr << indent << "  w/o quals " << reducedType.getAsString() << '\n'; )
+        typedef std::map<const clang::ASTContext*, TypeClassCache*> TypeClassCaches;
+        TypeClassCaches typeClassCaches_;
+        /// Guards the caches and the types that classification
+        /// creates, because function bodies may be analysed
+        /// concurrently. Classification of pointers recurses, so the
+        /// mutex is recursive.
+        llvm::sys::Mutex typeClassMutex_;
+
+        /// Called when the AST context of the cache is destroyed.
+        void releaseTypeClassCache(void *data)
+        {
+            llvm::sys::ScopedLock lock(typeClassMutex_);
+            TypeClassCache *cache = static_cast<TypeClassCache*>(data);
+            typeClassCaches_.erase(&cache->context);
+            delete cache;
+        }
+
+        TypeClassCache &getTypeClassCache(clang::ASTContext &context)
+        {
+            TypeClassCaches::iterator i = typeClassCaches_.find(&context);
+            if (i != typeClassCaches_.end())
+                return *i->second;
+
+            TypeClassCache *cache = new TypeClassCache(context);
+            typeClassCaches_[&context] = cache;
+            context.AddDeallocation(releaseTypeClassCache, cache);
+            return *cache;
+        }
+
+        OpaqueKind opaqueKind(const std::string &name)
+        {
+            if (name == "image2d_t")
+                return IMAGE2D_TYPE;
+            if (name == "image3d_t")
+                return IMAGE3D_TYPE;
+            if (name == "sampler_t")
+                return SAMPLER_TYPE;
+            if (name == "event_t")
+                return EVENT_TYPE;
+            return NOT_OPAQUE;
         }
 
-        // Clean up initial user typedefs, but stop when we encounter an OpenCL type
-        // (in Clang, some OpenCL types like image2d_t are typedefs, but we want to preserve them)
-        clang::QualType nextType;
-        while (!allOclTypes().count(reducedType.getAsString())
-            && (nextType = reducedType.getSingleStepDesugaredType(instance.getASTContext())) != reducedType) {
-                reducedType = nextType;
-                DEBUG( std::cerr << indent << "  desugared " << reducedType.getAsString() << '\n'; )
+        PointerKind pointerKind(clang::QualType type)
+        {
+            const clang::QualType canonical = type.getCanonicalType();
+            if (!canonical->isPointerType())
+                return NOT_POINTER;
+
+            switch (canonical->getPointeeType().getAddressSpace()) {
+            case clang::LangAS::opencl_global:
+                return GLOBAL_POINTER;
+            case clang::LangAS::opencl_constant:
+                return CONSTANT_POINTER;
+            case clang::LangAS::opencl_local:
+                return LOCAL_POINTER;
+            default:
+                return PRIVATE_POINTER;
+            }
         }
 
-        // Clean up pointer (to pointer (...)) types recursively
-        // ... except OpenCL types like image2d_t, which are actually pointers in the clang impl
-        if (reducedType.getTypePtr()->isPointerType() && !allOclTypes().count(reducedType.getAsString())) {
-            DEBUG( std::cerr << indent << "  Handling pointer recursively\n"; )
-            DEBUG( indent.append("    "); )
+        /// Reduces an unqualified type, see reduceType.
+        TypeClass computeTypeClass(const clang::CompilerInstance &instance, clang::QualType type)
+        {
+            clang::ASTContext &context = instance.getASTContext();
+            TypeClass result;
+
+            clang::QualType reducedType = type;
+            std::string name = reducedType.getAsString();
+            DEBUG( std::cerr << "Reducing " << name << '\n'; )
+
+            // Clean up initial user typedefs, but stop when we encounter an OpenCL type
+            // (in Clang, some OpenCL types like image2d_t are typedefs, but we want to preserve them)
+            clang::QualType nextType;
+            while (!allOclTypes().count(name)
+                && (nextType = reducedType.getSingleStepDesugaredType(context)) != reducedType) {
+                    reducedType = nextType;
+                    name = reducedType.getAsString();
+                    DEBUG( std::cerr << "  desugared " << name << '\n'; )
+            }
+
+            // Clean up pointer (to pointer (...)) types recursively
+            // ... except OpenCL types like image2d_t, which are actually pointers in the clang impl
+            if (reducedType.getTypePtr()->isPointerType() && !allOclTypes().count(name)) {
+                reducedType = context.getPointerType(
+                    classifyType(instance, reducedType.getTypePtr()->getPointeeType()).reduced);
+                name = reducedType.getAsString();
+            }
+
+            DEBUG( std::cerr << "Finally " << name << '\n'; )
+
+            result.reduced = reducedType;
+            result.name = name;
+            result.opaque = opaqueKind(name);
 
-            clang::QualType pointerType = instance.getASTContext().getPointerType(
-                reduceType(instance, reducedType.getTypePtr()->getPointeeType()));
-            reducedType = pointerType;
+            HostTypes::const_iterator host = hostTypes_.find(name);
+            if (host != hostTypes_.end())
+                result.hostType = host->second;
+            InitialZeroValues::const_iterator zero = initialZeroValues_.find(name);
+            if (zero != initialZeroValues_.end())
+                result.zeroValue = zero->second;
 
-            DEBUG( indent.erase(indent.size() - 4); )
-            DEBUG( std::cerr << "  After pointer recursion " << reducedType.getAsString() << '\n'; )
+            result.pointerKind = pointerKind(type);
+            return result;
         }
+    }
+
+    const TypeClass &classifyType(const clang::CompilerInstance &instance, clang::QualType type)
+    {
+        llvm::sys::ScopedLock lock(typeClassMutex_);
+        TypeClassCache &cache = getTypeClassCache(instance.getASTContext());
+
+        // First, clean up qualifiers (at the current indirection level in case of pointers)
+        const clang::QualType unqualified = type.getUnqualifiedType();
+        const clang::Type *key = unqualified.getTypePtr();
 
-        DEBUG( std::cerr << indent << "Finally " << reducedType.getAsString() << '\n'; )
+        std::map<const clang::Type*, TypeClass>::iterator i = cache.classes.find(key);
+        if (i != cache.classes.end())
+            return i->second;
 
-        return reducedType;
+        // computing the class of a pointer adds the class of its
+        // pointee, so the cache is looked up again when inserting
+        const TypeClass result = computeTypeClass(instance, unqualified);
+        return cache.classes.insert(std::make_pair(key, result)).first->second;
+    }
+
+    clang::QualType reduceType(const clang::CompilerInstance &instance, clang::QualType type)
+    {
+        return classifyType(instance, type).reduced;
     }
 
     unsigned getAddressSpace(clang::Expr *expr)
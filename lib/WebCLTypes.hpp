@@ -28,6 +28,11 @@
 
 #include <map>
 #include <set>
+#include <string>
+
+namespace clang {
+    class CompilerInstance;
+}
 
 namespace WebCLTypes {
     enum PointerKind {
@@ -48,6 +53,15 @@ namespace WebCLTypes {
         INVALID_TYPEDEF_ACCESS // a typedef was used with qualifiers. We don't allow that.
     };
 
+    /// OpenCL C builtin types that are recognized by name.
+    enum OpaqueKind {
+        NOT_OPAQUE,
+        IMAGE2D_TYPE,
+        IMAGE3D_TYPE,
+        SAMPLER_TYPE,
+        EVENT_TYPE
+    };
+
     /// Maps OpenCL C types to host types: int -> cl_int.
     typedef std::map<std::string, std::string> HostTypes;
 
@@ -83,6 +97,29 @@ namespace WebCLTypes {
     /// my_image -> image2d_t
     clang::QualType reduceType(const clang::CompilerInstance &instance, clang::QualType type);
 
+    /// Facts about a type that are derived from its reduced type.
+    struct TypeClass {
+        TypeClass();
+
+        /// \see reduceType
+        clang::QualType reduced;
+        /// Name of the reduced type.
+        std::string name;
+        /// Which OpenCL C builtin type the reduced type is, if any.
+        OpaqueKind opaque;
+        /// Host type such as cl_int, or empty if there is none.
+        std::string hostType;
+        /// Zero literal such as (int) 0, or empty if there is none.
+        std::string zeroValue;
+        /// Address space of the pointee if the type is a pointer.
+        PointerKind pointerKind;
+    };
+
+    /// Classifies a type. Each distinct unqualified type is reduced
+    /// and named only once per AST context, so this is cheap to call
+    /// repeatedly for the same types.
+    const TypeClass &classifyType(const clang::CompilerInstance &instance, clang::QualType type);
+
     ImageKind imageKind(const clang::Type* type, const clang::Decl* decl);
 
     /// \return Correct address space for the type of given
@@ -28,14 +28,24 @@
 #include "clang/AST/Attr.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
+#include "clang/AST/ParentMap.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Basic/OpenCL.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Mutex.h"
+
+#if LLVM_ENABLE_THREADS && defined(LLVM_ON_UNIX)
+#include <pthread.h>
+#define WEBCL_THREADS 1
+#endif
 
 // WebCLVisitor
 
 WebCLVisitor::WebCLVisitor(clang::CompilerInstance &instance)
     : WebCLReporter(instance)
-    , clang::RecursiveASTVisitor<WebCLVisitor>()
 {
 }
 
@@ -43,73 +53,357 @@ WebCLVisitor::~WebCLVisitor()
 {
 }
 
-bool WebCLVisitor::VisitTranslationUnitDecl(clang::TranslationUnitDecl *decl)
+WebCLVisitor *WebCLVisitor::forkBody(clang::FunctionDecl *decl)
+{
+    return NULL;
+}
+
+void WebCLVisitor::joinBody(WebCLVisitor *fork)
+{
+}
+
+// WebCLTraversal
+
+namespace {
+    /// Lets each visitor handle the node. Stops at the first visitor
+    /// that fails.
+    template <typename Node>
+    bool dispatch(
+        const std::vector<WebCLVisitor*> &visitors,
+        bool (WebCLVisitor::*handler)(Node*), Node *node)
+    {
+        for (std::vector<WebCLVisitor*>::const_iterator i = visitors.begin();
+             i != visitors.end(); ++i) {
+            if (!((*i)->*handler)(node))
+                return false;
+        }
+        return true;
+    }
+
+    /// Diagnostic reported by a fork.
+    struct BufferedDiagnostic
+    {
+        BufferedDiagnostic(
+            clang::DiagnosticsEngine::Level level,
+            clang::SourceLocation location, const std::string &message)
+            : level(level), location(location), message(message) {}
+
+        clang::DiagnosticsEngine::Level level;
+        clang::SourceLocation location;
+        std::string message;
+    };
+
+    /// Keeps the diagnostics of a function body until they can be
+    /// reported in source order.
+    class DiagnosticBuffer : public clang::DiagnosticConsumer
+    {
+    public:
+
+        /// \see clang::DiagnosticConsumer::HandleDiagnostic
+        virtual void HandleDiagnostic(
+            clang::DiagnosticsEngine::Level level, const clang::Diagnostic &info)
+        {
+            clang::DiagnosticConsumer::HandleDiagnostic(level, info);
+            llvm::SmallString<128> message;
+            info.FormatDiagnostic(message);
+            diagnostics_.push_back(
+                BufferedDiagnostic(level, info.getLocation(), message.str()));
+        }
+
+        /// Reports the buffered diagnostics again.
+        void replay(clang::DiagnosticsEngine &diags) const
+        {
+            for (std::vector<BufferedDiagnostic>::const_iterator i = diagnostics_.begin();
+                 i != diagnostics_.end(); ++i) {
+                diags.Report(i->location, diags.getCustomDiagID(i->level, "%0"))
+                    << i->message;
+            }
+        }
+
+        /// Forgets the buffered diagnostics.
+        void clear()
+        {
+            diagnostics_.clear();
+        }
+
+    private:
+
+        std::vector<BufferedDiagnostic> diagnostics_;
+    };
+}
+
+struct WebCLTraversal::BodyJob
+{
+    BodyJob(clang::CompilerInstance &instance, clang::FunctionDecl *function)
+        : function(function)
+        , forks()
+        , buffer()
+        , diagnostics(
+            llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs>(new clang::DiagnosticIDs),
+            new clang::DiagnosticOptions, &buffer, false)
+        , result(false)
+    {
+        diagnostics.setSourceManager(&instance.getSourceManager());
+
+        // The engine drops notes that follow an ignored diagnostic,
+        // which is the initial state. Start with a warning so that all
+        // notes are buffered and let the engine of the compiler
+        // instance decide about them when they are replayed.
+        diagnostics.Report(diagnostics.getCustomDiagID(
+            clang::DiagnosticsEngine::Warning, "buffered diagnostics"));
+        buffer.clear();
+    }
+
+    ~BodyJob()
+    {
+        for (Visitors::iterator i = forks.begin(); i != forks.end(); ++i)
+            delete *i;
+    }
+
+    /// Function whose body is handled.
+    clang::FunctionDecl *function;
+    /// Forks of the visitors, in the same order.
+    Visitors forks;
+    /// Diagnostics reported by the forks.
+    DiagnosticBuffer buffer;
+    clang::DiagnosticsEngine diagnostics;
+    /// Whether the forks handled all nodes of the body.
+    bool result;
+};
+
+struct WebCLTraversal::BodyQueue
+{
+    BodyQueue(clang::CompilerInstance &instance)
+        : instance(instance), jobs(), next(0), mutex() {}
+
+    /// \return Next job to run, or NULL if all jobs have been taken.
+    BodyJob *pop()
+    {
+        llvm::sys::ScopedLock lock(mutex);
+        return (next < jobs.size()) ? jobs[next++] : NULL;
+    }
+
+    clang::CompilerInstance &instance;
+    std::vector<BodyJob*> jobs;
+    std::vector<BodyJob*>::size_type next;
+    llvm::sys::Mutex mutex;
+};
+
+WebCLTraversal::WebCLTraversal(clang::CompilerInstance &instance, unsigned threads)
+    : WebCLReporter(instance)
+    , clang::RecursiveASTVisitor<WebCLTraversal>()
+    , visitors_()
+    , threads_(threads)
+    , bodyJobs_()
+{
+}
+
+WebCLTraversal::~WebCLTraversal()
+{
+    clearBodies();
+}
+
+void WebCLTraversal::addVisitor(WebCLVisitor *visitor)
+{
+    visitors_.push_back(visitor);
+}
+
+void WebCLTraversal::traverse(clang::TranslationUnitDecl *decl)
+{
+    if (threads_ > 1)
+        forkBodies(decl);
+    TraverseDecl(decl);
+    clearBodies();
+}
+
+bool WebCLTraversal::TraverseDecl(clang::Decl *decl)
+{
+    if (decl && isOutsideMainFile(decl))
+        return true;
+    return clang::RecursiveASTVisitor<WebCLTraversal>::TraverseDecl(decl);
+}
+
+bool WebCLTraversal::TraverseStmt(clang::Stmt *stmt)
+{
+    if (!bodyJobs_.empty()) {
+        BodyJobs::iterator i = bodyJobs_.find(stmt);
+        if (i != bodyJobs_.end())
+            return joinBody(*i->second);
+    }
+    return clang::RecursiveASTVisitor<WebCLTraversal>::TraverseStmt(stmt);
+}
+
+void WebCLTraversal::forkBodies(clang::TranslationUnitDecl *decl)
 {
-    return handleTranslationUnitDecl(decl);
+    BodyQueue queue(instance_);
+
+    for (clang::DeclContext::decl_iterator i = decl->decls_begin();
+         i != decl->decls_end(); ++i) {
+        clang::FunctionDecl *function = llvm::dyn_cast<clang::FunctionDecl>(*i);
+        if (!function || !function->doesThisDeclarationHaveABody() ||
+            isOutsideMainFile(function)) {
+            continue;
+        }
+
+        BodyJob *job = new BodyJob(instance_, function);
+        for (Visitors::iterator j = visitors_.begin(); j != visitors_.end(); ++j) {
+            WebCLVisitor *fork = (*j)->forkBody(function);
+            if (!fork)
+                break;
+            fork->setDiagnostics(&job->diagnostics);
+            job->forks.push_back(fork);
+        }
+
+        // The body is walked on this thread like any other node if
+        // some visitor needs to see it.
+        if (job->forks.size() != visitors_.size()) {
+            delete job;
+            continue;
+        }
+
+        bodyJobs_[function->getBody()] = job;
+        queue.jobs.push_back(job);
+    }
+
+    if (queue.jobs.empty())
+        return;
+
+#ifdef WEBCL_THREADS
+    std::vector<pthread_t> workers;
+    for (unsigned i = 1; (i < threads_) && (i < queue.jobs.size()); ++i) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, runBodies, &queue))
+            break;
+        workers.push_back(worker);
+    }
+#endif
+
+    // This thread takes jobs too, and runs all of them if threads
+    // aren't available.
+    runBodies(&queue);
+
+#ifdef WEBCL_THREADS
+    for (std::vector<pthread_t>::iterator i = workers.begin(); i != workers.end(); ++i)
+        pthread_join(*i, NULL);
+#endif
+}
+
+void *WebCLTraversal::runBodies(void *queue)
+{
+    BodyQueue *bodies = static_cast<BodyQueue*>(queue);
+    while (BodyJob *job = bodies->pop()) {
+        WebCLTraversal traversal(bodies->instance);
+        traversal.visitors_ = job->forks;
+        job->result = traversal.TraverseStmt(job->function->getBody());
+    }
+    return NULL;
 }
 
-bool WebCLVisitor::VisitFunctionDecl(clang::FunctionDecl *decl)
+bool WebCLTraversal::joinBody(BodyJob &job)
 {
-    return handleFunctionDecl(decl);
+    job.buffer.replay(instance_.getDiagnostics());
+
+    for (Visitors::size_type i = 0; i < visitors_.size(); ++i)
+        visitors_[i]->joinBody(job.forks[i]);
+    return job.result;
 }
 
-bool WebCLVisitor::VisitParmVarDecl(clang::ParmVarDecl *decl)
+void WebCLTraversal::clearBodies()
 {
-    return handleParmVarDecl(decl);
+    for (BodyJobs::iterator i = bodyJobs_.begin(); i != bodyJobs_.end(); ++i)
+        delete i->second;
+    bodyJobs_.clear();
 }
 
-bool WebCLVisitor::VisitVarDecl(clang::VarDecl *decl)
+bool WebCLTraversal::isOutsideMainFile(clang::Decl *decl) const
 {
-    return handleVarDecl(decl);
+    const clang::DeclContext *context = decl->getDeclContext();
+    if (!context || !context->isTranslationUnit())
+        return false;
+
+    // Declarations without locations are generated by the compiler,
+    // so they aren't skipped. Macros expanded in the main file are
+    // considered to be part of it.
+    clang::SourceManager &sources = instance_.getSourceManager();
+    const clang::SourceLocation location = decl->getLocStart();
+    if (location.isInvalid())
+        return false;
+    return sources.getFileID(sources.getExpansionLoc(location)) != sources.getMainFileID();
 }
 
-bool WebCLVisitor::VisitDeclStmt(clang::DeclStmt *stmt)
+bool WebCLTraversal::VisitTranslationUnitDecl(clang::TranslationUnitDecl *decl)
 {
-    return handleDeclStmt(stmt);
+    return dispatch(visitors_, &WebCLVisitor::handleTranslationUnitDecl, decl);
 }
 
-bool WebCLVisitor::VisitArraySubscriptExpr(clang::ArraySubscriptExpr *expr)
+bool WebCLTraversal::VisitFunctionDecl(clang::FunctionDecl *decl)
 {
-    return handleArraySubscriptExpr(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleFunctionDecl, decl);
 }
 
-bool WebCLVisitor::VisitUnaryOperator(clang::UnaryOperator *expr)
+bool WebCLTraversal::VisitParmVarDecl(clang::ParmVarDecl *decl)
 {
-    return handleUnaryOperator(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleParmVarDecl, decl);
 }
-bool WebCLVisitor::VisitMemberExpr(clang::MemberExpr *expr)
+
+bool WebCLTraversal::VisitVarDecl(clang::VarDecl *decl)
 {
-  return handleMemberExpr(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleVarDecl, decl);
 }
 
-bool WebCLVisitor::VisitExtVectorElementExpr(clang::ExtVectorElementExpr *expr)
+bool WebCLTraversal::VisitDeclStmt(clang::DeclStmt *stmt)
 {
-  return handleExtVectorElementExpr(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleDeclStmt, stmt);
 }
 
-bool WebCLVisitor::VisitCallExpr(clang::CallExpr *expr)
+bool WebCLTraversal::VisitArraySubscriptExpr(clang::ArraySubscriptExpr *expr)
 {
-    return handleCallExpr(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleArraySubscriptExpr, expr);
 }
 
-bool WebCLVisitor::VisitTypedefDecl(clang::TypedefDecl *decl)
+bool WebCLTraversal::VisitUnaryOperator(clang::UnaryOperator *expr)
 {
-  return handleTypedefDecl(decl);
+    return dispatch(visitors_, &WebCLVisitor::handleUnaryOperator, expr);
 }
 
-bool WebCLVisitor::VisitRecordDecl(clang::RecordDecl *decl)
+bool WebCLTraversal::VisitBinaryOperator(clang::BinaryOperator *expr)
 {
-  return handleRecordDecl(decl);
+    return dispatch(visitors_, &WebCLVisitor::handleBinaryOperator, expr);
 }
 
-bool WebCLVisitor::VisitDeclRefExpr(clang::DeclRefExpr *expr)
+bool WebCLTraversal::VisitMemberExpr(clang::MemberExpr *expr)
 {
-  return handleDeclRefExpr(expr);
+    return dispatch(visitors_, &WebCLVisitor::handleMemberExpr, expr);
 }
 
-bool WebCLVisitor::VisitForStmt(clang::ForStmt *stmt)
+bool WebCLTraversal::VisitExtVectorElementExpr(clang::ExtVectorElementExpr *expr)
 {
-  return handleForStmt(stmt);
+    return dispatch(visitors_, &WebCLVisitor::handleExtVectorElementExpr, expr);
+}
+
+bool WebCLTraversal::VisitCallExpr(clang::CallExpr *expr)
+{
+    return dispatch(visitors_, &WebCLVisitor::handleCallExpr, expr);
+}
+
+bool WebCLTraversal::VisitTypedefDecl(clang::TypedefDecl *decl)
+{
+    return dispatch(visitors_, &WebCLVisitor::handleTypedefDecl, decl);
+}
+
+bool WebCLTraversal::VisitRecordDecl(clang::RecordDecl *decl)
+{
+    return dispatch(visitors_, &WebCLVisitor::handleRecordDecl, decl);
+}
+
+bool WebCLTraversal::VisitDeclRefExpr(clang::DeclRefExpr *expr)
+{
+    return dispatch(visitors_, &WebCLVisitor::handleDeclRefExpr, expr);
+}
+
+bool WebCLTraversal::VisitForStmt(clang::ForStmt *stmt)
+{
+    return dispatch(visitors_, &WebCLVisitor::handleForStmt, stmt);
 }
 
 bool WebCLVisitor::handleTranslationUnitDecl(clang::TranslationUnitDecl *decl)
@@ -147,6 +441,11 @@ bool WebCLVisitor::handleUnaryOperator(clang::UnaryOperator *expr)
     return true;
 }
 
+bool WebCLVisitor::handleBinaryOperator(clang::BinaryOperator *expr)
+{
+    return true;
+}
+
 bool WebCLVisitor::handleMemberExpr(clang::MemberExpr *expr)
 {
   return true;
@@ -191,6 +490,11 @@ WebCLRestrictor::~WebCLRestrictor()
 {
 }
 
+WebCLVisitor *WebCLRestrictor::forkBody(clang::FunctionDecl *decl)
+{
+    return new WebCLRestrictor(instance_);
+}
+
 bool WebCLRestrictor::handleParmVarDecl(clang::ParmVarDecl *decl)
 { 
     const clang::TypeSourceInfo *info = decl->getTypeSourceInfo();
@@ -242,7 +546,7 @@ void WebCLRestrictor::check3dImageParameter(
         return;
 
     clang::QualType canonical = type->getCanonicalTypeInternal();
-    if (canonical.getAsString() == "image3d_t") {
+    if (WebCLTypes::classifyType(instance_, canonical).opaque == WebCLTypes::IMAGE3D_TYPE) {
         error(typeLocation, "WebCL doesn't support 3D images.\n");
     }
 }
@@ -251,11 +555,10 @@ void WebCLRestrictor::checkUnsupportedBuiltinParameter(
     clang::FunctionDecl *decl,
     clang::SourceLocation typeLocation, const clang::QualType &type)
 {
-    clang::QualType reduced = WebCLTypes::reduceType(instance_, type);
-    std::string typeName = reduced.getAsString();
+    const WebCLTypes::TypeClass &typeClass = WebCLTypes::classifyType(instance_, type);
     if (decl->hasAttr<clang::OpenCLKernelAttr>() &&
-        WebCLTypes::unsupportedBuiltinTypes().count(typeName) > 0) {
-            error(typeLocation, "Unsupported builtin type %0 used as a kernel parameter.") << typeName;
+        WebCLTypes::unsupportedBuiltinTypes().count(typeClass.name) > 0) {
+            error(typeLocation, "Unsupported builtin type %0 used as a kernel parameter.") << typeClass.name;
     }
 }
 
@@ -263,11 +566,88 @@ void WebCLRestrictor::checkUnsupportedBuiltinParameter(
 
 WebCLAnalyser::WebCLAnalyser(clang::CompilerInstance &instance)
 : WebCLVisitor(instance)
+, escapesAnalysed_(false)
+, currentFunction_(NULL)
+, parent_(NULL)
+, builtins_(new WebCLBuiltins)
+{
+}
+
+WebCLAnalyser::WebCLAnalyser(WebCLAnalyser &parent, clang::FunctionDecl *function)
+: WebCLVisitor(parent.instance_)
+, escapesAnalysed_(false)
+, currentFunction_(function)
+, parent_(&parent)
+, builtins_(parent.builtins_)
 {
 }
 
 WebCLAnalyser::~WebCLAnalyser()
 {
+    for (std::map<clang::FunctionDecl*, clang::ParentMap*>::iterator i = parentMaps_.begin();
+         i != parentMaps_.end(); ++i) {
+        delete i->second;
+    }
+    if (!parent_)
+        delete builtins_;
+}
+
+WebCLVisitor *WebCLAnalyser::forkBody(clang::FunctionDecl *decl)
+{
+    return new WebCLAnalyser(*this, decl);
+}
+
+namespace {
+    template <typename Set>
+    void appendSet(Set &to, const Set &from)
+    {
+        to.insert(from.begin(), from.end());
+    }
+}
+
+void WebCLAnalyser::joinBody(WebCLVisitor *fork)
+{
+    // Body nodes aren't visited before the body, so appending the
+    // nodes keeps everything in the order of a serial walk.
+    WebCLAnalyser &body = *static_cast<WebCLAnalyser*>(fork);
+
+    kernelFunctions_.insert(
+        kernelFunctions_.end(), body.kernelFunctions_.begin(), body.kernelFunctions_.end());
+    appendSet(helperFunctions_, body.helperFunctions_);
+    appendSet(internalCalls_, body.internalCalls_);
+    appendSet(builtinCalls_, body.builtinCalls_);
+    appendSet(constantVariables_, body.constantVariables_);
+    appendSet(localVariables_, body.localVariables_);
+    appendSet(privateVariables_, body.privateVariables_);
+    appendSet(declarationsWithAddressOfAccess_, body.declarationsWithAddressOfAccess_);
+    for (std::map<const clang::VarDecl*, unsigned>::iterator i = body.addressReferenceCounts_.begin();
+         i != body.addressReferenceCounts_.end(); ++i) {
+        addressReferenceCounts_[i->first] += i->second;
+    }
+    appendSet(modifiedDeclarations_, body.modifiedDeclarations_);
+    appendSet(declarationsMadeInForStatements_, body.declarationsMadeInForStatements_);
+    appendSet(singleDeclarationStatements_, body.singleDeclarationStatements_);
+    appendSet(variableUses_, body.variableUses_);
+    for (MemoryAccessMap::iterator i = body.pointerAccesses_.begin();
+         i != body.pointerAccesses_.end(); ++i) {
+        pointerAccesses_[i->first] = i->second;
+    }
+    typeDeclList_.insert(
+        typeDeclList_.end(), body.typeDeclList_.begin(), body.typeDeclList_.end());
+    appendSet(enclosingFunctions_, body.enclosingFunctions_);
+}
+
+bool WebCLAnalyser::isHelperFunction(clang::FunctionDecl *decl) const
+{
+    if (helperFunctions_.count(decl) > 0)
+        return true;
+
+    // Forks haven't seen the declarations before the body. Functions
+    // are declared before they are called, so the callee would have
+    // been collected if it is a user defined function other than a
+    // kernel.
+    return parent_ && isFromMainFile(decl->getLocStart()) &&
+        !decl->hasAttr<clang::OpenCLKernelAttr>();
 }
 
 bool WebCLAnalyser::handleVarDecl(clang::VarDecl *decl)
@@ -320,6 +700,7 @@ bool WebCLAnalyser::handleMemberExpr(clang::MemberExpr *expr)
     }
     
     pointerAccesses_[expr] = declaration;
+    collectEnclosingFunction(expr);
   }
   return true;
 }
@@ -338,6 +719,7 @@ bool WebCLAnalyser::handleExtVectorElementExpr(clang::ExtVectorElementExpr *expr
       declaration = llvm::dyn_cast<clang::VarDecl>(declRef->getDecl());
     }
     pointerAccesses_[expr] = declaration;
+    collectEnclosingFunction(expr);
   }
   return true;
 }
@@ -359,6 +741,7 @@ bool WebCLAnalyser::handleArraySubscriptExpr(clang::ArraySubscriptExpr *expr)
   }
   
   pointerAccesses_[expr] = declaration;
+  collectEnclosingFunction(expr);
 
   return true;
 }
@@ -384,6 +767,7 @@ bool WebCLAnalyser::handleUnaryOperator(clang::UnaryOperator *expr)
     //          << " address number space: " << addr->getType().getAddressSpace()
     //          <<  "\n\n";
     pointerAccesses_[expr] = declaration;
+    collectEnclosingFunction(expr);
     
   } else if(expr->getOpcode() == clang::UO_AddrOf) {
     info(expr->getLocStart(), "Address of something, might require some handling.");
@@ -394,6 +778,7 @@ bool WebCLAnalyser::handleUnaryOperator(clang::UnaryOperator *expr)
       clang::VarDecl *varDecl = llvm::dyn_cast<clang::VarDecl>(valueDecl);
       if (varDecl) {
           declarationsWithAddressOfAccess_.insert(varDecl);
+          ++addressReferenceCounts_[varDecl];
           // Add variable to corresponding address space record if its
           // address is required.
           collectVariable(varDecl);
@@ -401,25 +786,43 @@ bool WebCLAnalyser::handleUnaryOperator(clang::UnaryOperator *expr)
           error(valueDecl->getLocStart(), "Taking of value addresses is not supported.");
       }
     }
+  } else if (expr->isIncrementDecrementOp()) {
+    collectModifiedVariable(expr->getSubExpr());
   }
   return true;
 }
 
+bool WebCLAnalyser::handleBinaryOperator(clang::BinaryOperator *expr)
+{
+  if (!isFromMainFile(expr->getLocStart())) return true;
+
+  if (expr->isAssignmentOp())
+    collectModifiedVariable(expr->getLHS());
+  return true;
+}
+
 namespace {
-    std::map<std::string, std::string> typeShorthands()
+    typedef std::map<std::string, std::string> TypeShorthands;
+
+    TypeShorthands collectTypeShorthands()
     {
-        static std::map<std::string, std::string> typeShorthands_;
-        if (typeShorthands_.empty()) {
-            typeShorthands_["unsigned char"] = "uchar";
-            typeShorthands_["unsigned short"] = "ushort";
-            typeShorthands_["unsigned int"] = "uint";
-            typeShorthands_["unsigned long"] = "ulong";
-
-            typeShorthands_["unsigned char *"] = "uchar *";
-            typeShorthands_["unsigned short *"] = "ushort *";
-            typeShorthands_["unsigned int *"] = "uint *";
-            typeShorthands_["unsigned long *"] = "ulong *";
-        }
+        TypeShorthands shorthands;
+        shorthands["unsigned char"] = "uchar";
+        shorthands["unsigned short"] = "ushort";
+        shorthands["unsigned int"] = "uint";
+        shorthands["unsigned long"] = "ulong";
+
+        shorthands["unsigned char *"] = "uchar *";
+        shorthands["unsigned short *"] = "ushort *";
+        shorthands["unsigned int *"] = "uint *";
+        shorthands["unsigned long *"] = "ulong *";
+        return shorthands;
+    }
+
+    const TypeShorthands &typeShorthands()
+    {
+        // Initialized once even if programs are validated in parallel.
+        static const TypeShorthands typeShorthands_ = collectTypeShorthands();
         return typeShorthands_;
     }
 }
@@ -427,12 +830,13 @@ namespace {
 WebCLAnalyser::KernelArgInfo::KernelArgInfo(clang::CompilerInstance &instance, clang::ParmVarDecl *decl)
     : decl(decl)
     , name(decl->getName().str())
-    , reducedTypeName(WebCLTypes::reduceType(instance, decl->getType()).getAsString())
+    , reducedTypeName(WebCLTypes::classifyType(instance, decl->getType()).name)
     , pointerKind(WebCLTypes::NOT_POINTER)
     , imageKind(WebCLTypes::NOT_IMAGE)
 {
-    if (typeShorthands().count(reducedTypeName)) {
-        reducedTypeName = typeShorthands()[reducedTypeName];
+    TypeShorthands::const_iterator shorthand = typeShorthands().find(reducedTypeName);
+    if (shorthand != typeShorthands().end()) {
+        reducedTypeName = shorthand->second;
     }
 
     const clang::Type *type = decl->getType().getTypePtr();
@@ -441,20 +845,8 @@ WebCLAnalyser::KernelArgInfo::KernelArgInfo(clang::CompilerInstance &instance, c
     imageKind = WebCLTypes::imageKind(type, decl);
     if (imageKind != WebCLTypes::NOT_IMAGE) {
         pointerKind = WebCLTypes::IMAGE_HANDLE;
-    } else if (type->isPointerType()) {
-        switch (type->getPointeeType().getAddressSpace()) {
-        case clang::LangAS::opencl_global:
-            pointerKind = WebCLTypes::GLOBAL_POINTER;
-            break;
-        case clang::LangAS::opencl_constant:
-            pointerKind = WebCLTypes::CONSTANT_POINTER;
-            break;
-        case clang::LangAS::opencl_local:
-            pointerKind = WebCLTypes::LOCAL_POINTER;
-            break;
-        default:
-            pointerKind = WebCLTypes::PRIVATE_POINTER;
-        }
+    } else {
+        pointerKind = WebCLTypes::classifyType(instance, decl->getType()).pointerKind;
     }
 }
 
@@ -471,6 +863,10 @@ WebCLAnalyser::KernelInfo::KernelInfo(clang::CompilerInstance &instance, clang::
 
 bool WebCLAnalyser::handleFunctionDecl(clang::FunctionDecl *decl)
 {
+  // Function bodies are traversed right after their declarations.
+  if (decl->doesThisDeclarationHaveABody())
+    currentFunction_ = decl;
+
   if (!isFromMainFile(decl->getLocStart())) return true;
   
   if (decl->hasAttr<clang::OpenCLKernelAttr>()) {
@@ -505,26 +901,28 @@ bool WebCLAnalyser::handleCallExpr(clang::CallExpr *expr)
       return true;
   }
 
-  if (helperFunctions_.count(callee) > 0) {
+  if (isHelperFunction(callee)) {
     DEBUG( std::cerr << "Looks like it is call to internal function!\n"; );
     internalCalls_.insert(expr);
+    collectEnclosingFunction(expr);
   } else {
     DEBUG( std::cerr << "Looks like it is call to builtin!\n"; );
 
     // LAUNDRY: better to move this logic to builtins class, this api to call it is really unclear
     const std::string name = callee->getNameInfo().getAsString();
-    if (builtins_.isSafe(name)) {
+    if (builtins_->isSafe(name)) {
       info(expr->getLocStart(), "Builtin was found from safe list.");
-    } else if (builtins_.isUnsupported(name)) {
+    } else if (builtins_->isUnsupported(name)) {
       error(expr->getLocStart(), "WebCL doesn't support %0.") << name;
       return true;
-    } else if (builtins_.isUnsafe(name)) {
+    } else if (builtins_->isUnsafe(name)) {
       warning(expr->getLocStart(), "Builtin argument check is still incomplete.");
     } else if (hasUnsafeParameters(expr)) {
       error(expr->getLocStart(), "Unsafe builtin not recognized.");
     }
 
     builtinCalls_.insert(expr);
+    collectEnclosingFunction(expr);
   }
   
   return true;
@@ -585,6 +983,16 @@ bool WebCLAnalyser::handleForStmt(clang::ForStmt *stmt) {
   return true;
 }
 
+bool WebCLAnalyser::handleDeclStmt(clang::DeclStmt *stmt)
+{
+    if (!stmt->isSingleDecl())
+        return true;
+
+    if (clang::VarDecl *decl = llvm::dyn_cast<clang::VarDecl>(stmt->getSingleDecl()))
+        singleDeclarationStatements_[decl] = stmt;
+    return true;
+}
+
 WebCLAnalyser::KernelList &WebCLAnalyser::getKernelFunctions()
 {
     return kernelFunctions_;
@@ -690,11 +1098,103 @@ bool WebCLAnalyser::hasAddressReferences(clang::VarDecl *decl)
     return declarationsWithAddressOfAccess_.count(decl) > 0;
 }
 
+bool WebCLAnalyser::hasEscapingAddress(clang::VarDecl *decl)
+{
+    analyseEscapes();
+    return hasAddressReferences(decl) && (nonEscapingDeclarations_.count(decl) == 0);
+}
+
+bool WebCLAnalyser::isStaticallySafe(clang::Expr *access)
+{
+    analyseEscapes();
+    return staticallySafeAccesses_.count(access) > 0;
+}
+
+bool WebCLAnalyser::isModified(clang::VarDecl *decl)
+{
+    return modifiedDeclarations_.count(decl) > 0;
+}
+
 bool WebCLAnalyser::isInsideForStmt(clang::VarDecl *decl)
 {
     return declarationsMadeInForStatements_.count(decl) > 0;
 }
 
+clang::DeclStmt *WebCLAnalyser::getSingleDeclStmt(clang::VarDecl *decl)
+{
+    std::map<clang::VarDecl*, clang::DeclStmt*>::iterator i =
+        singleDeclarationStatements_.find(decl);
+    return (i != singleDeclarationStatements_.end()) ? i->second : NULL;
+}
+
+clang::FunctionDecl *WebCLAnalyser::getEnclosingFunction(clang::Stmt *stmt)
+{
+    std::map<clang::Stmt*, clang::FunctionDecl*>::iterator i =
+        enclosingFunctions_.find(stmt);
+    return (i != enclosingFunctions_.end()) ? i->second : NULL;
+}
+
+namespace {
+    /// \return Whether the expression is evaluated as a statement of
+    /// its own, i.e. it is followed by a semicolon that ends it.
+    bool isExpressionStatement(clang::Stmt *parent, clang::Expr *expr)
+    {
+        if (llvm::isa<clang::CompoundStmt>(parent))
+            return true;
+        if (clang::IfStmt *ifStmt = llvm::dyn_cast<clang::IfStmt>(parent))
+            return (expr == ifStmt->getThen()) || (expr == ifStmt->getElse());
+        if (clang::WhileStmt *whileStmt = llvm::dyn_cast<clang::WhileStmt>(parent))
+            return expr == whileStmt->getBody();
+        if (clang::DoStmt *doStmt = llvm::dyn_cast<clang::DoStmt>(parent))
+            return expr == doStmt->getBody();
+        if (clang::ForStmt *forStmt = llvm::dyn_cast<clang::ForStmt>(parent))
+            return expr == forStmt->getBody();
+        if (clang::SwitchCase *switchCase = llvm::dyn_cast<clang::SwitchCase>(parent))
+            return expr == switchCase->getSubStmt();
+        if (clang::LabelStmt *label = llvm::dyn_cast<clang::LabelStmt>(parent))
+            return expr == label->getSubStmt();
+        return false;
+    }
+}
+
+WebCLAnalyser::AccessUse WebCLAnalyser::getAccessUse(
+    clang::Expr *access, clang::Expr **storeExpr)
+{
+    clang::FunctionDecl *function = getEnclosingFunction(access);
+    if (!function || !function->getBody())
+        return ACCESS_USE_OTHER;
+
+    clang::ParentMap *&parents = parentMaps_[function];
+    if (!parents)
+        parents = new clang::ParentMap(function->getBody());
+
+    clang::Stmt *parent = parents->getParent(access);
+    if (clang::ImplicitCastExpr *cast = llvm::dyn_cast_or_null<clang::ImplicitCastExpr>(parent)) {
+        if (cast->getCastKind() == clang::CK_LValueToRValue)
+            return ACCESS_USE_LOAD;
+        return ACCESS_USE_OTHER;
+    }
+
+    clang::Expr *store = NULL;
+    if (clang::BinaryOperator *binary = llvm::dyn_cast_or_null<clang::BinaryOperator>(parent)) {
+        if (binary->isAssignmentOp() && (binary->getLHS() == access))
+            store = binary;
+    } else if (clang::UnaryOperator *unary = llvm::dyn_cast_or_null<clang::UnaryOperator>(parent)) {
+        if (unary->isIncrementDecrementOp() && unary->isPostfix())
+            store = unary;
+    }
+    if (!store || (store->getLocStart() != access->getLocStart()) ||
+        store->getLocStart().isMacroID() || store->getLocEnd().isMacroID())
+        return ACCESS_USE_OTHER;
+
+    clang::Stmt *statement = parents->getParent(store);
+    if (!statement || !isExpressionStatement(statement, store))
+        return ACCESS_USE_OTHER;
+    if (storeExpr)
+        *storeExpr = store;
+    return ACCESS_USE_STORE_STATEMENT;
+}
+
 bool WebCLAnalyser::hasUnsafeParameters(clang::CallExpr *callExpr)
 {
     clang::FunctionDecl *decl = callExpr->getDirectCallee();
@@ -702,7 +1202,7 @@ bool WebCLAnalyser::hasUnsafeParameters(clang::CallExpr *callExpr)
     for (unsigned i = 0; i < callExpr->getNumArgs(); ++i) {
 	clang::QualType type = callExpr->getArg(i)->getType();
 	if (type.getTypePtr()->isPointerType() &&
-	    WebCLTypes::reduceType(instance_, type).getAsString() != "image2d_t") {
+	    WebCLTypes::classifyType(instance_, type).opaque != WebCLTypes::IMAGE2D_TYPE) {
 	    return true;
 	}
     }
@@ -710,7 +1210,7 @@ bool WebCLAnalyser::hasUnsafeParameters(clang::CallExpr *callExpr)
     for (unsigned int i = 0; i < decl->getNumParams(); ++i) {
         const clang::ParmVarDecl *param = decl->getParamDecl(i);
         if (param->getType().getTypePtr()->isPointerType() &&
-	    WebCLTypes::reduceType(instance_, param->getType()).getAsString() != "image2d_t")
+	    WebCLTypes::classifyType(instance_, param->getType()).opaque != WebCLTypes::IMAGE2D_TYPE)
             return true;
     }
     return false;
@@ -735,3 +1235,196 @@ void WebCLAnalyser::collectVariable(clang::VarDecl *decl)
             privateVariables_.insert(decl);
     }
 }
+
+void WebCLAnalyser::collectModifiedVariable(clang::Expr *expr)
+{
+    clang::DeclRefExpr *declRef =
+        llvm::dyn_cast<clang::DeclRefExpr>(expr->IgnoreParenImpCasts());
+    if (!declRef)
+        return;
+
+    if (clang::VarDecl *varDecl = llvm::dyn_cast<clang::VarDecl>(declRef->getDecl()))
+        modifiedDeclarations_.insert(varDecl);
+}
+
+void WebCLAnalyser::collectEnclosingFunction(clang::Stmt *stmt)
+{
+    if (currentFunction_)
+        enclosingFunctions_[stmt] = currentFunction_;
+}
+
+namespace {
+    typedef std::set<const clang::VarDecl*> ConstVarDeclSet;
+    typedef std::map<const clang::VarDecl*, std::vector<clang::Expr*> > DereferenceMap;
+
+    /// \return Variable whose address is taken directly by the
+    /// expression, e.g. 'x' of '&x'.
+    const clang::VarDecl *getAddressedVariable(const clang::Expr *expr)
+    {
+        const clang::UnaryOperator *addressOf =
+            llvm::dyn_cast<clang::UnaryOperator>(expr->IgnoreParens());
+        if (!addressOf || (addressOf->getOpcode() != clang::UO_AddrOf))
+            return NULL;
+        const clang::DeclRefExpr *declRef =
+            llvm::dyn_cast<clang::DeclRefExpr>(addressOf->getSubExpr());
+        return declRef ? llvm::dyn_cast<clang::VarDecl>(declRef->getDecl()) : NULL;
+    }
+
+    /// \return Variable whose value is used directly by the
+    /// expression.
+    const clang::VarDecl *getReferencedVariable(const clang::Expr *expr)
+    {
+        const clang::DeclRefExpr *declRef =
+            llvm::dyn_cast<clang::DeclRefExpr>(expr->IgnoreParenImpCasts());
+        return declRef ? llvm::dyn_cast<clang::VarDecl>(declRef->getDecl()) : NULL;
+    }
+
+    /// \return Whether a dereference of the given type covers a
+    /// whole variable of the type.
+    bool isWholeObjectType(clang::QualType type)
+    {
+        return !type->isPointerType() && !type->isArrayType() &&
+            !type->isRecordType();
+    }
+
+    /// \return Whether pointer type points to given variable type.
+    bool pointsToType(clang::QualType pointer, clang::QualType type)
+    {
+        return pointer->getPointeeType().getUnqualifiedType().getCanonicalType() ==
+            type.getUnqualifiedType().getCanonicalType();
+    }
+
+    /// \return Number of expressions listed for the variable.
+    unsigned countDereferences(DereferenceMap &dereferences, const clang::VarDecl *decl)
+    {
+        DereferenceMap::iterator i = dereferences.find(decl);
+        return (i != dereferences.end()) ? i->second.size() : 0;
+    }
+}
+
+void WebCLAnalyser::analyseEscapes()
+{
+    if (escapesAnalysed_)
+        return;
+    escapesAnalysed_ = true;
+
+    // Address taken private variables that can be accessed as a whole.
+    ConstVarDeclSet variables;
+    for (VarDeclSet::iterator i = declarationsWithAddressOfAccess_.begin();
+         i != declarationsWithAddressOfAccess_.end(); ++i) {
+        if (isPrivate(*i) && isWholeObjectType((*i)->getType()))
+            variables.insert(*i);
+    }
+
+    // Private pointer parameters of helper functions that might only
+    // point to such variables.
+    ConstVarDeclSet parameters;
+    for (FunctionDeclSet::iterator i = helperFunctions_.begin();
+         i != helperFunctions_.end(); ++i) {
+        if (!(*i)->doesThisDeclarationHaveABody())
+            continue;
+        for (unsigned j = 0; j < (*i)->getNumParams(); ++j) {
+            const clang::ParmVarDecl *param = (*i)->getParamDecl(j);
+            const clang::QualType type = param->getType();
+            if (type->isPointerType() &&
+                (type->getPointeeType().getAddressSpace() == 0) &&
+                isWholeObjectType(type->getPointeeType())) {
+                parameters.insert(param);
+            }
+        }
+    }
+
+    // Dereferences of variable addresses, '*&x', and of pointer
+    // variables, '*p'.
+    DereferenceMap addressDereferences;
+    DereferenceMap pointerDereferences;
+    for (MemoryAccessMap::iterator i = pointerAccesses_.begin();
+         i != pointerAccesses_.end(); ++i) {
+        clang::UnaryOperator *deref = llvm::dyn_cast<clang::UnaryOperator>(i->first);
+        if (!deref || (deref->getOpcode() != clang::UO_Deref))
+            continue;
+        if (const clang::VarDecl *decl = getAddressedVariable(deref->getSubExpr()))
+            addressDereferences[decl].push_back(deref);
+        else if (const clang::VarDecl *decl = getReferencedVariable(deref->getSubExpr()))
+            pointerDereferences[decl].push_back(deref);
+    }
+
+    // Arguments passed to helper function parameters.
+    typedef std::vector< std::pair<const clang::ParmVarDecl*, const clang::Expr*> > ArgumentList;
+    ArgumentList arguments;
+    for (CallExprSet::iterator i = internalCalls_.begin(); i != internalCalls_.end(); ++i) {
+        const clang::FunctionDecl *definition = NULL;
+        clang::FunctionDecl *callee = (*i)->getDirectCallee();
+        if (!callee || !callee->hasBody(definition))
+            continue;
+        for (unsigned j = 0; (j < (*i)->getNumArgs()) && (j < definition->getNumParams()); ++j)
+            arguments.push_back(std::make_pair(definition->getParamDecl(j), (*i)->getArg(j)));
+    }
+
+    std::map<const clang::VarDecl*, unsigned> uses;
+    for (DeclRefExprSet::iterator i = variableUses_.begin(); i != variableUses_.end(); ++i) {
+        if (const clang::VarDecl *decl = llvm::dyn_cast<clang::VarDecl>((*i)->getDecl()))
+            ++uses[decl];
+    }
+
+    // Assume that nothing escapes and drop variables and parameters
+    // until every remaining address reference and parameter use is
+    // known to be safe.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        std::map<const clang::VarDecl*, unsigned> safeAddresses;
+        std::map<const clang::VarDecl*, unsigned> safeUses;
+
+        for (ArgumentList::iterator i = arguments.begin(); i != arguments.end(); ++i) {
+            const clang::ParmVarDecl *param = i->first;
+            const bool accepted = parameters.count(param) > 0;
+
+            if (const clang::VarDecl *decl = getAddressedVariable(i->second)) {
+                if (accepted && variables.count(decl) && pointsToType(param->getType(), decl->getType())) {
+                    ++safeAddresses[decl];
+                    continue;
+                }
+            } else if (const clang::VarDecl *decl = getReferencedVariable(i->second)) {
+                if (accepted && parameters.count(decl) &&
+                    (param->getType().getCanonicalType() == decl->getType().getCanonicalType())) {
+                    ++safeUses[decl];
+                    continue;
+                }
+            }
+
+            if (parameters.erase(param))
+                changed = true;
+        }
+
+        for (ConstVarDeclSet::iterator i = variables.begin(); i != variables.end();) {
+            const clang::VarDecl *decl = *i++;
+            const unsigned safe = safeAddresses[decl] + countDereferences(addressDereferences, decl);
+            if (safe != addressReferenceCounts_[decl]) {
+                variables.erase(decl);
+                changed = true;
+            }
+        }
+
+        for (ConstVarDeclSet::iterator i = parameters.begin(); i != parameters.end();) {
+            const clang::VarDecl *decl = *i++;
+            const unsigned safe = safeUses[decl] + countDereferences(pointerDereferences, decl);
+            if (safe != uses[decl]) {
+                parameters.erase(decl);
+                changed = true;
+            }
+        }
+    }
+
+    nonEscapingDeclarations_ = variables;
+
+    for (ConstVarDeclSet::iterator i = variables.begin(); i != variables.end(); ++i) {
+        std::vector<clang::Expr*> &accesses = addressDereferences[*i];
+        staticallySafeAccesses_.insert(accesses.begin(), accesses.end());
+    }
+    for (ConstVarDeclSet::iterator i = parameters.begin(); i != parameters.end(); ++i) {
+        std::vector<clang::Expr*> &accesses = pointerDereferences[*i];
+        staticallySafeAccesses_.insert(accesses.begin(), accesses.end());
+    }
+}
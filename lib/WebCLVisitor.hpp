@@ -25,6 +25,7 @@
 */
 
 #include "WebCLBuiltins.hpp"
+#include "WebCLHelper.hpp"
 #include "WebCLReporter.hpp"
 #include "WebCLTypes.hpp"
 
@@ -33,8 +34,11 @@
 #include <vector>
 
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
 
 namespace clang {
+    class ParentMap;
     class TranslationUnitDecl;
 }
 
@@ -46,17 +50,91 @@ namespace clang {
 /// - Visitors that analyze a valid WebCL AST and collect information
 ///   for transformation passes.
 ///
-/// This class also replaces Visit-methods of RecursiveASTVisitor with
-/// corresponding polymorphic handle-methods so that it would be
-/// easier to build visitor hierarchies.
+/// Visitors don't walk the AST themselves. They are registered to a
+/// WebCLTraversal, which calls the polymorphic handle-methods of
+/// every visitor for each node so that the AST is walked only once.
 class WebCLVisitor : public WebCLReporter
-                   , public clang::RecursiveASTVisitor<WebCLVisitor>
 {
 public:
 
     explicit WebCLVisitor(clang::CompilerInstance &instance);
     virtual ~WebCLVisitor();
 
+protected:
+
+    /// \return New visitor that handles the nodes of the given
+    /// function body instead of this visitor, or NULL if the body
+    /// can't be handled separately. Forks of different bodies are
+    /// run concurrently, so they may touch shared state only through
+    /// thread safe functions.
+    virtual WebCLVisitor *forkBody(clang::FunctionDecl *decl);
+    /// Takes over the nodes that a fork returned by forkBody has
+    /// collected. Forks are joined in source order when the
+    /// traversal reaches their bodies.
+    virtual void joinBody(WebCLVisitor *fork);
+
+    virtual bool handleTranslationUnitDecl(clang::TranslationUnitDecl *decl);
+    virtual bool handleFunctionDecl(clang::FunctionDecl *decl);
+    virtual bool handleParmVarDecl(clang::ParmVarDecl *decl);
+    virtual bool handleVarDecl(clang::VarDecl *decl);
+
+    virtual bool handleDeclStmt(clang::DeclStmt *stmt);
+
+    virtual bool handleArraySubscriptExpr(clang::ArraySubscriptExpr *expr);
+    virtual bool handleUnaryOperator(clang::UnaryOperator *expr);
+    virtual bool handleBinaryOperator(clang::BinaryOperator *expr);
+    virtual bool handleMemberExpr(clang::MemberExpr *expr);
+    virtual bool handleExtVectorElementExpr(clang::ExtVectorElementExpr *expr);
+    virtual bool handleCallExpr(clang::CallExpr *expr);
+    virtual bool handleTypedefDecl(clang::TypedefDecl *decl);
+    virtual bool handleRecordDecl(clang::RecordDecl *decl);
+    virtual bool handleDeclRefExpr(clang::DeclRefExpr *expr);
+    virtual bool handleForStmt(clang::ForStmt *stmt);
+
+    friend class WebCLTraversal;
+};
+
+/// \brief Walks the AST once for all registered visitors.
+///
+/// Each node is handed to the visitors in the order in which they
+/// were added. Top-level declarations that come from other files
+/// than the main file, such as the included builtin declarations,
+/// are skipped together with their children.
+///
+/// With several threads the bodies of top-level functions are
+/// handled first by forks of the visitors on worker threads. The
+/// diagnostics of each body are buffered and the forks are joined
+/// when the walk reaches the body, so the visitors end up in the
+/// same state and report the same diagnostics in the same order as
+/// after a walk on a single thread.
+class WebCLTraversal : public WebCLReporter
+                     , public clang::RecursiveASTVisitor<WebCLTraversal>
+{
+public:
+
+    explicit WebCLTraversal(clang::CompilerInstance &instance, unsigned threads = 1);
+    ~WebCLTraversal();
+
+    /// Registers a visitor that will handle the nodes of the next
+    /// traversal.
+    void addVisitor(WebCLVisitor *visitor);
+
+    /// Walks the translation unit. The walk stops if some visitor
+    /// fails to handle a node.
+    void traverse(clang::TranslationUnitDecl *decl);
+
+    /// Skips top-level declarations that aren't expanded in the
+    /// main file.
+    ///
+    /// \see clang::RecursiveASTVisitor::TraverseDecl
+    bool TraverseDecl(clang::Decl *decl);
+
+    /// Joins the forks that have handled the statement if it is a
+    /// function body handled on a worker thread.
+    ///
+    /// \see clang::RecursiveASTVisitor::TraverseStmt
+    bool TraverseStmt(clang::Stmt *stmt);
+
     /// \see clang::RecursiveASTVisitor::VisitTranslationUnitDecl
     bool VisitTranslationUnitDecl(clang::TranslationUnitDecl *decl);
     /// \see clang::RecursiveASTVisitor::VisitFunctionDecl
@@ -73,6 +151,8 @@ public:
     bool VisitArraySubscriptExpr(clang::ArraySubscriptExpr *expr);
     /// \see clang::RecursiveASTVisitor::VisitUnaryOperator
     bool VisitUnaryOperator(clang::UnaryOperator *expr);
+    /// \see clang::RecursiveASTVisitor::VisitBinaryOperator
+    bool VisitBinaryOperator(clang::BinaryOperator *expr);
     /// \see clang::RecursiveASTVisitor::MemberExpr
     bool VisitMemberExpr(clang::MemberExpr *expr);
     /// \see clang::RecursiveASTVisitor::ExtVectorElementExpr
@@ -88,24 +168,37 @@ public:
     /// \see clang::RecursiveASTVisitor::VisitForStmt
     bool VisitForStmt(clang::ForStmt *stmt);
   
-protected:
-
-    virtual bool handleTranslationUnitDecl(clang::TranslationUnitDecl *decl);
-    virtual bool handleFunctionDecl(clang::FunctionDecl *decl);
-    virtual bool handleParmVarDecl(clang::ParmVarDecl *decl);
-    virtual bool handleVarDecl(clang::VarDecl *decl);
-
-    virtual bool handleDeclStmt(clang::DeclStmt *stmt);
+private:
 
-    virtual bool handleArraySubscriptExpr(clang::ArraySubscriptExpr *expr);
-    virtual bool handleUnaryOperator(clang::UnaryOperator *expr);
-    virtual bool handleMemberExpr(clang::MemberExpr *expr);
-    virtual bool handleExtVectorElementExpr(clang::ExtVectorElementExpr *expr);
-    virtual bool handleCallExpr(clang::CallExpr *expr);
-    virtual bool handleTypedefDecl(clang::TypedefDecl *decl);
-    virtual bool handleRecordDecl(clang::RecordDecl *decl);
-    virtual bool handleDeclRefExpr(clang::DeclRefExpr *expr);
-    virtual bool handleForStmt(clang::ForStmt *stmt);
+    /// \return Whether the declaration is at the top level and comes
+    /// from another file than the main file.
+    bool isOutsideMainFile(clang::Decl *decl) const;
+
+    typedef std::vector<WebCLVisitor*> Visitors;
+    Visitors visitors_;
+
+    /// Forks and buffered diagnostics of a function body.
+    struct BodyJob;
+    /// Jobs that worker threads take in turns.
+    struct BodyQueue;
+    typedef std::map<clang::Stmt*, BodyJob*> BodyJobs;
+
+    /// Handles the bodies of top-level functions on worker threads
+    /// if all visitors can be forked.
+    void forkBodies(clang::TranslationUnitDecl *decl);
+    /// Replays the diagnostics of the body and joins its forks.
+    ///
+    /// \return Whether all forks handled the body successfully.
+    bool joinBody(BodyJob &job);
+    /// Deletes remaining forks.
+    void clearBodies();
+    /// Entry point of worker threads.
+    static void *runBodies(void *queue);
+
+    /// Number of threads that handle function bodies.
+    unsigned threads_;
+    /// Function bodies that have been handled by forks.
+    BodyJobs bodyJobs_;
 };
 
 /// \brief Complains about WebCL limitations in OpenCL C code.
@@ -119,6 +212,13 @@ public:
     /// \see WebCLVisitor::handleParmVar
     virtual bool handleParmVarDecl(clang::ParmVarDecl *decl);
 
+protected:
+
+    /// The restrictor has no state, so a new restrictor will do.
+    ///
+    /// \see WebCLVisitor::forkBody
+    virtual WebCLVisitor *forkBody(clang::FunctionDecl *decl);
+
 private:
 
     /// Checks that structures aren't passed to kernels.
@@ -168,6 +268,11 @@ public:
   /// \see WebCLVisitor::handleUnaryOperator
   virtual bool handleUnaryOperator(clang::UnaryOperator *expr);
 
+  /// Collect variables that are assigned to.
+  ///
+  /// \see WebCLVisitor::handleBinaryOperator
+  virtual bool handleBinaryOperator(clang::BinaryOperator *expr);
+
   /// Collect functions whose signatures must be changed.
   ///
   /// - Collects kernels and their pointer parameters so that
@@ -215,6 +320,14 @@ public:
   ///         have been normalized.
   virtual bool handleForStmt(clang::ForStmt *stmt);
 
+  /// Collects statements that declare a single variable.
+  ///
+  /// - Relocated arrays declared alone can be initialized directly
+  ///   in their relocated storage.
+  ///
+  /// \see WebCLVisitor::handleDeclStmt
+  virtual bool handleDeclStmt(clang::DeclStmt *stmt);
+
   /// Collected nodes.
   struct KernelArgInfo {
       /// Not exposed outside the library
@@ -239,21 +352,26 @@ public:
       std::string name;
       /// Kernel arguments
       std::vector<KernelArgInfo> args;
+      /// Instrumentation facts, filled in after transformations
+      KernelReport report;
 
       KernelInfo(clang::CompilerInstance &instance, clang::FunctionDecl *decl);
   };
 
-  typedef std::set<clang::FunctionDecl*> FunctionDeclSet;
+  /// Collected nodes are iterated in the order they were visited,
+  /// i.e. in source order, so that the output doesn't depend on
+  /// where the nodes happen to be allocated.
+  typedef llvm::SetVector<clang::FunctionDecl*> FunctionDeclSet;
   typedef std::vector<KernelInfo> KernelList;
-  typedef std::set<clang::CallExpr*> CallExprSet;
-  typedef std::set<clang::VarDecl*> VarDeclSet;
-  typedef std::set<clang::DeclRefExpr*> DeclRefExprSet;
+  typedef llvm::SetVector<clang::CallExpr*> CallExprSet;
+  typedef llvm::SetVector<clang::VarDecl*> VarDeclSet;
+  typedef llvm::SetVector<clang::DeclRefExpr*> DeclRefExprSet;
   typedef std::vector<clang::TypeDecl*> TypeDeclList;
 
   /// Memory accesses and corresponding declarations, this will change
   /// if separate dependence analysis is added to resolve which limits
   /// each memory access should respect.
-  typedef std::map<clang::Expr*, clang::VarDecl*> MemoryAccessMap;
+  typedef llvm::MapVector<clang::Expr*, clang::VarDecl*> MemoryAccessMap;
   
   /// Accessors for collected data.
   KernelList &getKernelFunctions();
@@ -282,21 +400,94 @@ public:
   /// \return Whether address of variable is taken.
   bool hasAddressReferences(clang::VarDecl *decl);
 
+  /// \return Whether address of variable is taken and may flow into
+  /// a memory access that isn't statically safe. Variables whose
+  /// address is only dereferenced directly, or passed to helper
+  /// function parameters that are only dereferenced, don't need to
+  /// be relocated.
+  bool hasEscapingAddress(clang::VarDecl *decl);
+
+  /// \return Whether memory access can only refer to a whole
+  /// variable that doesn't need to be relocated. Such accesses
+  /// don't need to be checked.
+  bool isStaticallySafe(clang::Expr *access);
+
+  /// \return Whether variable is assigned to, or incremented or
+  /// decremented, after its declaration.
+  bool isModified(clang::VarDecl *decl);
+
   /// \return Whether variable has been declared in first for clause.
   bool isInsideForStmt(clang::VarDecl *decl);
 
+  /// \return Declaration statement that declares only the given
+  /// variable. NULL if the statement declares other variables too.
+  clang::DeclStmt *getSingleDeclStmt(clang::VarDecl *decl);
+
+  /// How the value of a memory access is used.
+  enum AccessUse {
+      /// The value is read and nothing else is done with the access.
+      ACCESS_USE_LOAD,
+      /// The access is assigned to, incremented or decremented by a
+      /// whole expression statement that starts with the access.
+      ACCESS_USE_STORE_STATEMENT,
+      /// Any other use, e.g. the address of the access is taken.
+      ACCESS_USE_OTHER
+  };
+
+  /// \return How the value of a collected memory access is used.
+  /// For store statements the assignment, increment or decrement
+  /// expression is returned in storeExpr if given.
+  AccessUse getAccessUse(clang::Expr *access, clang::Expr **storeExpr = NULL);
+
+  /// \return Function whose body contains the given memory access
+  /// or call. NULL if the statement wasn't collected.
+  clang::FunctionDecl *getEnclosingFunction(clang::Stmt *stmt);
+
   /// \return Whether a function call passes pointer parameter or if the
   /// function declaration takes pointer parameters.
   bool hasUnsafeParameters(clang::CallExpr *expr);
 
+protected:
+
+  /// Collects the nodes of a function body into a new analyser.
+  ///
+  /// \see WebCLVisitor::forkBody
+  virtual WebCLVisitor *forkBody(clang::FunctionDecl *decl);
+
+  /// Appends the nodes collected from a function body.
+  ///
+  /// \see WebCLVisitor::joinBody
+  virtual void joinBody(WebCLVisitor *fork);
+
 private:
 
+  /// Creates a fork that collects the body of the given function.
+  WebCLAnalyser(WebCLAnalyser &parent, clang::FunctionDecl *function);
+
+  /// \return Whether the function is a user defined helper
+  /// function.
+  bool isHelperFunction(clang::FunctionDecl *decl) const;
+
   /// \return Whether a variable is stored in private address space.
   bool isPrivate(clang::VarDecl *decl) const;
 
   /// Save variable into address space specific variable collection.
   void collectVariable(clang::VarDecl *decl);
 
+  /// Save variable that is directly referred by the given expression
+  /// into the collection of modified variables.
+  void collectModifiedVariable(clang::Expr *expr);
+
+  /// Remember the function whose body is currently being traversed
+  /// as the enclosing function of the given statement.
+  void collectEnclosingFunction(clang::Stmt *stmt);
+
+  /// Finds out which address references of private variables flow
+  /// only into statically safe accesses. Interprocedural, but
+  /// follows addresses only through helper function parameters that
+  /// are dereferenced or passed on as such.
+  void analyseEscapes();
+
   /// User defined kernels.
   KernelList kernelFunctions_;
   /// User defined functions.
@@ -313,16 +504,36 @@ private:
   VarDeclSet privateVariables_;
   /// Variables whose address has been taken with the & operator.
   VarDeclSet declarationsWithAddressOfAccess_;
+  /// Number of times the address of each variable is taken.
+  std::map<const clang::VarDecl*, unsigned> addressReferenceCounts_;
+  /// Whether escape analysis has been done.
+  bool escapesAnalysed_;
+  /// Address taken variables that don't need to be relocated.
+  std::set<const clang::VarDecl*> nonEscapingDeclarations_;
+  /// Accesses that can't refer outside of a whole variable.
+  std::set<const clang::Expr*> staticallySafeAccesses_;
+  /// Variables that are assigned to, or incremented or decremented.
+  VarDeclSet modifiedDeclarations_;
   /// Variables declared in the first for clause.
   VarDeclSet declarationsMadeInForStatements_;
+  /// Statements that declare a single variable.
+  std::map<clang::VarDecl*, clang::DeclStmt*> singleDeclarationStatements_;
   /// All uses of variable declarations.
   DeclRefExprSet variableUses_;
   /// Field accesses with -> operator.
   MemoryAccessMap pointerAccesses_;
   /// Typedefs and record declarations.
   TypeDeclList typeDeclList_;
-  /// All unsupported and unsafe builtins.
-  WebCLBuiltins   builtins_;
+  /// Function whose body is currently being traversed.
+  clang::FunctionDecl *currentFunction_;
+  /// Enclosing functions of memory accesses and calls.
+  std::map<clang::Stmt*, clang::FunctionDecl*> enclosingFunctions_;
+  /// Parents of statements of functions, created when needed.
+  std::map<clang::FunctionDecl*, clang::ParentMap*> parentMaps_;
+  /// Analyser that will join this fork, NULL if this isn't a fork.
+  WebCLAnalyser *parent_;
+  /// All unsupported and unsafe builtins, shared with forks.
+  WebCLBuiltins *builtins_;
 };
 
 #endif // WEBCLVALIDATOR_WEBCLVISITOR
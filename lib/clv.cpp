@@ -34,6 +34,8 @@
 
 #include "WebCLArguments.hpp"
 #include "WebCLDiag.hpp"
+#include "WebCLOptions.hpp"
+#include "WebCLSourceMap.hpp"
 #include "WebCLVisitor.hpp"
 
 struct WebCLValidator
@@ -43,6 +45,7 @@ public:
     WebCLValidator(
         const std::string &inputSource,
         const std::set<std::string> &extensions,
+        const WebCLOptions &options,
         int argc,
         char const* argv[]);
     ~WebCLValidator();
@@ -53,6 +56,10 @@ public:
     const std::string &getValidatedSource() const { return validatedSource_; }
     /// Ditto for kernel info
     const WebCLAnalyser::KernelList &getKernels() const { return kernels_; }
+    /// Ditto for locations of counted memory access checks
+    const CheckSiteList &getCheckSites() const { return checkSites_; }
+    /// Ditto for origins of the validated source in the input source
+    const std::string &getSourceMappings() const { return sourceMappings_; }
 
     unsigned getNumWarnings() const { return diag->getNumWarnings(); }
     unsigned getNumErrors() const { return diag->getNumErrors(); }
@@ -61,9 +68,11 @@ public:
 
 private:
 
+    std::string inputSource;
     WebCLArguments arguments;
     WebCLDiag *diag;
     std::set<std::string> extensions;
+    WebCLOptions options;
 
     // Exit status for run()
     int exitStatus_;
@@ -71,17 +80,28 @@ private:
     std::string validatedSource_;
     /// Ditto for kernel info
     WebCLAnalyser::KernelList kernels_;
+    /// Ditto for check sites
+    CheckSiteList checkSites_;
+    /// Ditto for origins of the validated source, encoded as source
+    /// map mappings
+    std::string sourceMappings_;
+    /// Maps the input of the running stage back to the input source
+    /// for the log messages.
+    WebCLSourceMap sourceMap_;
 };
 
 WebCLValidator::WebCLValidator(
     const std::string &inputSource,
     const std::set<std::string> &extensions,
+    const WebCLOptions &options,
     int argc,
     char const* argv[])
-    : arguments(inputSource, argc, argv)
+    : inputSource(inputSource), arguments(inputSource, argc, argv)
     , diag(new WebCLDiag())
-    , extensions(extensions), exitStatus_(-1)
+    , extensions(extensions), options(options), exitStatus_(-1)
+    , sourceMap_()
 {
+    diag->setSourceMap(this->inputSource, sourceMap_);
 }
 
 WebCLValidator::~WebCLValidator()
@@ -130,11 +150,13 @@ void WebCLValidator::run()
                                            preprocessorInput, matcher1Input);
     preprocessorTool.setDiagnosticConsumer(diag);
     preprocessorTool.setExtensions(extensions);
+    preprocessorTool.setOptions(options);
     const int preprocessorStatus = preprocessorTool.run();
     if (preprocessorStatus) {
         exitStatus_ = EXIT_FAILURE;
         return;
     }
+    sourceMap_ = preprocessorTool.getSourceMap();
 
     // TODO: augment matcher/validator argv with -Dcl_khr_fp16 etc
     // based on which extension enable #pragmas have been encountered in preprocessing
@@ -169,30 +191,43 @@ void WebCLValidator::run()
                                    matcher1Input, matcher2Input);
     matcher1Tool.setDiagnosticConsumer(diag);
     matcher1Tool.setExtensions(extensions);
+    matcher1Tool.setOptions(options);
     const int matcher1Status = matcher1Tool.run();
     if (matcher1Status) {
         exitStatus_ = EXIT_FAILURE;
         return;
     }
+    sourceMap_.append(matcher1Tool.getSourceMap());
 
     WebCLMatcher2Tool matcher2Tool(matcher2Argc, matcher2Argv,
                                    matcher2Input, validatorInput);
     matcher2Tool.setDiagnosticConsumer(diag);
     matcher2Tool.setExtensions(extensions);
+    matcher2Tool.setOptions(options);
     const int matcher2Status = matcher2Tool.run();
     if (matcher2Status) {
         exitStatus_ = EXIT_FAILURE;
         return;
     }
+    sourceMap_.append(matcher2Tool.getSourceMap());
 
     WebCLValidatorTool validatorTool(validatorArgc, validatorArgv,
                                      validatorInput);
     validatorTool.setDiagnosticConsumer(diag);
     validatorTool.setExtensions(extensions);
+    validatorTool.setOptions(options);
     const int validatorStatus = validatorTool.run();
     validatedSource_ = validatorTool.getValidatedSource();
     kernels_ = validatorTool.getKernels();
+    checkSites_ = validatorTool.getCheckSites();
     exitStatus_ = validatorStatus;
+
+    if (exitStatus_ == EXIT_SUCCESS) {
+        // Chain the last stage too so that the validated source maps
+        // back to the input source.
+        sourceMap_.append(validatorTool.getSourceMap());
+        sourceMap_.encode(validatedSource_, inputSource, sourceMappings_);
+    }
 }
 
 CLV_API extern "C" clv_program CLV_CALL clvValidate(
@@ -202,6 +237,20 @@ CLV_API extern "C" clv_program CLV_CALL clvValidate(
     void (CL_CALLBACK *pfn_notify)(clv_program program, void *user_data),
     void *notify_data,
     cl_int *errcode_ret)
+{
+    return clvValidateWithOptions(
+        input_source, active_extensions, user_defines, NULL,
+        pfn_notify, notify_data, errcode_ret);
+}
+
+CLV_API extern "C" clv_program CLV_CALL clvValidateWithOptions(
+    const char *input_source,
+    const char **active_extensions,
+    const char **user_defines,
+    const char *options,
+    void (CL_CALLBACK *pfn_notify)(clv_program program, void *user_data),
+    void *notify_data,
+    cl_int *errcode_ret)
 {
     if (!input_source || !*input_source) {
         if (errcode_ret)
@@ -209,6 +258,14 @@ CLV_API extern "C" clv_program CLV_CALL clvValidate(
         return NULL;
     }
 
+    WebCLOptions validatorOptions;
+    std::string optionsError;
+    if (options && !validatorOptions.parse(options, optionsError)) {
+        if (errcode_ret)
+            *errcode_ret = CL_INVALID_BUILD_OPTIONS;
+        return NULL;
+    }
+
     std::set<std::string> extensions;
     while (active_extensions && *active_extensions)
         extensions.insert(*(active_extensions++));
@@ -221,7 +278,7 @@ CLV_API extern "C" clv_program CLV_CALL clvValidate(
     for (std::set<std::string>::const_iterator i = defineArgs.begin(); i != defineArgs.end(); ++i)
         argv.push_back(i->c_str());
 
-    WebCLValidator *validator = new WebCLValidator(input_source, extensions, argv.size(), argv.empty() ? NULL : &argv[0]);
+    WebCLValidator *validator = new WebCLValidator(input_source, extensions, validatorOptions, argv.size(), argv.empty() ? NULL : &argv[0]);
 
     // TODO: run in thread, call user callback when done if provided
     validator->run();
@@ -354,6 +411,24 @@ CLV_API extern "C" cl_long CLV_CALL clvGetProgramLogMessageSourceOffset(
     return messages[n].sourceOffset;
 }
 
+CLV_API extern "C" cl_long CLV_CALL clvGetProgramLogMessageInputLine(
+    clv_program program,
+    cl_uint n)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    const std::vector<WebCLDiag::Message> &messages = program->getLogMessages();
+
+    if (n >= messages.size())
+        return CL_INVALID_VALUE;
+
+    if (!clvProgramLogMessageHasSource(program, n))
+        return CL_INVALID_OPERATION;
+
+    return messages[n].inputLine;
+}
+
 CLV_API extern "C" size_t CLV_CALL clvGetProgramLogMessageSourceLen(
     clv_program program,
     cl_uint n)
@@ -587,6 +662,95 @@ CLV_API extern "C" cl_kernel_arg_access_qualifier CLV_CALL clvGetKernelArgAccess
     }
 }
 
+CLV_API extern "C" cl_long CLV_CALL clvGetKernelReportItem(
+    clv_program program,
+    cl_uint kernel,
+    clv_kernel_report_item item)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    const WebCLAnalyser::KernelList &kernels = program->getKernels();
+
+    if (kernel >= kernels.size())
+        return CL_INVALID_VALUE;
+
+    const KernelReport &report = kernels[kernel].report;
+
+    switch (item) {
+    case CLV_KERNEL_REPORT_PRIVATE_CHECKS:
+        return report.privateChecks;
+    case CLV_KERNEL_REPORT_LOCAL_CHECKS:
+        return report.localChecks;
+    case CLV_KERNEL_REPORT_CONSTANT_CHECKS:
+        return report.constantChecks;
+    case CLV_KERNEL_REPORT_GLOBAL_CHECKS:
+        return report.globalChecks;
+    case CLV_KERNEL_REPORT_CHECK_LIMITS:
+        return report.checkLimits;
+    case CLV_KERNEL_REPORT_MAX_CHECK_LIMITS:
+        return report.maxCheckLimits;
+    case CLV_KERNEL_REPORT_PRIVATE_BYTES:
+        return report.privateBytes;
+    case CLV_KERNEL_REPORT_LOCAL_BYTES:
+        return report.localBytes;
+    case CLV_KERNEL_REPORT_CONSTANT_BYTES:
+        return report.constantBytes;
+    case CLV_KERNEL_REPORT_WRAPPERS:
+        return report.wrappers;
+    case CLV_KERNEL_REPORT_ALLOCATIONS_BYTES:
+        return report.allocationsBytes;
+    case CLV_KERNEL_REPORT_LOCAL_ZEROING_BYTES:
+        return report.localZeroingBytes;
+    case CLV_KERNEL_REPORT_ADDED_PARAMETERS:
+        return report.addedParameters;
+    default:
+        return CL_INVALID_VALUE;
+    }
+}
+
+CLV_API extern "C" cl_int CLV_CALL clvGetProgramCheckSiteCount(
+    clv_program program)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    if (program->getExitStatus() != EXIT_SUCCESS)
+        return 0;
+
+    return program->getCheckSites().size();
+}
+
+CLV_API extern "C" cl_long CLV_CALL clvGetProgramCheckSiteLine(
+    clv_program program,
+    cl_uint n)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    const CheckSiteList &sites = program->getCheckSites();
+
+    if (n >= sites.size())
+        return CL_INVALID_VALUE;
+
+    return sites[n].line;
+}
+
+CLV_API extern "C" cl_long CLV_CALL clvGetProgramCheckSiteColumn(
+    clv_program program,
+    cl_uint n)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    const CheckSiteList &sites = program->getCheckSites();
+
+    if (n >= sites.size())
+        return CL_INVALID_VALUE;
+
+    return sites[n].column;
+}
+
 CLV_API cl_int CLV_CALL clvGetProgramValidatedSource(
     clv_program program,
     size_t source_buf_size,
@@ -606,6 +770,25 @@ CLV_API cl_int CLV_CALL clvGetProgramValidatedSource(
     return returnString(source, source_buf_size, source_buf, source_size_ret);
 }
 
+CLV_API cl_int CLV_CALL clvGetProgramSourceMap(
+    clv_program program,
+    size_t map_buf_size,
+    char *map_buf,
+    size_t *map_size_ret)
+{
+    if (!program)
+        return CL_INVALID_PROGRAM;
+
+    if (map_buf && !map_buf_size)
+        return CL_INVALID_VALUE;
+
+    std::string mappings;
+    if (program->getExitStatus() == EXIT_SUCCESS)
+        mappings = program->getSourceMappings();
+
+    return returnString(mappings, map_buf_size, map_buf, map_size_ret);
+}
+
 CLV_API extern "C" void CLV_CALL clvReleaseProgram(
     clv_program program)
 {
@@ -1,22 +1,37 @@
+//@ Each "//@ fragment <name> [requires <name>...]" line starts a
+//@ fragment that is emitted only if the generated code uses it or a
+//@ fragment that requires it. Text before the first fragment and
+//@ after "//@ end" is emitted around the used fragments. Lines
+//@ starting with "//@" aren't emitted.
 // => General code that doesn't depend on input.
 
+//@ fragment memcpy
 #define _WCL_MEMCPY(dst, src) for(ulong i = 0; i < sizeof((src))/sizeof((src)[0]); i++) { (dst)[i] = (src)[i]; }
 
+//@ fragment fill-zero
+#define _WCL_FILL_ZERO(dst, begin) for(ulong i = (begin); i < sizeof((dst))/sizeof((dst)[0]); i++) { (dst)[i] = 0; }
+
+//@ fragment last
 #define _WCL_LAST(type, ptr) (((type)(ptr)) - 1)
-#define _WCL_FILLCHAR ((uchar)0xCC)
 
-// POCL crashes at run time if the parameters are local character
-// pointers.
-typedef uint _WclInitType;
+//@ fragment fill
+#define _WCL_FILLCHAR ((uchar)0xCC)
+#define _WCL_FILLWORD ((uint)0xCCCCCCCC)
 
+//@ fragment set-null
 // NOTE: this expects that null pointer is type of uint*
 #define _WCL_SET_NULL(type, req_bytes, min, max, null) ( ((((type)max)-((type)min))*sizeof(uint) >= req_bytes) ? ((type)min) : (null) )
 
+//@ fragment local-range-init requires fill
 #ifdef cl_khr_initialize_memory
 #pragma OPENCL EXTENSION cl_khr_initialize_memory : enable
 #define _WCL_LOCAL_RANGE_INIT(begin, end)
 #else
 
+// Fills a local memory range cooperatively with all work items of
+// the work group. Bytes before the first and after the last 16 byte
+// boundary are written one at a time, the rest of the range with
+// uint4 stores. Consecutive work items write consecutive elements.
 #define _WCL_LOCAL_RANGE_INIT(begin, end) do {               \
     __local uchar *start = (__local uchar *)begin;           \
     __local uchar *stop = (__local uchar *)end;              \
@@ -27,18 +42,45 @@ typedef uint _WclInitType;
         (get_local_id(0) * yz_items) +                       \
         (get_local_id(1) * z_items) +                        \
         get_local_id(2);                                     \
+    const size_t wide = sizeof(uint4);                       \
     size_t item_count = stop - start;                        \
-    size_t items_per_kernel = item_count / xyz_items;        \
-    size_t items_offset = items_per_kernel * item_index;     \
-    size_t reminders = item_count % xyz_items;               \
-    if (item_index < reminders) {                            \
-        start[xyz_items*items_per_kernel + item_index] = _WCL_FILLCHAR; \
-    }                                                                   \
-    for (size_t i = 0; i < items_per_kernel; i++) {                     \
-        start[items_offset+i] = _WCL_FILLCHAR;                          \
-    }                                                                   \
-} while (0)                                                             \
+    size_t head_count = (wide - ((size_t)start & (wide - 1))) & (wide - 1); \
+    if (head_count > item_count) {                           \
+        head_count = item_count;                             \
+    }                                                        \
+    size_t wide_count = (item_count - head_count) / wide;    \
+    __local uint4 *wide_start = (__local uint4 *)(start + head_count); \
+    __local uchar *tail = start + head_count + (wide_count * wide);    \
+    size_t tail_count = stop - tail;                                   \
+    for (size_t i = item_index; i < head_count; i += xyz_items) {      \
+        start[i] = _WCL_FILLCHAR;                                      \
+    }                                                                  \
+    for (size_t i = item_index; i < wide_count; i += xyz_items) {      \
+        wide_start[i] = (uint4)(_WCL_FILLWORD);                        \
+    }                                                                  \
+    for (size_t i = item_index; i < tail_count; i += xyz_items) {      \
+        tail[i] = _WCL_FILLCHAR;                                       \
+    }                                                                  \
+} while (0)                                                            \
+
+#endif // cl_khr_initialize_memory
+
+//@ fragment local-item-range-init requires local-range-init
+#ifdef cl_khr_initialize_memory
+#define _WCL_LOCAL_ITEM_RANGE_INIT(begin, end, type)
+#else
+
+// Fills a local memory range unless it holds exactly one element for
+// each work item in the first dimension. The kernel writes such
+// ranges completely before reading them.
+#define _WCL_LOCAL_ITEM_RANGE_INIT(begin, end, type) do {                \
+    if (((__local uchar *)(end) - (__local uchar *)(begin)) !=           \
+        (get_local_size(0) * sizeof(type))) {                            \
+        _WCL_LOCAL_RANGE_INIT(begin, end);                               \
+    }                                                                    \
+} while (0)                                                              \
 
 #endif // cl_khr_initialize_memory
 
+//@ end
 // <= General code that doesn't depend on input.
@@ -11,15 +11,15 @@ int get_indexed_value(
     __global int *array, int index)
 {
     const int triple[3] = { 0, 1, 2 };
-    // CHECK: const int sum1 = (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(0), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(index), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
+    // CHECK: const int sum1 = (*(_wcl_checked_0 = _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_checked_1 = _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(0), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_checked_2 = _wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(index), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
     const int sum1 = array[index] + array[0] + triple[index];
-    // CHECK: const int sum2 = (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(0), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(1), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(2), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
+    // CHECK: const int sum2 = (*(_wcl_checked_3 = _wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(0), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_checked_4 = _wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(1), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_checked_5 = _wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(2), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
     const int sum2 = triple[0] + triple[1] + triple[2];
-    // CHECK: const int sum3 = (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(0), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(index), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
+    // CHECK: const int sum3 = (*_wcl_checked_0) + (*_wcl_checked_1) + (*_wcl_checked_2);
 #ifndef __PLATFORM_AMD__
     const int sum3 = index[array] + 0[array] + index[triple];
 #endif
-    // CHECK: const int sum4 = (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(0), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(1), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn))) + (*(_wcl_addr_clamp_private_1_const__int__Ptr((_wcl_allocs->pa._wcl_triple)+(2), 1, (const int *)&_wcl_allocs->pa, (const int *)(&_wcl_allocs->pa + 1), (const int *)_wcl_allocs->pn)));
+    // CHECK: const int sum4 = (*_wcl_checked_3) + (*_wcl_checked_4) + (*_wcl_checked_5);
 #ifndef __PLATFORM_AMD__
     const int sum4 = 0[triple] + 1[triple] + 2[triple];
 #endif
@@ -34,9 +34,9 @@ void set_indexed_value(
     // CHECK: _WclProgramAllocations *_wcl_allocs,
     __global int *array, int index, int value)
 {
-    // CHECK: (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) += value;
+    // CHECK: (*(_wcl_checked_0 = _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) += value;
     array[index] += value;
-    // CHECK: (*(_wcl_addr_clamp_global_1__u_uglobal__int__Ptr((array)+(index), 1, (__global int *)_wcl_allocs->gl.access_array__array_min, (__global int *)_wcl_allocs->gl.access_array__array_max, (__global int *)_wcl_allocs->gn))) += value;
+    // CHECK: (*_wcl_checked_0) += value;
 #ifndef __PLATFORM_AMD__
     index[array] += value;
 #endif
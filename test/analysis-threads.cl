@@ -0,0 +1,28 @@
+// RUN: sh %S/analysis-threads.sh %webcl-validator 4 %S/*.cl
+// RUN: %webcl-validator %s -analysis-threads=4 | %opencl-validator
+// RUN: %webcl-validator %s -analysis-threads=4 | grep -v CHECK | %FileCheck %s
+
+// Function bodies are analysed in parallel, but the result must be
+// the same as with a single thread.
+
+// CHECK: int helper(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+int helper(__global int *values, int i)
+{
+    // CHECK: _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((values)+(i), 1,
+    return values[i];
+}
+
+typedef struct {
+    int value;
+} Pair;
+
+// CHECK: __kernel void analysis_threads(__global int *values, ulong _wcl_values_size)
+__kernel void analysis_threads(__global int *values)
+{
+    int i = get_global_id(0);
+    Pair pair = { 1 };
+    Pair *p = &pair;
+
+    // CHECK: helper(_wcl_allocs, values, i)
+    values[i] = helper(values, i) + p->value;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# analysis-threads.sh bin/webcl-validator 4 test/*.cl
+#
+# Validates each file with one analysis thread and with the given
+# number of analysis threads and fails if the outputs or diagnostics
+# aren't identical.
+
+# Location of validator binary.
+VALIDATOR="$1"
+# Number of analysis threads.
+THREADS="$2"
+shift 2
+# Location of test files.
+TEST_FILES="$@"
+
+SERIAL=`mktemp`
+THREADED=`mktemp`
+STATUS=0
+
+for i in $TEST_FILES ; do
+    $VALIDATOR $i > $SERIAL 2>&1
+    $VALIDATOR $i -analysis-threads=$THREADS > $THREADED 2>&1
+    if ! cmp -s $SERIAL $THREADED ; then
+        echo "Output of $i depends on the number of analysis threads."
+        STATUS=1
+    fi
+done
+
+rm -f $SERIAL $THREADED
+exit $STATUS
@@ -0,0 +1,39 @@
+// RUN: sh %S/batch-mode.sh %webcl-validator 4 %S/*.cl
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: printf '# Inputs of the batch\r\n%%s\r\n\r\n%%s\r\n%%s\r\n' %s %S/analysis-threads.cl %S/log-message-lines.cl > %t.manifest
+// RUN: %webcl-validator -batch=%t -j 2 -manifest=%t.manifest | %FileCheck %s
+// RUN: test -s %t/batch-mode.cl
+// RUN: test -s %t/analysis-threads.cl
+// RUN: test ! -e %t/log-message-lines.cl
+// RUN: %webcl-validator -batch=%t %s %S/./batch-mode.cl 2>&1 | %FileCheck --check-prefix=CHECK-DUPLICATE %s
+// RUN: %webcl-validator -batch=%t -j 0 %s 2>&1 | %FileCheck --check-prefix=CHECK-THREADS %s
+// RUN: %webcl-validator -batch=%t -jx %s 2>&1 | %FileCheck --check-prefix=CHECK-THREADS-VALUE %s
+
+// Inputs of a batch can be listed in a manifest file. Comment lines,
+// empty lines and DOS line endings of the manifest are skipped. The
+// summary lists the inputs in the order of the manifest, and only
+// accepted inputs have an output file.
+
+// CHECK: "inputs" : 3,
+// CHECK-NEXT: "accepted" : 2,
+// CHECK-NEXT: "threads" : 2,
+// CHECK-NEXT: "wall-ms" : {{[0-9]+}},
+// CHECK-NEXT: "validation-ms" : {{[0-9]+}},
+// CHECK-NEXT: "results" : [
+// CHECK-NEXT: { "input" : "{{[^"]*}}/batch-mode.cl", "output" : "{{[^"]*}}/batch-mode.cl", "accepted" : true, "ms" : {{[0-9]+}} },
+// CHECK-NEXT: { "input" : "{{[^"]*}}/analysis-threads.cl", "output" : "{{[^"]*}}/analysis-threads.cl", "accepted" : true, "ms" : {{[0-9]+}} },
+// CHECK-NEXT: { "input" : "{{[^"]*}}/log-message-lines.cl", "output" : "{{[^"]*}}/log-message-lines.cl", "accepted" : false, "ms" : {{[0-9]+}} }
+// CHECK-NEXT: ]
+
+// Output files of inputs with the same name would overwrite each
+// other.
+
+// CHECK-DUPLICATE: Input file "{{[^"]*}}/./batch-mode.cl" has the same name as an earlier input, exiting
+
+// CHECK-THREADS: Invalid number of threads: -j0; exiting
+// CHECK-THREADS-VALUE: Invalid number of threads: -jx; exiting
+
+__kernel void batch_mode(__global float *values)
+{
+    values[get_global_id(0)] *= 2.0f;
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# batch-mode.sh bin/webcl-validator 4 test/*.cl
+#
+# Validates each file on its own and all files with one batch run
+# using the given number of threads. Fails if the output file of an
+# accepted file differs from the output of the single run, if a
+# rejected file has an output file or if the summary doesn't list
+# every file.
+
+# Location of validator binary.
+VALIDATOR="$1"
+# Number of validation threads.
+THREADS="$2"
+shift 2
+# Location of test files.
+TEST_FILES="$@"
+
+SINGLE=`mktemp`
+SUMMARY=`mktemp`
+OUTPUTS=`mktemp -d`
+STATUS=0
+
+$VALIDATOR -batch=$OUTPUTS -j $THREADS $TEST_FILES > $SUMMARY 2> /dev/null
+
+for i in $TEST_FILES ; do
+    OUTPUT=$OUTPUTS/`basename $i`
+    if $VALIDATOR $i > $SINGLE 2> /dev/null ; then
+        if ! cmp -s $SINGLE $OUTPUT ; then
+            echo "Batch output of $i differs from single output."
+            STATUS=1
+        fi
+    elif [ -e $OUTPUT ] ; then
+        echo "Batch run has output for rejected $i."
+        STATUS=1
+    fi
+    if ! grep -q "\"input\" : \"$i\"" $SUMMARY ; then
+        echo "Batch summary doesn't list $i."
+        STATUS=1
+    fi
+done
+
+rm -rf $SINGLE $SUMMARY $OUTPUTS
+exit $STATUS
@@ -0,0 +1,24 @@
+// RUN: %benchmark --print-buffers --scalar 5 --gcount 4 --length 4 --loop 1 %s | %FileCheck %s
+// RUN: %benchmark --print-buffers --scalar -3 --gcount 4 --length 4 --loop 1 %s | %FileCheck --check-prefix=CHECK-NEGATIVE %s
+
+// Scalar arguments get the value given with --scalar in each of
+// their components, both in the original and in the validated
+// kernel.
+
+// CHECK: scalar_int original buffer 0: 5 5 5 5
+// CHECK: scalar_int validated buffer 0: 5 5 5 5
+// CHECK-NEGATIVE: scalar_int original buffer 0: 4294967293 4294967293 4294967293 4294967293
+// CHECK-NEGATIVE: scalar_int validated buffer 0: 4294967293 4294967293 4294967293 4294967293
+__kernel void scalar_int(__global int *output, int value)
+{
+    output[get_global_id(0)] = value;
+}
+
+// CHECK: scalar_float2 original buffer 0: 5.000 5.000 5.000 5.000 5.000 5.000 5.000 5.000
+// CHECK: scalar_float2 validated buffer 0: 5.000 5.000 5.000 5.000 5.000 5.000 5.000 5.000
+// CHECK-NEGATIVE: scalar_float2 original buffer 0: -3.000 -3.000 -3.000 -3.000 -3.000 -3.000 -3.000 -3.000
+// CHECK-NEGATIVE: scalar_float2 validated buffer 0: -3.000 -3.000 -3.000 -3.000 -3.000 -3.000 -3.000 -3.000
+__kernel void scalar_float2(__global float2 *output, float2 value)
+{
+    output[get_global_id(0)] = value;
+}
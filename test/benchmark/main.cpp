@@ -0,0 +1,771 @@
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include "validator.hpp"
+#include "builder.hpp"
+
+#include "clv/clv.h"
+
+#include <stdlib.h>
+#include <new>
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Number of heap allocations made with operator new, counted in all
+/// threads.
+static std::atomic<unsigned long> heapAllocations(0);
+
+void *operator new(size_t size)
+{
+    ++heapAllocations;
+    void *memory = malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+namespace
+{
+    /// Benchmark settings given on the command line.
+    struct Settings {
+        Settings()
+            : options(), globalSize(65536), length(65536)
+            , localLength(256), scalar(16), runs(10)
+            , validation(false), builtinCalls(0), printBuffers(false) {
+        }
+
+        /// Code generation options for the validator.
+        std::string options;
+        /// Number of global work items.
+        size_t globalSize;
+        /// Number of elements in global and constant buffers.
+        cl_ulong length;
+        /// Number of elements in local buffers.
+        cl_ulong localLength;
+        /// Value of integer and floating point scalar arguments.
+        int scalar;
+        /// Number of timed runs after a warm up run.
+        unsigned runs;
+        /// Whether to time validation instead of kernels.
+        bool validation;
+        /// Number of builtin calls in a generated kernel that is
+        /// validated in addition to the given files.
+        unsigned builtinCalls;
+        /// Whether to print the global buffers after the runs.
+        bool printBuffers;
+    };
+
+    /// Argument of the original kernel and the generated data that
+    /// is passed to both the original and the validated kernel.
+    struct Argument {
+        Argument()
+            : isPointer(false), isLocal(false), isFloat(false)
+            , componentSize(0), components(0), length(0), data() {
+        }
+
+        bool isPointer;
+        bool isLocal;
+        bool isFloat;
+        /// Size of a vector component or of a scalar.
+        size_t componentSize;
+        /// Number of components in memory, three component vectors
+        /// take the space of four components.
+        size_t components;
+        /// Number of elements pointed to.
+        cl_ulong length;
+        /// Initial buffer contents or scalar value.
+        std::vector<unsigned char> data;
+    };
+    typedef std::vector<Argument> Arguments;
+
+    /// Parses a type name like "float4 *" or "uint".
+    bool parseType(std::string type, Argument &argument)
+    {
+        if (!type.empty() && (type[type.size() - 1] == '*')) {
+            type.erase(type.size() - 1);
+            while (!type.empty() && (type[type.size() - 1] == ' '))
+                type.erase(type.size() - 1);
+        }
+
+        const size_t digits = type.find_first_of("0123456789");
+        const std::string base = type.substr(0, digits);
+        argument.components = 1;
+        if (digits != std::string::npos) {
+            std::istringstream width(type.substr(digits));
+            if (!(width >> argument.components))
+                return false;
+            if (argument.components == 3)
+                argument.components = 4;
+        }
+
+        argument.isFloat = false;
+        if ((base == "char") || (base == "uchar")) {
+            argument.componentSize = 1;
+        } else if ((base == "short") || (base == "ushort")) {
+            argument.componentSize = 2;
+        } else if ((base == "int") || (base == "uint")) {
+            argument.componentSize = 4;
+        } else if ((base == "long") || (base == "ulong")) {
+            argument.componentSize = 8;
+        } else if (base == "float") {
+            argument.componentSize = 4;
+            argument.isFloat = true;
+        } else if (base == "double") {
+            argument.componentSize = 8;
+            argument.isFloat = true;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    /// Stores a value to a component of the argument type.
+    void storeComponent(unsigned char *out, const Argument &argument, cl_long value)
+    {
+        const size_t size = argument.componentSize;
+        if (argument.isFloat && (size == sizeof(cl_float))) {
+            const cl_float component = static_cast<cl_float>(value);
+            std::memcpy(out, &component, size);
+        } else if (argument.isFloat) {
+            const cl_double component = static_cast<cl_double>(value);
+            std::memcpy(out, &component, size);
+        } else {
+            // the host is assumed to be little endian like the CPU
+            // device
+            std::memcpy(out, &value, size);
+        }
+    }
+
+    /// Prints the components of the argument data. Integers are
+    /// printed without sign extension.
+    void printComponents(std::ostream &out, const Argument &argument)
+    {
+        const size_t size = argument.componentSize;
+        for (size_t offset = 0; (offset + size) <= argument.data.size(); offset += size) {
+            const unsigned char *in = &argument.data[offset];
+            out << " ";
+            if (argument.isFloat && (size == sizeof(cl_float))) {
+                cl_float component = 0;
+                std::memcpy(&component, in, size);
+                out << component;
+            } else if (argument.isFloat) {
+                cl_double component = 0;
+                std::memcpy(&component, in, size);
+                out << component;
+            } else {
+                cl_ulong component = 0;
+                std::memcpy(&component, in, size);
+                out << component;
+            }
+        }
+    }
+
+    /// Fills data with count elements. Integer components get
+    /// values that are valid indices of the buffers.
+    void generateData(Argument &argument, cl_ulong count, cl_ulong modulus)
+    {
+        const size_t size = argument.componentSize;
+        const cl_ulong components = count * argument.components;
+        argument.data.resize(components * size);
+        for (cl_ulong i = 0; i < components; ++i)
+            storeComponent(&argument.data[i * size], argument, (i / argument.components) % modulus);
+    }
+
+    std::string readFile(const std::string &name)
+    {
+        std::ifstream file(name.c_str());
+        file >> std::noskipws;
+        std::istream_iterator<char> begin(file);
+        std::istream_iterator<char> end;
+        return std::string(begin, end);
+    }
+
+    std::string getKernelName(clv_program program, cl_uint kernel)
+    {
+        char name[256];
+        if (clvGetProgramKernelName(program, kernel, sizeof(name), name, NULL) != CL_SUCCESS)
+            return "";
+        return name;
+    }
+
+    /// Generates a kernel that calls wrapped builtins the given number
+    /// of times.
+    std::string generateBuiltinCalls(unsigned calls)
+    {
+        std::ostringstream source;
+        source << "__kernel void builtin_calls(__global float *values, __global int *counters)\n"
+               << "{\n"
+               << "    size_t i = get_global_id(0);\n"
+               << "    float4 sum = (float4)(0.0f);\n"
+               << "    float whole = 0.0f;\n";
+        for (unsigned call = 0; call < calls; ++call) {
+            switch (call % 4) {
+            case 0:
+                source << "    sum += vload4(i + " << call << ", values);\n";
+                break;
+            case 1:
+                source << "    vstore4(sum, i + " << call << ", values);\n";
+                break;
+            case 2:
+                source << "    atomic_add(counters + " << call << ", 1);\n";
+                break;
+            default:
+                source << "    sum.x += fract(sum.y, &whole);\n";
+                break;
+            }
+        }
+        source << "    values[i] = sum.x + whole;\n"
+               << "}\n";
+        return source.str();
+    }
+
+    /// \return Fastest time of validating the source in
+    /// milliseconds, or a negative value if validation fails. The
+    /// number of heap allocations of the last run is stored to
+    /// allocations.
+    double timeValidation(
+        const std::string &source, const Settings &settings, unsigned long &allocations)
+    {
+        double fastest = -1;
+        // the first run is a warm up run
+        for (unsigned run = 0; run <= settings.runs; ++run) {
+            cl_int err = CL_SUCCESS;
+            const unsigned long allocationsBefore = heapAllocations;
+            const std::clock_t start = std::clock();
+            clv_program program = clvValidateWithOptions(
+                source.c_str(), NULL, NULL, settings.options.c_str(), NULL, NULL, &err);
+            const std::clock_t end = std::clock();
+            allocations = heapAllocations - allocationsBefore;
+
+            const bool accepted = (err == CL_SUCCESS) && program &&
+                (clvGetProgramStatus(program) != CLV_PROGRAM_ILLEGAL);
+            if (program)
+                clvReleaseProgram(program);
+            if (!accepted)
+                return -1;
+
+            const double ms = 1000.0 * (end - start) / CLOCKS_PER_SEC;
+            if (run && ((fastest < 0) || (ms < fastest)))
+                fastest = ms;
+        }
+        return fastest;
+    }
+
+    /// Reports validation times of the given files and of the
+    /// generated kernel.
+    int benchmarkValidation(const std::vector<std::string> &files, const Settings &settings)
+    {
+        std::vector<std::pair<std::string, std::string> > inputs;
+        for (std::vector<std::string>::const_iterator file = files.begin(); file != files.end(); ++file)
+            inputs.push_back(std::make_pair(*file, readFile(*file)));
+        if (settings.builtinCalls) {
+            std::ostringstream name;
+            name << "<" << settings.builtinCalls << " builtin calls>";
+            inputs.push_back(std::make_pair(name.str(), generateBuiltinCalls(settings.builtinCalls)));
+        }
+
+        std::cout << std::fixed << std::setprecision(3);
+        unsigned measured = 0;
+        unsigned skipped = 0;
+        for (std::vector<std::pair<std::string, std::string> >::iterator input = inputs.begin();
+             input != inputs.end(); ++input) {
+            if (input->second.empty()) {
+                std::cerr << input->first << ": Can't read file." << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            unsigned long allocations = 0;
+            const double ms = timeValidation(input->second, settings, allocations);
+            if (ms < 0) {
+                std::cerr << input->first << ": Validation failed." << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            ++measured;
+            std::cout << input->first << " validated in " << ms << " ms with "
+                      << allocations << " allocations" << std::endl;
+        }
+        if (skipped)
+            std::cout << skipped << " files skipped" << std::endl;
+
+        return measured ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /// Collects kernel arguments and generates their data. Returns
+    /// false if the kernel has arguments that can't be generated.
+    bool getArguments(
+        clv_program program, cl_uint kernel, const Settings &settings,
+        Arguments &arguments)
+    {
+        const cl_int count = clvGetKernelArgCount(program, kernel);
+        for (cl_int arg = 0; arg < count; ++arg) {
+            if (clvKernelArgIsImage(program, kernel, arg))
+                return false;
+
+            char type[256];
+            if (clvGetKernelArgType(program, kernel, arg, sizeof(type), type, NULL) != CL_SUCCESS)
+                return false;
+
+            Argument argument;
+            if (!parseType(type, argument))
+                return false;
+
+            argument.isPointer = clvKernelArgIsPointer(program, kernel, arg);
+            if (argument.isPointer) {
+                argument.isLocal = clvGetKernelArgAddressQual(program, kernel, arg) ==
+                    CL_KERNEL_ARG_ADDRESS_LOCAL;
+                argument.length = argument.isLocal ? settings.localLength : settings.length;
+                if (!argument.isLocal)
+                    generateData(argument, argument.length, settings.length);
+            } else {
+                const size_t size = argument.componentSize;
+                argument.data.resize(argument.components * size);
+                for (size_t i = 0; i < argument.components; ++i)
+                    storeComponent(&argument.data[i * size], argument, settings.scalar);
+            }
+
+            arguments.push_back(argument);
+        }
+        return true;
+    }
+}
+
+/// Builds a program and times its kernels with profiling events.
+class BenchmarkRunner : public OpenCLValidator
+{
+public:
+
+    explicit BenchmarkRunner(const std::string &code, cl_uint checkSites = 0)
+        : OpenCLValidator(code)
+        , checkSites_(checkSites) {
+    }
+
+    virtual ~BenchmarkRunner() {
+    }
+
+    virtual bool createQueue() {
+        if (queue_) {
+            clReleaseCommandQueue(queue_);
+            queue_ = 0;
+        }
+        queue_ = clCreateCommandQueue(
+            context_, device_, CL_QUEUE_PROFILING_ENABLE, NULL);
+        return queue_ != 0;
+    }
+
+    /// Runs the kernel once to warm up and then the given number of
+    /// times. Validated kernels also get the size arguments of
+    /// memory objects, the status word of trapped accesses and the
+    /// counters of counted checks. If contents is given, the global
+    /// buffers are read back to it after the runs.
+    ///
+    /// \return The fastest run in milliseconds, or a negative value
+    /// if the kernel couldn't be run.
+    double time(const std::string &name, const Arguments &arguments,
+                bool isValidated, const Settings &settings,
+                Arguments *contents = NULL) {
+        cl_int ret = CL_SUCCESS;
+        cl_kernel kernel = clCreateKernel(program_, name.c_str(), &ret);
+        if (ret != CL_SUCCESS) {
+            std::cerr << name << ": Can't create kernel." << std::endl;
+            return -1;
+        }
+
+        std::vector<cl_mem> buffers;
+        bool ok = setArguments(kernel, arguments, isValidated, buffers);
+
+        double fastest = -1;
+        for (unsigned run = 0; ok && (run <= settings.runs); ++run) {
+            cl_event event;
+            ret = clEnqueueNDRangeKernel(queue_, kernel, 1,
+                                         NULL, &settings.globalSize, NULL,
+                                         0, NULL, &event);
+            if (ret != CL_SUCCESS) {
+                std::cerr << name << ": clEnqueueNDRangeKernel failed with code "
+                          << ret << "." << std::endl;
+                ok = false;
+                break;
+            }
+
+            cl_ulong start = 0;
+            cl_ulong end = 0;
+            ok = (clWaitForEvents(1, &event) == CL_SUCCESS) &&
+                (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+                                         sizeof(start), &start, NULL) == CL_SUCCESS) &&
+                (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+                                         sizeof(end), &end, NULL) == CL_SUCCESS);
+            clReleaseEvent(event);
+
+            // the first run warms up caches and lazy compilation
+            const double ms = (end - start) / 1e6;
+            if (ok && run && ((fastest < 0) || (ms < fastest)))
+                fastest = ms;
+        }
+
+        if (ok && contents)
+            ok = readBuffers(arguments, buffers, *contents);
+
+        for (std::vector<cl_mem>::iterator i = buffers.begin(); i != buffers.end(); ++i)
+            clReleaseMemObject(*i);
+        clReleaseKernel(kernel);
+        return ok ? fastest : -1;
+    }
+
+private:
+
+    /// Reads the global buffers, which were created in the order of
+    /// the arguments.
+    bool readBuffers(const Arguments &arguments, const std::vector<cl_mem> &buffers,
+                     Arguments &contents) {
+        std::vector<cl_mem>::const_iterator buffer = buffers.begin();
+        for (Arguments::const_iterator i = arguments.begin(); i != arguments.end(); ++i) {
+            if (!i->isPointer || i->isLocal)
+                continue;
+
+            Argument content = *i;
+            const cl_int ret = clEnqueueReadBuffer(
+                queue_, *buffer++, CL_TRUE, 0, content.data.size(), &content.data[0],
+                0, NULL, NULL);
+            if (ret != CL_SUCCESS) {
+                std::cerr << "Can't read buffers." << std::endl;
+                return false;
+            }
+            contents.push_back(content);
+        }
+        return true;
+    }
+
+    bool setArguments(cl_kernel kernel, const Arguments &arguments,
+                      bool isValidated, std::vector<cl_mem> &buffers) {
+        cl_int ret = CL_SUCCESS;
+        cl_uint index = 0;
+
+        for (Arguments::const_iterator i = arguments.begin(); i != arguments.end(); ++i) {
+            if (!i->isPointer) {
+                ret |= clSetKernelArg(kernel, index++, i->data.size(), &i->data[0]);
+                continue;
+            }
+
+            if (i->isLocal) {
+                const size_t size = i->length * i->components * i->componentSize;
+                ret |= clSetKernelArg(kernel, index++, size, NULL);
+            } else {
+                cl_mem buffer = clCreateBuffer(
+                    context_, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                    i->data.size(), const_cast<unsigned char *>(&i->data[0]), &ret);
+                if (ret != CL_SUCCESS)
+                    return false;
+                buffers.push_back(buffer);
+                ret |= clSetKernelArg(kernel, index++, sizeof(buffer), &buffer);
+            }
+
+            if (isValidated) {
+                const cl_ulong length = i->length;
+                ret |= clSetKernelArg(kernel, index++, sizeof(length), &length);
+            }
+        }
+
+        // status word added by -violation-mode=trap and counters
+        // added by -count-checks, both big enough for the counters
+        cl_uint numArgs = 0;
+        ret |= clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(numArgs), &numArgs, NULL);
+        while (isValidated && (index < numArgs)) {
+            std::vector<cl_uint> words(2 * checkSites_ + 1, 0);
+            cl_mem buffer = clCreateBuffer(
+                context_, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                words.size() * sizeof(cl_uint), &words[0], &ret);
+            if (ret != CL_SUCCESS)
+                return false;
+            buffers.push_back(buffer);
+            ret |= clSetKernelArg(kernel, index++, sizeof(buffer), &buffer);
+        }
+
+        if ((ret != CL_SUCCESS) || (index != numArgs)) {
+            std::cerr << "Can't set kernel arguments." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /// Number of counted checks in the validated program.
+    cl_uint checkSites_;
+};
+
+/// Selects the first CPU device, or any device if there are no CPU
+/// devices.
+class OpenCLBuilderForCpuDevice : public OpenCLBuilder
+{
+public:
+
+    OpenCLBuilderForCpuDevice(const std::string &name)
+        : OpenCLBuilder(name), collected_(false) {
+    }
+
+    virtual ~OpenCLBuilderForCpuDevice() {
+    }
+
+protected:
+
+    virtual bool collectPlatformsAndDevices(
+        OpenCLValidator &validator, PlatformsAndDevices &platformsAndDevices) {
+        collected_ = false;
+        return OpenCLBuilder::collectPlatformsAndDevices(validator, platformsAndDevices);
+    }
+
+    virtual bool isCurrentPlatformAndDeviceGoodEnough(OpenCLValidator &validator) {
+        return true;
+    }
+
+    virtual bool isCurrentPlatformAndDeviceCollected(OpenCLValidator &validator) {
+        if (collected_ || !(validator.getDeviceType() & CL_DEVICE_TYPE_CPU))
+            return false;
+        collected_ = true;
+        return true;
+    }
+
+    bool collected_;
+};
+
+std::string usage =
+"/// Measures the runtime overhead of validation.\n"
+"///\n"
+"/// Each kernel of the given files is validated and both the original\n"
+"/// and the validated kernel are run on a CPU device with identical\n"
+"/// generated buffers. The fastest of the timed runs of each version\n"
+"/// is measured with profiling events. The slowdown of each kernel and\n"
+"/// the geometric mean of the slowdowns are reported.\n"
+"///\n"
+"/// --options  <string> Code generation options for the validator,\n"
+"///            e.g. \"-check-mode=offset\".\n"
+"/// --gcount   <size> Number of global work items. Default: 65536\n"
+"/// --length   <size> Elements in global and constant buffers.\n"
+"///            Default: 65536\n"
+"/// --local    <size> Elements in local buffers. Default: 256\n"
+"/// --scalar   <int> Value of scalar arguments. Default: 16\n"
+"/// --loop     <int> Number of timed runs. Default: 10\n"
+"/// --validation Time validation of the files instead of running\n"
+"///            kernels. The fastest run is reported in CPU time\n"
+"///            together with the heap allocations of a run.\n"
+"/// --builtin-calls <int> With --validation, also validate a\n"
+"///            generated kernel with the given number of builtin\n"
+"///            calls that need wrappers.\n"
+"/// --print-buffers Print the contents of global buffers after\n"
+"///            the runs of each kernel.\n"
+"///\n"
+"/// Integer buffer elements are initialized with indices of the\n"
+"/// buffers. Kernels with image, sampler or structure arguments are\n"
+"/// skipped.\n"
+"///\n";
+
+int main(int argc, char const* argv[])
+{
+    std::set<std::string> help;
+    help.insert("-h");
+    help.insert("-help");
+    help.insert("--help");
+
+    if ((argc < 2) || help.count(argv[1])) {
+        std::cerr << "Usage: " << argv[0] << " [OPTIONS] [FILE...]"
+                  << std::endl
+                  << usage
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Settings settings;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        const bool hasValue = (i + 1) < argc;
+        if (option == "--options" && hasValue) {
+            settings.options = argv[++i];
+        } else if (option == "--gcount" && hasValue) {
+            settings.globalSize = atoi(argv[++i]);
+        } else if (option == "--length" && hasValue) {
+            settings.length = atoi(argv[++i]);
+        } else if (option == "--local" && hasValue) {
+            settings.localLength = atoi(argv[++i]);
+        } else if (option == "--scalar" && hasValue) {
+            settings.scalar = atoi(argv[++i]);
+        } else if (option == "--loop" && hasValue) {
+            settings.runs = atoi(argv[++i]);
+        } else if (option == "--validation") {
+            settings.validation = true;
+        } else if (option == "--builtin-calls" && hasValue) {
+            settings.builtinCalls = atoi(argv[++i]);
+        } else if (option == "--print-buffers") {
+            settings.printBuffers = true;
+        } else if (!option.compare(0, 2, "--")) {
+            std::cerr << argv[0] << ": Unknown option " << option << "." << std::endl;
+            return EXIT_FAILURE;
+        } else {
+            files.push_back(option);
+        }
+    }
+    if (!settings.globalSize || !settings.length || !settings.localLength || !settings.runs) {
+        std::cerr << argv[0] << ": Sizes and counts must be positive." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (settings.validation)
+        return benchmarkValidation(files, settings);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    double logSum = 0;
+    unsigned measured = 0;
+    unsigned skipped = 0;
+
+    for (std::vector<std::string>::iterator file = files.begin(); file != files.end(); ++file) {
+        const std::string source = readFile(*file);
+        if (source.empty()) {
+            std::cerr << *file << ": Can't read file." << std::endl;
+            ++skipped;
+            continue;
+        }
+
+        cl_int err = CL_SUCCESS;
+        clv_program program = clvValidateWithOptions(
+            source.c_str(), NULL, NULL, settings.options.c_str(), NULL, NULL, &err);
+        if ((err != CL_SUCCESS) || !program ||
+            (clvGetProgramStatus(program) == CLV_PROGRAM_ILLEGAL)) {
+            std::cerr << *file << ": Validation failed." << std::endl;
+            if (program)
+                clvReleaseProgram(program);
+            ++skipped;
+            continue;
+        }
+
+        size_t size = 0;
+        clvGetProgramValidatedSource(program, 0, NULL, &size);
+        std::vector<char> validated(size + 1, '\0');
+        clvGetProgramValidatedSource(program, size, &validated[0], NULL);
+
+        BenchmarkRunner original(source);
+        BenchmarkRunner transformed(&validated[0], clvGetProgramCheckSiteCount(program));
+        OpenCLBuilderForCpuDevice builder(argv[0]);
+        if (!builder.compileInput(original, "") ||
+            !builder.compileInput(transformed, "")) {
+            std::cerr << *file << ": Build failed." << std::endl;
+            clvReleaseProgram(program);
+            ++skipped;
+            continue;
+        }
+
+        const cl_int kernels = clvGetProgramKernelCount(program);
+        for (cl_int kernel = 0; kernel < kernels; ++kernel) {
+            const std::string name = getKernelName(program, kernel);
+
+            Arguments arguments;
+            if (!getArguments(program, kernel, settings, arguments)) {
+                std::cerr << *file << ":" << name << ": Unsupported arguments." << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            Arguments originalContents;
+            Arguments validatedContents;
+            const double originalMs = original.time(
+                name, arguments, false, settings,
+                settings.printBuffers ? &originalContents : NULL);
+            const double validatedMs = transformed.time(
+                name, arguments, true, settings,
+                settings.printBuffers ? &validatedContents : NULL);
+            if ((originalMs <= 0) || (validatedMs <= 0)) {
+                std::cerr << *file << ":" << name << ": Can't time kernel." << std::endl;
+                ++skipped;
+                continue;
+            }
+
+            const double slowdown = validatedMs / originalMs;
+            logSum += std::log(slowdown);
+            ++measured;
+            report << *file << ":" << name
+                   << " original " << originalMs << " ms"
+                   << " validated " << validatedMs << " ms"
+                   << " slowdown " << slowdown << std::endl;
+
+            for (size_t i = 0; i < originalContents.size(); ++i) {
+                report << *file << ":" << name << " original buffer " << i << ":";
+                printComponents(report, originalContents[i]);
+                report << std::endl;
+            }
+            for (size_t i = 0; i < validatedContents.size(); ++i) {
+                report << *file << ":" << name << " validated buffer " << i << ":";
+                printComponents(report, validatedContents[i]);
+                report << std::endl;
+            }
+        }
+
+        clvReleaseProgram(program);
+    }
+
+    std::cout << report.str();
+    if (measured) {
+        std::cout << "geometric mean slowdown " << std::exp(logSum / measured)
+                  << " over " << measured << " kernels" << std::endl;
+    }
+    if (skipped)
+        std::cout << skipped << " kernels or files skipped" << std::endl;
+
+    return measured ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,11 +24,11 @@ __kernel void builtin_wrappers(__global char *output,
     float@SIZE@ r1 = vload@SIZE@(offset, input);
 
     offset = 1;
-    // CHECK: float4 r2 = _wcl_vload4_1(_wcl_allocs, _wcl_locals._wcl_offset, input);
+    // CHECK: float4 r2 = _wcl_vload4_0(_wcl_allocs, _wcl_locals._wcl_offset, input);
     float@SIZE@ r2 = vload@SIZE@(offset, input);
 
     offset = 2;
-    // CHECK: float4 r3 = _wcl_vload4_2(_wcl_allocs, _wcl_locals._wcl_offset, input);
+    // CHECK: float4 r3 = _wcl_vload4_0(_wcl_allocs, _wcl_locals._wcl_offset, input);
     float@SIZE@ r3 = vload@SIZE@(offset, input);
 
     output[0] = r1.x;
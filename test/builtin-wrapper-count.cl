@@ -0,0 +1,30 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -c '^float4 _wcl_vload4_[0-9]*(' | grep '^1$'
+// RUN: %webcl-validator %s | grep -c '^int4 _wcl_vload4_[0-9]*(' | grep '^1$'
+// RUN: %webcl-validator %s | grep -c '^void _wcl_vstore4_[0-9]*(' | grep '^1$'
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Calls of a builtin with the same argument types and limits share a
+// single wrapper function.
+
+__kernel void builtin_wrapper_count(
+    __global float *input, __global int *indices, __global float *output)
+{
+    int i = get_global_id(0);
+
+    // CHECK: float4 first = _wcl_vload4_[[FLOAT_LOAD:[0-9]+]](_wcl_allocs, 0, input);
+    float4 first = vload4(0, input);
+    // CHECK: float4 second = _wcl_vload4_[[FLOAT_LOAD]](_wcl_allocs, 1, input);
+    float4 second = vload4(1, input);
+    // CHECK: float4 third = _wcl_vload4_[[FLOAT_LOAD]](_wcl_allocs, i, input);
+    float4 third = vload4(i, input);
+
+    // CHECK: int4 index = _wcl_vload4_{{[0-9]+}}(_wcl_allocs, i, indices);
+    int4 index = vload4(i, indices);
+
+    // CHECK: _wcl_vstore4_[[FLOAT_STORE:[0-9]+]](_wcl_allocs, first + second, 0, output);
+    vstore4(first + second, 0, output);
+    // CHECK: _wcl_vstore4_[[FLOAT_STORE]](_wcl_allocs, third, index.x, output);
+    vstore4(third, index.x, output);
+}
@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 
+#include <cstring>
 #include <set>
 #include <string>
 #include <vector>
@@ -227,21 +228,178 @@ bool testSource(cl_device_id device, std::string const& source, bool isTransform
 
     return testPass;
 }
+namespace
+{
+    // Local buffer of the range kernel in bytes.
+    const size_t RangeBytes = 128;
+
+    // Zeroes a local buffer, fills a part of it with the macro of the
+    // validated source and copies the buffer to the result.
+    const char *RangeKernel =
+        "\n"
+        "__kernel void check_local_range(__global uchar *result, uint offset, uint size)\n"
+        "{\n"
+        "    __local uint4 words[8];\n"
+        "    __local uchar *bytes = (__local uchar *)words;\n"
+        "    const size_t items = get_local_size(0) * get_local_size(1) * get_local_size(2);\n"
+        "    const size_t item = (get_local_id(2) * get_local_size(1) + get_local_id(1)) * get_local_size(0) + get_local_id(0);\n"
+        "    for (size_t i = item; i < sizeof(words); i += items)\n"
+        "        bytes[i] = 0;\n"
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+        "    _WCL_LOCAL_RANGE_INIT(bytes + offset, bytes + offset + size);\n"
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+        "    for (size_t i = item; i < sizeof(words); i += items)\n"
+        "        result[i] = bytes[i];\n"
+        "}\n";
+
+    bool hasExtension(cl_device_id device, const std::string &extension)
+    {
+        size_t size = 0;
+        if (CL_SUCCESS != clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, NULL, &size))
+            return false;
+        std::string extensions(size, '\0');
+        if (CL_SUCCESS != clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, size, &extensions[0], NULL))
+            return false;
+        return (" " + extensions + " ").find(" " + extension + " ") != std::string::npos;
+    }
+
+    // Checks that exactly the bytes of the range were filled.
+    bool verifyRange(const unsigned char *buf, size_t offset, size_t size)
+    {
+        for (size_t i = 0; i < RangeBytes; ++i)
+        {
+            const bool inside = (i >= offset) && (i < (offset + size));
+            if (buf[i] != (inside ? FillChar : 0))
+                return false;
+        }
+        return true;
+    }
+}
+
+// Runs the local memory zeroing macro of the validated source on
+// ranges that start at different alignments, have odd sizes and are
+// filled by work groups whose sizes don't divide the range.
+bool testRanges(cl_device_id device, std::string const& source)
+{
+    if (hasExtension(device, "cl_khr_initialize_memory"))
+    {
+        std::cout << "Local memory is zeroed by the device, skipping." << std::endl;
+        return true;
+    }
+
+    size_t maxItems = 0;
+    size_t maxSizes[3] = { 0, 0, 0 };
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxItems), &maxItems, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(maxSizes), maxSizes, NULL);
+
+    cl_int ret = CL_SUCCESS;
+    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &ret);
+    if (ret != CL_SUCCESS)
+    {
+        std::cerr << "Failed to create OpenCL context." << std::endl;
+        return false;
+    }
+
+    const std::string rangeSource = source + RangeKernel;
+    const char *buf = rangeSource.c_str();
+    cl_program program = clCreateProgramWithSource(context, 1, &buf, NULL, &ret);
+    if (CL_SUCCESS != clBuildProgram(program, 1, &device, NULL, NULL, NULL))
+    {
+        std::cerr << "Failed to build program." << std::endl;
+        clReleaseProgram(program);
+        clReleaseContext(context);
+        return false;
+    }
+
+    cl_command_queue command_queue = clCreateCommandQueue(context, device, 0, &ret);
+    cl_mem result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, RangeBytes, NULL, &ret);
+    cl_kernel kernel = clCreateKernel(program, "check_local_range", &ret);
+
+    static const size_t shapes[][3] = {
+        { 1, 1, 1 }, { 3, 1, 1 }, { 7, 1, 1 }, { 16, 1, 1 }, { 3, 5, 1 }, { 2, 3, 5 }
+    };
+    static const cl_uint offsets[] = { 0, 1, 3, 8, 13, 15, 16 };
+    static const cl_uint sizes[] = { 0, 1, 5, 13, 15, 16, 17, 31, 33, 47, 63, 95 };
+
+    bool testPass = true;
+    unsigned char bytes[RangeBytes];
+    for (size_t s = 0; testPass && (s < (sizeof(shapes) / sizeof(shapes[0]))); ++s)
+    {
+        const size_t *shape = shapes[s];
+        if (((shape[0] * shape[1] * shape[2]) > maxItems) ||
+            (shape[0] > maxSizes[0]) || (shape[1] > maxSizes[1]) || (shape[2] > maxSizes[2]))
+        {
+            continue;
+        }
+
+        for (size_t o = 0; testPass && (o < (sizeof(offsets) / sizeof(offsets[0]))); ++o)
+        {
+            for (size_t n = 0; testPass && (n < (sizeof(sizes) / sizeof(sizes[0]))); ++n)
+            {
+                const cl_uint offset = offsets[o];
+                const cl_uint size = sizes[n];
+
+                clSetKernelArg(kernel, 0, sizeof(cl_mem), &result);
+                clSetKernelArg(kernel, 1, sizeof(cl_uint), &offset);
+                clSetKernelArg(kernel, 2, sizeof(cl_uint), &size);
+                ret = clEnqueueNDRangeKernel(command_queue, kernel, 3,
+                                             NULL, shape, shape, 0, NULL, NULL);
+                if (ret == CL_SUCCESS)
+                {
+                    ret = clEnqueueReadBuffer(command_queue, result, CL_TRUE, 0,
+                                              RangeBytes, bytes, 0, NULL, NULL);
+                }
+
+                if (ret != CL_SUCCESS)
+                {
+                    std::cerr << "Running range kernel failed with code " << ret << std::endl;
+                    testPass = false;
+                }
+                else if (!verifyRange(bytes, offset, size))
+                {
+                    std::cerr << "range of " << size << " bytes at offset " << offset
+                              << " not filled correctly by "
+                              << shape[0] << "x" << shape[1] << "x" << shape[2]
+                              << " work items" << std::endl;
+                    testPass = false;
+                }
+            }
+        }
+    }
+
+    bool cleanupOk = true;
+    cleanupOk &= CL_SUCCESS == clFinish(command_queue);
+    cleanupOk &= CL_SUCCESS == clReleaseKernel(kernel);
+    cleanupOk &= CL_SUCCESS == clReleaseProgram(program);
+    cleanupOk &= CL_SUCCESS == clReleaseMemObject(result);
+    cleanupOk &= CL_SUCCESS == clReleaseCommandQueue(command_queue);
+    cleanupOk &= CL_SUCCESS == clReleaseContext(context);
+    if (!cleanupOk)
+        std::cerr << "OpenCL program run was not cleaned up properly." << std::endl;
+
+    return testPass;
+}
 
 int main(int argc, char const* argv[])
 {
     const std::string original = "-original";
     const std::string transformed = "-transformed";
+    const std::string ranges = "-ranges";
     std::set<std::string> mode;
     mode.insert(original);
     mode.insert(transformed);
+    mode.insert(ranges);
 
     if ((argc != 2) || ((argc == 2) && !mode.count(argv[1]))) {
-        std::cerr << "Usage: cat FILE | " << argv[0] << " -original|-transformed"
+        std::cerr << "Usage: cat FILE | " << argv[0] << " -original|-transformed|-ranges"
                   << std::endl;
         std::cerr << "Check local memory is zeroed before copied back to system memory."
                   << std::endl
                   << "Use \"-original\" for opencl code and \"-transformed\" for webcl code."
+                  << std::endl
+                  << "Use \"-ranges\" to check that the zeroing of webcl code fills exactly"
+                  << std::endl
+                  << "the given local memory ranges."
                   << std::endl;
         return EXIT_FAILURE;
     }
@@ -254,7 +412,8 @@ int main(int argc, char const* argv[])
         return EXIT_FAILURE;
     }
 
-    const bool isInputTransformed = (transformed == argv[1]);
+    const bool isRangeTest = (ranges == argv[1]);
+    const bool isInputTransformed = isRangeTest || (transformed == argv[1]);
     std::cout << "Treating input source as " << (isInputTransformed ? "transformed" : "not transformed") << std::endl;
 
 
@@ -271,7 +430,9 @@ int main(int argc, char const* argv[])
              device != devices.end(); ++device)
         {
             printDevInfo(*device);
-            if (!testSource(*device, source, isInputTransformed))
+            const bool testPass = isRangeTest ?
+                testRanges(*device, source) : testSource(*device, source, isInputTransformed);
+            if (!testPass)
             {
                 return EXIT_FAILURE;
             }
@@ -1,5 +1,6 @@
 // RUN: %opencl-validator < %s
 // RUN: %webcl-validator %s | %check-empty-memory -transformed
+// RUN: %webcl-validator %s | %check-empty-memory -ranges
 
 __kernel void copy_local_mem(
     __global int *int_result,
@@ -0,0 +1,307 @@
+/*
+** Copyright (c) 2013 The Khronos Group Inc.
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and/or associated documentation files (the
+** "Materials"), to deal in the Materials without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Materials, and to
+** permit persons to whom the Materials are furnished to do so, subject to
+** the following conditions:
+**
+** The above copyright notice and this permission notice shall be included
+** in all copies or substantial portions of the Materials.
+**
+** THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+** MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+** IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+** CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+** TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+** MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+*/
+
+#include "WebCLSourceMap.hpp"
+
+#include <stdlib.h>
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void expect(const std::string &what, const std::string &actual, const std::string &expected)
+    {
+        if (actual == expected)
+            return;
+        std::cerr << what << ": expected \"" << expected
+                  << "\", got \"" << actual << "\"" << std::endl;
+        ++failures;
+    }
+
+    void expect(const std::string &what, unsigned actual, unsigned expected)
+    {
+        if (actual == expected)
+            return;
+        std::cerr << what << ": expected " << expected
+                  << ", got " << actual << std::endl;
+        ++failures;
+    }
+
+    std::string encode(const WebCLSourceMap &map,
+                       const std::string &output, const std::string &input)
+    {
+        std::string mappings;
+        map.encode(output, input, mappings);
+        return mappings;
+    }
+
+    void testEmpty()
+    {
+        WebCLSourceMap map;
+        expect("empty map input", map.getInput(3), 3);
+        expect("empty map output", map.getOutput(3), 3);
+        expect("empty map", encode(map, "a\nb", "a\nb"), "AAAA;AACA");
+    }
+
+    /// "ab" -> "aXYb"
+    void addInsertion(WebCLSourceMap &map)
+    {
+        map.add(0, 0);
+        map.add(1, 1);
+        map.add(1, 3);
+        map.add(2, 4);
+    }
+
+    void testInsertion()
+    {
+        WebCLSourceMap map;
+        addInsertion(map);
+        expect("insertion input 1", map.getInput(1), 1);
+        expect("insertion input 2", map.getInput(2), 1);
+        expect("insertion input 3", map.getInput(3), 1);
+        expect("insertion input 4", map.getInput(4), 2);
+        expect("insertion output 1", map.getOutput(1), 3);
+        // 'a' is copied, "XY" starts a segment of its own that maps
+        // to the insertion point and 'b' is copied again
+        expect("insertion", encode(map, "aXYb", "ab"), "AAAA,CAAC,EAAA");
+    }
+
+    void testLines()
+    {
+        // "abc\nd" -> "abcX\nd", the input column goes back on the
+        // next line
+        WebCLSourceMap inserted;
+        inserted.add(0, 0);
+        inserted.add(3, 3);
+        inserted.add(3, 4);
+        inserted.add(5, 6);
+        expect("line end insertion", encode(inserted, "abcX\nd", "abc\nd"), "AAAA,GAAG;AACH");
+
+        // "a\n\nb\n" -> "a\nb\n", a blank line is left out
+        WebCLSourceMap removed;
+        removed.add(0, 0);
+        removed.add(2, 2);
+        removed.add(3, 2);
+        removed.add(5, 4);
+        expect("line removal input", removed.getInput(2), 3);
+        expect("line removal", encode(removed, "a\nb\n", "a\n\nb\n"), "AAAA;AAEA");
+    }
+
+    void testLongVlq()
+    {
+        // columns above 15 need more than one base64 digit
+        const std::string input(16, 'a');
+        WebCLSourceMap map;
+        map.add(0, 0);
+        map.add(16, 16);
+        map.add(16, 17);
+        map.add(17, 18);
+        expect("long vlq", encode(map, input + "Xb", input + "b"), "AAAA,gBAAgB,CAAA");
+    }
+
+    void testAppend()
+    {
+        // "ab" -> "aXb"
+        WebCLSourceMap first;
+        first.add(0, 0);
+        first.add(1, 1);
+        first.add(1, 2);
+        first.add(2, 3);
+
+        // "aXb" -> "aXYb"
+        WebCLSourceMap second;
+        second.add(0, 0);
+        second.add(2, 2);
+        second.add(2, 3);
+        second.add(3, 4);
+
+        first.append(second);
+        expect("append input 0", first.getInput(0), 0);
+        expect("append input 1", first.getInput(1), 1);
+        expect("append input 2", first.getInput(2), 1);
+        expect("append input 3", first.getInput(3), 1);
+        expect("append input 4", first.getInput(4), 2);
+        expect("append", encode(first, "aXYb", "ab"), "AAAA,CAAC,EAAA");
+
+        // an empty map changes nothing
+        WebCLSourceMap inserted;
+        addInsertion(inserted);
+        inserted.append(WebCLSourceMap());
+        expect("append empty", encode(inserted, "aXYb", "ab"), "AAAA,CAAC,EAAA");
+
+        WebCLSourceMap empty;
+        empty.append(inserted);
+        expect("append to empty", encode(empty, "aXYb", "ab"), "AAAA,CAAC,EAAA");
+    }
+
+    std::string readAllInput()
+    {
+        // don't skip the whitespace while reading
+        std::cin >> std::noskipws;
+
+        // use stream iterators to copy the stream to a string
+        std::istream_iterator<char> begin(std::cin);
+        std::istream_iterator<char> end;
+        return std::string(begin, end);
+    }
+
+    bool decodeVlq(const std::string &mappings, std::string::size_type &i, int &value)
+    {
+        static const char digits[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        static const int continuation = 32;
+
+        int vlq = 0;
+        int shift = 0;
+        while (i < mappings.size()) {
+            const char *digit = std::strchr(digits, mappings[i++]);
+            if (!digit || !*digit)
+                return false;
+            const int bits = digit - digits;
+            vlq += (bits % continuation) << shift;
+            shift += 5;
+            if (bits < continuation) {
+                // the sign is stored in the least significant bit
+                value = (vlq & 1) ? -(vlq >> 1) : (vlq >> 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Prints each line of the validated source after the input line
+    /// and column, counting from 1, where the first segment of the
+    /// line maps to.
+    int decode(const std::string &output)
+    {
+        const std::string key = "\"source-map\" : \"";
+        const std::string::size_type begin = output.find(key);
+        const std::string::size_type end =
+            (begin == std::string::npos) ? begin : output.find('"', begin + key.size());
+        const std::string::size_type header =
+            (end == std::string::npos) ? end : output.find("*/\n\n", end);
+        if (header == std::string::npos) {
+            std::cerr << "No source map in the JSON header." << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        const std::string mappings = output.substr(begin + key.size(), end - begin - key.size());
+        const std::string source = output.substr(header + 4);
+
+        std::string::size_type line = 0;
+        std::string::size_type i = 0;
+        int inputLine = 0;
+        int inputColumn = 0;
+        while (line < source.size()) {
+            std::string::size_type lineEnd = source.find('\n', line);
+            if (lineEnd == std::string::npos)
+                lineEnd = source.size();
+            const std::string text = source.substr(line, lineEnd - line);
+
+            int column = 0;
+            bool first = true;
+            while ((i < mappings.size()) && (mappings[i] != ';')) {
+                if (!first && (mappings[i++] != ',')) {
+                    std::cerr << "Malformed source map at " << i << "." << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                int columnDelta = 0;
+                int sourceDelta = 0;
+                int lineDelta = 0;
+                int columnDeltaInInput = 0;
+                if (!decodeVlq(mappings, i, columnDelta) || !decodeVlq(mappings, i, sourceDelta) ||
+                    !decodeVlq(mappings, i, lineDelta) || !decodeVlq(mappings, i, columnDeltaInInput)) {
+                    std::cerr << "Malformed segment before " << i << "." << std::endl;
+                    return EXIT_FAILURE;
+                }
+                column += columnDelta;
+                inputLine += lineDelta;
+                inputColumn += columnDeltaInInput;
+                if ((column < 0) || (static_cast<unsigned>(column) >= text.size()) ||
+                    sourceDelta || (inputLine < 0) || (inputColumn < 0)) {
+                    std::cerr << "Invalid segment before " << i << "." << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                if (first)
+                    std::cout << (inputLine + 1) << ":" << (inputColumn + 1) << "| ";
+                first = false;
+            }
+            if (first)
+                std::cout << "-| ";
+            std::cout << text << std::endl;
+
+            if (i < mappings.size())
+                ++i;
+            line = lineEnd + 1;
+        }
+
+        if (i < mappings.size()) {
+            std::cerr << "Source map has more lines than the validated source." << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    const std::string unit = "-unit";
+    const std::string decoded = "-decode";
+    std::set<std::string> mode;
+    mode.insert(unit);
+    mode.insert(decoded);
+
+    if ((argc != 2) || ((argc == 2) && !mode.count(argv[1]))) {
+        std::cerr << "Usage: " << argv[0] << " -unit" << std::endl
+                  << "       cat FILE | " << argv[0] << " -decode" << std::endl;
+        std::cerr << "Use \"-unit\" to test the source map encoding and \"-decode\" to"
+                  << std::endl
+                  << "print the input positions of validated source lines read from stdin."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (decoded == argv[1])
+        return decode(readAllInput());
+
+    testEmpty();
+    testInsertion();
+    testLines();
+    testLongVlq();
+    testAppend();
+    if (failures) {
+        std::cerr << failures << " source map tests failed." << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All source map tests passed." << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,34 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s -compact-output | %opencl-validator
+// RUN: %webcl-validator %s -compact-output | %FileCheck %s
+
+// Compact output has no comments, indentation or blank line runs.
+// Line directives keep the line numbers of the remaining lines
+// where many lines are left out, e.g. after the joined lines of the
+// local memory zeroing macro. The JSON header is left as it is.
+
+// CHECK: {{^}}*/
+// CHECK-NOT: //
+// CHECK-NOT: {{^[ ]}}
+// CHECK: #define _WCL_LOCAL_RANGE_INIT(begin, end) do { __local uchar *start
+// CHECK-NEXT: #line {{[0-9]+}}
+// CHECK-NOT: //
+// CHECK-NOT: {{^[ ]}}
+// CHECK: __kernel void compact_output(
+// CHECK-NOT: //
+// CHECK-NOT: {{^[ ]}}
+// CHECK: scratch[{{.*}}] = input[{{.*}}];
+// CHECK-NOT: //
+// CHECK-NOT: {{^[ ]}}
+
+__kernel void compact_output(
+    __global int *input, __global int *output, __local int *scratch)
+{
+    // Comments are left out.
+    int i = get_global_id(0);
+
+    /* Also block
+       comments. */
+    scratch[i] = input[i];
+    output[i] = scratch[i];
+}
@@ -0,0 +1,36 @@
+// RUN: %webcl-validator %s -count-checks | %opencl-validator
+// RUN: %webcl-validator %s -count-checks -violation-mode=trap | %opencl-validator
+// RUN: %webcl-validator %s -count-checks | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -count-checks -violation-mode=trap | grep -v CHECK | %FileCheck --check-prefix=CHECK-TRAP %s
+// RUN: %webcl-validator %s -count-checks | %kernel-runner --webcl --nooutput --kernel count_checks --global int 8 --gcount 10 --counters 2 | grep '^check counters: 10,2,10,0,'
+
+// Each memory access check counts how many times it is executed and
+// how many times the access is out of bounds. The counters are
+// stored to a buffer given as the last kernel parameter. The JSON
+// header tells where each access is.
+
+// CHECK: "_wcl_check_counters" :
+// CHECK: "check-sites" :
+// CHECK: { "line" : {{[0-9]+}}, "column" : 5 },
+// CHECK: { "line" : {{[0-9]+}}, "column" : 5 }
+
+// CHECK: typedef struct {
+// CHECK: __global uint *cc;
+// CHECK: } _WclProgramAllocations;
+
+// CHECK: bool _wcl_counted_addr_check_global_1__u_uglobal__int__Ptr(__global uint *counters, __global int *addr, unsigned size, __global int *min0, __global int *max0)
+// CHECK: atomic_inc(&counters[0]);
+// CHECK: atomic_inc(&counters[1]);
+
+// CHECK: __kernel void count_checks(__global int *values, ulong _wcl_values_size, __global uint *_wcl_check_counters)
+// CHECK-TRAP: __kernel void count_checks(__global int *values, ulong _wcl_values_size, __global uint *_wcl_trap_status, __global uint *_wcl_check_counters)
+__kernel void count_checks(__global int *values)
+{
+    // CHECK: _wcl_check_counters
+    int i = get_global_id(0);
+
+    // CHECK: _wcl_counted_addr_clamp_global_1__u_uglobal__int__Ptr(_wcl_allocs->cc + 0, (values)+(i), 1,
+    values[i] = i;
+    // CHECK: _wcl_counted_addr_clamp_global_1__u_uglobal__int__Ptr(_wcl_allocs->cc + 2, (values)+(i / 2), 1,
+    values[i / 2] = 0;
+}
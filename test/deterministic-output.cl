@@ -0,0 +1,11 @@
+// RUN: sh %S/deterministic-output.sh %webcl-validator "" %S/*.cl
+// RUN: sh %S/deterministic-output.sh %webcl-validator "-count-checks -helper-clones=2 -report" %S/*.cl
+// RUN: sh %S/deterministic-output.sh %webcl-validator "-check-mode=offset -violation-mode=trap -limit-mode=scalar" %S/*.cl
+
+// Output mustn't depend on the addresses of AST nodes so that
+// compilation caches keyed by the validated source keep hitting.
+
+__kernel void deterministic_output(__global int *values)
+{
+    values[get_global_id(0)] = 0;
+}
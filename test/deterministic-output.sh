@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# deterministic-output.sh bin/webcl-validator "-count-checks" test/*.cl
+#
+# Validates each file twice with different heap layouts and fails if
+# the outputs aren't byte-identical. The second run allocates every
+# block with mmap, which places objects in a different address order
+# than the first run.
+
+# Location of validator binary.
+VALIDATOR="$1"
+# Options passed to validator.
+OPTIONS="$2"
+shift 2
+# Location of test files.
+TEST_FILES="$@"
+
+FIRST=`mktemp`
+SECOND=`mktemp`
+STATUS=0
+
+for i in $TEST_FILES ; do
+    $VALIDATOR $i $OPTIONS > $FIRST 2> /dev/null
+    MALLOC_MMAP_THRESHOLD_=0 MALLOC_PERTURB_=165 $VALIDATOR $i $OPTIONS > $SECOND 2> /dev/null
+    if ! cmp -s $FIRST $SECOND ; then
+        echo "Output of $i $OPTIONS depends on heap layout."
+        STATUS=1
+    fi
+done
+
+rm -f $FIRST $SECOND
+exit $STATUS
@@ -0,0 +1,51 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Private variables whose address is only dereferenced as a whole
+// aren't relocated and their accesses aren't checked.
+
+// CHECK: typedef struct {
+// CHECK-NOT: _wcl_kept;
+// CHECK: _wcl_escaping;
+// CHECK-NOT: _wcl_kept;
+// CHECK: } _WclPrivates
+
+// CHECK: void set_value(_WclProgramAllocations *_wcl_allocs, int *value, int x)
+void set_value(int *value, int x)
+{
+    // CHECK: *value = x;
+    *value = x;
+}
+
+void forward_value(int *value, int x)
+{
+    // CHECK: set_value(_wcl_allocs, value, x);
+    set_value(value, x);
+}
+
+void move_pointer(int *value)
+{
+    // CHECK: _wcl_addr_clamp_private_1_int__Ptr(
+    *(value + 1) = 0;
+}
+
+__kernel void escape_analysis(__global int *output)
+{
+    int i = get_global_id(0);
+
+    // CHECK: int kept = 0;
+    int kept = 0;
+    // CHECK: set_value(_wcl_allocs, &kept, i);
+    set_value(&kept, i);
+    // CHECK: forward_value(_wcl_allocs, &kept, i);
+    forward_value(&kept, i);
+    // CHECK: *&kept += 1;
+    *&kept += 1;
+
+    int escaping = 0;
+    // CHECK: move_pointer(_wcl_allocs, &_wcl_allocs->pa._wcl_escaping);
+    move_pointer(&escaping);
+
+    output[i] = kept + escaping;
+}
@@ -0,0 +1,44 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -DUSE_LOCAL | %opencl-validator
+// RUN: %webcl-validator %s -DUSE_LOCAL | grep -v CHECK | %FileCheck --check-prefix=CHECK-LOCAL %s
+
+// Only the macros of the general code that the generated code uses
+// are emitted.
+
+// CHECK-NOT: _WCL_MEMCPY
+// CHECK-NOT: _WCL_FILL_ZERO
+// CHECK-NOT: _WCL_FILLCHAR
+// CHECK-NOT: _WCL_LOCAL_RANGE_INIT
+// CHECK: #define _WCL_LAST
+// CHECK-NOT: _WCL_MEMCPY
+// CHECK-NOT: _WCL_FILL_ZERO
+// CHECK-NOT: _WCL_FILLCHAR
+// CHECK-NOT: _WCL_LOCAL_RANGE_INIT
+// CHECK: __kernel void general_code(
+
+// CHECK-LOCAL-NOT: _WCL_MEMCPY
+// CHECK-LOCAL: #define _WCL_LAST
+// CHECK-LOCAL: #define _WCL_FILLCHAR
+// CHECK-LOCAL: #define _WCL_LOCAL_RANGE_INIT
+// CHECK-LOCAL-NOT: _WCL_LOCAL_ITEM_RANGE_INIT
+// CHECK-LOCAL-NOT: _WCL_MEMCPY
+// CHECK-LOCAL: __kernel void general_code(
+// CHECK-LOCAL: _WCL_LOCAL_RANGE_INIT(
+
+__kernel void general_code(
+    __global int *input, __global int *output
+#ifdef USE_LOCAL
+    , __local int *scratch
+#endif
+    )
+{
+    int i = get_global_id(0);
+#ifdef USE_LOCAL
+    scratch[i] = input[i];
+    output[i] = scratch[i];
+#else
+    output[i] = input[i];
+#endif
+}
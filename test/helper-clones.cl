@@ -0,0 +1,42 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s -helper-clones=2 | %opencl-validator
+// RUN: %webcl-validator %s -helper-clones=2 | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -helper-clones=1 | grep -v CHECK | %FileCheck --check-prefix=CHECK-CAP %s
+
+// Helper functions are copied for each combination of memory objects
+// that kernels pass to them. The copies check accesses only against
+// the passed memory objects. Calls that would need more copies than
+// allowed keep calling the original function.
+
+// CHECK: int get_value(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+// CHECK: _wcl_addr_clamp_global_3__u_uglobal__int__Ptr((values)+(i), 1,
+// CHECK: int _wcl_get_value_clone_0(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+// CHECK: _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((values)+(i), 1, (__global int *)_wcl_allocs->gl.helper_clones__input_min, (__global int *)_wcl_allocs->gl.helper_clones__input_max, (__global int *)_wcl_allocs->gn)
+// CHECK: int _wcl_get_value_clone_1(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+// CHECK: _wcl_addr_clamp_global_1__u_uglobal__int__Ptr((values)+(i), 1, (__global int *)_wcl_allocs->gl.helper_clones__other_min, (__global int *)_wcl_allocs->gl.helper_clones__other_max, (__global int *)_wcl_allocs->gn)
+// CHECK-CAP: int _wcl_get_value_clone_0(
+// CHECK-CAP-NOT: _wcl_get_value_clone_1(
+int get_value(__global int *values, int i)
+{
+    return values[i];
+}
+
+// Copies call copies of their callees.
+// CHECK: int sum_pair(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+// CHECK: return get_value(_wcl_allocs, values, i) + get_value(_wcl_allocs, values, i + 1);
+// CHECK: int _wcl_sum_pair_clone_0(_WclProgramAllocations *_wcl_allocs, __global int *values, int i)
+// CHECK: return _wcl_get_value_clone_0(_wcl_allocs, values, i) + _wcl_get_value_clone_0(_wcl_allocs, values, i + 1);
+int sum_pair(__global int *values, int i)
+{
+    return get_value(values, i) + get_value(values, i + 1);
+}
+
+__kernel void helper_clones(
+    __global int *input, __global int *other, __global int *output)
+{
+    int i = get_global_id(0);
+
+    // CHECK: = _wcl_get_value_clone_0(_wcl_allocs, input, i) + _wcl_get_value_clone_1(_wcl_allocs, other, i) + _wcl_sum_pair_clone_0(_wcl_allocs, input, i);
+    // CHECK-CAP: = _wcl_get_value_clone_0(_wcl_allocs, input, i) + get_value(_wcl_allocs, other, i) + _wcl_sum_pair_clone_0(_wcl_allocs, input, i);
+    output[i] = get_value(input, i) + get_value(other, i) + sum_pair(input, i);
+}
@@ -74,6 +74,15 @@ public:
         }
     }
 
+    // Buffers like the counters of memory access checks don't have
+    // a size argument.
+    void appendBuffer(const cl_mem *buffer)
+    {
+        cl_int ret = clSetKernelArg(kernel_, argi_++, sizeof(cl_mem), buffer);
+        if (ret != CL_SUCCESS)
+            std::cerr << "clSetKernelArg failed for arg " << (argi_ - 1) << std::endl;
+    }
+
     void appendInt(cl_int val) {
         cl_int ret = clSetKernelArg(kernel_, argi_++, sizeof(val), &val);
         if (ret != CL_SUCCESS)
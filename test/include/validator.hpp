@@ -53,6 +53,12 @@ public:
         code_ = std::string(pos, end);
     }
 
+    explicit OpenCLValidator(const std::string &code)
+        : numPlatforms_(0), platform_(0), numDevices_(0), device_(0)
+        , context_(0), queue_(0), program_(0)
+        , code_(code) {
+    }
+
     virtual ~OpenCLValidator() {
         // Intel's implementation requires cleanup if clBuildProgram
         // fails. Otherwise we get these errors:
@@ -174,6 +180,13 @@ public:
         return name;
     }
 
+    cl_device_type getDeviceType() {
+        cl_device_type type = 0;
+        if (clGetDeviceInfo(device_, CL_DEVICE_TYPE, sizeof(type), &type, NULL) != CL_SUCCESS)
+            return 0;
+        return type;
+    }
+
     virtual void printProgramLog() {
         char log[10 * 1024];
         if (clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, sizeof(log), log, NULL) == CL_SUCCESS) {
@@ -0,0 +1,62 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Kernels that don't share helper functions get allocation
+// structures of their own. Kernels sharing helper functions share
+// an allocation structure.
+
+// CHECK: typedef struct {
+// CHECK: copy__input_min;
+// CHECK: copy_twice__output_min;
+// CHECK-NOT: scale__values_min;
+// CHECK: } _WclGlobalLimits_copy;
+// CHECK: typedef struct {
+// CHECK: _WclGlobalLimits_copy gl;
+// CHECK: } _WclProgramAllocations_copy;
+// CHECK: typedef struct {
+// CHECK-NOT: copy__input_min;
+// CHECK: scale__values_min;
+// CHECK: } _WclGlobalLimits_scale;
+// CHECK: typedef struct {
+// CHECK: _WclGlobalLimits_scale gl;
+// CHECK: } _WclProgramAllocations_scale;
+
+// CHECK: int get_value(_WclProgramAllocations_copy *_wcl_allocs, __global int *values, int i)
+int get_value(__global int *values, int i)
+{
+    return values[i];
+}
+
+// CHECK: void scale_value(_WclProgramAllocations_scale *_wcl_allocs, __global float *values, int i, float factor)
+void scale_value(__global float *values, int i, float factor)
+{
+    values[i] *= factor;
+}
+
+__kernel void copy(__global int *input, __global int *output)
+{
+    // CHECK: _WclProgramAllocations_copy _wcl_allocations_allocation = {
+    // CHECK: _WclProgramAllocations_copy *_wcl_allocs = &_wcl_allocations_allocation;
+    int i = get_global_id(0);
+    // CHECK: get_value(_wcl_allocs, input, i)
+    output[i] = get_value(input, i);
+}
+
+__kernel void copy_twice(__global int *input, __global int *output)
+{
+    // CHECK: _WclProgramAllocations_copy _wcl_allocations_allocation = {
+    // CHECK: _WclProgramAllocations_copy *_wcl_allocs = &_wcl_allocations_allocation;
+    int i = get_global_id(0);
+    output[2 * i] = get_value(input, i);
+    output[2 * i + 1] = get_value(input, i);
+}
+
+__kernel void scale(__global float *values, float factor)
+{
+    // CHECK: _WclProgramAllocations_scale _wcl_allocations_allocation = {
+    // CHECK: _WclProgramAllocations_scale *_wcl_allocs = &_wcl_allocations_allocation;
+    int i = get_global_id(0);
+    // CHECK: scale_value(_wcl_allocs, values, i, factor);
+    scale_value(values, i, factor);
+}
@@ -0,0 +1,42 @@
+// RUN: %webcl-validator %s -report | %opencl-validator
+// RUN: %webcl-validator %s -report | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -report -violation-mode=trap | grep -v CHECK | %FileCheck --check-prefix=CHECK-TRAP %s
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck --check-prefix=CHECK-NONE %s
+
+// The JSON header reports how each kernel has been instrumented.
+
+// CHECK-NONE: "kernels" :
+// CHECK-NONE-NOT: "reports" :
+
+// CHECK: "reports" :
+// CHECK: "kernel_report" :
+// CHECK-NEXT: {
+// CHECK-NEXT: "private-checks" : 1,
+// CHECK-NEXT: "local-checks" : 1,
+// CHECK-NEXT: "constant-checks" : 0,
+// CHECK-NEXT: "global-checks" : 2,
+// CHECK-NEXT: "check-limits" : 6,
+// CHECK-NEXT: "max-check-limits" : 2,
+// CHECK-NEXT: "private-bytes" : 8,
+// CHECK-NEXT: "local-bytes" : 0,
+// CHECK-NEXT: "constant-bytes" : 0,
+// CHECK-NEXT: "wrappers" : 0,
+// CHECK-NEXT: "allocations-bytes" : {{[0-9]+}},
+// CHECK-NEXT: "local-zeroing-bytes" : 16,
+// CHECK-NEXT: "added-parameters" : 3
+// CHECK-NEXT: }
+
+// The status word is an added parameter too.
+// CHECK-TRAP: "kernel_report" :
+// CHECK-TRAP: "added-parameters" : 4
+
+__kernel void kernel_report(
+    __global int *input, __global int *output, __local int *scratch)
+{
+    int i = get_global_id(0);
+    int pair[2] = { 1, 2 };
+    int *p = pair;
+
+    scratch[i] = input[i] + p[i & 1];
+    output[i] = i;
+}
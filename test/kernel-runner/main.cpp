@@ -113,7 +113,7 @@ typedef struct {
 
 bool testSource(int id, cl_device_id device, std::string const& source, 
     std::string &kernelName, int globalWorkSize, int loopCount, std::vector<BufferArg> &buffers, bool isTransformed, 
-    char* programOutput, bool debug, bool hasOutput)
+    char* programOutput, bool debug, bool hasOutput, int counterSites)
 {
     using llvm::sys::TimeValue;
 
@@ -213,6 +213,18 @@ bool testSource(int id, cl_device_id device, std::string const& source,
         }
     }
 
+    // two counters for each check site
+    std::vector<cl_uint> counters(2 * counterSites + 1, 0);
+    cl_mem counterBuf = NULL;
+    if (counterSites > 0) {
+        if (debug) std::cerr << "Adding check counter buffer\n";
+        counterBuf = clCreateBuffer(context,
+            CL_MEM_READ_WRITE|CL_MEM_COPY_HOST_PTR,
+            counters.size() * sizeof(cl_uint), &counters[0], &ret);
+        cleanUpVec.push_back(counterBuf);
+        args.appendBuffer(&counterBuf);
+    }
+
     ret = clFinish(command_queue);
 
     TimeValue enqueue_kernel_begin = TimeValue::now();
@@ -244,6 +256,20 @@ bool testSource(int id, cl_device_id device, std::string const& source,
               << "enqueue_kernel: " << enqueue_kernel_ms << "ms\n"
               << "total:" << elapsed_ms << "ms\n";
 
+    if (counterSites > 0) {
+        ret = clEnqueueReadBuffer(command_queue, counterBuf, CL_TRUE, 0,
+                                  counters.size() * sizeof(cl_uint), &counters[0], 0, NULL, NULL);
+        if (ret != CL_SUCCESS) {
+            std::cerr << "Failed to read check counters." << std::endl;
+            return false;
+        }
+        std::cout << "check counters: ";
+        for (int i = 0; i < 2 * counterSites; i++) {
+            std::cout << counters[i] << ",";
+        }
+        std::cout << std::endl;
+    }
+
     bool testPass = true;
     if (hasOutput)
     {
@@ -297,6 +323,9 @@ std::string usage =
 "/// -d         Print out parsed options and other debug.\n"
 "/// --nooutput Do not require char* ret_val argument..\n"
 "/// --loop     <int> How many times kernel will be called.\n"
+"/// --counters <sites> Adds counter buffer of a kernel validated with\n"
+"///            -count-checks and prints the execution and violation\n"
+"///            counts of each check site after running the kernel.\n"
 "///\n"
 "/// All buffers are initialized with values from 0 to buffer size.\n"
 "/// <type> can be one of int,float,int<2-16>,float<2-16>\n"
@@ -347,6 +376,8 @@ int main(int argc, char const* argv[])
     scalar.insert("--scalar");
     std::set<std::string> loopcount;
     loopcount.insert("--loop");
+    std::set<std::string> counters;
+    counters.insert("--counters");
 
     std::vector<BufferArg> buffers;
     std::string kernel = "test_kernel";
@@ -355,6 +386,7 @@ int main(int argc, char const* argv[])
     int globalWorkItemCount = 1;
     bool addOutput = true;
     int loopCount = 1;
+    int counterSites = 0;
 
     std::map<std::string, int> atotype;
     atotype["int"]   = 0;
@@ -429,6 +461,9 @@ int main(int argc, char const* argv[])
         } else if (loopcount.count(argv[i])) {
             loopCount = atoi(argv[i+1]);
             i++;
+        } else if (counters.count(argv[i])) {
+            counterSites = atoi(argv[i+1]);
+            i++;
         }
     }
     if (printDebug) {
@@ -457,7 +492,7 @@ int main(int argc, char const* argv[])
              device != devices.end(); ++device)
         {        
             if (!checkDevInfo(*device)) {
-                if (!testSource(id, *device, source, kernel, globalWorkItemCount, loopCount, buffers, useWebCL, &retVal[0], printDebug, addOutput))
+                if (!testSource(id, *device, source, kernel, globalWorkItemCount, loopCount, buffers, useWebCL, &retVal[0], printDebug, addOutput, counterSites))
                 {
                     return EXIT_FAILURE;
                 }
@@ -0,0 +1,28 @@
+// RUN: %webcl-validator %s 2>&1 | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -compact-output 2>&1 | grep -v CHECK | %FileCheck %s
+
+// Log messages tell the line of the input file they refer to, even
+// though the earlier stages have changed the lines of the source.
+
+#define IMAGE image3d_t
+
+#if 0
+// A variant that isn't compiled. It is left out of the preprocessed
+// source together with the lines of its block.
+__kernel void log_message_lines(
+    __global int *array,
+    image2d_t m)
+{
+    const int i = get_global_id(0);
+    array[i] = get_image_width(m);
+}
+#endif
+
+__kernel void log_message_lines(
+    __global int *array,
+// CHECK: line [[@LINE+1]]: error: WebCL doesn't support 3D images.
+    IMAGE m)
+{
+    const int i = get_global_id(0);
+    array[i] = get_image_width(m);
+}
@@ -1,5 +1,9 @@
 // RUN: %opencl-validator < %s
 // RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Accesses nested in other accesses must keep their own checks, so
+// they are replaced before the accesses that contain them.
 
 typedef struct {
     int field;
@@ -10,7 +14,7 @@ typedef struct {
 } SStruct;
 
 __kernel void nested_transformation(
-    // CHECK: __global int *result, unsigned long wcl_result_size)
+    // CHECK: __global int *result, ulong _wcl_result_size)
     __global int *result)
 {
     int value = 0;
@@ -29,8 +33,12 @@ __kernel void nested_transformation(
     *(pointer + *pointer + array[0] + pfstruct->field) =
         array[*pointer + array[0] + pfstruct->field];
 
+    // CHECK: = (*({{(_wcl_checked_[0-9]+ = )?}}_wcl_addr_clamp_private_1_int__Ptr(({{[^)]*}}array2)+((*{{_wcl_checked_[0-9]+\)|\(}}
     (**pointer2) = array2[array[0]];
+    // CHECK-NOT: {{array2?\[}}
+    // CHECK: (*({{(_wcl_checked_[0-9]+ = )?}}_wcl_addr_clamp_private_1_int__Ptr(({{[^)]*}}array2)+((*{{_wcl_checked_[0-9]+\)|\(}}
     array2[array[0]] = psstruct->fstruct->field;
+    // CHECK-NOT: {{array2?\[}}
     psstruct->fstruct->field = (**pointer2);
 
     result[get_global_id(0)] = ((psstruct + *pointer)->fstruct + array[0])->field;
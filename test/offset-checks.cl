@@ -0,0 +1,25 @@
+// RUN: %webcl-validator %s -check-mode=offset | %opencl-validator
+// RUN: %webcl-validator %s -check-mode=offset | grep -v CHECK | %FileCheck %s
+
+// CHECK: __global int *_wcl_idx_clamp_global__u_uglobal__int__Ptr(__global int *base, ulong index, ulong size, __global int *asnull)
+// CHECK: return (index < size) ? (base + index) : asnull;
+
+__kernel void offset_checks(
+    // CHECK: __global int *input, ulong _wcl_input_size,
+    __global int *input,
+    // CHECK: __global int *output, ulong _wcl_output_size,
+    __global int *output,
+    // CHECK: __global int *moving, ulong _wcl_moving_size)
+    __global int *moving)
+{
+    const int i = get_global_id(0);
+
+    // CHECK: (*(_wcl_idx_clamp_global__u_uglobal__int__Ptr((output), (i), _wcl_output_size, (__global int *)_wcl_allocs->gn))) = (*(_wcl_idx_clamp_global__u_uglobal__int__Ptr((input), (i + 1), _wcl_input_size, (__global int *)_wcl_allocs->gn)));
+    output[i] = input[i + 1];
+
+    // Modified parameters don't point to the start of the memory
+    // object anymore.
+    ++moving;
+    // CHECK: (*(_wcl_addr_clamp_global_3__u_uglobal__int__Ptr((moving)+(i), 1,
+    moving[i] = 0;
+}
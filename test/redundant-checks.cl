@@ -0,0 +1,46 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Identical accesses that are always preceded by an earlier access
+// reuse the address that was checked by the earlier access.
+
+__kernel void redundant_checks(
+    __global int *a, __global int *b, __global int *c, int n)
+{
+    // CHECK: __global int * _wcl_checked_0;
+    // CHECK: __global int * _wcl_checked_1;
+    // CHECK-NOT: _wcl_checked_2;
+    int i = get_global_id(0);
+
+    // CHECK: (*(_wcl_checked_0 = _wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((a)+(i), 1, {{.*}}))) += (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((b)+(i), 1,
+    a[i] += b[i];
+    // CHECK: (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((c)+(i), 1, {{.*}}))) = (*_wcl_checked_0);
+    c[i] = a[i];
+
+    if (i > 0) {
+        // CHECK: = (*_wcl_checked_0);
+        b[i - 1] = a[i];
+    }
+
+    // CHECK: while ((*(_wcl_checked_1 = _wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((b)+(n), 1,
+    while (b[n] > 0) {
+        // CHECK: (*_wcl_checked_1) -= 1;
+        b[n] -= 1;
+    }
+
+    // Accesses that may be skipped don't store checked addresses.
+    if (n > 1)
+        // CHECK: (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((c)+(n), 1,
+        c[n] = 1;
+    // CHECK: (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((c)+(n), 1,
+    c[n] += 2;
+
+    // Accesses with modified indices are always checked.
+    int j = i;
+    // CHECK: (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((b)+(j), 1,
+    b[j] = 0;
+    ++j;
+    // CHECK: (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((b)+(j), 1,
+    b[j] = 1;
+}
@@ -0,0 +1,25 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Relocated private arrays are initialized directly in the relocated
+// storage instead of being copied from the original variable.
+
+__kernel void relocated_array_init(
+    __global int *input, __global int *output)
+{
+    int i = get_global_id(0);
+
+    // CHECK: _wcl_allocs->pa._wcl_full[0] = 1; _wcl_allocs->pa._wcl_full[1] = 2; _wcl_allocs->pa._wcl_full[2] = 3 ;
+    int full[3] = { 1, 2, 3 };
+    // CHECK: _wcl_allocs->pa._wcl_partial[0] = (*(_wcl_addr_clamp_global_{{[0-9]+}}__u_uglobal__int__Ptr((input)+(i), 1, {{.*}}) ; _WCL_FILL_ZERO(_wcl_allocs->pa._wcl_partial, 1);
+    int partial[4] = { input[i] };
+    // CHECK: _wcl_allocs->pa._wcl_trailing[0] = i; _wcl_allocs->pa._wcl_trailing[1] = i + 1;
+    int trailing[2] = { i, i + 1, };
+
+    // Arrays that share the declaration are still copied.
+    // CHECK: _WCL_MEMCPY(_wcl_allocs->pa._wcl_shared,shared);
+    int other = 0, shared[2] = { 4, 5 };
+
+    output[i] = full[i % 3] + partial[i % 4] + trailing[i % 2] + shared[i % 2] + other;
+}
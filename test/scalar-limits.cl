@@ -0,0 +1,40 @@
+// RUN: %webcl-validator %s -limit-mode=scalar | %opencl-validator
+// RUN: %webcl-validator %s -limit-mode=scalar | grep -v CHECK | %FileCheck %s
+
+// Limits are kept in kernel scope variables and passed by value to
+// the helper functions that use them.
+
+// CHECK-NOT: _WclGlobalLimits
+// CHECK: typedef struct {
+// CHECK-NOT: gl;
+// CHECK: __global uint *gn;
+// CHECK: } _WclProgramAllocations;
+
+// CHECK: int get_value(_WclProgramAllocations *_wcl_allocs, __global int *_wcl_scalar_limits__input_min, __global int *_wcl_scalar_limits__input_max, __global int *_wcl_scalar_limits__output_min, __global int *_wcl_scalar_limits__output_max, __global int *values, int i)
+int get_value(__global int *values, int i)
+{
+    // CHECK: (__global int *)_wcl_scalar_limits__input_min, (__global int *)_wcl_scalar_limits__input_max
+    return values[i];
+}
+
+// Helpers that don't access memory don't get limits.
+// CHECK: int twice(_WclProgramAllocations *_wcl_allocs, int value)
+int twice(int value)
+{
+    return 2 * value;
+}
+
+__kernel void scalar_limits(__global int *input, __global int *output)
+{
+    // CHECK: __global int *_wcl_scalar_limits__input_min = &input[0];
+    // CHECK: __global int *_wcl_scalar_limits__input_max = &input[_wcl_input_size];
+    // CHECK: __global int *_wcl_scalar_limits__output_min = &output[0];
+    // CHECK: __global int *_wcl_scalar_limits__output_max = &output[_wcl_output_size];
+    // CHECK: _WclProgramAllocations _wcl_allocations_allocation = {
+    // CHECK-NEXT: 0
+    // CHECK-NEXT: };
+    int i = get_global_id(0);
+
+    // CHECK: twice(_wcl_allocs, get_value(_wcl_allocs, _wcl_scalar_limits__input_min, _wcl_scalar_limits__input_max, _wcl_scalar_limits__output_min, _wcl_scalar_limits__output_max, input, i))
+    output[i] = twice(get_value(input, i));
+}
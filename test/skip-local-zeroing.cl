@@ -0,0 +1,56 @@
+// RUN: %opencl-validator < %s
+// RUN: %webcl-validator %s | %opencl-validator
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck %s
+
+// Local memory ranges that each work item writes at its local id
+// before the first barrier are zeroed only if they don't hold
+// exactly one element per work item.
+
+__kernel void skip_local_zeroing(
+    __global float *input, __global float *output,
+    __local float *tile, __local float *scratch)
+{
+    // CHECK: _WCL_LOCAL_ITEM_RANGE_INIT(_wcl_allocs->ll.skip_local_zeroing__tile_min, _wcl_allocs->ll.skip_local_zeroing__tile_max, float);
+    // CHECK: _WCL_LOCAL_RANGE_INIT(_wcl_allocs->ll.skip_local_zeroing__scratch_min, _wcl_allocs->ll.skip_local_zeroing__scratch_max);
+    // CHECK: barrier(CLK_LOCAL_MEM_FENCE);
+
+    const size_t lid = get_local_id(0);
+    const size_t gid = get_global_id(0);
+
+    tile[lid] = input[gid];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    scratch[lid] = tile[(lid + 1) % get_local_size(0)];
+    output[gid] = scratch[lid];
+}
+
+// Narrowed local ids wrap around in large work groups, so the ranges
+// indexed with them are always zeroed.
+
+__kernel void narrow_uchar_id(
+    __global float *input, __local float *tile)
+{
+    // CHECK: _WCL_LOCAL_RANGE_INIT(_wcl_allocs->ll.narrow_uchar_id__tile_min, _wcl_allocs->ll.narrow_uchar_id__tile_max);
+    // CHECK: barrier(CLK_LOCAL_MEM_FENCE);
+
+    const uchar lid = get_local_id(0);
+
+    tile[lid] = input[get_global_id(0)];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    input[get_global_id(0)] = tile[0];
+}
+
+__kernel void narrow_ushort_id(
+    __global float *input, __local float *tile)
+{
+    // CHECK: _WCL_LOCAL_RANGE_INIT(_wcl_allocs->ll.narrow_ushort_id__tile_min, _wcl_allocs->ll.narrow_ushort_id__tile_max);
+    // CHECK: barrier(CLK_LOCAL_MEM_FENCE);
+
+    ushort lid = get_local_id(0);
+
+    tile[lid] = input[get_global_id(0)];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    input[get_global_id(0)] = tile[0];
+}
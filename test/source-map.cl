@@ -0,0 +1,36 @@
+// RUN: %check-source-map -unit
+// RUN: %webcl-validator %s -source-map | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -source-map -compact-output | grep -v CHECK | %FileCheck %s
+// RUN: %webcl-validator %s -source-map | %check-source-map -decode | grep -v CHECK | %FileCheck --check-prefix=CHECK-MAP %s
+// RUN: %webcl-validator %s -source-map -compact-output | %check-source-map -decode | grep -v CHECK | %FileCheck --check-prefix=CHECK-MAP %s
+// RUN: %webcl-validator %s | grep -v CHECK | %FileCheck --check-prefix=CHECK-NONE %s
+
+// The JSON header maps the validated source back to the input
+// source, which can then be used to attribute compiler diagnostics
+// and profiles to the lines of the input source.
+
+// CHECK: "source-map" : "{{[A-Za-z0-9+/]+[A-Za-z0-9+/,;]*}}"
+// CHECK: */
+// CHECK: __kernel void source_map(
+
+// CHECK-NONE-NOT: "source-map" :
+
+// The decoded lines of the validated source are prefixed with the
+// input line and column of their first segment. Code inserted at the
+// start of the kernel body maps to the position after the opening
+// brace. Indentation is left out of compact output, so the columns
+// of indented lines vary.
+
+#define INDEX get_global_id(0)
+
+// CHECK-MAP: [[@LINE+1]]:1| __kernel void source_map(
+__kernel void source_map(
+    __global int *input, __global int *output)
+// CHECK-MAP: [[@LINE+2]]:1| {
+// CHECK-MAP-NEXT: [[@LINE+1]]:2| {{ *}}_WclProgramAllocations _wcl_allocations_allocation = {
+{
+    // CHECK-MAP: [[@LINE+1]]:{{[0-9]+}}| {{ *}}int i = get_global_id(0);
+    int i = INDEX;
+    // CHECK-MAP: [[@LINE+1]]:{{[0-9]+}}| {{.*}}_wcl_allocs->gl.source_map__output_min
+    output[i] = input[i];
+}
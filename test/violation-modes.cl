@@ -0,0 +1,55 @@
+// RUN: %webcl-validator %s -violation-mode=mask | %opencl-validator
+// RUN: %webcl-validator %s -violation-mode=trap | %opencl-validator
+// RUN: %webcl-validator %s -violation-mode=mask | grep -v CHECK | %FileCheck --check-prefix=CHECK-MASK %s
+// RUN: %webcl-validator %s -violation-mode=trap | grep -v CHECK | %FileCheck --check-prefix=CHECK-TRAP %s
+
+// Out of bounds stores are skipped and loads read zero instead of
+// accessing the null area. The stored value is still evaluated. In
+// trap mode the violation is also recorded to the status word given
+// as the last kernel parameter.
+
+// CHECK-TRAP: "_wcl_trap_status" :
+
+// Null areas aren't needed if all accesses are guarded.
+// CHECK-MASK: typedef struct {
+// CHECK-MASK-NOT: gn;
+// CHECK-MASK: } _WclProgramAllocations_violation_modes;
+// CHECK-TRAP: typedef struct {
+// CHECK-TRAP-NOT: gn;
+// CHECK-TRAP: __global uint *ts;
+// CHECK-TRAP: } _WclProgramAllocations_violation_modes;
+
+int get_value(__global int *values, int i)
+{
+    // CHECK-MASK: { int _wcl_value = 0; if (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_0 = (values)+(i + 1)), 1, {{.*}})) (*_wcl_guarded_0) = _wcl_value; }
+    // CHECK-TRAP: { int _wcl_value = 0; if (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_0 = (values)+(i + 1)), 1, {{.*}})) (*_wcl_guarded_0) = _wcl_value; else *_wcl_allocs->ts = 1; }
+    values[i + 1] = 0;
+    // CHECK-MASK: return (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_1 = (values)+(i)), 1, {{.*}}) ? (*_wcl_guarded_1) : (int) 0);
+    // CHECK-TRAP: return (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_1 = (values)+(i)), 1, {{.*}}) ? (*_wcl_guarded_1) : (*_wcl_allocs->ts = 1, (int) 0));
+    return values[i];
+}
+
+// CHECK-TRAP: __kernel void violation_modes(__global int *input, ulong _wcl_input_size, __global int *output, ulong _wcl_output_size, __global uint *_wcl_trap_status)
+__kernel void violation_modes(__global int *input, __global int *output)
+{
+    // CHECK-MASK-NOT: _WCL_SET_NULL(
+    // CHECK-TRAP: _wcl_trap_status
+    // CHECK-TRAP-NOT: _WCL_SET_NULL(
+    int i = get_global_id(0);
+
+    // CHECK-MASK: { int _wcl_value = get_value(_wcl_allocs, input, i); if (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_0 = (output)+(i)), 1, {{.*}})) (*_wcl_guarded_0) = _wcl_value; }
+    // CHECK-TRAP: { int _wcl_value = get_value(_wcl_allocs, input, i); if (_wcl_addr_check_global_2__u_uglobal__int__Ptr((_wcl_guarded_0 = (output)+(i)), 1, {{.*}})) (*_wcl_guarded_0) = _wcl_value; else { *_wcl_allocs->ts = 1; return; } }
+    output[i] = get_value(input, i);
+}
+
+// Work items don't return before a barrier that the other work items
+// of the group wait at.
+__kernel void trap_before_barrier(__global int *output)
+{
+    int i = get_global_id(0);
+
+    // CHECK-MASK: { int _wcl_value = 1; if (_wcl_addr_check_global_{{.*}}((_wcl_guarded_0 = (output)+(i)), 1, {{.*}})) (*_wcl_guarded_0) += _wcl_value; }
+    // CHECK-TRAP: { int _wcl_value = 1; if (_wcl_addr_check_global_{{.*}}((_wcl_guarded_0 = (output)+(i)), 1, {{.*}})) (*_wcl_guarded_0) += _wcl_value; else *_wcl_allocs->ts = 1; }
+    output[i] += 1;
+    barrier(CLK_GLOBAL_MEM_FENCE);
+}